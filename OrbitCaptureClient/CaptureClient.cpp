@@ -13,6 +13,11 @@
 
 ABSL_DECLARE_FLAG(uint16_t, sampling_rate);
 ABSL_DECLARE_FLAG(bool, frame_pointer_unwinding);
+ABSL_DECLARE_FLAG(bool, event_driven_ring_buffer_reading);
+ABSL_DECLARE_FLAG(uint32_t, ring_buffer_reader_threads);
+ABSL_DECLARE_FLAG(uint32_t, stack_dump_size);
+ABSL_DECLARE_FLAG(bool, adaptive_stack_copy);
+ABSL_DECLARE_FLAG(uint32_t, unwinding_threads);
 
 using orbit_client_protos::FunctionInfo;
 
@@ -37,7 +42,7 @@ ErrorMessageOr<void> CaptureClient::StartCapture(
     ThreadPool* thread_pool, int32_t process_id, std::string process_name,
     std::shared_ptr<Process> process,
     absl::flat_hash_map<uint64_t, FunctionInfo> selected_functions,
-    TracepointInfoSet selected_tracepoints) {
+    TracepointInfoSet selected_tracepoints, CaptureEventRecorder* capture_event_recorder) {
   absl::MutexLock lock(&state_mutex_);
   if (state_ != State::kStopped) {
     return ErrorMessage(
@@ -49,9 +54,10 @@ ErrorMessageOr<void> CaptureClient::StartCapture(
   thread_pool->Schedule([this, process_id, process_name = std::move(process_name),
                          process = std::move(process),
                          selected_functions = std::move(selected_functions),
-                         selected_tracepoints = std::move(selected_tracepoints)]() mutable {
+                         selected_tracepoints = std::move(selected_tracepoints),
+                         capture_event_recorder]() mutable {
     Capture(process_id, std::move(process_name), std::move(process), std::move(selected_functions),
-            std::move(selected_tracepoints));
+            std::move(selected_tracepoints), capture_event_recorder);
   });
 
   return outcome::success();
@@ -60,7 +66,8 @@ ErrorMessageOr<void> CaptureClient::StartCapture(
 void CaptureClient::Capture(int32_t process_id, std::string process_name,
                             std::shared_ptr<Process> process,
                             absl::flat_hash_map<uint64_t, FunctionInfo> selected_functions,
-                            TracepointInfoSet selected_tracepoints) {
+                            TracepointInfoSet selected_tracepoints,
+                            CaptureEventRecorder* capture_event_recorder) {
   CHECK(reader_writer_ == nullptr);
 
   grpc::ClientContext context;
@@ -79,9 +86,18 @@ void CaptureClient::Capture(int32_t process_id, std::string process_name,
       capture_options->set_unwinding_method(CaptureOptions::kFramePointers);
     } else {
       capture_options->set_unwinding_method(CaptureOptions::kDwarf);
+      capture_options->set_stack_dump_size(absl::GetFlag(FLAGS_stack_dump_size));
+      capture_options->set_adaptive_stack_copy(absl::GetFlag(FLAGS_adaptive_stack_copy));
+      capture_options->set_unwinding_thread_count(absl::GetFlag(FLAGS_unwinding_threads));
     }
   }
 
+  if (absl::GetFlag(FLAGS_event_driven_ring_buffer_reading)) {
+    capture_options->set_ring_buffer_reading_mode(CaptureOptions::kEventDriven);
+  }
+  capture_options->set_ring_buffer_reader_thread_count(
+      absl::GetFlag(FLAGS_ring_buffer_reader_threads));
+
   capture_options->set_trace_gpu_driver(true);
   for (const auto& pair : selected_functions) {
     const FunctionInfo& function = pair.second;
@@ -116,6 +132,9 @@ void CaptureClient::Capture(int32_t process_id, std::string process_name,
 
   CaptureEventProcessor event_processor(capture_listener_);
 
+  if (capture_event_recorder != nullptr) {
+    capture_event_recorder->OnCaptureStarted(process_id, process_name, selected_functions);
+  }
   capture_listener_->OnCaptureStarted(process_id, std::move(process_name), std::move(process),
                                       std::move(selected_functions),
                                       std::move(selected_tracepoints));
@@ -123,6 +142,12 @@ void CaptureClient::Capture(int32_t process_id, std::string process_name,
   CaptureResponse response;
   while (!force_stop_ && reader_writer_->Read(&response)) {
     event_processor.ProcessEvents(response.capture_events());
+    if (capture_event_recorder != nullptr) {
+      capture_event_recorder->RecordCaptureResponse(std::move(response));
+    }
+  }
+  if (capture_event_recorder != nullptr) {
+    capture_event_recorder->OnCaptureFinished();
   }
   if (force_stop_) {
     capture_listener_->OnCaptureFailed(
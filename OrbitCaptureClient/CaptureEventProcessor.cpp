@@ -4,6 +4,8 @@
 
 #include "OrbitCaptureClient/CaptureEventProcessor.h"
 
+#include <vector>
+
 #include "capture_data.pb.h"
 
 using orbit_client_protos::CallstackEvent;
@@ -76,19 +78,24 @@ void CaptureEventProcessor::ProcessInternedCallstack(InternedCallstack interned_
   if (callstack_intern_pool.contains(interned_callstack.key())) {
     ERROR("Overwriting InternedCallstack with key %llu", interned_callstack.key());
   }
+  // The callstack is hashed once here, not at each sample that refers to it.
+  const Callstack& callstack = interned_callstack.intern();
   callstack_intern_pool.emplace(interned_callstack.key(),
-                                std::move(*interned_callstack.mutable_intern()));
+                                CallStack({callstack.pcs().begin(), callstack.pcs().end()}));
 }
 
 void CaptureEventProcessor::ProcessCallstackSample(const CallstackSample& callstack_sample) {
-  Callstack callstack;
+  uint64_t hash;
   if (callstack_sample.callstack_or_key_case() == CallstackSample::kCallstackKey) {
-    callstack = callstack_intern_pool[callstack_sample.callstack_key()];
+    auto callstack_it =
+        callstack_intern_pool.try_emplace(callstack_sample.callstack_key(), std::vector<uint64_t>{})
+            .first;
+    hash = GetCallstackHashAndSendToListenerIfNecessary(callstack_it->second);
   } else {
-    callstack = callstack_sample.callstack();
+    const Callstack& callstack = callstack_sample.callstack();
+    hash = GetCallstackHashAndSendToListenerIfNecessary(
+        CallStack({callstack.pcs().begin(), callstack.pcs().end()}));
   }
-
-  uint64_t hash = GetCallstackHashAndSendToListenerIfNecessary(callstack);
   CallstackEvent callstack_event;
   callstack_event.set_time(callstack_sample.timestamp_ns());
   callstack_event.set_callstack_hash(hash);
@@ -201,14 +208,12 @@ void CaptureEventProcessor::ProcessAddressInfo(const AddressInfo& address_info)
 }
 
 uint64_t CaptureEventProcessor::GetCallstackHashAndSendToListenerIfNecessary(
-    const Callstack& callstack) {
-  CallStack cs({callstack.pcs().begin(), callstack.pcs().end()});
-  // TODO: Compute the hash without creating the CallStack if not necessary.
-  uint64_t hash = cs.GetHash();
+    const CallStack& callstack) {
+  uint64_t hash = callstack.GetHash();
 
   if (!callstack_hashes_seen_.contains(hash)) {
     callstack_hashes_seen_.emplace(hash);
-    capture_listener_->OnUniqueCallStack(cs);
+    capture_listener_->OnUniqueCallStack(callstack);
   }
   return hash;
 }
@@ -13,6 +13,17 @@
 
 ABSL_FLAG(uint16_t, sampling_rate, 1000, "Frequency of callstack sampling in samples per second");
 ABSL_FLAG(bool, frame_pointer_unwinding, false, "Use frame pointers for unwinding");
+ABSL_FLAG(bool, event_driven_ring_buffer_reading, false,
+          "Let the service wait for the kernel to signal new events instead of polling");
+ABSL_FLAG(uint32_t, ring_buffer_reader_threads, 1,
+          "Number of threads of the service that read the events, each for a group of cores");
+ABSL_FLAG(uint32_t, stack_dump_size, 65000,
+          "Bytes of user stack that the service copies with each sample to unwind it with DWARF");
+ABSL_FLAG(bool, adaptive_stack_copy, false,
+          "Only copy the part of each stack dump that unwinding the same thread recently needed");
+ABSL_FLAG(uint32_t, unwinding_threads, 0,
+          "Number of threads of the service that unwind the samples with DWARF, 0 to unwind them "
+          "on the thread that processes all events");
 
 using orbit_grpc_protos::CaptureResponse;
 
@@ -7,6 +7,7 @@
 
 #include <optional>
 
+#include "CaptureEventRecorder.h"
 #include "CaptureListener.h"
 #include "OrbitBase/Logging.h"
 #include "OrbitBase/Result.h"
@@ -31,11 +32,14 @@ class CaptureClient {
     CHECK(capture_listener_ != nullptr);
   }
 
+  // If capture_event_recorder is not nullptr, it also receives the events of
+  // the capture and has to outlive it.
   [[nodiscard]] ErrorMessageOr<void> StartCapture(
       ThreadPool* thread_pool, int32_t process_id, std::string process_name,
       std::shared_ptr<Process> process,
       absl::flat_hash_map<uint64_t, orbit_client_protos::FunctionInfo> selected_functions,
-      TracepointInfoSet selected_tracepoints);
+      TracepointInfoSet selected_tracepoints,
+      CaptureEventRecorder* capture_event_recorder = nullptr);
 
   // Returns true if stop was initiated and false otherwise.
   // The latter can happen if for example the stop was already
@@ -58,7 +62,8 @@ class CaptureClient {
  private:
   void Capture(int32_t process_id, std::string process_name, std::shared_ptr<Process> process,
                absl::flat_hash_map<uint64_t, orbit_client_protos::FunctionInfo> selected_functions,
-               TracepointInfoSet selected_tracepoints);
+               TracepointInfoSet selected_tracepoints,
+               CaptureEventRecorder* capture_event_recorder);
 
   void FinishCapture();
 
@@ -5,6 +5,7 @@
 #ifndef ORBIT_CAPTURE_CLIENT_CAPTURE_EVENT_PROCESSOR_H_
 #define ORBIT_CAPTURE_CLIENT_CAPTURE_EVENT_PROCESSOR_H_
 
+#include "Callstack.h"
 #include "OrbitCaptureClient/CaptureListener.h"
 #include "absl/container/flat_hash_map.h"
 #include "absl/container/flat_hash_set.h"
@@ -37,14 +38,13 @@ class CaptureEventProcessor {
   void ProcessTracepointEvent(const orbit_grpc_protos::TracepointEvent& tracepoint_event);
   void ProcessAddressInfo(const orbit_grpc_protos::AddressInfo& address_info);
 
-  absl::flat_hash_map<uint64_t, orbit_grpc_protos::Callstack> callstack_intern_pool;
+  absl::flat_hash_map<uint64_t, CallStack> callstack_intern_pool;
   absl::flat_hash_map<uint64_t, std::string> string_intern_pool;
   absl::flat_hash_map<uint64_t, orbit_grpc_protos::TracepointInfo> tracepoint_intern_pool_;
   CaptureListener* capture_listener_ = nullptr;
 
   absl::flat_hash_set<uint64_t> callstack_hashes_seen_;
-  uint64_t GetCallstackHashAndSendToListenerIfNecessary(
-      const orbit_grpc_protos::Callstack& callstack);
+  uint64_t GetCallstackHashAndSendToListenerIfNecessary(const CallStack& callstack);
   absl::flat_hash_set<uint64_t> string_hashes_seen_;
   uint64_t GetStringHashAndSendToListenerIfNecessary(const std::string& str);
   absl::flat_hash_set<uint64_t> tracepoint_hashes_seen_;
@@ -0,0 +1,35 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef ORBIT_CAPTURE_CLIENT_CAPTURE_EVENT_RECORDER_H_
+#define ORBIT_CAPTURE_CLIENT_CAPTURE_EVENT_RECORDER_H_
+
+#include <string>
+
+#include "absl/container/flat_hash_map.h"
+#include "capture_data.pb.h"
+#include "services.pb.h"
+
+// Receives the CaptureEvents of a capture as CaptureClient receives them, e.g.,
+// to write them to a file while the capture is running. All methods are called
+// from the capture thread.
+class CaptureEventRecorder {
+ public:
+  virtual ~CaptureEventRecorder() = default;
+
+  // Called before the first CaptureResponse. The tracepoints are not passed,
+  // as the events of the capture refer to them with InternedTracepointInfos.
+  virtual void OnCaptureStarted(
+      int32_t process_id, const std::string& process_name,
+      const absl::flat_hash_map<uint64_t, orbit_client_protos::FunctionInfo>&
+          selected_functions) = 0;
+  // Called after the events of the response have been passed to the
+  // CaptureListener.
+  virtual void RecordCaptureResponse(orbit_grpc_protos::CaptureResponse&& response) = 0;
+  // Called once no more CaptureResponses will arrive, whether the capture has
+  // completed or failed.
+  virtual void OnCaptureFinished() = 0;
+};
+
+#endif  // ORBIT_CAPTURE_CLIENT_CAPTURE_EVENT_RECORDER_H_
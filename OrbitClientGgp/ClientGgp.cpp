@@ -87,13 +87,26 @@ bool ClientGgp::RequestStartCapture(ThreadPool* thread_pool) {
     LOG("No functions provided; no functions hooked in the capture");
   }
 
+  if (options_.stream_capture) {
+    std::string file_name =
+        GetCaptureFileName(CaptureData{pid, target_process_->GetName(), target_process_, {}, {}});
+    ErrorMessageOr<std::unique_ptr<capture_serializer::CaptureStreamWriter>> capture_stream_writer =
+        capture_serializer::CaptureStreamWriter::Create(file_name, GetCaptureCompression());
+    if (capture_stream_writer.has_error()) {
+      ERROR("Error starting capture: %s", capture_stream_writer.error().message());
+      return false;
+    }
+    capture_stream_writer_ = std::move(capture_stream_writer.value());
+    LOG("Streaming the capture to %s", file_name);
+  }
+
   // Start capture
   LOG("Capture pid %d", pid);
   TracepointInfoSet selected_tracepoints;
 
-  ErrorMessageOr<void> result =
-      capture_client_->StartCapture(thread_pool, pid, target_process_->GetName(), target_process_,
-                                    selected_functions, selected_tracepoints);
+  ErrorMessageOr<void> result = capture_client_->StartCapture(
+      thread_pool, pid, target_process_->GetName(), target_process_, selected_functions,
+      selected_tracepoints, capture_stream_writer_.get());
 
   if (result.has_error()) {
     ERROR("Error starting capture: %s", result.error().message());
@@ -108,18 +121,17 @@ bool ClientGgp::StopCapture() {
 }
 
 bool ClientGgp::SaveCapture() {
+  if (capture_stream_writer_ != nullptr) {
+    LOG("The capture has already been written while capturing");
+    return true;
+  }
   LOG("Saving capture");
   const auto& key_to_string_map = string_manager_->GetKeyToStringMap();
-  std::string file_name = options_.capture_file_name;
-  if (file_name.empty()) {
-    file_name = capture_serializer::GetCaptureFileName(capture_data_);
-  } else {
-    // Make sure the file is saved with orbit extension
-    capture_serializer::IncludeOrbitExtensionInFile(file_name);
-  }
+  std::string file_name = GetCaptureFileName(capture_data_);
 
-  ErrorMessageOr<void> result = capture_serializer::Save(
-      file_name, capture_data_, key_to_string_map, timer_infos_.begin(), timer_infos_.end());
+  ErrorMessageOr<void> result =
+      capture_serializer::Save(file_name, capture_data_, key_to_string_map, timer_infos_.begin(),
+                               timer_infos_.end(), GetCaptureCompression());
   if (result.has_error()) {
     ERROR("Could not save the capture: %s", result.error().message());
     return false;
@@ -127,6 +139,21 @@ bool ClientGgp::SaveCapture() {
   return true;
 }
 
+std::string ClientGgp::GetCaptureFileName(const CaptureData& capture_data) {
+  std::string file_name = options_.capture_file_name;
+  if (file_name.empty()) {
+    return capture_serializer::GetCaptureFileName(capture_data);
+  }
+  // Make sure the file is saved with orbit extension
+  capture_serializer::IncludeOrbitExtensionInFile(file_name);
+  return file_name;
+}
+
+capture_serializer::ChunkCompression ClientGgp::GetCaptureCompression() const {
+  return options_.compress_capture ? capture_serializer::ChunkCompression::kZlib
+                                   : capture_serializer::ChunkCompression::kNone;
+}
+
 ErrorMessageOr<std::shared_ptr<Process>> ClientGgp::GetOrbitProcessByPid(int32_t pid) {
   // We retrieve the information of the process to later get the module corresponding to its binary
   OUTCOME_TRY(process_infos, process_client_->GetProcessList());
@@ -252,7 +279,12 @@ absl::flat_hash_map<uint64_t, FunctionInfo> ClientGgp::GetSelectedFunctions() {
   return selected_functions;
 }
 
-void ClientGgp::ProcessTimer(const TimerInfo& timer_info) { timer_infos_.push_back(timer_info); }
+void ClientGgp::ProcessTimer(const TimerInfo& timer_info) {
+  // The timers are only kept to be saved at the end of the capture.
+  if (capture_stream_writer_ == nullptr) {
+    timer_infos_.push_back(timer_info);
+  }
+}
 
 // CaptureListener implementation
 void ClientGgp::OnCaptureStarted(
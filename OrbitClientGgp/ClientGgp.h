@@ -14,6 +14,7 @@
 #include "OrbitBase/Result.h"
 #include "OrbitCaptureClient/CaptureClient.h"
 #include "OrbitCaptureClient/CaptureListener.h"
+#include "OrbitClientModel/CaptureStreamWriter.h"
 #include "OrbitClientServices/ProcessClient.h"
 #include "OrbitProcess.h"
 #include "StringManager.h"
@@ -53,10 +54,14 @@ class ClientGgp final : public CaptureListener {
   std::shared_ptr<StringManager> string_manager_;
   std::unique_ptr<CaptureClient> capture_client_;
   std::unique_ptr<ProcessClient> process_client_;
+  // Only set with stream_capture.
+  std::unique_ptr<capture_serializer::CaptureStreamWriter> capture_stream_writer_;
   CaptureData capture_data_;
   std::vector<orbit_client_protos::TimerInfo> timer_infos_;
 
   ErrorMessageOr<std::shared_ptr<Process>> GetOrbitProcessByPid(int32_t pid);
+  std::string GetCaptureFileName(const CaptureData& capture_data);
+  capture_serializer::ChunkCompression GetCaptureCompression() const;
   bool InitCapture();
   ErrorMessageOr<void> LoadModuleAndSymbols();
   std::string SelectedFunctionMatch(const orbit_client_protos::FunctionInfo& func);
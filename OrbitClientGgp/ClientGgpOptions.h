@@ -16,6 +16,8 @@ struct ClientGgpOptions {
   int32_t capture_pid;
   std::vector<std::string> capture_functions;
   std::string capture_file_name;
+  bool stream_capture;
+  bool compress_capture;
 };
 
 #endif  // ORBIT_CLIENT_GGP_CLIENT_GGP_OPTIONS_H_
\ No newline at end of file
@@ -19,10 +19,26 @@ ABSL_FLAG(uint32_t, capture_length, 10, "duration of capture in seconds");
 ABSL_FLAG(std::vector<std::string>, functions, {},
           "Comma-separated list of functions to hook to the capture");
 ABSL_FLAG(std::string, file_name, "", "File name used for saving the capture");
+ABSL_FLAG(bool, stream_capture, false,
+          "Write the capture to the file while capturing instead of keeping the timers in memory "
+          "and saving them at the end");
+ABSL_FLAG(bool, compress_capture, false,
+          "Compress the capture file; it is about three times smaller, but takes longer to write");
 ABSL_FLAG(std::string, log_directory, "",
           "Path to locate debug file. By default only stdout is used for logs");
 ABSL_FLAG(uint16_t, sampling_rate, 1000, "Frequency of callstack sampling in samples per second");
 ABSL_FLAG(bool, frame_pointer_unwinding, false, "Use frame pointers for unwinding");
+ABSL_FLAG(bool, event_driven_ring_buffer_reading, false,
+          "Let the service wait for the kernel to signal new events instead of polling");
+ABSL_FLAG(uint32_t, ring_buffer_reader_threads, 1,
+          "Number of threads of the service that read the events, each for a group of cores");
+ABSL_FLAG(uint32_t, stack_dump_size, 65000,
+          "Bytes of user stack that the service copies with each sample to unwind it with DWARF");
+ABSL_FLAG(bool, adaptive_stack_copy, false,
+          "Only copy the part of each stack dump that unwinding the same thread recently needed");
+ABSL_FLAG(uint32_t, unwinding_threads, 0,
+          "Number of threads of the service that unwind the samples with DWARF, 0 to unwind them "
+          "on the thread that processes all events");
 
 namespace {
 
@@ -56,6 +72,8 @@ int main(int argc, char** argv) {
   options.capture_pid = absl::GetFlag(FLAGS_pid);
   options.capture_functions = absl::GetFlag(FLAGS_functions);
   options.capture_file_name = absl::GetFlag(FLAGS_file_name);
+  options.stream_capture = absl::GetFlag(FLAGS_stream_capture);
+  options.compress_capture = absl::GetFlag(FLAGS_compress_capture);
 
   ClientGgp client_ggp(std::move(options));
   if (!client_ggp.InitClient()) {
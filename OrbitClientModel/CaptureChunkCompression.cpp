@@ -0,0 +1,98 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "OrbitClientModel/CaptureChunkCompression.h"
+
+#include <zlib.h>
+
+#include <limits>
+
+#include "OrbitBase/Logging.h"
+#include "google/protobuf/io/coded_stream.h"
+
+using orbit_client_protos::CallstackEvent;
+using orbit_client_protos::TimerInfo;
+
+namespace capture_serializer::internal {
+
+namespace {
+
+// Deflate does not compress more than about 1032:1. Larger uncompressed sizes
+// come from malformed payloads and are not allocated.
+constexpr uint64_t kMaxCompressionRatio = 1032;
+
+uint64_t ZigZagEncode(uint64_t difference) {
+  return (difference << 1) ^ static_cast<uint64_t>(static_cast<int64_t>(difference) >> 63);
+}
+
+uint64_t ZigZagDecode(uint64_t value) { return (value >> 1) ^ (0 - (value & 1)); }
+
+}  // namespace
+
+std::string CompressChunkPayload(const std::string& payload) {
+  CHECK(payload.size() <= std::numeric_limits<uint32_t>::max());
+  uLongf compressed_size = compressBound(payload.size());
+  std::string compressed_payload(sizeof(uint32_t) + compressed_size, '\0');
+  google::protobuf::io::CodedOutputStream::WriteLittleEndian32ToArray(
+      payload.size(), reinterpret_cast<uint8_t*>(compressed_payload.data()));
+  // The fastest level compresses the delta-encoded chunks almost as well as the
+  // default one, at several times its speed.
+  int result = compress2(reinterpret_cast<Bytef*>(compressed_payload.data() + sizeof(uint32_t)),
+                         &compressed_size, reinterpret_cast<const Bytef*>(payload.data()),
+                         payload.size(), Z_BEST_SPEED);
+  CHECK(result == Z_OK);
+  compressed_payload.resize(sizeof(uint32_t) + compressed_size);
+  return compressed_payload;
+}
+
+bool DecompressChunkPayload(const std::string& compressed_payload, std::string* payload) {
+  if (compressed_payload.size() < sizeof(uint32_t)) {
+    return false;
+  }
+  uint32_t payload_size;
+  google::protobuf::io::CodedInputStream::ReadLittleEndian32FromArray(
+      reinterpret_cast<const uint8_t*>(compressed_payload.data()), &payload_size);
+  if (payload_size > kMaxCompressionRatio * compressed_payload.size()) {
+    return false;
+  }
+  payload->resize(payload_size);
+  uLongf decompressed_size = payload_size;
+  int result = uncompress(reinterpret_cast<Bytef*>(payload->data()), &decompressed_size,
+                          reinterpret_cast<const Bytef*>(compressed_payload.data()) +
+                              sizeof(uint32_t),
+                          compressed_payload.size() - sizeof(uint32_t));
+  return result == Z_OK && decompressed_size == payload_size;
+}
+
+void ChunkDeltaCoder::Encode(TimerInfo* timer_info) {
+  uint64_t start = timer_info->start();
+  timer_info->set_start(ZigZagEncode(start - previous_time_ns_));
+  timer_info->set_end(ZigZagEncode(timer_info->end() - start));
+  previous_time_ns_ = start;
+  uint64_t function_address = timer_info->function_address();
+  timer_info->set_function_address(ZigZagEncode(function_address - previous_address_));
+  previous_address_ = function_address;
+}
+
+void ChunkDeltaCoder::Decode(TimerInfo* timer_info) {
+  uint64_t start = previous_time_ns_ + ZigZagDecode(timer_info->start());
+  timer_info->set_start(start);
+  timer_info->set_end(start + ZigZagDecode(timer_info->end()));
+  previous_time_ns_ = start;
+  previous_address_ += ZigZagDecode(timer_info->function_address());
+  timer_info->set_function_address(previous_address_);
+}
+
+void ChunkDeltaCoder::Encode(CallstackEvent* callstack_event) {
+  uint64_t time = callstack_event->time();
+  callstack_event->set_time(ZigZagEncode(time - previous_time_ns_));
+  previous_time_ns_ = time;
+}
+
+void ChunkDeltaCoder::Decode(CallstackEvent* callstack_event) {
+  previous_time_ns_ += ZigZagDecode(callstack_event->time());
+  callstack_event->set_time(previous_time_ns_);
+}
+
+}  // namespace capture_serializer::internal
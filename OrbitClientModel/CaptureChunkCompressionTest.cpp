@@ -0,0 +1,107 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <limits>
+#include <string>
+#include <vector>
+
+#include "OrbitClientModel/CaptureChunkCompression.h"
+#include "capture_data.pb.h"
+#include "gtest/gtest.h"
+
+using capture_serializer::internal::ChunkDeltaCoder;
+using capture_serializer::internal::CompressChunkPayload;
+using capture_serializer::internal::DecompressChunkPayload;
+using orbit_client_protos::CallstackEvent;
+using orbit_client_protos::TimerInfo;
+
+TEST(CaptureChunkCompression, CompressAndDecompress) {
+  std::string payload;
+  for (int i = 0; i < 10'000; ++i) {
+    payload.append(std::to_string(i % 100));
+  }
+  std::string compressed_payload = CompressChunkPayload(payload);
+  EXPECT_LT(compressed_payload.size(), payload.size() / 10);
+
+  std::string decompressed_payload;
+  ASSERT_TRUE(DecompressChunkPayload(compressed_payload, &decompressed_payload));
+  EXPECT_EQ(decompressed_payload, payload);
+
+  ASSERT_TRUE(DecompressChunkPayload(CompressChunkPayload(""), &decompressed_payload));
+  EXPECT_EQ(decompressed_payload, "");
+}
+
+TEST(CaptureChunkCompression, DecompressMalformedPayload) {
+  std::string compressed_payload = CompressChunkPayload(std::string(1000, 'a'));
+  std::string payload;
+  EXPECT_FALSE(DecompressChunkPayload("", &payload));
+  EXPECT_FALSE(DecompressChunkPayload(compressed_payload.substr(0, compressed_payload.size() - 1),
+                                      &payload));
+
+  // A wrong uncompressed size.
+  std::string wrong_size = compressed_payload;
+  wrong_size[0] = 1;
+  EXPECT_FALSE(DecompressChunkPayload(wrong_size, &payload));
+
+  // An uncompressed size too large for the compressed size is not allocated.
+  std::string too_large = compressed_payload;
+  too_large[3] = '\x7f';
+  EXPECT_FALSE(DecompressChunkPayload(too_large, &payload));
+}
+
+TEST(CaptureChunkCompression, DeltaCodeTimers) {
+  std::vector<TimerInfo> timers(4);
+  timers[0].set_start(1'000'000'000'000);
+  timers[0].set_end(1'000'000'001'000);
+  timers[0].set_function_address(0x7f0000001000);
+  timers[1].set_start(1'000'000'000'500);
+  timers[1].set_end(1'000'000'000'600);
+  timers[1].set_function_address(0x7f0000001010);
+  // Going back and ending before the start still round-trip.
+  timers[2].set_start(1);
+  timers[2].set_end(0);
+  timers[2].set_function_address(std::numeric_limits<uint64_t>::max());
+  timers[3].set_start(std::numeric_limits<uint64_t>::max());
+  timers[3].set_end(0);
+  timers[3].set_function_address(0);
+
+  std::vector<TimerInfo> encoded_timers = timers;
+  ChunkDeltaCoder encoder;
+  for (TimerInfo& timer : encoded_timers) {
+    encoder.Encode(&timer);
+  }
+  // The second timer starts 500 ns after the first one, lasts 100 ns and is 16
+  // bytes further.
+  EXPECT_EQ(encoded_timers[1].start(), 1000);
+  EXPECT_EQ(encoded_timers[1].end(), 200);
+  EXPECT_EQ(encoded_timers[1].function_address(), 32);
+
+  ChunkDeltaCoder decoder;
+  for (size_t i = 0; i < timers.size(); ++i) {
+    decoder.Decode(&encoded_timers[i]);
+    EXPECT_EQ(encoded_timers[i].start(), timers[i].start());
+    EXPECT_EQ(encoded_timers[i].end(), timers[i].end());
+    EXPECT_EQ(encoded_timers[i].function_address(), timers[i].function_address());
+  }
+}
+
+TEST(CaptureChunkCompression, DeltaCodeCallstackEvents) {
+  std::vector<uint64_t> times{1'000'000'000'000, 1'000'000'001'000, 1'000'000'000'999, 0};
+  std::vector<CallstackEvent> callstack_events(times.size());
+  ChunkDeltaCoder encoder;
+  for (size_t i = 0; i < times.size(); ++i) {
+    callstack_events[i].set_time(times[i]);
+    callstack_events[i].set_callstack_hash(42);
+    encoder.Encode(&callstack_events[i]);
+  }
+  EXPECT_EQ(callstack_events[1].time(), 2000);
+  EXPECT_EQ(callstack_events[2].time(), 1);
+
+  ChunkDeltaCoder decoder;
+  for (size_t i = 0; i < times.size(); ++i) {
+    decoder.Decode(&callstack_events[i]);
+    EXPECT_EQ(callstack_events[i].time(), times[i]);
+    EXPECT_EQ(callstack_events[i].callstack_hash(), 42);
+  }
+}
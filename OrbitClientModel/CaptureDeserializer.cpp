@@ -4,13 +4,23 @@
 
 #include "OrbitClientModel/CaptureDeserializer.h"
 
+#include <algorithm>
+#include <deque>
 #include <fstream>
+#include <istream>
 #include <memory>
+#include <thread>
+#include <type_traits>
+#include <vector>
 
 #include "Callstack.h"
 #include "FunctionUtils.h"
-#include "OrbitBase/MakeUniqueForOverwrite.h"
+#include "OrbitBase/Action.h"
+#include "OrbitBase/ThreadPool.h"
+#include "OrbitCaptureClient/CaptureEventProcessor.h"
+#include "OrbitClientModel/CaptureChunkCompression.h"
 #include "absl/strings/str_format.h"
+#include "absl/synchronization/mutex.h"
 #include "capture_data.pb.h"
 #include "google/protobuf/io/coded_stream.h"
 #include "google/protobuf/io/zero_copy_stream_impl.h"
@@ -18,10 +28,15 @@
 
 using orbit_client_protos::CallstackEvent;
 using orbit_client_protos::CallstackInfo;
+using orbit_client_protos::CaptureChunkIndex;
 using orbit_client_protos::CaptureHeader;
 using orbit_client_protos::CaptureInfo;
 using orbit_client_protos::FunctionInfo;
+using orbit_client_protos::KeyAndString;
+using orbit_client_protos::LinuxAddressInfo;
 using orbit_client_protos::TimerInfo;
+using orbit_client_protos::TracepointEventInfo;
+using orbit_grpc_protos::CaptureEvent;
 
 namespace capture_deserializer {
 
@@ -43,22 +58,28 @@ void Load(const std::string& file_name, CaptureListener* capture_listener,
 
 void Load(std::istream& stream, const std::string& file_name, CaptureListener* capture_listener,
           std::atomic<bool>* cancellation_requested) {
-  google::protobuf::io::IstreamInputStream input_stream(&stream);
-  google::protobuf::io::CodedInputStream coded_input(&input_stream);
-
   std::string error_message = absl::StrFormat(
       "Error parsing the capture from \"%s\".\nNote: If the capture "
       "was taken with a previous Orbit version, it could be incompatible. "
       "Please check release notes for more information.",
       file_name);
 
+  // The header is read directly from the stream, as chunked captures are also
+  // read directly from the stream.
   CaptureHeader header;
-  if (!internal::ReadMessage(&header, &coded_input) || header.version().empty()) {
+  if (!internal::ReadHeader(&stream, &header) || header.version().empty()) {
     ERROR("%s", error_message);
     capture_listener->OnCaptureFailed(ErrorMessage(std::move(error_message)));
     return;
   }
-  if (header.version() != internal::kRequiredCaptureVersion) {
+
+  if (header.version() == internal::kChunkedCaptureVersion) {
+    internal::LoadChunks(&stream, error_message, capture_listener, cancellation_requested,
+                         std::max(1u, std::thread::hardware_concurrency()));
+    return;
+  }
+
+  if (header.version() != internal::kCaptureInfoVersion) {
     std::string incompatible_version_error_message = absl::StrFormat(
         "The format of capture \"%s\" is no longer supported but could be opened with "
         "Orbit version %s.",
@@ -68,6 +89,9 @@ void Load(std::istream& stream, const std::string& file_name, CaptureListener* c
     return;
   }
 
+  google::protobuf::io::IstreamInputStream input_stream(&stream);
+  google::protobuf::io::CodedInputStream coded_input(&input_stream);
+
   CaptureInfo capture_info;
   if (!internal::ReadMessage(&capture_info, &coded_input)) {
     ERROR("%s", error_message);
@@ -80,6 +104,248 @@ void Load(std::istream& stream, const std::string& file_name, CaptureListener* c
 
 namespace internal {
 
+namespace {
+
+// The payload of a chunk is read in pieces of at most this size, so that a
+// corrupted payload size only allocates as much memory as the file holds.
+constexpr size_t kChunkPayloadPieceSize = 1024 * 1024;
+
+orbit_grpc_protos::TracepointInfo TranslateTracepointInfo(
+    const orbit_client_protos::TracepointInfo& tracepoint_info) {
+  orbit_grpc_protos::TracepointInfo tracepoint_info_translated;
+  tracepoint_info_translated.set_category(tracepoint_info.category());
+  tracepoint_info_translated.set_name(tracepoint_info.name());
+  return tracepoint_info_translated;
+}
+
+void StartCapture(const CaptureInfo& capture_info, CaptureListener* capture_listener) {
+  absl::flat_hash_map<uint64_t, orbit_client_protos::FunctionInfo> selected_functions;
+  for (const auto& function : capture_info.selected_functions()) {
+    uint64_t address = FunctionUtils::GetAbsoluteAddress(function);
+    selected_functions[address] = function;
+  }
+  TracepointInfoSet selected_tracepoints;
+  for (const orbit_client_protos::TracepointInfo& tracepoint_info :
+       capture_info.tracepoint_infos()) {
+    selected_tracepoints.emplace(TranslateTracepointInfo(tracepoint_info));
+  }
+
+  capture_listener->OnCaptureStarted(capture_info.process_id(), capture_info.process_name(),
+                                     std::make_shared<Process>(), std::move(selected_functions),
+                                     std::move(selected_tracepoints));
+}
+
+// Parses the messages of the payload of a chunk. Returns an Action that calls
+// on_message with each of them, or nullptr if the payload is malformed.
+template <typename MessageType, typename OnMessage>
+std::unique_ptr<Action> ParseChunkMessages(const std::string& payload, bool compressed,
+                                           OnMessage on_message) {
+  google::protobuf::io::CodedInputStream input(reinterpret_cast<const uint8_t*>(payload.data()),
+                                               payload.size());
+  std::vector<MessageType> messages;
+  while (!input.ExpectAtEnd()) {
+    if (!ReadChunkMessage(&messages.emplace_back(), &input)) {
+      return nullptr;
+    }
+  }
+  // Only TimerInfos and CallstackEvents are delta-encoded in compressed chunks.
+  if constexpr (std::is_same_v<MessageType, TimerInfo> ||
+                std::is_same_v<MessageType, CallstackEvent>) {
+    if (compressed) {
+      capture_serializer::internal::ChunkDeltaCoder delta_coder;
+      for (MessageType& message : messages) {
+        delta_coder.Decode(&message);
+      }
+    }
+  }
+  return CreateAction([messages = std::move(messages), on_message]() mutable {
+    for (MessageType& message : messages) {
+      on_message(std::move(message));
+    }
+  });
+}
+
+// Parses a chunk, decompressing it first if needed. Returns an Action that
+// passes its content to the listener, or nullptr if the payload is malformed or
+// the type unknown.
+std::unique_ptr<Action> ParseChunk(CaptureChunkIndex::ChunkType type, bool compressed,
+                                   const std::string& chunk_payload,
+                                   CaptureListener* capture_listener,
+                                   CaptureEventProcessor* capture_event_processor) {
+  std::string decompressed_payload;
+  if (compressed &&
+      !capture_serializer::internal::DecompressChunkPayload(chunk_payload, &decompressed_payload)) {
+    return nullptr;
+  }
+  const std::string& payload = compressed ? decompressed_payload : chunk_payload;
+
+  switch (type) {
+    case CaptureChunkIndex::kCaptureInfo:
+      return ParseChunkMessages<CaptureInfo>(
+          payload, compressed, [capture_listener](const CaptureInfo& capture_info) {
+            StartCapture(capture_info, capture_listener);
+            for (const auto& [thread_id, thread_name] : capture_info.thread_names()) {
+              capture_listener->OnThreadName(thread_id, thread_name);
+            }
+            for (const orbit_client_protos::TracepointInfo& tracepoint_info :
+                 capture_info.tracepoint_infos()) {
+              capture_listener->OnUniqueTracepointInfo(tracepoint_info.tracepoint_info_key(),
+                                                       TranslateTracepointInfo(tracepoint_info));
+            }
+          });
+    case CaptureChunkIndex::kAddressInfo:
+      return ParseChunkMessages<LinuxAddressInfo>(
+          payload, compressed, [capture_listener](LinuxAddressInfo address_info) {
+            capture_listener->OnAddressInfo(std::move(address_info));
+          });
+    case CaptureChunkIndex::kCallstack:
+      return ParseChunkMessages<CallstackInfo>(
+          payload, compressed, [capture_listener](const CallstackInfo& callstack) {
+            capture_listener->OnUniqueCallStack(
+                CallStack({callstack.data().begin(), callstack.data().end()}));
+          });
+    case CaptureChunkIndex::kCallstackEvent:
+      return ParseChunkMessages<CallstackEvent>(
+          payload, compressed, [capture_listener](CallstackEvent callstack_event) {
+            capture_listener->OnCallstackEvent(std::move(callstack_event));
+          });
+    case CaptureChunkIndex::kTracepointEvent:
+      return ParseChunkMessages<TracepointEventInfo>(
+          payload, compressed, [capture_listener](TracepointEventInfo tracepoint_event_info) {
+            capture_listener->OnTracepointEvent(std::move(tracepoint_event_info));
+          });
+    case CaptureChunkIndex::kKeyAndString:
+      return ParseChunkMessages<KeyAndString>(
+          payload, compressed, [capture_listener](KeyAndString key_and_string) {
+            capture_listener->OnKeyAndString(key_and_string.key(),
+                                             std::move(*key_and_string.mutable_str()));
+          });
+    case CaptureChunkIndex::kTimer:
+      return ParseChunkMessages<TimerInfo>(
+          payload, compressed, [capture_listener](const TimerInfo& timer_info) {
+            capture_listener->OnTimer(timer_info);
+          });
+    case CaptureChunkIndex::kCaptureEvent:
+      return ParseChunkMessages<CaptureEvent>(
+          payload, compressed, [capture_event_processor](const CaptureEvent& capture_event) {
+            capture_event_processor->ProcessEvent(capture_event);
+          });
+    default:
+      return nullptr;
+  }
+}
+
+// A chunk that is parsed on the thread pool, while the chunks before it are
+// passed to the listener.
+struct PendingChunk {
+  absl::Mutex mutex;
+  bool parsed ABSL_GUARDED_BY(mutex) = false;
+  // nullptr if the chunk is malformed.
+  std::unique_ptr<Action> deliver ABSL_GUARDED_BY(mutex);
+};
+
+std::shared_ptr<PendingChunk> CreateMalformedChunk() {
+  auto pending_chunk = std::make_shared<PendingChunk>();
+  absl::MutexLock lock{&pending_chunk->mutex};
+  pending_chunk->parsed = true;
+  return pending_chunk;
+}
+
+enum class LoadResult { kComplete, kCancelled, kFailed };
+
+// Reads the chunks and schedules their parsing on thread_pool, keeping at most
+// max_pending_chunk_count of them in memory, and passes them to the listener
+// in the order of the file. The pending chunks are shared with the thread pool,
+// so this can return before the thread pool is done. The CaptureEventProcessor
+// is only used by the delivering Actions, which run on this thread.
+LoadResult LoadChunksInOrder(std::istream* stream, ThreadPool* thread_pool,
+                             size_t max_pending_chunk_count, CaptureListener* capture_listener,
+                             CaptureEventProcessor* capture_event_processor,
+                             std::atomic<bool>* cancellation_requested) {
+  std::deque<std::shared_ptr<PendingChunk>> pending_chunks;
+  bool end_of_chunks = false;
+  uint64_t chunk_count = 0;
+  while (true) {
+    while (!end_of_chunks && pending_chunks.size() < max_pending_chunk_count) {
+      CaptureChunkIndex::ChunkType type;
+      bool compressed;
+      std::string payload;
+      if (!ReadChunk(stream, &type, &compressed, &payload)) {
+        // A capture that was streamed to the file and not finished ends
+        // without an index, possibly in the middle of a chunk.
+        if (stream->eof() && chunk_count > 0) {
+          ERROR("The capture ends without a chunk index, loading only its complete chunks");
+        } else {
+          pending_chunks.push_back(CreateMalformedChunk());
+        }
+        end_of_chunks = true;
+        break;
+      }
+      if (type == CaptureChunkIndex::kChunkIndex && chunk_count > 0) {
+        end_of_chunks = true;
+        break;
+      }
+      // The CaptureInfo comes first, and only once.
+      if ((chunk_count == 0) != (type == CaptureChunkIndex::kCaptureInfo)) {
+        pending_chunks.push_back(CreateMalformedChunk());
+        end_of_chunks = true;
+        break;
+      }
+
+      ++chunk_count;
+      auto pending_chunk = std::make_shared<PendingChunk>();
+      pending_chunks.push_back(pending_chunk);
+      thread_pool->Schedule([pending_chunk, type, compressed, payload = std::move(payload),
+                             capture_listener, capture_event_processor] {
+        std::unique_ptr<Action> deliver =
+            ParseChunk(type, compressed, payload, capture_listener, capture_event_processor);
+        absl::MutexLock lock{&pending_chunk->mutex};
+        pending_chunk->deliver = std::move(deliver);
+        pending_chunk->parsed = true;
+      });
+    }
+
+    if (pending_chunks.empty()) {
+      return LoadResult::kComplete;
+    }
+    std::shared_ptr<PendingChunk> pending_chunk = std::move(pending_chunks.front());
+    pending_chunks.pop_front();
+    std::unique_ptr<Action> deliver;
+    {
+      absl::MutexLock lock{&pending_chunk->mutex};
+      pending_chunk->mutex.Await(absl::Condition(&pending_chunk->parsed));
+      deliver = std::move(pending_chunk->deliver);
+    }
+    if (deliver == nullptr) {
+      return LoadResult::kFailed;
+    }
+    if (*cancellation_requested) {
+      return LoadResult::kCancelled;
+    }
+    deliver->Execute();
+  }
+}
+
+bool ReadLittleEndian32(std::istream* stream, uint32_t* value) {
+  uint8_t bytes[sizeof(*value)];
+  if (!stream->read(reinterpret_cast<char*>(bytes), sizeof(bytes))) {
+    return false;
+  }
+  google::protobuf::io::CodedInputStream::ReadLittleEndian32FromArray(bytes, value);
+  return true;
+}
+
+bool ReadLittleEndian64(std::istream* stream, uint64_t* value) {
+  uint8_t bytes[sizeof(*value)];
+  if (!stream->read(reinterpret_cast<char*>(bytes), sizeof(bytes))) {
+    return false;
+  }
+  google::protobuf::io::CodedInputStream::ReadLittleEndian64FromArray(bytes, value);
+  return true;
+}
+
+}  // namespace
+
 bool ReadMessage(google::protobuf::Message* message,
                  google::protobuf::io::CodedInputStream* input) {
   uint32_t message_size;
@@ -87,41 +353,124 @@ bool ReadMessage(google::protobuf::Message* message,
     return false;
   }
 
-  std::unique_ptr<char[]> buffer = make_unique_for_overwrite<char[]>(message_size);
-  if (!input->ReadRaw(buffer.get(), message_size)) {
+  google::protobuf::io::CodedInputStream::Limit limit = input->PushLimit(message_size);
+  message->ParseFromCodedStream(input);
+  // Skip what a failed parse has left, like a parse of a separate buffer would.
+  bool success = input->Skip(input->BytesUntilLimit());
+  input->PopLimit(limit);
+  return success;
+}
+
+bool ReadHeader(std::istream* stream, CaptureHeader* header) {
+  uint32_t header_size;
+  if (!ReadLittleEndian32(stream, &header_size)) {
     return false;
   }
-  message->ParseFromArray(buffer.get(), message_size);
+  std::string serialized_header(header_size, '\0');
+  if (!stream->read(serialized_header.data(), header_size)) {
+    return false;
+  }
+  return header->ParseFromString(serialized_header);
+}
 
+bool ReadChunk(std::istream* stream, CaptureChunkIndex::ChunkType* type, bool* compressed,
+               std::string* payload) {
+  uint32_t chunk_type;
+  uint32_t payload_size;
+  if (!ReadLittleEndian32(stream, &chunk_type) || !ReadLittleEndian32(stream, &payload_size)) {
+    return false;
+  }
+  *compressed = (chunk_type & capture_serializer::internal::kCompressedChunkFlag) != 0;
+  chunk_type &= ~capture_serializer::internal::kCompressedChunkFlag;
+  if (!CaptureChunkIndex::ChunkType_IsValid(chunk_type)) {
+    return false;
+  }
+  *type = static_cast<CaptureChunkIndex::ChunkType>(chunk_type);
+  payload->clear();
+  while (payload->size() < payload_size) {
+    size_t offset = payload->size();
+    size_t piece_size = std::min<size_t>(kChunkPayloadPieceSize, payload_size - offset);
+    payload->resize(offset + piece_size);
+    if (!stream->read(payload->data() + offset, piece_size)) {
+      return false;
+    }
+  }
   return true;
 }
 
+bool ReadChunkMessage(google::protobuf::Message* message,
+                      google::protobuf::io::CodedInputStream* input) {
+  uint32_t message_size;
+  if (!input->ReadLittleEndian32(&message_size)) {
+    return false;
+  }
+  google::protobuf::io::CodedInputStream::Limit limit = input->PushLimit(message_size);
+  bool success = message->ParseFromCodedStream(input) && input->BytesUntilLimit() == 0;
+  input->PopLimit(limit);
+  return success;
+}
+
+ErrorMessageOr<CaptureChunkIndex> ReadChunkIndex(std::istream* stream) {
+  uint64_t index_offset;
+  if (!stream->seekg(-static_cast<int64_t>(sizeof(index_offset)), std::ios::end) ||
+      !ReadLittleEndian64(stream, &index_offset) || !stream->seekg(index_offset)) {
+    return ErrorMessage("Could not read the offset of the chunk index");
+  }
+  CaptureChunkIndex::ChunkType type;
+  bool compressed;
+  std::string payload;
+  if (!ReadChunk(stream, &type, &compressed, &payload) || type != CaptureChunkIndex::kChunkIndex ||
+      compressed) {
+    return ErrorMessage("Could not read the chunk index");
+  }
+  CaptureChunkIndex index;
+  google::protobuf::io::CodedInputStream input(reinterpret_cast<const uint8_t*>(payload.data()),
+                                               payload.size());
+  if (!ReadChunkMessage(&index, &input)) {
+    return ErrorMessage("Could not parse the chunk index");
+  }
+  return index;
+}
+
+void LoadChunks(std::istream* stream, const std::string& error_message,
+                CaptureListener* capture_listener, std::atomic<bool>* cancellation_requested,
+                size_t thread_count) {
+  CHECK(capture_listener != nullptr);
+  CHECK(thread_count > 0);
+
+  std::unique_ptr<ThreadPool> thread_pool =
+      ThreadPool::Create(thread_count, thread_count, absl::Seconds(1));
+  CaptureEventProcessor capture_event_processor{capture_listener};
+  // Two chunks per thread keep the threads busy while the next chunks are read.
+  LoadResult result =
+      LoadChunksInOrder(stream, thread_pool.get(), 2 * thread_count, capture_listener,
+                        &capture_event_processor, cancellation_requested);
+  thread_pool->ShutdownAndWait();
+
+  switch (result) {
+    case LoadResult::kComplete:
+      capture_listener->OnCaptureComplete();
+      break;
+    case LoadResult::kCancelled:
+      capture_listener->OnCaptureCancelled();
+      break;
+    case LoadResult::kFailed:
+      ERROR("%s", error_message);
+      capture_listener->OnCaptureFailed(ErrorMessage(error_message));
+      break;
+  }
+}
+
 void LoadCaptureInfo(const CaptureInfo& capture_info, CaptureListener* capture_listener,
                      google::protobuf::io::CodedInputStream* coded_input,
                      std::atomic<bool>* cancellation_requested) {
   CHECK(capture_listener != nullptr);
 
-  absl::flat_hash_map<uint64_t, orbit_client_protos::FunctionInfo> selected_functions;
-  for (const auto& function : capture_info.selected_functions()) {
-    uint64_t address = FunctionUtils::GetAbsoluteAddress(function);
-    selected_functions[address] = function;
-  }
-  TracepointInfoSet selected_tracepoints;
-  for (const orbit_client_protos::TracepointInfo& tracepoint_info :
-       capture_info.tracepoint_infos()) {
-    orbit_grpc_protos::TracepointInfo tracepoint_info_translated;
-    tracepoint_info_translated.set_category(tracepoint_info.category());
-    tracepoint_info_translated.set_name(tracepoint_info.name());
-    selected_tracepoints.emplace(tracepoint_info_translated);
-  }
-
   if (*cancellation_requested) {
     capture_listener->OnCaptureCancelled();
     return;
   }
-  capture_listener->OnCaptureStarted(capture_info.process_id(), capture_info.process_name(),
-                                     std::make_shared<Process>(), std::move(selected_functions),
-                                     std::move(selected_tracepoints));
+  StartCapture(capture_info, capture_listener);
 
   for (const auto& address_info : capture_info.address_infos()) {
     if (*cancellation_requested) {
@@ -161,11 +510,8 @@ void LoadCaptureInfo(const CaptureInfo& capture_info, CaptureListener* capture_l
       capture_listener->OnCaptureCancelled();
       return;
     }
-    orbit_grpc_protos::TracepointInfo tracepoint_info_translated;
-    tracepoint_info_translated.set_category(tracepoint_info.category());
-    tracepoint_info_translated.set_name(tracepoint_info.name());
     capture_listener->OnUniqueTracepointInfo(tracepoint_info.tracepoint_info_key(),
-                                             std::move(tracepoint_info_translated));
+                                             TranslateTracepointInfo(tracepoint_info));
   }
 
   for (orbit_client_protos::TracepointEventInfo tracepoint_event_info :
@@ -0,0 +1,157 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// Saves a capture with many timers to a file, uncompressed and compressed, and
+// loads it back with 1, 2, 4, ... up to --max_threads parsing threads. Reports
+// the file size and save time, and the load time and the timers per second for
+// each thread count.
+
+#include <OrbitBase/Logging.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <utility>
+
+#include "OrbitClientModel/CaptureDeserializer.h"
+#include "OrbitClientModel/CaptureSerializer.h"
+#include "absl/flags/flag.h"
+#include "absl/flags/parse.h"
+#include "capture_data.pb.h"
+
+ABSL_FLAG(uint64_t, timers, 40'000'000, "Number of timers in the capture");
+ABSL_FLAG(uint32_t, max_threads, std::max(1u, std::thread::hardware_concurrency()),
+          "Maximum number of parsing threads");
+ABSL_FLAG(std::string, file, "", "Capture file to write and load (default: in the temp dir)");
+
+namespace {
+
+using orbit_client_protos::CallstackEvent;
+using orbit_client_protos::CaptureHeader;
+using orbit_client_protos::FunctionInfo;
+using orbit_client_protos::LinuxAddressInfo;
+using orbit_client_protos::TimerInfo;
+using orbit_client_protos::TracepointEventInfo;
+
+// Generates timers that look like the ones of dynamically instrumented
+// functions while the capture is saved. The durations, threads and functions
+// are pseudo-random, so that the timers do not compress better than real ones.
+class TimerGenerator {
+ public:
+  explicit TimerGenerator(uint64_t index) : index_{index} { Update(); }
+  const TimerInfo& operator*() const { return timer_; }
+  TimerGenerator& operator++() {
+    ++index_;
+    Update();
+    return *this;
+  }
+  bool operator!=(const TimerGenerator& other) const { return index_ != other.index_; }
+
+ private:
+  void Update() {
+    uint64_t random = index_ * 0x9e3779b97f4a7c15;
+    random ^= random >> 29;
+    uint64_t start = 1'000'000'000'000 + index_ * 1000 + random % 500;
+    timer_.set_start(start);
+    timer_.set_end(start + 100 + (random >> 8) % 100'000);
+    timer_.set_process_id(42);
+    timer_.set_thread_id(static_cast<int32_t>(100 + (random >> 24) % 64));
+    timer_.set_depth(static_cast<uint32_t>((random >> 32) % 16));
+    timer_.set_function_address(0x7f0000000000 + (random >> 40) % 4096 * 16);
+    timer_.set_processor(static_cast<int32_t>((random >> 52) % 32));
+  }
+
+  uint64_t index_;
+  TimerInfo timer_;
+};
+
+class CountingCaptureListener : public CaptureListener {
+ public:
+  void OnCaptureStarted(int32_t /*process_id*/, std::string /*process_name*/,
+                        std::shared_ptr<Process> /*process*/,
+                        absl::flat_hash_map<uint64_t, FunctionInfo> /*selected_functions*/,
+                        TracepointInfoSet /*selected_tracepoints*/) override {}
+  void OnCaptureComplete() override { completed = true; }
+  void OnCaptureCancelled() override {}
+  void OnCaptureFailed(ErrorMessage error_message) override {
+    ERROR("Loading the capture failed: %s", error_message.message());
+  }
+  void OnTimer(const TimerInfo& timer_info) override {
+    ++timer_count;
+    timer_duration_sum += timer_info.end() - timer_info.start();
+  }
+  void OnKeyAndString(uint64_t /*key*/, std::string /*str*/) override {}
+  void OnUniqueCallStack(CallStack /*callstack*/) override {}
+  void OnCallstackEvent(CallstackEvent /*callstack_event*/) override {}
+  void OnThreadName(int32_t /*thread_id*/, std::string /*thread_name*/) override {}
+  void OnAddressInfo(LinuxAddressInfo /*address_info*/) override {}
+  void OnUniqueTracepointInfo(uint64_t /*key*/,
+                              orbit_grpc_protos::TracepointInfo /*tracepoint_info*/) override {}
+  void OnTracepointEvent(TracepointEventInfo /*tracepoint_event_info*/) override {}
+
+  uint64_t timer_count = 0;
+  uint64_t timer_duration_sum = 0;
+  bool completed = false;
+};
+
+void SaveAndLoad(const std::string& file_name, uint64_t timer_count, uint32_t max_thread_count,
+                 capture_serializer::ChunkCompression compression) {
+  {
+    std::ofstream file{file_name, std::ios::binary};
+    auto begin = std::chrono::steady_clock::now();
+    capture_serializer::internal::Save(file, CaptureData{}, {}, TimerGenerator{0},
+                                       TimerGenerator{timer_count}, compression);
+    file.flush();
+    double duration_s =
+        std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+    FAIL_IF(file.fail(), "Could not write \"%s\"", file_name);
+    printf("Saved %lu timers, %.2f GB: %.2f s, %.0f timers/s\n", timer_count,
+           static_cast<double>(file.tellp()) / 1e9, duration_s, timer_count / duration_s);
+  }
+
+  for (uint32_t thread_count = 1; thread_count <= max_thread_count; thread_count *= 2) {
+    std::ifstream file{file_name, std::ios::binary};
+    CountingCaptureListener listener;
+    std::atomic<bool> cancellation_requested = false;
+    auto begin = std::chrono::steady_clock::now();
+    CaptureHeader header;
+    FAIL_IF(!capture_deserializer::internal::ReadHeader(&file, &header),
+            "Could not read the header");
+    capture_deserializer::internal::LoadChunks(&file, "Could not load the capture", &listener,
+                                               &cancellation_requested, thread_count);
+    double duration_s =
+        std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+    FAIL_IF(!listener.completed || listener.timer_count != timer_count, "Loading failed");
+    printf("%u threads: %.2f s, %.0f timers/s\n", thread_count, duration_s,
+           timer_count / duration_s);
+  }
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  absl::ParseCommandLine(argc, argv);
+  uint64_t timer_count = absl::GetFlag(FLAGS_timers);
+  uint32_t max_thread_count = absl::GetFlag(FLAGS_max_threads);
+  std::string file_name = absl::GetFlag(FLAGS_file);
+  if (file_name.empty()) {
+    file_name =
+        (std::filesystem::temp_directory_path() / "CaptureDeserializerBenchmark.orbit").string();
+  }
+
+  for (auto [compression, name] :
+       {std::pair{capture_serializer::ChunkCompression::kNone, "Uncompressed"},
+        std::pair{capture_serializer::ChunkCompression::kZlib, "Compressed"}}) {
+    printf("%s:\n", name);
+    SaveAndLoad(file_name, timer_count, max_thread_count, compression);
+  }
+
+  std::filesystem::remove(file_name);
+  return 0;
+}
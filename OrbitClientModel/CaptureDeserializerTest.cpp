@@ -2,9 +2,16 @@
 // Use of this source code is governed by a BSD-style license that can be
 // found in the LICENSE file.
 
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <limits>
+#include <sstream>
 #include <vector>
 
+#include "FunctionUtils.h"
 #include "OrbitClientModel/CaptureDeserializer.h"
+#include "OrbitClientModel/CaptureSerializer.h"
 #include "absl/base/casts.h"
 #include "capture_data.pb.h"
 #include "gmock/gmock.h"
@@ -12,6 +19,7 @@
 
 using orbit_client_protos::CallstackEvent;
 using orbit_client_protos::CallstackInfo;
+using orbit_client_protos::CaptureChunkIndex;
 using orbit_client_protos::CaptureHeader;
 using orbit_client_protos::CaptureInfo;
 using orbit_client_protos::FunctionInfo;
@@ -128,7 +136,7 @@ TEST(CaptureDeserializer, LoadNoCaptureInfo) {
   EXPECT_CALL(listener, OnCaptureComplete).Times(0);
   EXPECT_CALL(listener, OnCaptureCancelled).Times(0);
   CaptureHeader header;
-  header.set_version(capture_deserializer::internal::kRequiredCaptureVersion);
+  header.set_version(capture_deserializer::internal::kCaptureInfoVersion);
 
   std::string serialized_header;
   header.SerializeToString(&serialized_header);
@@ -415,4 +423,375 @@ TEST(CaptureDeserializer, LoadCaptureInfoTimers) {
   EXPECT_EQ(timer_2.process_id(), actual_timer_2.process_id());
 }
 
+TEST(CaptureDeserializer, LoadSavedCapture) {
+  absl::flat_hash_map<uint64_t, FunctionInfo> selected_functions;
+  FunctionInfo selected_function;
+  selected_function.set_name("foo");
+  selected_function.set_address(123);
+  selected_functions[FunctionUtils::GetAbsoluteAddress(selected_function)] = selected_function;
+  CaptureData capture_data{42, "process", std::make_shared<Process>(), selected_functions,
+                           TracepointInfoSet{}};
+
+  LinuxAddressInfo address_info;
+  address_info.set_absolute_address(987);
+  address_info.set_function_name("bar");
+  capture_data.InsertAddressInfo(address_info);
+  capture_data.AddOrAssignThreadName(7, "thread");
+
+  CallStack callstack({1, 2, 3});
+  capture_data.AddUniqueCallStack(callstack);
+  CallstackEvent callstack_event;
+  callstack_event.set_time(1);
+  callstack_event.set_thread_id(7);
+  callstack_event.set_callstack_hash(callstack.GetHash());
+  capture_data.AddCallstackEvent(callstack_event);
+
+  absl::flat_hash_map<uint64_t, std::string> key_to_string_map;
+  key_to_string_map[1] = "string_a";
+  std::vector<TimerInfo> timers(2);
+  timers[0].set_start(10);
+  timers[1].set_start(20);
+
+  std::stringstream stream;
+  capture_serializer::internal::Save(stream, capture_data, key_to_string_map, timers.begin(),
+                                     timers.end());
+
+  MockCaptureListener listener;
+  std::atomic<bool> cancellation_requested = false;
+  absl::flat_hash_map<uint64_t, FunctionInfo> actual_selected_functions;
+  LinuxAddressInfo actual_address_info;
+  CallStack actual_callstack;
+  CallstackEvent actual_callstack_event;
+  TimerInfo actual_timer_1;
+  TimerInfo actual_timer_2;
+  {
+    ::testing::InSequence in_sequence;
+    EXPECT_CALL(listener, OnCaptureStarted(42, "process", NotNull(), _, IsEmpty()))
+        .WillOnce(SaveArg<3>(&actual_selected_functions));
+    EXPECT_CALL(listener, OnThreadName(7, "thread"));
+    EXPECT_CALL(listener, OnAddressInfo).WillOnce(SaveArg<0>(&actual_address_info));
+    EXPECT_CALL(listener, OnUniqueCallStack).WillOnce(SaveArg<0>(&actual_callstack));
+    EXPECT_CALL(listener, OnCallstackEvent).WillOnce(SaveArg<0>(&actual_callstack_event));
+    EXPECT_CALL(listener, OnKeyAndString(1, "string_a"));
+    EXPECT_CALL(listener, OnTimer)
+        .WillOnce(SaveArg<0>(&actual_timer_1))
+        .WillOnce(SaveArg<0>(&actual_timer_2));
+    EXPECT_CALL(listener, OnCaptureComplete);
+  }
+  EXPECT_CALL(listener, OnCaptureFailed).Times(0);
+
+  capture_deserializer::Load(stream, "file_name", &listener, &cancellation_requested);
+
+  EXPECT_EQ(actual_selected_functions.size(), 1);
+  EXPECT_EQ(actual_address_info.absolute_address(), 987);
+  EXPECT_EQ(actual_callstack.GetFrames(), callstack.GetFrames());
+  EXPECT_EQ(actual_callstack_event.callstack_hash(), callstack.GetHash());
+  EXPECT_EQ(actual_timer_1.start(), 10);
+  EXPECT_EQ(actual_timer_2.start(), 20);
+}
+
+TEST(CaptureDeserializer, LoadUnfinishedChunkedCapture) {
+  CaptureData capture_data;
+  std::vector<TimerInfo> timers(100);
+  std::stringstream stream;
+  capture_serializer::internal::Save(stream, capture_data, {}, timers.begin(), timers.end());
+  std::string serialized_capture = stream.str();
+  // Cut the capture in the middle of the chunk index.
+  std::stringstream truncated_stream{serialized_capture.substr(0, serialized_capture.size() - 20)};
+
+  MockCaptureListener listener;
+  std::atomic<bool> cancellation_requested = false;
+  EXPECT_CALL(listener, OnCaptureStarted).Times(1);
+  EXPECT_CALL(listener, OnTimer).Times(100);
+  EXPECT_CALL(listener, OnCaptureFailed).Times(0);
+  EXPECT_CALL(listener, OnCaptureComplete).Times(1);
+  capture_deserializer::Load(truncated_stream, "file_name", &listener, &cancellation_requested);
+}
+
+TEST(CaptureDeserializer, LoadUnfinishedChunkedCaptureWithoutCaptureInfo) {
+  std::stringstream stream;
+  capture_serializer::internal::Save(stream, CaptureData{}, {}, std::vector<TimerInfo>{}.begin(),
+                                     std::vector<TimerInfo>{}.end());
+  std::string serialized_capture = stream.str();
+  CaptureHeader header;
+  ASSERT_TRUE(capture_deserializer::internal::ReadHeader(&stream, &header));
+  // Cut the capture in the middle of the CaptureInfo chunk.
+  std::stringstream truncated_stream{serialized_capture.substr(0, stream.tellg() + 4)};
+
+  MockCaptureListener listener;
+  std::atomic<bool> cancellation_requested = false;
+  EXPECT_CALL(listener, OnCaptureStarted).Times(0);
+  EXPECT_CALL(listener, OnCaptureFailed).Times(1);
+  EXPECT_CALL(listener, OnCaptureComplete).Times(0);
+  capture_deserializer::Load(truncated_stream, "file_name", &listener, &cancellation_requested);
+}
+
+TEST(CaptureDeserializer, LoadChunkedCaptureWithInvalidChunkType) {
+  CaptureData capture_data;
+  std::vector<TimerInfo> timers(100);
+  std::stringstream stream;
+  capture_serializer::internal::Save(stream, capture_data, {}, timers.begin(), timers.end());
+  ErrorMessageOr<CaptureChunkIndex> index = capture_deserializer::internal::ReadChunkIndex(&stream);
+  ASSERT_TRUE(index.has_value());
+  ASSERT_EQ(index.value().chunks_size(), 2);
+  ASSERT_EQ(index.value().chunks(1).type(), CaptureChunkIndex::kTimer);
+  std::string serialized_capture = stream.str();
+  // The timer chunk starts with its type.
+  serialized_capture[index.value().chunks(1).offset()] = 42;
+  std::stringstream corrupted_stream{serialized_capture};
+
+  MockCaptureListener listener;
+  std::atomic<bool> cancellation_requested = false;
+  EXPECT_CALL(listener, OnCaptureStarted).Times(1);
+  EXPECT_CALL(listener, OnTimer).Times(0);
+  EXPECT_CALL(listener, OnCaptureFailed).Times(1);
+  EXPECT_CALL(listener, OnCaptureComplete).Times(0);
+  capture_deserializer::Load(corrupted_stream, "file_name", &listener, &cancellation_requested);
+}
+
+TEST(CaptureDeserializer, ReadChunkWithPayloadSizeLargerThanTheFile) {
+  std::string serialized_chunk(8, '\0');
+  serialized_chunk[0] = CaptureChunkIndex::kTimer;
+  // A payload size of almost 4 GiB, followed by 16 bytes of payload.
+  serialized_chunk[4] = '\xf0';
+  serialized_chunk[5] = '\xff';
+  serialized_chunk[6] = '\xff';
+  serialized_chunk[7] = '\xff';
+  serialized_chunk.append(16, 'x');
+  std::stringstream stream{serialized_chunk};
+
+  CaptureChunkIndex::ChunkType type;
+  bool compressed;
+  std::string payload;
+  EXPECT_FALSE(capture_deserializer::internal::ReadChunk(&stream, &type, &compressed, &payload));
+  // Only about what the file holds was allocated.
+  EXPECT_LT(payload.capacity(), std::numeric_limits<uint32_t>::max() / 2);
+}
+
+TEST(CaptureDeserializer, LoadCompressedCapture) {
+  CaptureData capture_data;
+  CallStack callstack({1, 2, 3});
+  capture_data.AddUniqueCallStack(callstack);
+  CallstackEvent callstack_event;
+  callstack_event.set_thread_id(7);
+  callstack_event.set_callstack_hash(callstack.GetHash());
+  for (uint64_t time : {30, 10, 20}) {
+    callstack_event.set_time(time);
+    capture_data.AddCallstackEvent(callstack_event);
+  }
+  // Timestamps and addresses that go back and forth, and a timer that ends
+  // before it starts, as the delta encoding must not assume any order.
+  std::vector<TimerInfo> timers(4);
+  timers[0].set_start(1000);
+  timers[0].set_end(2000);
+  timers[0].set_function_address(0x7f0000001000);
+  timers[1].set_start(500);
+  timers[1].set_end(400);
+  timers[1].set_function_address(0x1000);
+  timers[2].set_start(std::numeric_limits<uint64_t>::max());
+  timers[2].set_end(std::numeric_limits<uint64_t>::max());
+  timers[2].set_function_address(std::numeric_limits<uint64_t>::max());
+  timers[3].set_start(1500);
+  timers[3].set_end(1600);
+  timers[3].set_thread_id(7);
+  std::stringstream stream;
+  capture_serializer::internal::Save(stream, capture_data, {}, timers.begin(), timers.end(),
+                                     capture_serializer::ChunkCompression::kZlib);
+
+  ErrorMessageOr<CaptureChunkIndex> index = capture_deserializer::internal::ReadChunkIndex(&stream);
+  ASSERT_TRUE(index.has_value());
+  ASSERT_EQ(index.value().chunks_size(), 4);
+  for (const CaptureChunkIndex::Chunk& chunk : index.value().chunks()) {
+    EXPECT_TRUE(chunk.compressed());
+  }
+  stream.seekg(0);
+
+  MockCaptureListener listener;
+  std::atomic<bool> cancellation_requested = false;
+  std::vector<uint64_t> callstack_event_times;
+  std::vector<TimerInfo> actual_timers;
+  EXPECT_CALL(listener, OnCaptureStarted).Times(1);
+  EXPECT_CALL(listener, OnUniqueCallStack).Times(1);
+  EXPECT_CALL(listener, OnCallstackEvent)
+      .Times(3)
+      .WillRepeatedly([&callstack_event_times](CallstackEvent callstack_event) {
+        callstack_event_times.push_back(callstack_event.time());
+      });
+  EXPECT_CALL(listener, OnTimer)
+      .Times(4)
+      .WillRepeatedly(
+          [&actual_timers](const TimerInfo& timer_info) { actual_timers.push_back(timer_info); });
+  EXPECT_CALL(listener, OnCaptureComplete).Times(1);
+  EXPECT_CALL(listener, OnCaptureFailed).Times(0);
+  capture_deserializer::Load(stream, "file_name", &listener, &cancellation_requested);
+
+  EXPECT_THAT(callstack_event_times, ::testing::UnorderedElementsAre(10, 20, 30));
+  ASSERT_EQ(actual_timers.size(), timers.size());
+  for (size_t i = 0; i < timers.size(); ++i) {
+    EXPECT_EQ(actual_timers[i].start(), timers[i].start());
+    EXPECT_EQ(actual_timers[i].end(), timers[i].end());
+    EXPECT_EQ(actual_timers[i].function_address(), timers[i].function_address());
+    EXPECT_EQ(actual_timers[i].thread_id(), timers[i].thread_id());
+  }
+}
+
+TEST(CaptureDeserializer, LoadCompressedCaptureWithCorruptedChunk) {
+  std::vector<TimerInfo> timers(100);
+  std::stringstream stream;
+  capture_serializer::internal::Save(stream, CaptureData{}, {}, timers.begin(), timers.end(),
+                                     capture_serializer::ChunkCompression::kZlib);
+  ErrorMessageOr<CaptureChunkIndex> index = capture_deserializer::internal::ReadChunkIndex(&stream);
+  ASSERT_TRUE(index.has_value());
+  ASSERT_EQ(index.value().chunks_size(), 2);
+  const CaptureChunkIndex::Chunk& timer_chunk = index.value().chunks(1);
+  ASSERT_EQ(timer_chunk.type(), CaptureChunkIndex::kTimer);
+  std::string serialized_capture = stream.str();
+  // Corrupt the end of the zlib stream of the timer chunk.
+  serialized_capture[timer_chunk.offset() + 8 + timer_chunk.payload_size() - 1] ^= 0xff;
+  std::stringstream corrupted_stream{serialized_capture};
+
+  MockCaptureListener listener;
+  std::atomic<bool> cancellation_requested = false;
+  EXPECT_CALL(listener, OnCaptureStarted).Times(1);
+  EXPECT_CALL(listener, OnTimer).Times(0);
+  EXPECT_CALL(listener, OnCaptureFailed).Times(1);
+  EXPECT_CALL(listener, OnCaptureComplete).Times(0);
+  capture_deserializer::Load(corrupted_stream, "file_name", &listener, &cancellation_requested);
+}
+
+class TimerCountingCaptureListener : public CaptureListener {
+ public:
+  void OnCaptureStarted(int32_t /*process_id*/, std::string /*process_name*/,
+                        std::shared_ptr<Process> /*process*/,
+                        absl::flat_hash_map<uint64_t, FunctionInfo> /*selected_functions*/,
+                        TracepointInfoSet /*selected_tracepoints*/) override {}
+  void OnCaptureComplete() override { completed = true; }
+  void OnCaptureCancelled() override {}
+  void OnCaptureFailed(ErrorMessage /*error_message*/) override {}
+  void OnTimer(const TimerInfo& timer_info) override {
+    if (timer_info.start() != timer_count || timer_info.registers_size() != kRegisterCount) {
+      ++unexpected_timer_count;
+    }
+    ++timer_count;
+  }
+  void OnKeyAndString(uint64_t /*key*/, std::string /*str*/) override {}
+  void OnUniqueCallStack(CallStack /*callstack*/) override {}
+  void OnCallstackEvent(CallstackEvent /*callstack_event*/) override {}
+  void OnThreadName(int32_t /*thread_id*/, std::string /*thread_name*/) override {}
+  void OnAddressInfo(LinuxAddressInfo /*address_info*/) override {}
+  void OnUniqueTracepointInfo(uint64_t /*key*/, TracepointInfo /*tracepoint_info*/) override {}
+  void OnTracepointEvent(TracepointEventInfo /*tracepoint_event_info*/) override {}
+
+  static constexpr int kRegisterCount = 256;
+  uint64_t timer_count = 0;
+  uint64_t unexpected_timer_count = 0;
+  bool completed = false;
+};
+
+// Generates the timers while the capture is saved, so that they are never all
+// in memory.
+class TimerGenerator {
+ public:
+  explicit TimerGenerator(uint64_t index) : index_{index} {
+    for (int i = 0; i < TimerCountingCaptureListener::kRegisterCount; ++i) {
+      // Large enough to take the maximum size of a varint.
+      timer_.add_registers(std::numeric_limits<uint64_t>::max() - i);
+    }
+    timer_.set_start(index_);
+  }
+  const TimerInfo& operator*() const { return timer_; }
+  TimerGenerator& operator++() {
+    timer_.set_start(++index_);
+    return *this;
+  }
+  bool operator!=(const TimerGenerator& other) const { return index_ != other.index_; }
+
+ private:
+  uint64_t index_;
+  TimerInfo timer_;
+};
+
+TEST(CaptureDeserializer, LoadChunksOnSeveralThreadsInOrder) {
+  // Each timer takes more than 2.5 KiB, so this makes several chunks.
+  constexpr uint64_t kTimerCount = 10'000;
+  std::stringstream stream;
+  capture_serializer::internal::Save(stream, CaptureData{}, {}, TimerGenerator{0},
+                                     TimerGenerator{kTimerCount});
+  CaptureHeader header;
+  ASSERT_TRUE(capture_deserializer::internal::ReadHeader(&stream, &header));
+
+  TimerCountingCaptureListener listener;
+  std::atomic<bool> cancellation_requested = false;
+  capture_deserializer::internal::LoadChunks(&stream, "error", &listener, &cancellation_requested,
+                                             4);
+
+  EXPECT_TRUE(listener.completed);
+  EXPECT_EQ(listener.timer_count, kTimerCount);
+  EXPECT_EQ(listener.unexpected_timer_count, 0);
+}
+
+TEST(CaptureDeserializer, LoadCompressedChunksOnSeveralThreadsInOrder) {
+  constexpr uint64_t kTimerCount = 10'000;
+  std::stringstream stream;
+  capture_serializer::internal::Save(stream, CaptureData{}, {}, TimerGenerator{0},
+                                     TimerGenerator{kTimerCount},
+                                     capture_serializer::ChunkCompression::kZlib);
+  ErrorMessageOr<CaptureChunkIndex> index = capture_deserializer::internal::ReadChunkIndex(&stream);
+  ASSERT_TRUE(index.has_value());
+  // The chunks are split before compression, so the timers still make several
+  // chunks, each delta-encoded on its own.
+  ASSERT_GT(index.value().chunks_size(), 2);
+  stream.seekg(0);
+  CaptureHeader header;
+  ASSERT_TRUE(capture_deserializer::internal::ReadHeader(&stream, &header));
+
+  TimerCountingCaptureListener listener;
+  std::atomic<bool> cancellation_requested = false;
+  capture_deserializer::internal::LoadChunks(&stream, "error", &listener, &cancellation_requested,
+                                             4);
+
+  EXPECT_TRUE(listener.completed);
+  EXPECT_EQ(listener.timer_count, kTimerCount);
+  EXPECT_EQ(listener.unexpected_timer_count, 0);
+}
+
+TEST(CaptureDeserializer, LoadChunksCancelled) {
+  CaptureData capture_data;
+  std::vector<TimerInfo> timers(100);
+  std::stringstream stream;
+  capture_serializer::internal::Save(stream, capture_data, {}, timers.begin(), timers.end());
+
+  MockCaptureListener listener;
+  std::atomic<bool> cancellation_requested = false;
+  EXPECT_CALL(listener, OnCaptureStarted)
+      .WillOnce(InvokeWithoutArgs([&cancellation_requested] { cancellation_requested = true; }));
+  EXPECT_CALL(listener, OnTimer).Times(0);
+  EXPECT_CALL(listener, OnCaptureCancelled).Times(1);
+  EXPECT_CALL(listener, OnCaptureComplete).Times(0);
+  capture_deserializer::Load(stream, "file_name", &listener, &cancellation_requested);
+}
+
+TEST(CaptureDeserializer, LoadChunkedCaptureLargerThan2GiB) {
+  // Each timer takes more than 2.5 KiB, so this is more than 2 GiB.
+  constexpr uint64_t kTimerCount = 850'000;
+  std::string file_name =
+      (std::filesystem::temp_directory_path() / "LoadChunkedCaptureLargerThan2GiB.orbit").string();
+  {
+    std::ofstream file{file_name, std::ios::binary};
+    capture_serializer::internal::Save(file, CaptureData{}, {}, TimerGenerator{0},
+                                       TimerGenerator{kTimerCount});
+    ASSERT_FALSE(file.fail());
+    ASSERT_GT(file.tellp(), std::numeric_limits<int32_t>::max());
+  }
+
+  TimerCountingCaptureListener listener;
+  std::atomic<bool> cancellation_requested = false;
+  capture_deserializer::Load(file_name, &listener, &cancellation_requested);
+  std::remove(file_name.c_str());
+
+  EXPECT_TRUE(listener.completed);
+  EXPECT_EQ(listener.timer_count, kTimerCount);
+  EXPECT_EQ(listener.unexpected_timer_count, 0);
+}
+
 }  // namespace
\ No newline at end of file
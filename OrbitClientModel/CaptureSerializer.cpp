@@ -4,7 +4,9 @@
 
 #include "OrbitClientModel/CaptureSerializer.h"
 
+#include <limits>
 #include <memory>
+#include <ostream>
 
 #include "Callstack.h"
 #include "OrbitProcess.h"
@@ -13,9 +15,13 @@
 #include "google/protobuf/io/coded_stream.h"
 #include "google/protobuf/message.h"
 
+using orbit_client_protos::CallstackEvent;
 using orbit_client_protos::CallstackInfo;
+using orbit_client_protos::CaptureChunkIndex;
+using orbit_client_protos::CaptureHeader;
 using orbit_client_protos::CaptureInfo;
 using orbit_client_protos::FunctionStats;
+using orbit_client_protos::TimerInfo;
 
 namespace {
 inline constexpr std::string_view kFileOrbitExtension = ".orbit";
@@ -47,9 +53,133 @@ void IncludeOrbitExtensionInFile(std::string& file_name) {
 
 namespace internal {
 
-CaptureInfo GenerateCaptureInfo(
-    const CaptureData& capture_data,
-    const absl::flat_hash_map<uint64_t, std::string>& key_to_string_map) {
+namespace {
+
+void AppendLittleEndian32(uint32_t value, std::string* output) {
+  uint8_t bytes[sizeof(value)];
+  google::protobuf::io::CodedOutputStream::WriteLittleEndian32ToArray(value, bytes);
+  output->append(reinterpret_cast<const char*>(bytes), sizeof(bytes));
+}
+
+void AppendLittleEndian64(uint64_t value, std::string* output) {
+  uint8_t bytes[sizeof(value)];
+  google::protobuf::io::CodedOutputStream::WriteLittleEndian64ToArray(value, bytes);
+  output->append(reinterpret_cast<const char*>(bytes), sizeof(bytes));
+}
+
+void AppendMessage(const google::protobuf::Message& message, std::string* output) {
+  AppendLittleEndian32(message.ByteSizeLong(), output);
+  message.AppendToString(output);
+}
+
+}  // namespace
+
+ChunkWriter::ChunkWriter(std::ostream* stream, ChunkCompression compression)
+    : stream_{stream}, compression_{compression} {
+  CaptureHeader header;
+  header.set_version(kRequiredCaptureVersion);
+  std::string serialized_header;
+  AppendMessage(header, &serialized_header);
+  stream_->write(serialized_header.data(), serialized_header.size());
+  offset_ += serialized_header.size();
+}
+
+void ChunkWriter::WriteMessage(CaptureChunkIndex::ChunkType type,
+                               const google::protobuf::Message& message) {
+  CHECK(type != CaptureChunkIndex::kUnknown && type != CaptureChunkIndex::kChunkIndex);
+  if (type != chunk_type_) {
+    WriteCurrentChunk();
+  }
+  chunk_type_ = type;
+  AppendMessage(DeltaEncode(type, message), &chunk_payload_);
+  ++chunk_message_count_;
+  if (chunk_payload_.size() >= kMaxChunkSize) {
+    WriteCurrentChunk();
+  }
+}
+
+void ChunkWriter::Flush() {
+  WriteCurrentChunk();
+  stream_->flush();
+}
+
+void ChunkWriter::Finish() {
+  WriteCurrentChunk();
+
+  uint64_t index_offset = offset_;
+  std::string index_payload;
+  AppendMessage(index_, &index_payload);
+  WriteChunk(CaptureChunkIndex::kChunkIndex, index_payload, 1);
+  std::string footer;
+  AppendLittleEndian64(index_offset, &footer);
+  stream_->write(footer.data(), footer.size());
+  offset_ += footer.size();
+}
+
+const google::protobuf::Message& ChunkWriter::DeltaEncode(
+    CaptureChunkIndex::ChunkType type, const google::protobuf::Message& message) {
+  if (compression_ == ChunkCompression::kNone) {
+    return message;
+  }
+  switch (type) {
+    case CaptureChunkIndex::kTimer: {
+      const auto* timer_info = dynamic_cast<const TimerInfo*>(&message);
+      CHECK(timer_info != nullptr);
+      encoded_timer_info_ = *timer_info;
+      delta_coder_.Encode(&encoded_timer_info_);
+      return encoded_timer_info_;
+    }
+    case CaptureChunkIndex::kCallstackEvent: {
+      const auto* callstack_event = dynamic_cast<const CallstackEvent*>(&message);
+      CHECK(callstack_event != nullptr);
+      encoded_callstack_event_ = *callstack_event;
+      delta_coder_.Encode(&encoded_callstack_event_);
+      return encoded_callstack_event_;
+    }
+    default:
+      return message;
+  }
+}
+
+void ChunkWriter::WriteCurrentChunk() {
+  if (chunk_message_count_ == 0) {
+    return;
+  }
+  WriteChunk(chunk_type_, chunk_payload_, chunk_message_count_);
+  chunk_payload_.clear();
+  chunk_message_count_ = 0;
+  delta_coder_ = ChunkDeltaCoder{};
+}
+
+void ChunkWriter::WriteChunk(CaptureChunkIndex::ChunkType type, const std::string& payload,
+                             uint32_t message_count) {
+  // The index stays uncompressed, so that it can be read without the chunks.
+  bool compressed =
+      compression_ != ChunkCompression::kNone && type != CaptureChunkIndex::kChunkIndex;
+  std::string compressed_payload;
+  if (compressed) {
+    compressed_payload = CompressChunkPayload(payload);
+  }
+  const std::string& written_payload = compressed ? compressed_payload : payload;
+  CHECK(written_payload.size() <= std::numeric_limits<uint32_t>::max());
+  if (type != CaptureChunkIndex::kChunkIndex) {
+    CaptureChunkIndex::Chunk* chunk = index_.add_chunks();
+    chunk->set_type(type);
+    chunk->set_offset(offset_);
+    chunk->set_payload_size(written_payload.size());
+    chunk->set_message_count(message_count);
+    chunk->set_compressed(compressed);
+  }
+
+  std::string chunk_header;
+  AppendLittleEndian32(compressed ? type | kCompressedChunkFlag : type, &chunk_header);
+  AppendLittleEndian32(written_payload.size(), &chunk_header);
+  stream_->write(chunk_header.data(), chunk_header.size());
+  stream_->write(written_payload.data(), written_payload.size());
+  offset_ += chunk_header.size() + written_payload.size();
+}
+
+CaptureInfo GenerateCaptureInfo(const CaptureData& capture_data) {
   CaptureInfo capture_info;
   for (const auto& pair : capture_data.selected_functions()) {
     capture_info.add_selected_functions()->CopyFrom(pair.second);
@@ -61,35 +191,10 @@ CaptureInfo GenerateCaptureInfo(
   capture_info.mutable_thread_names()->insert(capture_data.thread_names().begin(),
                                               capture_data.thread_names().end());
 
-  capture_info.mutable_address_infos()->Reserve(capture_data.address_infos().size());
-  for (const auto& address_info : capture_data.address_infos()) {
-    orbit_client_protos::LinuxAddressInfo* added_address_info = capture_info.add_address_infos();
-    added_address_info->CopyFrom(address_info.second);
-    // Fix names in address infos (some might only be in process):
-    added_address_info->set_function_name(
-        capture_data.GetFunctionNameByAddress(added_address_info->absolute_address()));
-  }
-
   const absl::flat_hash_map<uint64_t, FunctionStats>& functions_stats =
       capture_data.functions_stats();
   capture_info.mutable_function_stats()->insert(functions_stats.begin(), functions_stats.end());
 
-  // TODO: this is not really synchronized, since GetCallstackData processing below is not under the
-  // same mutex lock we could end up having list of callstacks inconsistent with unique_callstacks.
-  // Revisit sampling profiler data thread-safety.
-  capture_data.GetCallstackData()->ForEachUniqueCallstack(
-      [&capture_info](const CallStack& call_stack) {
-        CallstackInfo* callstack = capture_info.add_callstacks();
-        *callstack->mutable_data() = {call_stack.GetFrames().begin(), call_stack.GetFrames().end()};
-      });
-
-  capture_info.mutable_callstack_events()->Reserve(
-      capture_data.GetCallstackData()->GetCallstackEventsCount());
-  capture_data.GetCallstackData()->ForEachCallstackEvent(
-      [&capture_info](const orbit_client_protos::CallstackEvent& event) {
-        capture_info.add_callstack_events()->CopyFrom(event);
-      });
-
   capture_data.GetTracepointInfoManager()->ForEachUniqueTracepointInfo(
       [&capture_info](const orbit_client_protos::TracepointInfo& tracepoint_info) {
         orbit_client_protos::TracepointInfo* new_tracepoint_info =
@@ -99,14 +204,48 @@ CaptureInfo GenerateCaptureInfo(
         new_tracepoint_info->set_tracepoint_info_key(tracepoint_info.tracepoint_info_key());
       });
 
-  capture_data.GetTracepointEventBuffer()->ForEachTracepointEvent(
-      [&capture_info](const orbit_client_protos::TracepointEventInfo& tracepoint_event_info) {
-        capture_info.add_tracepoint_event_infos()->CopyFrom(tracepoint_event_info);
+  return capture_info;
+}
+
+void WriteCaptureData(const CaptureData& capture_data,
+                      const absl::flat_hash_map<uint64_t, std::string>& key_to_string_map,
+                      ChunkWriter* writer) {
+  writer->WriteMessage(CaptureChunkIndex::kCaptureInfo, GenerateCaptureInfo(capture_data));
+
+  for (const auto& address_info : capture_data.address_infos()) {
+    orbit_client_protos::LinuxAddressInfo fixed_address_info = address_info.second;
+    // Fix names in address infos (some might only be in process):
+    fixed_address_info.set_function_name(
+        capture_data.GetFunctionNameByAddress(fixed_address_info.absolute_address()));
+    writer->WriteMessage(CaptureChunkIndex::kAddressInfo, fixed_address_info);
+  }
+
+  // TODO: this is not really synchronized, since GetCallstackData processing below is not under the
+  // same mutex lock we could end up having list of callstacks inconsistent with unique_callstacks.
+  // Revisit sampling profiler data thread-safety.
+  CallstackInfo callstack;
+  capture_data.GetCallstackData()->ForEachUniqueCallstack(
+      [writer, &callstack](const CallStack& call_stack) {
+        *callstack.mutable_data() = {call_stack.GetFrames().begin(), call_stack.GetFrames().end()};
+        writer->WriteMessage(CaptureChunkIndex::kCallstack, callstack);
       });
 
-  capture_info.mutable_key_to_string()->insert(key_to_string_map.begin(), key_to_string_map.end());
+  capture_data.GetCallstackData()->ForEachCallstackEvent(
+      [writer](const orbit_client_protos::CallstackEvent& event) {
+        writer->WriteMessage(CaptureChunkIndex::kCallstackEvent, event);
+      });
 
-  return capture_info;
+  capture_data.GetTracepointEventBuffer()->ForEachTracepointEvent(
+      [writer](const orbit_client_protos::TracepointEventInfo& tracepoint_event_info) {
+        writer->WriteMessage(CaptureChunkIndex::kTracepointEvent, tracepoint_event_info);
+      });
+
+  orbit_client_protos::KeyAndString key_and_string;
+  for (const auto& [key, str] : key_to_string_map) {
+    key_and_string.set_key(key);
+    key_and_string.set_str(str);
+    writer->WriteMessage(CaptureChunkIndex::kKeyAndString, key_and_string);
+  }
 }
 
 }  // namespace internal
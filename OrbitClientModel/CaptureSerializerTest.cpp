@@ -2,8 +2,12 @@
 // Use of this source code is governed by a BSD-style license that can be
 // found in the LICENSE file.
 
+#include <sstream>
+#include <vector>
+
 #include "CaptureData.h"
 #include "FunctionUtils.h"
+#include "OrbitClientModel/CaptureDeserializer.h"
 #include "OrbitClientModel/CaptureSerializer.h"
 #include "OrbitProcess.h"
 #include "TracepointCustom.h"
@@ -14,12 +18,13 @@
 #include "gtest/gtest.h"
 
 using orbit_client_protos::CallstackEvent;
-using orbit_client_protos::CallstackInfo;
+using orbit_client_protos::CaptureChunkIndex;
+using orbit_client_protos::CaptureHeader;
 using orbit_client_protos::CaptureInfo;
 using orbit_client_protos::FunctionInfo;
 using orbit_client_protos::FunctionStats;
 using orbit_client_protos::LinuxAddressInfo;
-using ::testing::ElementsAreArray;
+using orbit_client_protos::TimerInfo;
 
 TEST(CaptureSerializer, GetCaptureFileName) {
   CaptureData capture_data;
@@ -42,10 +47,8 @@ TEST(CaptureSerializer, IncludeOrbitExtensionInFile) {
 
 TEST(CaptureSerializer, GenerateCaptureInfoEmpty) {
   CaptureData capture_data;
-  absl::flat_hash_map<uint64_t, std::string> key_to_string_map;
 
-  CaptureInfo capture_info =
-      capture_serializer::internal::GenerateCaptureInfo(capture_data, key_to_string_map);
+  CaptureInfo capture_info = capture_serializer::internal::GenerateCaptureInfo(capture_data);
   EXPECT_EQ(0, capture_info.selected_functions_size());
   EXPECT_EQ(-1, capture_info.process_id());
   EXPECT_EQ("", capture_info.process_name());
@@ -56,7 +59,9 @@ TEST(CaptureSerializer, GenerateCaptureInfoEmpty) {
   EXPECT_EQ(0, capture_info.function_stats_size());
 }
 
-TEST(CaptureSerializer, GenerateCaptureInfo) {
+namespace {
+
+CaptureData CreateCaptureData() {
   int32_t process_id = 42;
   std::string process_name = "p";
   auto process = std::make_shared<Process>();
@@ -95,39 +100,30 @@ TEST(CaptureSerializer, GenerateCaptureInfo) {
   capture_data.UpdateFunctionStats(selected_function, 100);
   capture_data.UpdateFunctionStats(selected_function, 110);
   capture_data.UpdateFunctionStats(selected_function, 120);
+  return capture_data;
+}
 
-  absl::flat_hash_map<uint64_t, std::string> key_to_string_map;
-  key_to_string_map[0] = "a";
-  key_to_string_map[1] = "b";
-  key_to_string_map[2] = "c";
+}  // namespace
+
+TEST(CaptureSerializer, GenerateCaptureInfo) {
+  CaptureData capture_data = CreateCaptureData();
+  const FunctionInfo& selected_function = capture_data.selected_functions().begin()->second;
 
-  CaptureInfo capture_info =
-      capture_serializer::internal::GenerateCaptureInfo(capture_data, key_to_string_map);
+  CaptureInfo capture_info = capture_serializer::internal::GenerateCaptureInfo(capture_data);
 
   ASSERT_EQ(1, capture_info.selected_functions_size());
   const FunctionInfo& actual_selected_function = capture_info.selected_functions(0);
   EXPECT_EQ(selected_function.address(), actual_selected_function.address());
   EXPECT_EQ(selected_function.name(), actual_selected_function.name());
 
-  EXPECT_EQ(process_id, capture_info.process_id());
-  EXPECT_EQ(process_name, capture_info.process_name());
-
-  ASSERT_EQ(1, capture_info.address_infos_size());
-  const LinuxAddressInfo& actual_address_info = capture_info.address_infos(0);
-  EXPECT_EQ(address_info.absolute_address(), actual_address_info.absolute_address());
-  EXPECT_EQ(address_info.offset_in_function(), actual_address_info.offset_in_function());
+  EXPECT_EQ(42, capture_info.process_id());
+  EXPECT_EQ("p", capture_info.process_name());
 
-  ASSERT_EQ(1, capture_info.callstacks_size());
-  const CallstackInfo& actual_callstack = capture_info.callstacks(0);
-  std::vector<uint64_t> actual_callstack_data{actual_callstack.data().begin(),
-                                              actual_callstack.data().end()};
-  EXPECT_THAT(actual_callstack_data, ElementsAreArray(callstack.GetFrames()));
-
-  ASSERT_EQ(1, capture_info.callstack_events_size());
-  const CallstackEvent& actual_callstack_event = capture_info.callstack_events(0);
-  EXPECT_EQ(callstack_event.thread_id(), actual_callstack_event.thread_id());
-  EXPECT_EQ(callstack_event.time(), actual_callstack_event.time());
-  EXPECT_EQ(callstack_event.callstack_hash(), actual_callstack_event.callstack_hash());
+  // These have their own chunks.
+  EXPECT_EQ(0, capture_info.address_infos_size());
+  EXPECT_EQ(0, capture_info.callstacks_size());
+  EXPECT_EQ(0, capture_info.callstack_events_size());
+  EXPECT_EQ(0, capture_info.key_to_string_size());
 
   ASSERT_EQ(1, capture_info.function_stats_size());
   ASSERT_TRUE(
@@ -141,11 +137,108 @@ TEST(CaptureSerializer, GenerateCaptureInfo) {
   EXPECT_EQ(expected_function_stats.average_time_ns(), actual_function_stats.average_time_ns());
   EXPECT_EQ(expected_function_stats.min_ns(), actual_function_stats.min_ns());
   EXPECT_EQ(expected_function_stats.max_ns(), actual_function_stats.max_ns());
+}
+
+TEST(CaptureSerializer, SaveWritesChunksAndIndex) {
+  CaptureData capture_data = CreateCaptureData();
+  absl::flat_hash_map<uint64_t, std::string> key_to_string_map;
+  key_to_string_map[0] = "a";
+  key_to_string_map[1] = "b";
+  key_to_string_map[2] = "c";
+  std::vector<TimerInfo> timers(3);
+
+  std::stringstream stream;
+  capture_serializer::internal::Save(stream, capture_data, key_to_string_map, timers.begin(),
+                                     timers.end());
+
+  CaptureHeader header;
+  ASSERT_TRUE(capture_deserializer::internal::ReadHeader(&stream, &header));
+  EXPECT_EQ(header.version(), capture_serializer::internal::kRequiredCaptureVersion);
+
+  std::vector<CaptureChunkIndex::Chunk> chunks;
+  CaptureChunkIndex::ChunkType type;
+  bool compressed;
+  std::string payload;
+  do {
+    CaptureChunkIndex::Chunk chunk;
+    chunk.set_offset(stream.tellg());
+    ASSERT_TRUE(capture_deserializer::internal::ReadChunk(&stream, &type, &compressed, &payload));
+    EXPECT_FALSE(compressed);
+    chunk.set_type(type);
+    chunk.set_payload_size(payload.size());
+    chunks.push_back(chunk);
+  } while (type != CaptureChunkIndex::kChunkIndex);
+  chunks.pop_back();
+
+  std::vector<CaptureChunkIndex::ChunkType> expected_types{
+      CaptureChunkIndex::kCaptureInfo,    CaptureChunkIndex::kAddressInfo,
+      CaptureChunkIndex::kCallstack,      CaptureChunkIndex::kCallstackEvent,
+      CaptureChunkIndex::kKeyAndString,   CaptureChunkIndex::kTimer};
+  std::vector<uint32_t> expected_message_counts{1, 1, 1, 1, 3, 3};
+
+  ErrorMessageOr<CaptureChunkIndex> index = capture_deserializer::internal::ReadChunkIndex(&stream);
+  ASSERT_FALSE(index.has_error()) << index.error().message();
+  ASSERT_EQ(index.value().chunks_size(), chunks.size());
+  ASSERT_EQ(chunks.size(), expected_types.size());
+  for (size_t i = 0; i < chunks.size(); ++i) {
+    const CaptureChunkIndex::Chunk& indexed_chunk = index.value().chunks(i);
+    EXPECT_EQ(indexed_chunk.type(), expected_types[i]);
+    EXPECT_EQ(chunks[i].type(), expected_types[i]);
+    EXPECT_EQ(indexed_chunk.offset(), chunks[i].offset());
+    EXPECT_EQ(indexed_chunk.payload_size(), chunks[i].payload_size());
+    EXPECT_EQ(indexed_chunk.message_count(), expected_message_counts[i]);
+  }
+}
 
-  ASSERT_EQ(key_to_string_map.size(), capture_info.key_to_string_size());
-  for (const auto& expected_key_to_string : key_to_string_map) {
-    ASSERT_TRUE(capture_info.key_to_string().contains(expected_key_to_string.first));
-    EXPECT_EQ(expected_key_to_string.second,
-              capture_info.key_to_string().at(expected_key_to_string.first));
+TEST(CaptureSerializer, ChunkWriterSplitsChunks) {
+  std::stringstream stream;
+  capture_serializer::internal::ChunkWriter writer{&stream};
+  orbit_client_protos::KeyAndString key_and_string;
+  key_and_string.set_str(std::string(1024 * 1024, 'a'));
+  constexpr size_t kMessageCount = 10;
+  for (size_t i = 0; i < kMessageCount; ++i) {
+    key_and_string.set_key(i);
+    writer.WriteMessage(CaptureChunkIndex::kKeyAndString, key_and_string);
+  }
+  writer.Finish();
+
+  ErrorMessageOr<CaptureChunkIndex> index = capture_deserializer::internal::ReadChunkIndex(&stream);
+  ASSERT_FALSE(index.has_error()) << index.error().message();
+  ASSERT_GT(index.value().chunks_size(), 1);
+  uint64_t message_count = 0;
+  for (const CaptureChunkIndex::Chunk& chunk : index.value().chunks()) {
+    EXPECT_EQ(chunk.type(), CaptureChunkIndex::kKeyAndString);
+    EXPECT_LT(chunk.payload_size(),
+              capture_serializer::internal::ChunkWriter::kMaxChunkSize + 1024 * 1024 + 16);
+    message_count += chunk.message_count();
   }
-}
\ No newline at end of file
+  EXPECT_EQ(message_count, kMessageCount);
+}
+
+TEST(CaptureSerializer, ChunkWriterCompressesChunksButNotTheIndex) {
+  std::stringstream stream;
+  capture_serializer::internal::ChunkWriter writer{&stream,
+                                                   capture_serializer::ChunkCompression::kZlib};
+  orbit_client_protos::KeyAndString key_and_string;
+  key_and_string.set_str(std::string(1024 * 1024, 'a'));
+  writer.WriteMessage(CaptureChunkIndex::kKeyAndString, key_and_string);
+  writer.Finish();
+
+  CaptureHeader header;
+  ASSERT_TRUE(capture_deserializer::internal::ReadHeader(&stream, &header));
+  CaptureChunkIndex::ChunkType type;
+  bool compressed;
+  std::string payload;
+  ASSERT_TRUE(capture_deserializer::internal::ReadChunk(&stream, &type, &compressed, &payload));
+  EXPECT_EQ(type, CaptureChunkIndex::kKeyAndString);
+  EXPECT_TRUE(compressed);
+  EXPECT_LT(payload.size(), 1024 * 1024 / 100);
+  ASSERT_TRUE(capture_deserializer::internal::ReadChunk(&stream, &type, &compressed, &payload));
+  EXPECT_EQ(type, CaptureChunkIndex::kChunkIndex);
+  EXPECT_FALSE(compressed);
+
+  ErrorMessageOr<CaptureChunkIndex> index = capture_deserializer::internal::ReadChunkIndex(&stream);
+  ASSERT_FALSE(index.has_error()) << index.error().message();
+  ASSERT_EQ(index.value().chunks_size(), 1);
+  EXPECT_TRUE(index.value().chunks(0).compressed());
+}
@@ -0,0 +1,134 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "OrbitClientModel/CaptureStreamWriter.h"
+
+#include <utility>
+
+#include "OrbitBase/Logging.h"
+#include "absl/strings/str_format.h"
+#include "capture_data.pb.h"
+
+using orbit_client_protos::CaptureChunkIndex;
+using orbit_client_protos::CaptureInfo;
+using orbit_client_protos::FunctionInfo;
+using orbit_grpc_protos::CaptureEvent;
+using orbit_grpc_protos::CaptureResponse;
+
+namespace capture_serializer {
+
+ErrorMessageOr<std::unique_ptr<CaptureStreamWriter>> CaptureStreamWriter::Create(
+    const std::string& file_name, ChunkCompression compression) {
+  std::ofstream file(file_name, std::ios::binary);
+  if (file.fail()) {
+    ERROR("Streaming capture to \"%s\": %s", file_name, "file.fail()");
+    return ErrorMessage(absl::StrFormat("Error opening file \"%s\" for writing", file_name));
+  }
+  return std::unique_ptr<CaptureStreamWriter>(
+      new CaptureStreamWriter(file_name, std::move(file), compression));
+}
+
+CaptureStreamWriter::CaptureStreamWriter(std::string file_name, std::ofstream file,
+                                         ChunkCompression compression)
+    : file_name_{std::move(file_name)},
+      file_{std::move(file)},
+      chunk_writer_{&file_, compression} {}
+
+CaptureStreamWriter::~CaptureStreamWriter() {
+  if (writer_thread_.joinable()) {
+    OnCaptureFinished();
+  }
+}
+
+void CaptureStreamWriter::OnCaptureStarted(
+    int32_t process_id, const std::string& process_name,
+    const absl::flat_hash_map<uint64_t, FunctionInfo>& selected_functions) {
+  CHECK(!writer_thread_.joinable());
+  CaptureInfo capture_info;
+  for (const auto& [address, function] : selected_functions) {
+    *capture_info.add_selected_functions() = function;
+  }
+  capture_info.set_process_id(process_id);
+  capture_info.set_process_name(process_name);
+  chunk_writer_.WriteMessage(CaptureChunkIndex::kCaptureInfo, capture_info);
+  chunk_writer_.Flush();
+  CheckFile();
+
+  writer_thread_ = std::thread{[this] { WriterThread(); }};
+}
+
+void CaptureStreamWriter::RecordCaptureResponse(CaptureResponse&& response) {
+  absl::MutexLock lock{&mutex_};
+  mutex_.Await(absl::Condition(this, &CaptureStreamWriter::CanAcceptResponse));
+  responses_.push_back(std::move(response));
+}
+
+void CaptureStreamWriter::OnCaptureFinished() {
+  {
+    absl::MutexLock lock{&mutex_};
+    finishing_ = true;
+  }
+  writer_thread_.join();
+  LOG("Finished streaming capture to \"%s\"", file_name_);
+}
+
+bool CaptureStreamWriter::HasResponseOrIsFinishing() const {
+  return !responses_.empty() || finishing_;
+}
+
+bool CaptureStreamWriter::CanAcceptResponse() const {
+  return responses_.size() < kMaxPendingResponses;
+}
+
+void CaptureStreamWriter::CheckFile() {
+  if (!write_failed_ && file_.fail()) {
+    ERROR("Streaming capture to \"%s\": %s", file_name_, "file.fail()");
+    write_failed_ = true;
+  }
+}
+
+void CaptureStreamWriter::WriterThread() {
+  absl::Time last_flush_time = absl::Now();
+  while (true) {
+    CaptureResponse response;
+    bool finished = false;
+    {
+      absl::MutexLock lock{&mutex_};
+      mutex_.AwaitWithTimeout(
+          absl::Condition(this, &CaptureStreamWriter::HasResponseOrIsFinishing), kFlushInterval);
+      if (!responses_.empty()) {
+        response = std::move(responses_.front());
+        responses_.pop_front();
+      } else {
+        finished = finishing_;
+      }
+    }
+
+    // After a write error, keep taking the responses, so that the capture is
+    // not blocked.
+    if (write_failed_) {
+      if (finished) {
+        return;
+      }
+      continue;
+    }
+
+    for (const CaptureEvent& event : response.capture_events()) {
+      chunk_writer_.WriteMessage(CaptureChunkIndex::kCaptureEvent, event);
+    }
+    if (finished) {
+      chunk_writer_.Finish();
+      file_.flush();
+      CheckFile();
+      return;
+    }
+    if (absl::Now() - last_flush_time >= kFlushInterval) {
+      chunk_writer_.Flush();
+      CheckFile();
+      last_flush_time = absl::Now();
+    }
+  }
+}
+
+}  // namespace capture_serializer
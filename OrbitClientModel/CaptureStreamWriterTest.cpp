@@ -0,0 +1,187 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "FunctionUtils.h"
+#include "OrbitClientModel/CaptureDeserializer.h"
+#include "OrbitClientModel/CaptureStreamWriter.h"
+#include "capture_data.pb.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "services.pb.h"
+
+using orbit_client_protos::CallstackEvent;
+using orbit_client_protos::CaptureChunkIndex;
+using orbit_client_protos::FunctionInfo;
+using orbit_client_protos::LinuxAddressInfo;
+using orbit_client_protos::TimerInfo;
+using orbit_client_protos::TracepointEventInfo;
+using orbit_grpc_protos::CaptureEvent;
+using orbit_grpc_protos::CaptureResponse;
+using orbit_grpc_protos::TracepointInfo;
+
+using ::testing::_;
+using ::testing::ElementsAre;
+using ::testing::SaveArg;
+
+namespace {
+
+class MockCaptureListener : public CaptureListener {
+ public:
+  MOCK_METHOD(
+      void, OnCaptureStarted,
+      (int32_t /*process_id*/, std::string /*process_name*/, std::shared_ptr<Process> /*process*/,
+       (absl::flat_hash_map<uint64_t, orbit_client_protos::FunctionInfo>)/*selected_functions*/,
+       TracepointInfoSet /*selected_tracepoints*/),
+      (override));
+  MOCK_METHOD(void, OnCaptureComplete, (), (override));
+  MOCK_METHOD(void, OnCaptureCancelled, (), (override));
+  MOCK_METHOD(void, OnCaptureFailed, (ErrorMessage), (override));
+  MOCK_METHOD(void, OnTimer, (const TimerInfo&), (override));
+  MOCK_METHOD(void, OnKeyAndString, (uint64_t /*key*/, std::string), (override));
+  MOCK_METHOD(void, OnUniqueCallStack, (CallStack), (override));
+  MOCK_METHOD(void, OnCallstackEvent, (CallstackEvent), (override));
+  MOCK_METHOD(void, OnThreadName, (int32_t /*thread_id*/, std::string /*thread_name*/), (override));
+  MOCK_METHOD(void, OnAddressInfo, (LinuxAddressInfo), (override));
+  MOCK_METHOD(void, OnUniqueTracepointInfo, (uint64_t /*key*/, TracepointInfo /*tracepoint_info*/),
+              (override));
+  MOCK_METHOD(void, OnTracepointEvent, (TracepointEventInfo), (override));
+};
+
+std::string GetTestFileName(const std::string& test_name) {
+  return (std::filesystem::temp_directory_path() / (test_name + ".orbit")).string();
+}
+
+// Streams a capture with a selected function, a thread name and two scheduling
+// slices in two CaptureResponses.
+void StreamCapture(const std::string& file_name,
+                   capture_serializer::ChunkCompression compression =
+                       capture_serializer::ChunkCompression::kNone) {
+  auto capture_stream_writer =
+      capture_serializer::CaptureStreamWriter::Create(file_name, compression);
+  ASSERT_FALSE(capture_stream_writer.has_error());
+  capture_serializer::CaptureStreamWriter* writer = capture_stream_writer.value().get();
+
+  FunctionInfo function;
+  function.set_name("foo");
+  function.set_address(123);
+  absl::flat_hash_map<uint64_t, FunctionInfo> selected_functions;
+  selected_functions[FunctionUtils::GetAbsoluteAddress(function)] = function;
+  writer->OnCaptureStarted(42, "process", selected_functions);
+
+  CaptureResponse response;
+  CaptureEvent* event = response.add_capture_events();
+  event->mutable_thread_name()->set_tid(7);
+  event->mutable_thread_name()->set_name("thread");
+  event = response.add_capture_events();
+  event->mutable_scheduling_slice()->set_tid(7);
+  event->mutable_scheduling_slice()->set_in_timestamp_ns(10);
+  writer->RecordCaptureResponse(std::move(response));
+
+  response.Clear();
+  event = response.add_capture_events();
+  event->mutable_scheduling_slice()->set_tid(7);
+  event->mutable_scheduling_slice()->set_in_timestamp_ns(20);
+  writer->RecordCaptureResponse(std::move(response));
+
+  writer->OnCaptureFinished();
+}
+
+std::string ReadFile(const std::string& file_name) {
+  std::ifstream file{file_name, std::ios::binary};
+  std::stringstream content;
+  content << file.rdbuf();
+  return content.str();
+}
+
+}  // namespace
+
+TEST(CaptureStreamWriter, StreamedCaptureCanBeLoaded) {
+  std::string file_name = GetTestFileName("StreamedCaptureCanBeLoaded");
+  StreamCapture(file_name);
+
+  MockCaptureListener listener;
+  std::atomic<bool> cancellation_requested = false;
+  absl::flat_hash_map<uint64_t, FunctionInfo> selected_functions;
+  std::vector<uint64_t> timer_starts;
+  {
+    ::testing::InSequence in_sequence;
+    EXPECT_CALL(listener, OnCaptureStarted(42, "process", _, _, _))
+        .WillOnce(SaveArg<3>(&selected_functions));
+    EXPECT_CALL(listener, OnThreadName(7, "thread"));
+    EXPECT_CALL(listener, OnTimer)
+        .Times(2)
+        .WillRepeatedly([&timer_starts](const TimerInfo& timer_info) {
+          timer_starts.push_back(timer_info.start());
+        });
+    EXPECT_CALL(listener, OnCaptureComplete);
+  }
+  EXPECT_CALL(listener, OnCaptureFailed).Times(0);
+  capture_deserializer::Load(file_name, &listener, &cancellation_requested);
+
+  std::ifstream file{file_name, std::ios::binary};
+  ErrorMessageOr<CaptureChunkIndex> index = capture_deserializer::internal::ReadChunkIndex(&file);
+  file.close();
+  std::remove(file_name.c_str());
+
+  ASSERT_EQ(selected_functions.size(), 1);
+  EXPECT_EQ(selected_functions.begin()->second.name(), "foo");
+  EXPECT_THAT(timer_starts, ElementsAre(10, 20));
+  ASSERT_TRUE(index.has_value());
+  ASSERT_EQ(index.value().chunks_size(), 2);
+  EXPECT_EQ(index.value().chunks(0).type(), CaptureChunkIndex::kCaptureInfo);
+  EXPECT_EQ(index.value().chunks(1).type(), CaptureChunkIndex::kCaptureEvent);
+  EXPECT_EQ(index.value().chunks(1).message_count(), 3);
+}
+
+TEST(CaptureStreamWriter, UnfinishedStreamedCaptureCanBeLoaded) {
+  std::string file_name = GetTestFileName("UnfinishedStreamedCaptureCanBeLoaded");
+  StreamCapture(file_name);
+  std::string streamed_capture = ReadFile(file_name);
+  std::ifstream file{file_name, std::ios::binary};
+  ErrorMessageOr<CaptureChunkIndex> index = capture_deserializer::internal::ReadChunkIndex(&file);
+  file.close();
+  std::remove(file_name.c_str());
+  ASSERT_TRUE(index.has_value());
+  ASSERT_EQ(index.value().chunks_size(), 2);
+
+  // Like a capture whose client stopped before the last CaptureEvents were
+  // flushed.
+  std::stringstream unfinished_stream{streamed_capture.substr(0, index.value().chunks(1).offset())};
+  MockCaptureListener listener;
+  std::atomic<bool> cancellation_requested = false;
+  EXPECT_CALL(listener, OnCaptureStarted(42, "process", _, _, _)).Times(1);
+  EXPECT_CALL(listener, OnTimer).Times(0);
+  EXPECT_CALL(listener, OnCaptureComplete).Times(1);
+  EXPECT_CALL(listener, OnCaptureFailed).Times(0);
+  capture_deserializer::Load(unfinished_stream, "file_name", &listener, &cancellation_requested);
+}
+
+TEST(CaptureStreamWriter, CompressedStreamedCaptureCanBeLoaded) {
+  std::string file_name = GetTestFileName("CompressedStreamedCaptureCanBeLoaded");
+  StreamCapture(file_name, capture_serializer::ChunkCompression::kZlib);
+  std::ifstream file{file_name, std::ios::binary};
+  ErrorMessageOr<CaptureChunkIndex> index = capture_deserializer::internal::ReadChunkIndex(&file);
+  file.close();
+  ASSERT_TRUE(index.has_value());
+  ASSERT_EQ(index.value().chunks_size(), 2);
+  EXPECT_TRUE(index.value().chunks(0).compressed());
+  EXPECT_TRUE(index.value().chunks(1).compressed());
+
+  MockCaptureListener listener;
+  std::atomic<bool> cancellation_requested = false;
+  EXPECT_CALL(listener, OnCaptureStarted(42, "process", _, _, _)).Times(1);
+  EXPECT_CALL(listener, OnThreadName(7, "thread")).Times(1);
+  EXPECT_CALL(listener, OnTimer).Times(2);
+  EXPECT_CALL(listener, OnCaptureComplete).Times(1);
+  EXPECT_CALL(listener, OnCaptureFailed).Times(0);
+  capture_deserializer::Load(file_name, &listener, &cancellation_requested);
+  std::remove(file_name.c_str());
+}
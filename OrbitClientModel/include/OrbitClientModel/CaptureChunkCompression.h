@@ -0,0 +1,50 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef ORBIT_CLIENT_MODEL_CAPTURE_CHUNK_COMPRESSION_H_
+#define ORBIT_CLIENT_MODEL_CAPTURE_CHUNK_COMPRESSION_H_
+
+#include <cstdint>
+#include <string>
+
+#include "capture_data.pb.h"
+
+namespace capture_serializer {
+
+enum class ChunkCompression { kNone, kZlib };
+
+namespace internal {
+
+// Set in the type of a chunk whose payload is compressed (see CaptureChunkIndex
+// in capture_data.proto).
+inline constexpr uint32_t kCompressedChunkFlag = 1u << 31;
+
+// Returns the size of the payload as a little-endian uint32 followed by the
+// payload compressed with zlib.
+[[nodiscard]] std::string CompressChunkPayload(const std::string& payload);
+// Returns false if compressed_payload is malformed.
+[[nodiscard]] bool DecompressChunkPayload(const std::string& compressed_payload,
+                                          std::string* payload);
+
+// Replaces the timestamps and addresses of the messages of a compressed chunk
+// by their zigzag-encoded difference to the ones of the previous message of the
+// chunk, which compresses much better. Use one ChunkDeltaCoder per chunk, so
+// that each chunk can be decoded on its own.
+class ChunkDeltaCoder {
+ public:
+  void Encode(orbit_client_protos::TimerInfo* timer_info);
+  void Decode(orbit_client_protos::TimerInfo* timer_info);
+  void Encode(orbit_client_protos::CallstackEvent* callstack_event);
+  void Decode(orbit_client_protos::CallstackEvent* callstack_event);
+
+ private:
+  uint64_t previous_time_ns_ = 0;
+  uint64_t previous_address_ = 0;
+};
+
+}  // namespace internal
+
+}  // namespace capture_serializer
+
+#endif  // ORBIT_CLIENT_MODEL_CAPTURE_CHUNK_COMPRESSION_H_
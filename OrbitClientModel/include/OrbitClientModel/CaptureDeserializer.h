@@ -27,13 +27,33 @@ void Load(const std::string& file_name, CaptureListener* capture_listener,
 namespace internal {
 
 bool ReadMessage(google::protobuf::Message* message, google::protobuf::io::CodedInputStream* input);
+bool ReadHeader(std::istream* stream, orbit_client_protos::CaptureHeader* header);
 
+// Loads the single CaptureInfo of version 1.52 and the timers that follow it.
 void LoadCaptureInfo(const orbit_client_protos::CaptureInfo& capture_info,
                      CaptureListener* capture_listener,
                      google::protobuf::io::CodedInputStream* coded_input,
                      std::atomic<bool>* cancellation_requested);
 
-inline const std::string kRequiredCaptureVersion = "1.52";
+// Reads the next chunk (see CaptureChunkIndex in capture_data.proto). The
+// payload of a compressed chunk is returned as it is in the file.
+bool ReadChunk(std::istream* stream, orbit_client_protos::CaptureChunkIndex::ChunkType* type,
+               bool* compressed, std::string* payload);
+// Reads a message of the payload of a chunk.
+bool ReadChunkMessage(google::protobuf::Message* message,
+                      google::protobuf::io::CodedInputStream* input);
+// Seeks to the index at the end of a chunked capture and reads it.
+ErrorMessageOr<orbit_client_protos::CaptureChunkIndex> ReadChunkIndex(std::istream* stream);
+
+// Loads the chunks that follow the CaptureHeader of a chunked capture. The
+// chunks are parsed on thread_count threads and passed to the listener in
+// order, on the calling thread.
+void LoadChunks(std::istream* stream, const std::string& error_message,
+                CaptureListener* capture_listener, std::atomic<bool>* cancellation_requested,
+                size_t thread_count);
+
+inline const std::string kCaptureInfoVersion = "1.52";
+inline const std::string kChunkedCaptureVersion = "1.53";
 
 }  // namespace internal
 
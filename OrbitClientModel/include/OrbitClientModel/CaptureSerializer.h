@@ -11,6 +11,7 @@
 
 #include "CaptureData.h"
 #include "OrbitBase/Result.h"
+#include "OrbitClientModel/CaptureChunkCompression.h"
 #include "capture_data.pb.h"
 #include "google/protobuf/io/coded_stream.h"
 #include "google/protobuf/io/zero_copy_stream_impl.h"
@@ -21,7 +22,8 @@ namespace capture_serializer {
 template <class TimersIterator>
 ErrorMessageOr<void> Save(const std::string& filename, const CaptureData& capture_data,
                           const absl::flat_hash_map<uint64_t, std::string>& key_to_string_map,
-                          TimersIterator timers_iterator_begin, TimersIterator timers_iterator_end);
+                          TimersIterator timers_iterator_begin, TimersIterator timers_iterator_end,
+                          ChunkCompression compression = ChunkCompression::kNone);
 
 void WriteMessage(const google::protobuf::Message* message,
                   google::protobuf::io::CodedOutputStream* output);
@@ -32,31 +34,70 @@ void IncludeOrbitExtensionInFile(std::string& file_name);
 
 namespace internal {
 
-inline const std::string kRequiredCaptureVersion = "1.52";
-
-orbit_client_protos::CaptureInfo GenerateCaptureInfo(
-    const CaptureData& capture_data,
-    const absl::flat_hash_map<uint64_t, std::string>& key_to_string_map);
+inline const std::string kRequiredCaptureVersion = "1.53";
+
+// Writes a capture file made of chunks (see CaptureChunkIndex in
+// capture_data.proto). Only the current chunk is held in memory. With
+// compression, all chunks but the index are delta-encoded and compressed.
+class ChunkWriter {
+ public:
+  // Writes the CaptureHeader.
+  explicit ChunkWriter(std::ostream* stream,
+                       ChunkCompression compression = ChunkCompression::kNone);
+
+  // Appends the message to the current chunk if it has the same type, or
+  // starts a new chunk. Chunks are written once they reach kMaxChunkSize.
+  void WriteMessage(orbit_client_protos::CaptureChunkIndex::ChunkType type,
+                    const google::protobuf::Message& message);
+  // Writes the current chunk and flushes the stream, so that what has been
+  // written so far can be loaded even if Finish is never called.
+  void Flush();
+  // Writes the current chunk, the index and the offset of the index.
+  void Finish();
+
+  static constexpr size_t kMaxChunkSize = 4 * 1024 * 1024;
+
+ private:
+  [[nodiscard]] const google::protobuf::Message& DeltaEncode(
+      orbit_client_protos::CaptureChunkIndex::ChunkType type,
+      const google::protobuf::Message& message);
+  void WriteCurrentChunk();
+  void WriteChunk(orbit_client_protos::CaptureChunkIndex::ChunkType type,
+                  const std::string& payload, uint32_t message_count);
+
+  std::ostream* stream_;
+  ChunkCompression compression_;
+  ChunkDeltaCoder delta_coder_;
+  orbit_client_protos::TimerInfo encoded_timer_info_;
+  orbit_client_protos::CallstackEvent encoded_callstack_event_;
+  uint64_t offset_ = 0;
+  orbit_client_protos::CaptureChunkIndex::ChunkType chunk_type_ =
+      orbit_client_protos::CaptureChunkIndex::kUnknown;
+  std::string chunk_payload_;
+  uint32_t chunk_message_count_ = 0;
+  orbit_client_protos::CaptureChunkIndex index_;
+};
+
+// Returns a CaptureInfo without the fields that have their own ChunkType.
+orbit_client_protos::CaptureInfo GenerateCaptureInfo(const CaptureData& capture_data);
+
+void WriteCaptureData(const CaptureData& capture_data,
+                      const absl::flat_hash_map<uint64_t, std::string>& key_to_string_map,
+                      ChunkWriter* writer);
 
 template <class TimersIterator>
 void Save(std::ostream& stream, const CaptureData& capture_data,
           const absl::flat_hash_map<uint64_t, std::string>& key_to_string_map,
-          TimersIterator timers_iterator_begin, TimersIterator timers_iterator_end) {
-  google::protobuf::io::OstreamOutputStream out_stream(&stream);
-  google::protobuf::io::CodedOutputStream coded_output(&out_stream);
-
-  orbit_client_protos::CaptureHeader header;
-  header.set_version(kRequiredCaptureVersion);
-  WriteMessage(&header, &coded_output);
-
-  orbit_client_protos::CaptureInfo capture_info =
-      GenerateCaptureInfo(capture_data, key_to_string_map);
-  WriteMessage(&capture_info, &coded_output);
+          TimersIterator timers_iterator_begin, TimersIterator timers_iterator_end,
+          ChunkCompression compression = ChunkCompression::kNone) {
+  ChunkWriter writer{&stream, compression};
+  WriteCaptureData(capture_data, key_to_string_map, &writer);
 
   // Timers
   for (auto it = timers_iterator_begin; it != timers_iterator_end; ++it) {
-    WriteMessage(&(*it), &coded_output);
+    writer.WriteMessage(orbit_client_protos::CaptureChunkIndex::kTimer, *it);
   }
+  writer.Finish();
 }
 
 }  // namespace internal
@@ -64,8 +105,8 @@ void Save(std::ostream& stream, const CaptureData& capture_data,
 template <class TimersIterator>
 ErrorMessageOr<void> Save(const std::string& filename, const CaptureData& capture_data,
                           const absl::flat_hash_map<uint64_t, std::string>& key_to_string_map,
-                          TimersIterator timers_iterator_begin,
-                          TimersIterator timers_iterator_end) {
+                          TimersIterator timers_iterator_begin, TimersIterator timers_iterator_end,
+                          ChunkCompression compression) {
   std::ofstream file(filename, std::ios::binary);
   if (file.fail()) {
     ERROR("Saving capture in \"%s\": %s", filename, "file.fail()");
@@ -75,7 +116,11 @@ ErrorMessageOr<void> Save(const std::string& filename, const CaptureData& captur
   {
     SCOPE_TIMER_LOG(absl::StrFormat("Saving capture in \"%s\"", filename));
     internal::Save(file, capture_data, key_to_string_map, std::move(timers_iterator_begin),
-                   std::move(timers_iterator_end));
+                   std::move(timers_iterator_end), compression);
+  }
+  if (file.fail()) {
+    ERROR("Saving capture in \"%s\": %s", filename, "file.fail()");
+    return ErrorMessage("Error writing the capture to the file");
   }
 
   return outcome::success();
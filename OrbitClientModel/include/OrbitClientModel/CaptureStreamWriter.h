@@ -0,0 +1,69 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef ORBIT_CLIENT_MODEL_CAPTURE_STREAM_WRITER_H_
+#define ORBIT_CLIENT_MODEL_CAPTURE_STREAM_WRITER_H_
+
+#include <deque>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <thread>
+
+#include "OrbitBase/Result.h"
+#include "OrbitCaptureClient/CaptureEventRecorder.h"
+#include "OrbitClientModel/CaptureSerializer.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/time/time.h"
+#include "services.pb.h"
+
+namespace capture_serializer {
+
+// Writes the CaptureEvents of a running capture to a chunked capture file, on
+// a background thread. RecordCaptureResponse blocks while kMaxPendingResponses
+// responses are waiting to be written. The file is flushed at least every
+// kFlushInterval, so that what has been written can be loaded even if the
+// client stops before the capture is finished.
+class CaptureStreamWriter : public CaptureEventRecorder {
+ public:
+  [[nodiscard]] static ErrorMessageOr<std::unique_ptr<CaptureStreamWriter>> Create(
+      const std::string& file_name, ChunkCompression compression = ChunkCompression::kNone);
+
+  CaptureStreamWriter(const CaptureStreamWriter&) = delete;
+  CaptureStreamWriter& operator=(const CaptureStreamWriter&) = delete;
+  ~CaptureStreamWriter() override;
+
+  void OnCaptureStarted(int32_t process_id, const std::string& process_name,
+                        const absl::flat_hash_map<uint64_t, orbit_client_protos::FunctionInfo>&
+                            selected_functions) override;
+  void RecordCaptureResponse(orbit_grpc_protos::CaptureResponse&& response) override;
+  // Writes the remaining events and the index of the chunks.
+  void OnCaptureFinished() override;
+
+  static constexpr size_t kMaxPendingResponses = 64;
+  static constexpr absl::Duration kFlushInterval = absl::Seconds(1);
+
+ private:
+  CaptureStreamWriter(std::string file_name, std::ofstream file, ChunkCompression compression);
+
+  void WriterThread();
+  [[nodiscard]] bool HasResponseOrIsFinishing() const ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+  [[nodiscard]] bool CanAcceptResponse() const ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+  void CheckFile();
+
+  std::string file_name_;
+  std::ofstream file_;
+  // Only used by the writer thread once it has started.
+  internal::ChunkWriter chunk_writer_;
+  bool write_failed_ = false;
+  std::thread writer_thread_;
+
+  mutable absl::Mutex mutex_;
+  std::deque<orbit_grpc_protos::CaptureResponse> responses_ ABSL_GUARDED_BY(mutex_);
+  bool finishing_ ABSL_GUARDED_BY(mutex_) = false;
+};
+
+}  // namespace capture_serializer
+
+#endif  // ORBIT_CLIENT_MODEL_CAPTURE_STREAM_WRITER_H_
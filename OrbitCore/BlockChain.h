@@ -168,6 +168,27 @@ class BlockChain final {
 
   [[nodiscard]] const Block<T, BlockSize>* root() const { return root_; }
 
+  // Calls action on the elements from index begin to index end, excluded. All
+  // blocks before the last one are full, so the block of begin is found
+  // without visiting the elements before it.
+  template <typename Action>
+  void ForEachInRange(uint32_t begin, uint32_t end, Action&& action) const {
+    CHECK(begin <= end && end <= size_);
+    if (begin == end) return;
+    const Block<T, BlockSize>* block = root_;
+    for (uint32_t i = begin / BlockSize; i > 0; --i) {
+      block = block->next();
+    }
+    uint32_t index = begin % BlockSize;
+    for (uint32_t i = begin; i < end; ++i) {
+      if (index == BlockSize) {
+        block = block->next();
+        index = 0;
+      }
+      action(block->Get(index++));
+    }
+  }
+
   void Reset() {
     Block<T, BlockSize>* block = root_;
     while (block) {
@@ -6,6 +6,8 @@
 #include <gtest/gtest.h>
 
 #include <string>
+#include <utility>
+#include <vector>
 
 namespace {
 
@@ -202,3 +204,21 @@ TEST(BlockChain, MovableType) {
   EXPECT_EQ(chain.root()->data()[0].value(), "v1");
   EXPECT_EQ(chain.root()->data()[1].value(), "v2");
 }
+
+TEST(BlockChain, ForEachInRange) {
+  BlockChain<int, 1024> chain;
+  for (int i = 0; i < 1024 * 3 + 10; ++i) {
+    chain.push_back(i);
+  }
+
+  for (auto [begin, end] : {std::pair{0, 0}, std::pair{0, 1024}, std::pair{5, 6},
+                            std::pair{1000, 2100}, std::pair{1024, 2048},
+                            std::pair{2047, 1024 * 3 + 10}}) {
+    std::vector<int> visited;
+    chain.ForEachInRange(begin, end, [&visited](int value) { visited.push_back(value); });
+    ASSERT_EQ(visited.size(), static_cast<size_t>(end - begin));
+    for (size_t i = 0; i < visited.size(); ++i) {
+      EXPECT_EQ(visited[i], begin + static_cast<int>(i));
+    }
+  }
+}
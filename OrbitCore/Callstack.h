@@ -18,6 +18,9 @@ class CallStack {
     frames_ = std::move(addresses);
     hash_ = XXH64(frames_.data(), frames_.size() * sizeof(uint64_t), 0xca1157ac);
   };
+  // For frames whose hash is already known, to avoid hashing them again.
+  explicit CallStack(CallstackID hash, std::vector<uint64_t>&& addresses)
+      : hash_{hash}, frames_{std::move(addresses)} {}
 
   CallstackID GetHash() const { return hash_; }
   uint64_t GetFrame(size_t index) const { return frames_.at(index); }
@@ -4,17 +4,36 @@
 
 #include "CallstackData.h"
 
+#include <limits>
+
 #include "Callstack.h"
 
 using orbit_client_protos::CallstackEvent;
 
+namespace {
+
+void ForEachCallstackEventOfTimelineInTimeRange(
+    int32_t tid, const CallstackEventTimeline& timeline, uint64_t time_begin, uint64_t time_end,
+    const std::function<void(const CallstackEvent&)>& action) {
+  CallstackEvent callstack_event;
+  callstack_event.set_thread_id(tid);
+  timeline.ForEachEventInTimeRange(
+      time_begin, time_end,
+      [&callstack_event, &action](const CallstackEventTimeline::Event& event) {
+        callstack_event.set_time(event.time);
+        callstack_event.set_callstack_hash(event.callstack_id);
+        action(callstack_event);
+      });
+}
+
+}  // namespace
+
 void CallstackData::AddCallstackEvent(CallstackEvent callstack_event) {
   std::lock_guard lock(mutex_);
   CallstackID hash = callstack_event.callstack_hash();
-  CHECK(unique_callstacks_.contains(hash));
+  CHECK(unique_callstacks_->HasCallstack(hash));
   RegisterTime(callstack_event.time());
-  callstack_events_by_tid_[callstack_event.thread_id()][callstack_event.time()] =
-      std::move(callstack_event);
+  callstack_events_by_tid_[callstack_event.thread_id()].Add(callstack_event.time(), hash);
 }
 
 void CallstackData::RegisterTime(uint64_t time) {
@@ -24,8 +43,8 @@ void CallstackData::RegisterTime(uint64_t time) {
 
 void CallstackData::AddUniqueCallStack(CallStack call_stack) {
   std::lock_guard lock(mutex_);
-  CallstackID hash = call_stack.GetHash();
-  unique_callstacks_[hash] = std::make_shared<CallStack>(std::move(call_stack));
+  if (unique_callstacks_->HasCallstack(call_stack.GetHash())) return;
+  GetMutableUniqueCallstacks()->AddCallstack(call_stack);
 }
 
 uint32_t CallstackData::GetCallstackEventsCount() const {
@@ -41,17 +60,9 @@ std::vector<orbit_client_protos::CallstackEvent> CallstackData::GetCallstackEven
     uint64_t time_begin, uint64_t time_end) const {
   std::lock_guard lock(mutex_);
   std::vector<CallstackEvent> callstack_events;
-  for (const auto& tid_and_events : callstack_events_by_tid_) {
-    const std::map<uint64_t, CallstackEvent>& events = tid_and_events.second;
-    for (auto event_it = events.lower_bound(time_begin); event_it != events.end(); ++event_it) {
-      uint64_t time = event_it->first;
-      if (time < time_end) {
-        callstack_events.push_back(event_it->second);
-      } else {
-        break;
-      }
-    }
-  }
+  ForEachCallstackEventInTimeRange(
+      time_begin, time_end,
+      [&callstack_events](const CallstackEvent& event) { callstack_events.push_back(event); });
   return callstack_events;
 }
 
@@ -75,103 +86,95 @@ uint32_t CallstackData::GetCallstackEventsOfTidCount(int32_t thread_id) const {
 
 std::vector<CallstackEvent> CallstackData::GetCallstackEventsOfTidInTimeRange(
     int32_t tid, uint64_t time_begin, uint64_t time_end) const {
-  std::lock_guard lock(mutex_);
   std::vector<CallstackEvent> callstack_events;
+  ForEachCallstackEventOfTidInTimeRange(
+      tid, time_begin, time_end,
+      [&callstack_events](const CallstackEvent& event) { callstack_events.push_back(event); });
+  return callstack_events;
+}
 
-  auto tid_and_events_it = callstack_events_by_tid_.find(tid);
-  if (tid_and_events_it == callstack_events_by_tid_.end()) {
-    return callstack_events;
-  }
-
-  const std::map<uint64_t, CallstackEvent>& events = tid_and_events_it->second;
-  for (auto event_it = events.lower_bound(time_begin); event_it != events.end(); ++event_it) {
-    uint64_t time = event_it->first;
-    if (time < time_end) {
-      callstack_events.push_back(event_it->second);
-    } else {
-      break;
-    }
+const absl::flat_hash_map<int32_t, CallstackEventTimeline>& CallstackData::callstack_events_by_tid()
+    const {
+  std::lock_guard lock(mutex_);
+  for (const auto& tid_and_events : callstack_events_by_tid_) {
+    // Merges the events added out of order.
+    tid_and_events.second.GetEvents();
   }
-  return callstack_events;
+  return callstack_events_by_tid_;
 }
 
 void CallstackData::ForEachCallstackEvent(
     const std::function<void(const orbit_client_protos::CallstackEvent&)>& action) const {
+  ForEachCallstackEventInTimeRange(0, std::numeric_limits<uint64_t>::max(), action);
+}
+
+void CallstackData::ForEachCallstackEventInTimeRange(
+    uint64_t time_begin, uint64_t time_end,
+    const std::function<void(const orbit_client_protos::CallstackEvent&)>& action) const {
   std::lock_guard lock(mutex_);
-  for (const auto& tid_and_events : callstack_events_by_tid_) {
-    for (const auto& time_and_event : tid_and_events.second) {
-      action(time_and_event.second);
-    }
+  for (const auto& [tid, timeline] : callstack_events_by_tid_) {
+    ForEachCallstackEventOfTimelineInTimeRange(tid, timeline, time_begin, time_end, action);
   }
 }
 
-void CallstackData::ForEachCallstackEventOfTid(
-    int32_t tid,
+void CallstackData::ForEachCallstackEventOfTidInTimeRange(
+    int32_t tid, uint64_t time_begin, uint64_t time_end,
     const std::function<void(const orbit_client_protos::CallstackEvent&)>& action) const {
   std::lock_guard lock(mutex_);
   const auto& tid_and_events_it = callstack_events_by_tid_.find(tid);
   if (tid_and_events_it == callstack_events_by_tid_.end()) {
     return;
   }
-  for (const auto& time_and_event : tid_and_events_it->second) {
-    action(time_and_event.second);
-  }
+  ForEachCallstackEventOfTimelineInTimeRange(tid, tid_and_events_it->second, time_begin, time_end,
+                                             action);
 }
 
 void CallstackData::AddCallStackFromKnownCallstackData(const CallstackEvent& event,
                                                        const CallstackData* known_callstack_data) {
   std::lock_guard lock(mutex_);
   uint64_t hash = event.callstack_hash();
-  std::shared_ptr<CallStack> unique_callstack = known_callstack_data->GetCallstackPtr(hash);
-  if (unique_callstack == nullptr) {
-    return;
+  if (!unique_callstacks_->HasCallstack(hash)) {
+    std::optional<CallStack> unique_callstack = known_callstack_data->GetCallStack(hash);
+    if (!unique_callstack.has_value()) {
+      return;
+    }
+    GetMutableUniqueCallstacks()->AddCallstack(unique_callstack.value());
   }
-
-  // The insertion only happens if the hash isn't already present.
-  unique_callstacks_.emplace(hash, std::move(unique_callstack));
-  callstack_events_by_tid_[event.thread_id()][event.time()] = CallstackEvent(event);
+  callstack_events_by_tid_[event.thread_id()].Add(event.time(), hash);
 }
 
-const CallStack* CallstackData::GetCallStack(CallstackID callstack_id) const {
+std::optional<CallStack> CallstackData::GetCallStack(CallstackID callstack_id) const {
   std::lock_guard lock(mutex_);
-  auto it = unique_callstacks_.find(callstack_id);
-  if (it != unique_callstacks_.end()) {
-    return it->second.get();
-  }
-  return nullptr;
+  return unique_callstacks_->GetCallstack(callstack_id);
 }
 
 bool CallstackData::HasCallStack(CallstackID callstack_id) const {
   std::lock_guard lock(mutex_);
-  return unique_callstacks_.contains(callstack_id);
+  return unique_callstacks_->HasCallstack(callstack_id);
 }
 
 void CallstackData::ForEachUniqueCallstack(
     const std::function<void(const CallStack&)>& action) const {
   std::lock_guard lock(mutex_);
-  for (const auto& it : unique_callstacks_) {
-    action(*it.second);
-  }
+  unique_callstacks_->ForEachCallstack(action);
 }
 
 void CallstackData::ForEachFrameInCallstack(uint64_t callstack_id,
                                             const std::function<void(uint64_t)>& action) const {
   std::lock_guard lock(mutex_);
-  for (uint64_t frame : unique_callstacks_.at(callstack_id)->GetFrames()) {
-    action(frame);
-  }
+  unique_callstacks_->ForEachFrame(callstack_id, action);
 }
 
-absl::flat_hash_map<CallstackID, std::shared_ptr<CallStack>>
-CallstackData::GetUniqueCallstacksCopy() const {
+std::shared_ptr<const CallstackTrie> CallstackData::GetUniqueCallstacks() const {
   std::lock_guard lock(mutex_);
   return unique_callstacks_;
 }
 
-std::shared_ptr<CallStack> CallstackData::GetCallstackPtr(CallstackID callstack_id) const {
-  auto it = unique_callstacks_.find(callstack_id);
-  if (it != unique_callstacks_.end()) {
-    return unique_callstacks_.at(callstack_id);
+CallstackTrie* CallstackData::GetMutableUniqueCallstacks() {
+  // Copies are only handed out while holding the mutex, so the use count can
+  // only decrease concurrently.
+  if (unique_callstacks_.use_count() > 1) {
+    unique_callstacks_ = std::make_shared<CallstackTrie>(*unique_callstacks_);
   }
-  return nullptr;
+  return unique_callstacks_.get();
 }
@@ -7,16 +7,19 @@
 
 #include <memory>
 #include <mutex>
+#include <optional>
 
 #include "BlockChain.h"
 #include "Callstack.h"
+#include "CallstackEventTimeline.h"
+#include "CallstackTrie.h"
 #include "CallstackTypes.h"
 #include "absl/container/flat_hash_map.h"
 #include "capture_data.pb.h"
 
 class CallstackData {
  public:
-  explicit CallstackData() = default;
+  explicit CallstackData() : unique_callstacks_{std::make_shared<CallstackTrie>()} {}
 
   CallstackData(const CallstackData& other) = delete;
   CallstackData& operator=(const CallstackData& other) = delete;
@@ -26,17 +29,16 @@ class CallstackData {
   ~CallstackData() = default;
 
   // Assume that callstack_event.callstack_hash is filled correctly and the
-  // CallStack with corresponding hash is already in unique_callstacks_
+  // CallStack with corresponding hash was already added.
   void AddCallstackEvent(orbit_client_protos::CallstackEvent callstack_event);
   void AddUniqueCallStack(CallStack call_stack);
   void AddCallStackFromKnownCallstackData(const orbit_client_protos::CallstackEvent& event,
                                           const CallstackData* known_callstack_data);
 
-  [[nodiscard]] const absl::flat_hash_map<int32_t,
-                                          std::map<uint64_t, orbit_client_protos::CallstackEvent>>&
-  callstack_events_by_tid() const {
-    return callstack_events_by_tid_;
-  }
+  // The timelines are sorted when they are returned and can be read
+  // concurrently, but not while events are added.
+  [[nodiscard]] const absl::flat_hash_map<int32_t, CallstackEventTimeline>&
+  callstack_events_by_tid() const;
 
   [[nodiscard]] uint32_t GetCallstackEventsCount() const;
 
@@ -50,11 +52,17 @@ class CallstackData {
   [[nodiscard]] std::vector<orbit_client_protos::CallstackEvent> GetCallstackEventsOfTidInTimeRange(
       int32_t tid, uint64_t time_begin, uint64_t time_end) const;
 
+  // The CallstackEvent passed to action is only valid during the call. The
+  // events of each thread are in time order.
   void ForEachCallstackEvent(
       const std::function<void(const orbit_client_protos::CallstackEvent&)>& action) const;
 
-  void ForEachCallstackEventOfTid(
-      int32_t tid,
+  void ForEachCallstackEventInTimeRange(
+      uint64_t time_begin, uint64_t time_end,
+      const std::function<void(const orbit_client_protos::CallstackEvent&)>& action) const;
+
+  void ForEachCallstackEventOfTidInTimeRange(
+      int32_t tid, uint64_t time_begin, uint64_t time_end,
       const std::function<void(const orbit_client_protos::CallstackEvent&)>& action) const;
 
   [[nodiscard]] uint64_t max_time() const {
@@ -67,7 +75,7 @@ class CallstackData {
     return min_time_;
   }
 
-  [[nodiscard]] const CallStack* GetCallStack(CallstackID callstack_id) const;
+  [[nodiscard]] std::optional<CallStack> GetCallStack(CallstackID callstack_id) const;
 
   [[nodiscard]] bool HasCallStack(CallstackID callstack_id) const;
 
@@ -76,20 +84,22 @@ class CallstackData {
   void ForEachFrameInCallstack(uint64_t callstack_id,
                                const std::function<void(uint64_t)>& action) const;
 
-  [[nodiscard]] absl::flat_hash_map<CallstackID, std::shared_ptr<CallStack>>
-  GetUniqueCallstacksCopy() const;
+  // Returns the unique callstacks added so far. The returned trie is not
+  // modified anymore, so it can be read without holding the mutex while
+  // callstacks are added: it is copied on the next addition if it is still in
+  // use.
+  [[nodiscard]] std::shared_ptr<const CallstackTrie> GetUniqueCallstacks() const;
 
  private:
-  [[nodiscard]] std::shared_ptr<CallStack> GetCallstackPtr(CallstackID callstack_id) const;
+  [[nodiscard]] CallstackTrie* GetMutableUniqueCallstacks();
 
   void RegisterTime(uint64_t time);
 
   // Use a reentrant mutex so that calls to the ForEach... methods can be nested.
   // E.g., one might want to nest ForEachCallstackEvent and ForEachFrameInCallstack.
   mutable std::recursive_mutex mutex_;
-  absl::flat_hash_map<CallstackID, std::shared_ptr<CallStack>> unique_callstacks_;
-  absl::flat_hash_map<int32_t, std::map<uint64_t, orbit_client_protos::CallstackEvent>>
-      callstack_events_by_tid_;
+  std::shared_ptr<CallstackTrie> unique_callstacks_;
+  absl::flat_hash_map<int32_t, CallstackEventTimeline> callstack_events_by_tid_;
 
   uint64_t max_time_ = 0;
   uint64_t min_time_ = std::numeric_limits<uint64_t>::max();
@@ -0,0 +1,74 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "CallstackEventTimeline.h"
+
+#include <algorithm>
+
+namespace {
+
+bool IsEarlier(const CallstackEventTimeline::Event& lhs, const CallstackEventTimeline::Event& rhs) {
+  return lhs.time < rhs.time;
+}
+
+bool IsEarlierThanTime(const CallstackEventTimeline::Event& event, uint64_t time) {
+  return event.time < time;
+}
+
+}  // namespace
+
+void CallstackEventTimeline::Add(uint64_t time, CallstackID callstack_id) {
+  if (events_.empty() || time > events_.back().time) {
+    events_.push_back(Event{time, callstack_id});
+    return;
+  }
+  if (time == events_.back().time) {
+    events_.back().callstack_id = callstack_id;
+    return;
+  }
+
+  pending_events_.push_back(Event{time, callstack_id});
+  if (pending_events_.size() >= kMaxPendingEventCount) {
+    MergePendingEvents();
+  }
+}
+
+const std::vector<CallstackEventTimeline::Event>& CallstackEventTimeline::GetEvents() const {
+  MergePendingEvents();
+  return events_;
+}
+
+void CallstackEventTimeline::ForEachEventInTimeRange(
+    uint64_t time_begin, uint64_t time_end, const std::function<void(const Event&)>& action) const {
+  const std::vector<Event>& events = GetEvents();
+  auto event_it = std::lower_bound(events.begin(), events.end(), time_begin, IsEarlierThanTime);
+  for (; event_it != events.end() && event_it->time < time_end; ++event_it) {
+    action(*event_it);
+  }
+}
+
+void CallstackEventTimeline::MergePendingEvents() const {
+  if (pending_events_.empty()) return;
+
+  // Out-of-order events are usually only a little late, so only the end of
+  // events_ is merged with them.
+  std::stable_sort(pending_events_.begin(), pending_events_.end(), IsEarlier);
+  size_t merge_begin = std::lower_bound(events_.begin(), events_.end(),
+                                        pending_events_.front().time, IsEarlierThanTime) -
+                       events_.begin();
+  size_t pending_begin = events_.size();
+  events_.insert(events_.end(), pending_events_.begin(), pending_events_.end());
+  pending_events_.clear();
+  std::inplace_merge(events_.begin() + merge_begin, events_.begin() + pending_begin, events_.end(),
+                     IsEarlier);
+
+  // The merge is stable, so of the events with the same time, the last one is
+  // the one that was added last.
+  auto write_it = events_.begin() + merge_begin;
+  for (auto read_it = write_it; read_it != events_.end(); ++read_it) {
+    if (read_it + 1 != events_.end() && (read_it + 1)->time == read_it->time) continue;
+    *write_it++ = *read_it;
+  }
+  events_.erase(write_it, events_.end());
+}
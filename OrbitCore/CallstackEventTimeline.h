@@ -0,0 +1,55 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef ORBIT_CORE_CALLSTACK_EVENT_TIMELINE_H_
+#define ORBIT_CORE_CALLSTACK_EVENT_TIMELINE_H_
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#include "CallstackTypes.h"
+
+// The callstack events of a thread, sorted by time, in 16 bytes per event.
+// Events mostly come in time order and are appended. The ones that come out
+// of order are kept aside, and merged into the sorted events once there are
+// many of them or before the events are read.
+//
+// Not thread-safe, not even the const methods, which can merge the events.
+class CallstackEventTimeline {
+ public:
+  struct Event {
+    uint64_t time;
+    CallstackID callstack_id;
+  };
+
+  // An event replaces the event with the same time, if any.
+  void Add(uint64_t time, CallstackID callstack_id);
+
+  [[nodiscard]] size_t size() const { return GetEvents().size(); }
+
+  // Sorted by time.
+  [[nodiscard]] const std::vector<Event>& GetEvents() const;
+
+  // Calls action for each event with time_begin <= time < time_end, in time
+  // order.
+  void ForEachEventInTimeRange(uint64_t time_begin, uint64_t time_end,
+                               const std::function<void(const Event&)>& action) const;
+
+  // The heap memory used by the events, in bytes.
+  [[nodiscard]] size_t GetMemoryUsage() const {
+    return (events_.capacity() + pending_events_.capacity()) * sizeof(Event);
+  }
+
+ private:
+  static constexpr size_t kMaxPendingEventCount = 1024;
+
+  void MergePendingEvents() const;
+
+  mutable std::vector<Event> events_;
+  // Events older than the last of events_, in the order they were added.
+  mutable std::vector<Event> pending_events_;
+};
+
+#endif  // ORBIT_CORE_CALLSTACK_EVENT_TIMELINE_H_
@@ -0,0 +1,116 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// Compares the memory used by the callstack events of a synthetic capture of
+// one thread, sampled every millisecond with some jitter and a few events
+// arriving out of order, when stored in a std::map of CallstackEvent protos
+// and when stored in a CallstackEventTimeline. Also reports the time to add
+// them and to run range queries like the ones of the timeline.
+
+#include <OrbitBase/Logging.h>
+
+#include <chrono>
+#include <cstdio>
+#include <map>
+#include <utility>
+#include <vector>
+
+#include "CallstackEventTimeline.h"
+#include "absl/flags/flag.h"
+#include "absl/flags/parse.h"
+#include "capture_data.pb.h"
+
+ABSL_FLAG(uint32_t, events, 2'000'000, "Number of callstack events");
+ABSL_FLAG(uint32_t, queries, 100'000, "Number of range queries");
+ABSL_FLAG(uint32_t, query_events, 1'000, "Average number of events in a range query");
+
+using orbit_client_protos::CallstackEvent;
+
+namespace {
+
+constexpr uint64_t kSamplingPeriodNs = 1'000'000;
+constexpr uint64_t kCallstackCount = 20'000;
+// A node of a red-black tree: color, parent, left and right children.
+constexpr size_t kMapNodeOverhead = 4 * sizeof(void*);
+
+uint64_t Random(uint64_t index) {
+  uint64_t random = index * 0x9e3779b97f4a7c15;
+  return random ^ (random >> 29);
+}
+
+// One event in 100 is swapped with the one before, as when the samples of
+// several cores are merged.
+std::vector<CallstackEvent> CreateEvents(uint32_t event_count) {
+  std::vector<CallstackEvent> events(event_count);
+  for (uint32_t i = 0; i < event_count; ++i) {
+    events[i].set_time(i * kSamplingPeriodNs + Random(i) % (kSamplingPeriodNs / 2));
+    events[i].set_callstack_hash(Random(Random(i)) % kCallstackCount);
+    events[i].set_thread_id(42);
+    if (i > 0 && Random(i) % 100 == 0) std::swap(events[i - 1], events[i]);
+  }
+  return events;
+}
+
+double SecondsSince(std::chrono::steady_clock::time_point begin) {
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  absl::ParseCommandLine(argc, argv);
+  uint32_t event_count = absl::GetFlag(FLAGS_events);
+  uint32_t query_count = absl::GetFlag(FLAGS_queries);
+  uint64_t query_duration = absl::GetFlag(FLAGS_query_events) * kSamplingPeriodNs;
+  FAIL_IF(event_count == 0, "Invalid flags");
+
+  std::vector<CallstackEvent> events = CreateEvents(event_count);
+  std::vector<uint64_t> query_begins(query_count);
+  for (uint32_t i = 0; i < query_count; ++i) {
+    query_begins[i] = Random(i + event_count) % (event_count * kSamplingPeriodNs);
+  }
+  printf("%u events, %u range queries of %.1f ms\n", event_count, query_count,
+         query_duration / 1e6);
+
+  auto begin = std::chrono::steady_clock::now();
+  std::map<uint64_t, CallstackEvent> event_map;
+  for (const CallstackEvent& event : events) event_map[event.time()] = event;
+  double add_s = SecondsSince(begin);
+  begin = std::chrono::steady_clock::now();
+  uint64_t callstack_id_sum = 0;
+  for (uint64_t query_begin : query_begins) {
+    for (auto event_it = event_map.lower_bound(query_begin);
+         event_it != event_map.end() && event_it->first < query_begin + query_duration;
+         ++event_it) {
+      callstack_id_sum += event_it->second.callstack_hash();
+    }
+  }
+  double query_s = SecondsSince(begin);
+  size_t map_memory = event_map.size() * (sizeof(decltype(event_map)::value_type) +
+                                          kMapNodeOverhead);
+  printf("std::map<uint64_t, CallstackEvent>: %.1f bytes per event, add %.3f s, query %.3f s\n",
+         static_cast<double>(map_memory) / event_map.size(), add_s, query_s);
+
+  begin = std::chrono::steady_clock::now();
+  CallstackEventTimeline timeline;
+  for (const CallstackEvent& event : events) timeline.Add(event.time(), event.callstack_hash());
+  // Merges the events added out of order.
+  FAIL_IF(timeline.size() != event_map.size(), "The timeline does not have the same events");
+  add_s = SecondsSince(begin);
+  begin = std::chrono::steady_clock::now();
+  uint64_t timeline_callstack_id_sum = 0;
+  for (uint64_t query_begin : query_begins) {
+    timeline.ForEachEventInTimeRange(
+        query_begin, query_begin + query_duration,
+        [&timeline_callstack_id_sum](const CallstackEventTimeline::Event& event) {
+          timeline_callstack_id_sum += event.callstack_id;
+        });
+  }
+  query_s = SecondsSince(begin);
+  FAIL_IF(timeline_callstack_id_sum != callstack_id_sum,
+          "The timeline does not return the same events");
+  printf("CallstackEventTimeline: %.1f bytes per event, add %.3f s, query %.3f s\n",
+         static_cast<double>(timeline.GetMemoryUsage()) / timeline.size(), add_s, query_s);
+  return 0;
+}
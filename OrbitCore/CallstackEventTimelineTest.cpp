@@ -0,0 +1,150 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "Callstack.h"
+#include "CallstackData.h"
+#include "CallstackEventTimeline.h"
+#include "capture_data.pb.h"
+
+using orbit_client_protos::CallstackEvent;
+
+namespace {
+
+std::vector<std::pair<uint64_t, CallstackID>> GetEvents(const CallstackEventTimeline& timeline) {
+  std::vector<std::pair<uint64_t, CallstackID>> events;
+  for (const CallstackEventTimeline::Event& event : timeline.GetEvents()) {
+    events.emplace_back(event.time, event.callstack_id);
+  }
+  return events;
+}
+
+std::vector<std::pair<uint64_t, CallstackID>> GetEventsInTimeRange(
+    const CallstackEventTimeline& timeline, uint64_t time_begin, uint64_t time_end) {
+  std::vector<std::pair<uint64_t, CallstackID>> events;
+  timeline.ForEachEventInTimeRange(
+      time_begin, time_end, [&events](const CallstackEventTimeline::Event& event) {
+        events.emplace_back(event.time, event.callstack_id);
+      });
+  return events;
+}
+
+}  // namespace
+
+TEST(CallstackEventTimeline, EventsAddedInOrderAreKeptInOrder) {
+  CallstackEventTimeline timeline;
+  EXPECT_EQ(timeline.size(), 0);
+  timeline.Add(10, 1);
+  timeline.Add(20, 2);
+  timeline.Add(30, 1);
+
+  EXPECT_EQ(timeline.size(), 3);
+  std::vector<std::pair<uint64_t, CallstackID>> expected{{10, 1}, {20, 2}, {30, 1}};
+  EXPECT_EQ(GetEvents(timeline), expected);
+}
+
+TEST(CallstackEventTimeline, EventsAddedOutOfOrderAreSorted) {
+  CallstackEventTimeline timeline;
+  timeline.Add(30, 3);
+  timeline.Add(10, 1);
+  timeline.Add(40, 4);
+  timeline.Add(20, 2);
+  timeline.Add(5, 5);
+
+  std::vector<std::pair<uint64_t, CallstackID>> expected{
+      {5, 5}, {10, 1}, {20, 2}, {30, 3}, {40, 4}};
+  EXPECT_EQ(GetEvents(timeline), expected);
+
+  timeline.Add(25, 6);
+  timeline.Add(50, 7);
+  expected = {{5, 5}, {10, 1}, {20, 2}, {25, 6}, {30, 3}, {40, 4}, {50, 7}};
+  EXPECT_EQ(GetEvents(timeline), expected);
+}
+
+TEST(CallstackEventTimeline, EventReplacesEventWithTheSameTime) {
+  CallstackEventTimeline timeline;
+  timeline.Add(10, 1);
+  timeline.Add(20, 2);
+  timeline.Add(20, 3);
+  timeline.Add(10, 4);
+  timeline.Add(5, 5);
+  timeline.Add(5, 6);
+
+  std::vector<std::pair<uint64_t, CallstackID>> expected{{5, 6}, {10, 4}, {20, 3}};
+  EXPECT_EQ(GetEvents(timeline), expected);
+}
+
+TEST(CallstackEventTimeline, ManyEventsAddedOutOfOrderAreSorted) {
+  constexpr uint64_t kEventCount = 10'000;
+  CallstackEventTimeline timeline;
+  // Each pair of events is added in reverse order, and every event is added
+  // twice, the second time with its time as callstack id.
+  for (uint64_t time = 0; time < kEventCount; time += 2) {
+    timeline.Add(time + 1, 0);
+    timeline.Add(time, 0);
+  }
+  for (uint64_t time = 0; time < kEventCount; ++time) {
+    timeline.Add(time, time);
+  }
+
+  const std::vector<CallstackEventTimeline::Event>& events = timeline.GetEvents();
+  ASSERT_EQ(events.size(), kEventCount);
+  for (uint64_t time = 0; time < kEventCount; ++time) {
+    EXPECT_EQ(events[time].time, time);
+    EXPECT_EQ(events[time].callstack_id, time);
+  }
+}
+
+TEST(CallstackEventTimeline, ForEachEventInTimeRange) {
+  CallstackEventTimeline timeline;
+  timeline.Add(10, 1);
+  timeline.Add(30, 3);
+  timeline.Add(20, 2);
+  timeline.Add(40, 4);
+
+  std::vector<std::pair<uint64_t, CallstackID>> expected{{20, 2}, {30, 3}};
+  EXPECT_EQ(GetEventsInTimeRange(timeline, 20, 40), expected);
+  EXPECT_EQ(GetEventsInTimeRange(timeline, 11, 31), expected);
+  EXPECT_TRUE(GetEventsInTimeRange(timeline, 41, 100).empty());
+  EXPECT_TRUE(GetEventsInTimeRange(timeline, 0, 10).empty());
+  EXPECT_EQ(GetEventsInTimeRange(timeline, 0, 100).size(), 4);
+}
+
+TEST(CallstackData, CallstackEventsInTimeRange) {
+  CallStack callstack({0x10, 0x20});
+  CallstackData callstack_data;
+  callstack_data.AddUniqueCallStack(callstack);
+  for (uint64_t time : {30, 10, 20}) {
+    CallstackEvent event;
+    event.set_time(time);
+    event.set_callstack_hash(callstack.GetHash());
+    event.set_thread_id(time == 20 ? 2 : 1);
+    callstack_data.AddCallstackEvent(event);
+  }
+
+  EXPECT_EQ(callstack_data.GetCallstackEventsCount(), 3);
+  std::vector<CallstackEvent> events = callstack_data.GetCallstackEventsInTimeRange(10, 30);
+  ASSERT_EQ(events.size(), 2);
+  // The events are only sorted by time within a thread.
+  std::sort(events.begin(), events.end(), [](const CallstackEvent& lhs, const CallstackEvent& rhs) {
+    return lhs.time() < rhs.time();
+  });
+  EXPECT_EQ(events[0].time(), 10);
+  EXPECT_EQ(events[0].callstack_hash(), callstack.GetHash());
+  EXPECT_EQ(events[0].thread_id(), 1);
+  EXPECT_EQ(events[1].time(), 20);
+  EXPECT_EQ(events[1].thread_id(), 2);
+
+  events = callstack_data.GetCallstackEventsOfTidInTimeRange(1, 0, 100);
+  ASSERT_EQ(events.size(), 2);
+  EXPECT_EQ(events[0].time(), 10);
+  EXPECT_EQ(events[1].time(), 30);
+  EXPECT_EQ(events[1].callstack_hash(), callstack.GetHash());
+}
@@ -0,0 +1,66 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "CallstackTrie.h"
+
+#include "OrbitBase/Logging.h"
+
+void CallstackTrie::AddCallstack(CallstackID callstack_id, const std::vector<uint64_t>& frames) {
+  auto [node_index_it, inserted] =
+      callstack_id_to_node_index_.try_emplace(callstack_id, kRootNodeIndex);
+  if (!inserted) return;
+
+  uint32_t node_index = kRootNodeIndex;
+  for (auto frame_it = frames.crbegin(); frame_it != frames.crend(); ++frame_it) {
+    uint32_t child_index = nodes_[node_index].first_child_index;
+    while (child_index != kNoNodeIndex && nodes_[child_index].frame != *frame_it) {
+      child_index = nodes_[child_index].next_sibling_index;
+    }
+    if (child_index == kNoNodeIndex) {
+      CHECK(nodes_.size() < kNoNodeIndex);
+      child_index = nodes_.size();
+      nodes_.push_back(Node{*frame_it, node_index, kNoNodeIndex,
+                            nodes_[node_index].first_child_index, nodes_[node_index].depth + 1});
+      nodes_[node_index].first_child_index = child_index;
+    }
+    node_index = child_index;
+  }
+  node_index_it->second = node_index;
+}
+
+std::optional<CallStack> CallstackTrie::GetCallstack(CallstackID callstack_id) const {
+  auto node_index_it = callstack_id_to_node_index_.find(callstack_id);
+  if (node_index_it == callstack_id_to_node_index_.end()) {
+    return std::nullopt;
+  }
+
+  uint32_t node_index = node_index_it->second;
+  std::vector<uint64_t> frames;
+  frames.reserve(nodes_[node_index].depth);
+  for (; node_index != kRootNodeIndex; node_index = nodes_[node_index].parent_index) {
+    frames.push_back(nodes_[node_index].frame);
+  }
+  return CallStack(callstack_id, std::move(frames));
+}
+
+void CallstackTrie::ForEachFrame(CallstackID callstack_id,
+                                 const std::function<void(uint64_t)>& action) const {
+  for (uint32_t node_index = GetNodeIndex(callstack_id); node_index != kRootNodeIndex;
+       node_index = nodes_[node_index].parent_index) {
+    action(nodes_[node_index].frame);
+  }
+}
+
+void CallstackTrie::ForEachCallstack(const std::function<void(const CallStack&)>& action) const {
+  for (const auto& [callstack_id, node_index] : callstack_id_to_node_index_) {
+    action(GetCallstack(callstack_id).value());
+  }
+}
+
+size_t CallstackTrie::GetMemoryUsage() const {
+  // One control byte per slot of the map, plus the slots.
+  return nodes_.capacity() * sizeof(Node) +
+         callstack_id_to_node_index_.capacity() *
+             (sizeof(decltype(callstack_id_to_node_index_)::value_type) + 1);
+}
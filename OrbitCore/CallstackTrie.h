@@ -0,0 +1,87 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef ORBIT_CORE_CALLSTACK_TRIE_H_
+#define ORBIT_CORE_CALLSTACK_TRIE_H_
+
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <optional>
+#include <vector>
+
+#include "Callstack.h"
+#include "CallstackTypes.h"
+#include "absl/container/flat_hash_map.h"
+
+// Stores unique callstacks as the paths of a prefix tree of frames, going
+// from the outermost frame at the root to the innermost frame. Callstacks
+// share long prefixes (main, the main loop, ...), which are only stored once.
+// A CallstackID maps to the node of the innermost frame of the callstack, and
+// its frames are read by walking up the parents of that node.
+//
+// The children of a node are a linked list, which is looked up linearly when
+// a callstack is added: functions usually have few different callers and
+// callees, and this keeps nodes small.
+//
+// Nodes are never removed, so node indices stay valid.
+class CallstackTrie {
+ public:
+  static constexpr uint32_t kRootNodeIndex = 0;
+
+  CallstackTrie() : nodes_{Node{0, kRootNodeIndex, kNoNodeIndex, kNoNodeIndex, 0}} {}
+
+  // frames start from the innermost frame, as in CallStack. Does nothing if a
+  // callstack with callstack_id was already added.
+  void AddCallstack(CallstackID callstack_id, const std::vector<uint64_t>& frames);
+  void AddCallstack(const CallStack& callstack) {
+    AddCallstack(callstack.GetHash(), callstack.GetFrames());
+  }
+
+  [[nodiscard]] bool HasCallstack(CallstackID callstack_id) const {
+    return callstack_id_to_node_index_.contains(callstack_id);
+  }
+  [[nodiscard]] size_t GetCallstackCount() const { return callstack_id_to_node_index_.size(); }
+
+  // Copies the frames of the callstack into a CallStack.
+  [[nodiscard]] std::optional<CallStack> GetCallstack(CallstackID callstack_id) const;
+
+  // Calls action for each frame of the callstack, from the innermost one.
+  void ForEachFrame(CallstackID callstack_id, const std::function<void(uint64_t)>& action) const;
+
+  void ForEachCallstack(const std::function<void(const CallStack&)>& action) const;
+
+  // The node of the innermost frame of the callstack, kRootNodeIndex if the
+  // callstack has no frames. The callstack must have been added.
+  [[nodiscard]] uint32_t GetNodeIndex(CallstackID callstack_id) const {
+    return callstack_id_to_node_index_.at(callstack_id);
+  }
+  [[nodiscard]] uint64_t GetFrame(uint32_t node_index) const { return nodes_[node_index].frame; }
+  [[nodiscard]] uint32_t GetParentNodeIndex(uint32_t node_index) const {
+    return nodes_[node_index].parent_index;
+  }
+  // The number of frames from the root to the node, 0 for the root.
+  [[nodiscard]] uint32_t GetDepth(uint32_t node_index) const { return nodes_[node_index].depth; }
+
+  [[nodiscard]] size_t GetNodeCount() const { return nodes_.size(); }
+
+  // An estimate of the heap memory used by the trie, in bytes.
+  [[nodiscard]] size_t GetMemoryUsage() const;
+
+ private:
+  static constexpr uint32_t kNoNodeIndex = std::numeric_limits<uint32_t>::max();
+
+  struct Node {
+    uint64_t frame;
+    uint32_t parent_index;
+    uint32_t first_child_index;
+    uint32_t next_sibling_index;
+    uint32_t depth;
+  };
+
+  std::vector<Node> nodes_;
+  absl::flat_hash_map<CallstackID, uint32_t> callstack_id_to_node_index_;
+};
+
+#endif  // ORBIT_CORE_CALLSTACK_TRIE_H_
@@ -0,0 +1,126 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// Compares the memory used by the unique callstacks of a synthetic capture
+// shaped like the callstacks of a game (deep, with long common prefixes) when
+// each one is stored as its own CallStack and when they are stored in a
+// CallstackTrie. Also reports the time to add them and to read their frames.
+
+#include <OrbitBase/Logging.h>
+
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <vector>
+
+#include "Callstack.h"
+#include "CallstackTrie.h"
+#include "absl/container/flat_hash_map.h"
+#include "absl/flags/flag.h"
+#include "absl/flags/parse.h"
+
+ABSL_FLAG(uint32_t, callstacks, 200'000, "Number of unique callstacks");
+ABSL_FLAG(uint32_t, min_depth, 20, "Minimum number of frames of a callstack");
+ABSL_FLAG(uint32_t, max_depth, 80, "Maximum number of frames of a callstack");
+
+namespace {
+
+constexpr uint64_t kFirstFunctionAddress = 0x7f0000000000;
+constexpr uint64_t kFunctionCount = 50'000;
+// Control block of the std::shared_ptr created by std::make_shared.
+constexpr size_t kSharedPtrControlBlockSize = 16;
+
+uint64_t Random(uint64_t index) {
+  uint64_t random = index * 0x9e3779b97f4a7c15;
+  return random ^ (random >> 29);
+}
+
+// Each function calls up to 8 different functions, half of the time the same
+// one, so that callstacks share long prefixes (main, the main loop, the
+// systems of the engine, ...) and mostly differ in their innermost frames.
+std::vector<CallStack> CreateCallstacks(uint32_t callstack_count, uint32_t min_depth,
+                                        uint32_t max_depth) {
+  std::vector<CallStack> callstacks;
+  callstacks.reserve(callstack_count);
+  for (uint32_t i = 0; i < callstack_count; ++i) {
+    size_t depth = min_depth + Random(i) % (max_depth - min_depth + 1);
+    std::vector<uint64_t> frames(depth);
+    uint64_t path = 0;
+    for (size_t j = 0; j < depth; ++j) {
+      uint64_t random = Random(i * 1024 + j);
+      uint64_t callee = random % 2 == 0 ? (random >> 8) % 8 : 0;
+      path = Random(path * 31 + callee + 1);
+      // Return addresses in the middle of the functions.
+      frames[depth - 1 - j] = kFirstFunctionAddress + (path % kFunctionCount) * 0x400 + 0x42;
+    }
+    callstacks.emplace_back(std::move(frames));
+  }
+  return callstacks;
+}
+
+template <typename Map>
+size_t GetFlatHashMapMemoryUsage(const Map& map) {
+  return map.capacity() * (sizeof(typename Map::value_type) + 1);
+}
+
+double SecondsSince(std::chrono::steady_clock::time_point begin) {
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  absl::ParseCommandLine(argc, argv);
+  uint32_t callstack_count = absl::GetFlag(FLAGS_callstacks);
+  uint32_t min_depth = absl::GetFlag(FLAGS_min_depth);
+  uint32_t max_depth = absl::GetFlag(FLAGS_max_depth);
+  FAIL_IF(callstack_count == 0 || min_depth > max_depth, "Invalid flags");
+
+  std::vector<CallStack> callstacks = CreateCallstacks(callstack_count, min_depth, max_depth);
+  size_t frame_count = 0;
+  for (const CallStack& callstack : callstacks) frame_count += callstack.GetFramesCount();
+  printf("%u callstacks, %.1f frames per callstack\n", callstack_count,
+         static_cast<double>(frame_count) / callstack_count);
+
+  auto begin = std::chrono::steady_clock::now();
+  absl::flat_hash_map<CallstackID, std::shared_ptr<CallStack>> callstack_map;
+  for (const CallStack& callstack : callstacks) {
+    callstack_map.emplace(callstack.GetHash(), std::make_shared<CallStack>(callstack));
+  }
+  double add_s = SecondsSince(begin);
+  begin = std::chrono::steady_clock::now();
+  uint64_t frame_sum = 0;
+  for (const CallStack& callstack : callstacks) {
+    for (uint64_t frame : callstack_map.at(callstack.GetHash())->GetFrames()) frame_sum += frame;
+  }
+  double read_s = SecondsSince(begin);
+  size_t map_memory = GetFlatHashMapMemoryUsage(callstack_map);
+  for (const auto& [callstack_id, callstack] : callstack_map) {
+    map_memory += sizeof(CallStack) + kSharedPtrControlBlockSize +
+                  callstack->GetFrames().capacity() * sizeof(uint64_t);
+  }
+  printf("CallStack per callstack: %.1f bytes per callstack, add %.3f s, read frames %.3f s\n",
+         static_cast<double>(map_memory) / callstack_count, add_s, read_s);
+
+  begin = std::chrono::steady_clock::now();
+  CallstackTrie trie;
+  for (const CallStack& callstack : callstacks) trie.AddCallstack(callstack);
+  add_s = SecondsSince(begin);
+  begin = std::chrono::steady_clock::now();
+  uint64_t trie_frame_sum = 0;
+  for (const CallStack& callstack : callstacks) {
+    for (uint32_t node_index = trie.GetNodeIndex(callstack.GetHash());
+         node_index != CallstackTrie::kRootNodeIndex;
+         node_index = trie.GetParentNodeIndex(node_index)) {
+      trie_frame_sum += trie.GetFrame(node_index);
+    }
+  }
+  read_s = SecondsSince(begin);
+  FAIL_IF(trie_frame_sum != frame_sum, "The trie does not have the same frames");
+  printf("CallstackTrie: %.1f bytes per callstack, %.2f nodes per callstack, add %.3f s, "
+         "read frames %.3f s\n",
+         static_cast<double>(trie.GetMemoryUsage()) / callstack_count,
+         static_cast<double>(trie.GetNodeCount()) / callstack_count, add_s, read_s);
+  return 0;
+}
@@ -0,0 +1,125 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <vector>
+
+#include "Callstack.h"
+#include "CallstackData.h"
+#include "CallstackTrie.h"
+
+namespace {
+
+std::vector<uint64_t> GetFrames(const CallstackTrie& trie, CallstackID callstack_id) {
+  std::vector<uint64_t> frames;
+  trie.ForEachFrame(callstack_id, [&frames](uint64_t frame) { frames.push_back(frame); });
+  return frames;
+}
+
+}  // namespace
+
+TEST(CallstackTrie, EmptyTrieHasOnlyTheRoot) {
+  CallstackTrie trie;
+  EXPECT_EQ(trie.GetCallstackCount(), 0);
+  EXPECT_EQ(trie.GetNodeCount(), 1);
+  EXPECT_FALSE(trie.HasCallstack(42));
+  EXPECT_FALSE(trie.GetCallstack(42).has_value());
+}
+
+TEST(CallstackTrie, CallstacksAreReturnedAsAdded) {
+  CallStack callstack_1({0x10, 0x20, 0x30});
+  CallStack callstack_2({0x11, 0x21, 0x30});
+  CallstackTrie trie;
+  trie.AddCallstack(callstack_1);
+  trie.AddCallstack(callstack_2);
+
+  EXPECT_EQ(trie.GetCallstackCount(), 2);
+  ASSERT_TRUE(trie.HasCallstack(callstack_1.GetHash()));
+  std::optional<CallStack> actual_1 = trie.GetCallstack(callstack_1.GetHash());
+  ASSERT_TRUE(actual_1.has_value());
+  EXPECT_EQ(actual_1->GetHash(), callstack_1.GetHash());
+  EXPECT_EQ(actual_1->GetFrames(), callstack_1.GetFrames());
+  EXPECT_EQ(GetFrames(trie, callstack_2.GetHash()), callstack_2.GetFrames());
+
+  std::vector<CallstackID> callstack_ids;
+  trie.ForEachCallstack([&callstack_ids, &trie](const CallStack& callstack) {
+    callstack_ids.push_back(callstack.GetHash());
+    EXPECT_EQ(callstack.GetFrames(), GetFrames(trie, callstack.GetHash()));
+  });
+  EXPECT_EQ(callstack_ids.size(), 2);
+}
+
+TEST(CallstackTrie, OutermostFramesAreShared) {
+  CallstackTrie trie;
+  trie.AddCallstack(CallStack({0x10, 0x20, 0x30, 0x40}));
+  EXPECT_EQ(trie.GetNodeCount(), 5);
+
+  // Same outermost frames, another innermost frame.
+  CallStack callstack({0x11, 0x20, 0x30, 0x40});
+  trie.AddCallstack(callstack);
+  EXPECT_EQ(trie.GetNodeCount(), 6);
+
+  // Same innermost frame, but not the same outermost frames.
+  trie.AddCallstack(CallStack({0x10, 0x20, 0x30, 0x41}));
+  EXPECT_EQ(trie.GetNodeCount(), 10);
+
+  // A prefix of a callstack added before.
+  CallStack prefix({0x30, 0x40});
+  trie.AddCallstack(prefix);
+  EXPECT_EQ(trie.GetNodeCount(), 10);
+  EXPECT_EQ(trie.GetCallstackCount(), 4);
+  EXPECT_EQ(GetFrames(trie, prefix.GetHash()), prefix.GetFrames());
+
+  uint32_t node_index = trie.GetNodeIndex(callstack.GetHash());
+  EXPECT_EQ(trie.GetFrame(node_index), 0x11);
+  EXPECT_EQ(trie.GetDepth(node_index), 4);
+  uint32_t parent_index = trie.GetParentNodeIndex(trie.GetParentNodeIndex(node_index));
+  EXPECT_EQ(parent_index, trie.GetNodeIndex(prefix.GetHash()));
+  EXPECT_EQ(trie.GetDepth(parent_index), 2);
+}
+
+TEST(CallstackTrie, AddingACallstackAgainDoesNothing) {
+  CallStack callstack({0x10, 0x20});
+  CallstackTrie trie;
+  trie.AddCallstack(callstack);
+  trie.AddCallstack(callstack);
+  EXPECT_EQ(trie.GetCallstackCount(), 1);
+  EXPECT_EQ(trie.GetNodeCount(), 3);
+}
+
+TEST(CallstackTrie, CallstackWithoutFramesIsTheRoot) {
+  CallStack callstack(std::vector<uint64_t>{});
+  CallstackTrie trie;
+  trie.AddCallstack(callstack);
+  EXPECT_TRUE(trie.HasCallstack(callstack.GetHash()));
+  EXPECT_EQ(trie.GetNodeIndex(callstack.GetHash()), CallstackTrie::kRootNodeIndex);
+  std::optional<CallStack> actual = trie.GetCallstack(callstack.GetHash());
+  ASSERT_TRUE(actual.has_value());
+  EXPECT_EQ(actual->GetFramesCount(), 0);
+}
+
+TEST(CallstackData, UniqueCallstacksDoNotChangeAfterTheyAreReturned) {
+  CallstackData callstack_data;
+  CallStack callstack_1({0x10, 0x20});
+  callstack_data.AddUniqueCallStack(callstack_1);
+  std::shared_ptr<const CallstackTrie> unique_callstacks = callstack_data.GetUniqueCallstacks();
+
+  CallStack callstack_2({0x11, 0x20});
+  callstack_data.AddUniqueCallStack(callstack_2);
+  EXPECT_EQ(unique_callstacks->GetCallstackCount(), 1);
+  EXPECT_FALSE(unique_callstacks->HasCallstack(callstack_2.GetHash()));
+
+  std::shared_ptr<const CallstackTrie> new_unique_callstacks =
+      callstack_data.GetUniqueCallstacks();
+  EXPECT_EQ(new_unique_callstacks->GetCallstackCount(), 2);
+  EXPECT_TRUE(new_unique_callstacks->HasCallstack(callstack_1.GetHash()));
+  EXPECT_TRUE(callstack_data.HasCallStack(callstack_2.GetHash()));
+  std::optional<CallStack> actual_2 = callstack_data.GetCallStack(callstack_2.GetHash());
+  ASSERT_TRUE(actual_2.has_value());
+  EXPECT_EQ(actual_2->GetFrames(), callstack_2.GetFrames());
+}
@@ -5,6 +5,7 @@
 #ifndef ORBIT_CORE_CAPTURE_DATA_H_
 #define ORBIT_CORE_CAPTURE_DATA_H_
 
+#include <map>
 #include <memory>
 #include <vector>
 
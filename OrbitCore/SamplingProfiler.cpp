@@ -4,9 +4,16 @@
 
 #include "SamplingProfiler.h"
 
+#include <algorithm>
+#include <atomic>
+#include <queue>
+#include <tuple>
+#include <utility>
+
 #include "CaptureData.h"
 #include "FunctionUtils.h"
 #include "OrbitModule.h"
+#include "absl/synchronization/mutex.h"
 
 using orbit_client_protos::CallstackEvent;
 using orbit_client_protos::FunctionInfo;
@@ -14,18 +21,28 @@ using orbit_client_protos::LinuxAddressInfo;
 
 namespace {
 
-std::multimap<int, CallstackID> SortCallstacks(const ThreadSampleData& data,
-                                               const std::set<CallstackID>& callstacks) {
-  std::multimap<int, CallstackID> sorted_callstacks;
+// The number of shards the new callstacks are split into by CallstackID to be
+// resolved in parallel.
+constexpr size_t kCallstackShardCount = 64;
+
+// Sorted by decreasing count, and then by decreasing id.
+std::vector<CallstackCount> SortCallstacks(const ThreadSampleData& data,
+                                           const std::vector<CallstackID>& callstacks) {
+  std::vector<CallstackCount> callstack_counts;
+  callstack_counts.reserve(callstacks.size());
   for (CallstackID id : callstacks) {
     auto it = data.callstack_count.find(id);
     if (it != data.callstack_count.end()) {
-      int count = it->second;
-      sorted_callstacks.insert(std::make_pair(count, id));
+      CallstackCount& callstack_count = callstack_counts.emplace_back();
+      callstack_count.count = it->second;
+      callstack_count.callstack_id = id;
     }
   }
-
-  return sorted_callstacks;
+  std::sort(callstack_counts.begin(), callstack_counts.end(),
+            [](const CallstackCount& lhs, const CallstackCount& rhs) {
+              return std::tie(lhs.count, lhs.callstack_id) > std::tie(rhs.count, rhs.callstack_id);
+            });
+  return callstack_counts;
 }
 
 void ComputeAverageThreadUsage(ThreadSampleData* data) {
@@ -40,6 +57,134 @@ void ComputeAverageThreadUsage(ThreadSampleData* data) {
   }
 }
 
+// Calls function(index) for every index in [0, count), on the calling thread
+// and on the threads of thread_pool, if any, and returns when all calls have
+// returned. Each thread takes the next index when it is done with one.
+void ParallelFor(ThreadPool* thread_pool, size_t count,
+                 const std::function<void(size_t index)>& function) {
+  std::atomic<size_t> next_index = 0;
+  auto run = [count, &next_index, &function] {
+    for (size_t index = next_index++; index < count; index = next_index++) {
+      function(index);
+    }
+  };
+
+  size_t helper_count =
+      thread_pool == nullptr || count == 0 ? 0 : std::min(count - 1, thread_pool->GetPoolSize());
+  absl::Mutex mutex;
+  size_t running_helper_count = helper_count;
+  for (size_t i = 0; i < helper_count; ++i) {
+    thread_pool->Schedule([&run, &mutex, &running_helper_count] {
+      run();
+      absl::MutexLock lock{&mutex};
+      --running_helper_count;
+    });
+  }
+  run();
+
+  absl::MutexLock lock{&mutex};
+  mutex.Await(absl::Condition(
+      +[](size_t* running_helper_count) { return *running_helper_count == 0; },
+      &running_helper_count));
+}
+
+// Returns the start address of the function absolute_address falls inside.
+// Uses the Function returned by Process::GetFunctionFromAddress, and when this
+// fails (e.g., the module containing the function has not been loaded) uses
+// (for now) the LinuxAddressInfo that is collected for every address in a
+// callstack. SamplingProfiler relies heavily on the association between
+// address and function address, otherwise each address is considered a
+// different function.
+uint64_t ComputeFunctionAddress(uint64_t absolute_address, const CaptureData& capture_data) {
+  const FunctionInfo* function =
+      capture_data.process()->GetFunctionFromAddress(absolute_address, false);
+  if (function != nullptr) {
+    return FunctionUtils::GetAbsoluteAddress(*function);
+  }
+  const LinuxAddressInfo* address_info = capture_data.GetAddressInfo(absolute_address);
+  if (address_info != nullptr) {
+    return absolute_address - address_info->offset_in_function();
+  }
+  return absolute_address;
+}
+
+// Returns the addresses of the frames of callstack, sorted and without
+// duplicates.
+std::vector<uint64_t> GetUniqueFrames(const CallStack& callstack) {
+  std::vector<uint64_t> unique_frames = callstack.GetFrames();
+  std::sort(unique_frames.begin(), unique_frames.end());
+  unique_frames.erase(std::unique(unique_frames.begin(), unique_frames.end()),
+                      unique_frames.end());
+  return unique_frames;
+}
+
+// Adds the counts of the callstacks to the counts of their frames. Callstacks
+// share the nodes of their outermost frames, which are counted once for all of
+// them: the counts are moved up the trie from the deepest node, as parents
+// have smaller indices than their children.
+void AddRawAddressCounts(const CallstackTrie& unique_callstacks,
+                         const absl::flat_hash_map<CallstackID, uint32_t>& callstack_counts,
+                         absl::flat_hash_map<uint64_t, uint32_t>* raw_address_count) {
+  std::priority_queue<std::pair<uint32_t, uint32_t>> node_counts;
+  for (const auto& [callstack_id, count] : callstack_counts) {
+    node_counts.emplace(unique_callstacks.GetNodeIndex(callstack_id), count);
+  }
+  while (!node_counts.empty()) {
+    auto [node_index, count] = node_counts.top();
+    node_counts.pop();
+    while (!node_counts.empty() && node_counts.top().first == node_index) {
+      count += node_counts.top().second;
+      node_counts.pop();
+    }
+    if (node_index == CallstackTrie::kRootNodeIndex) break;
+    (*raw_address_count)[unique_callstacks.GetFrame(node_index)] += count;
+    node_counts.emplace(unique_callstacks.GetParentNodeIndex(node_index), count);
+  }
+}
+
+void FillThreadSampleDataSampleReport(const CaptureData& capture_data,
+                                      ThreadSampleData* thread_sample_data) {
+  // sort thread addresses by count, and by address for equal counts
+  std::vector<std::pair<uint32_t, uint64_t>>* address_count_sorted =
+      &thread_sample_data->address_count_sorted;
+  address_count_sorted->clear();
+  address_count_sorted->reserve(thread_sample_data->address_count.size());
+  for (const auto& [address, count] : thread_sample_data->address_count) {
+    address_count_sorted->emplace_back(count, address);
+  }
+  std::sort(address_count_sorted->begin(), address_count_sorted->end());
+
+  std::vector<SampledFunction>* sampled_functions = &thread_sample_data->sampled_function;
+  sampled_functions->clear();
+  sampled_functions->reserve(address_count_sorted->size());
+
+  for (auto sortedIt = address_count_sorted->rbegin(); sortedIt != address_count_sorted->rend();
+       ++sortedIt) {
+    uint32_t numOccurences = sortedIt->first;
+    uint64_t absolute_address = sortedIt->second;
+    float inclusive_percent = 100.f * numOccurences / thread_sample_data->samples_count;
+
+    SampledFunction function;
+    function.name = capture_data.GetFunctionNameByAddress(absolute_address);
+    function.inclusive = inclusive_percent;
+    function.exclusive = 0.f;
+    auto it = thread_sample_data->exclusive_count.find(absolute_address);
+    if (it != thread_sample_data->exclusive_count.end()) {
+      function.exclusive = 100.f * it->second / thread_sample_data->samples_count;
+    }
+    function.absolute_address = absolute_address;
+    function.module_path = capture_data.GetModulePathByAddress(absolute_address);
+
+    const FunctionInfo* function_info = capture_data.GetFunctionInfoByAddress(absolute_address);
+    if (function_info != nullptr) {
+      function.line = function_info->line();
+      function.file = function_info->file();
+    }
+
+    sampled_functions->push_back(function);
+  }
+}
+
 }  // namespace
 
 uint32_t ThreadSampleData::GetCountForAddress(uint64_t address) const {
@@ -50,13 +195,13 @@ uint32_t ThreadSampleData::GetCountForAddress(uint64_t address) const {
   return (*res).second;
 }
 
-std::multimap<int, CallstackID> SamplingProfiler::GetCallstacksFromAddress(
+std::vector<CallstackCount> SamplingProfiler::GetCallstacksFromAddress(
     uint64_t address, ThreadID thread_id) const {
   const auto& callstacks_it = function_address_to_callstack_.find(address);
   const auto& sample_data_it = thread_id_to_sample_data_.find(thread_id);
   if (callstacks_it == function_address_to_callstack_.end() ||
       sample_data_it == thread_id_to_sample_data_.end()) {
-    return std::multimap<int, CallstackID>();
+    return {};
   }
   return SortCallstacks(sample_data_it->second, callstacks_it->second);
 }
@@ -72,16 +217,9 @@ const CallStack& SamplingProfiler::GetResolvedCallstack(CallstackID raw_callstac
 std::unique_ptr<SortedCallstackReport> SamplingProfiler::GetSortedCallstacksFromAddress(
     uint64_t address, ThreadID thread_id) const {
   std::unique_ptr<SortedCallstackReport> report = std::make_unique<SortedCallstackReport>();
-  std::multimap<int, CallstackID> multi_map = GetCallstacksFromAddress(address, thread_id);
-  size_t unique_callstacks_count = multi_map.size();
-  report->callstacks_count.resize(unique_callstacks_count);
-  size_t index = unique_callstacks_count;
-
-  for (const auto& pair : multi_map) {
-    CallstackCount* callstack = &report->callstacks_count[--index];
-    callstack->count = pair.first;
-    callstack->callstack_id = pair.second;
-    report->callstacks_total_count += callstack->count;
+  report->callstacks_count = GetCallstacksFromAddress(address, thread_id);
+  for (const CallstackCount& callstack : report->callstacks_count) {
+    report->callstacks_total_count += callstack.count;
   }
 
   return report;
@@ -89,125 +227,262 @@ std::unique_ptr<SortedCallstackReport> SamplingProfiler::GetSortedCallstacksFrom
 
 const int32_t SamplingProfiler::kAllThreadsFakeTid = -1;
 
-void SamplingProfiler::SortByThreadUsage() {
-  sorted_thread_sample_data_.clear();
-  sorted_thread_sample_data_.reserve(thread_id_to_sample_data_.size());
+void SamplingProfiler::AddCallstackEvent(const CallstackEvent& event) {
+  new_callstack_counts_[event.thread_id()][event.callstack_hash()]++;
+  if (generate_summary_) {
+    new_callstack_counts_[kAllThreadsFakeTid][event.callstack_hash()]++;
+  }
+}
 
-  // If "All" exists, set to 100% usage
-  auto all_threads_it = thread_id_to_sample_data_.find(kAllThreadsFakeTid);
-  if (all_threads_it != thread_id_to_sample_data_.end()) {
-    all_threads_it->second.average_thread_usage = 100.f;
+void SamplingProfiler::ProcessSamples(const CallstackData& callstack_data,
+                                      const CaptureData& capture_data, ThreadPool* thread_pool) {
+  // The events of each thread are counted on their own, and the counts of all
+  // threads are added up for the summary.
+  const auto& callstack_events_by_tid = callstack_data.callstack_events_by_tid();
+  std::vector<ThreadID> thread_ids;
+  thread_ids.reserve(callstack_events_by_tid.size());
+  for (const auto& [thread_id, events] : callstack_events_by_tid) {
+    thread_ids.push_back(thread_id);
   }
 
-  for (auto& pair : thread_id_to_sample_data_) {
-    ThreadSampleData& data = pair.second;
-    data.thread_id = pair.first;
-    sorted_thread_sample_data_.push_back(data);
+  std::vector<absl::flat_hash_map<CallstackID, uint32_t>> thread_callstack_counts(
+      thread_ids.size());
+  ParallelFor(thread_pool, thread_ids.size(),
+              [&callstack_events_by_tid, &thread_ids, &thread_callstack_counts](size_t index) {
+                absl::flat_hash_map<CallstackID, uint32_t>* callstack_counts =
+                    &thread_callstack_counts[index];
+                // callstack_events_by_tid() has merged the events of each thread, so they can
+                // be read from several threads.
+                for (const CallstackEventTimeline::Event& event :
+                     callstack_events_by_tid.at(thread_ids[index]).GetEvents()) {
+                  (*callstack_counts)[event.callstack_id]++;
+                }
+              });
+
+  for (size_t i = 0; i < thread_ids.size(); ++i) {
+    for (const auto& [callstack_id, count] : thread_callstack_counts[i]) {
+      new_callstack_counts_[thread_ids[i]][callstack_id] += count;
+      if (generate_summary_) {
+        new_callstack_counts_[kAllThreadsFakeTid][callstack_id] += count;
+      }
+    }
   }
 
-  sort(sorted_thread_sample_data_.begin(), sorted_thread_sample_data_.end(),
-       [](const ThreadSampleData& a, const ThreadSampleData& b) {
-         return a.average_thread_usage > b.average_thread_usage;
-       });
+  ProcessNewSamples(callstack_data, capture_data, thread_pool);
 }
 
-void SamplingProfiler::ProcessSamples(const CallstackData& callstack_data,
-                                      const CaptureData& capture_data, bool generate_summary) {
-  // Unique call stacks and per thread data
-  callstack_data.ForEachCallstackEvent(
-      [this, &callstack_data, generate_summary](const CallstackEvent& event) {
-        CHECK(callstack_data.HasCallStack(event.callstack_hash()));
-
-        ThreadSampleData* thread_sample_data = &thread_id_to_sample_data_[event.thread_id()];
-        thread_sample_data->samples_count++;
-        thread_sample_data->callstack_count[event.callstack_hash()]++;
-        callstack_data.ForEachFrameInCallstack(event.callstack_hash(),
-                                               [&thread_sample_data](uint64_t address) {
-                                                 thread_sample_data->raw_address_count[address]++;
-                                               });
-
-        if (generate_summary) {
-          ThreadSampleData* all_thread_sample_data = &thread_id_to_sample_data_[kAllThreadsFakeTid];
-          all_thread_sample_data->samples_count++;
-          all_thread_sample_data->callstack_count[event.callstack_hash()]++;
-          callstack_data.ForEachFrameInCallstack(
-              event.callstack_hash(), [&all_thread_sample_data](uint64_t address) {
-                all_thread_sample_data->raw_address_count[address]++;
+std::vector<ThreadID> SamplingProfiler::ProcessNewSamples(const CallstackData& callstack_data,
+                                                          const CaptureData& capture_data,
+                                                          ThreadPool* thread_pool) {
+  // The trie is not modified while it is used here, even during a capture.
+  std::shared_ptr<const CallstackTrie> unique_callstacks = callstack_data.GetUniqueCallstacks();
+  absl::flat_hash_set<CallstackID> unresolved_callstack_ids;
+  for (const auto& [thread_id, callstack_counts] : new_callstack_counts_) {
+    for (const auto& [callstack_id, count] : callstack_counts) {
+      if (!original_to_resolved_callstack_.contains(callstack_id)) {
+        unresolved_callstack_ids.insert(callstack_id);
+      }
+    }
+  }
+  ResolveCallstacks(*unique_callstacks,
+                    {unresolved_callstack_ids.begin(), unresolved_callstack_ids.end()},
+                    capture_data, thread_pool);
+
+  std::vector<ThreadID> updated_thread_ids;
+  updated_thread_ids.reserve(new_callstack_counts_.size());
+  for (const auto& [thread_id, callstack_counts] : new_callstack_counts_) {
+    thread_id_to_sample_data_[thread_id].thread_id = thread_id;
+    updated_thread_ids.push_back(thread_id);
+  }
+  // The summary has the most samples, start with it.
+  std::sort(updated_thread_ids.begin(), updated_thread_ids.end());
+
+  // The threads are independent from each other from here on.
+  ParallelFor(thread_pool, updated_thread_ids.size(),
+              [this, &updated_thread_ids, &unique_callstacks, &capture_data](size_t index) {
+                ThreadID thread_id = updated_thread_ids[index];
+                const absl::flat_hash_map<CallstackID, uint32_t>& callstack_counts =
+                    new_callstack_counts_.at(thread_id);
+                ThreadSampleData* thread_sample_data = &thread_id_to_sample_data_.at(thread_id);
+                for (const auto& [callstack_id, count] : callstack_counts) {
+                  thread_sample_data->samples_count += count;
+                  thread_sample_data->callstack_count[callstack_id] += count;
+                }
+                AddRawAddressCounts(*unique_callstacks, callstack_counts,
+                                    &thread_sample_data->raw_address_count);
+                AddResolvedCounts(callstack_counts, thread_sample_data);
+                UpdateThreadSampleDataReport(capture_data, thread_sample_data);
               });
-        }
-      });
+  new_callstack_counts_.clear();
 
-  ResolveCallstacks(callstack_data, capture_data);
+  SortByThreadUsage(updated_thread_ids);
+  return updated_thread_ids;
+}
 
-  for (auto& sample_data_it : thread_id_to_sample_data_) {
-    ThreadSampleData* thread_sample_data = &sample_data_it.second;
+void SamplingProfiler::ResolveCallstacksAgain(const CallstackData& callstack_data,
+                                              const CaptureData& capture_data,
+                                              ThreadPool* thread_pool) {
+  unique_resolved_callstacks_.clear();
+  original_to_resolved_callstack_.clear();
+  function_address_to_callstack_.clear();
+  exact_address_to_function_address_.clear();
+  function_address_to_exact_addresses_.clear();
+
+  absl::flat_hash_set<CallstackID> callstack_ids;
+  std::vector<ThreadID> thread_ids;
+  thread_ids.reserve(thread_id_to_sample_data_.size());
+  for (const auto& [thread_id, thread_sample_data] : thread_id_to_sample_data_) {
+    for (const auto& [callstack_id, count] : thread_sample_data.callstack_count) {
+      callstack_ids.insert(callstack_id);
+    }
+    thread_ids.push_back(thread_id);
+  }
+  ResolveCallstacks(*callstack_data.GetUniqueCallstacks(),
+                    {callstack_ids.begin(), callstack_ids.end()}, capture_data, thread_pool);
+
+  std::sort(thread_ids.begin(), thread_ids.end());
+  ParallelFor(thread_pool, thread_ids.size(), [this, &thread_ids, &capture_data](size_t index) {
+    ThreadSampleData* thread_sample_data = &thread_id_to_sample_data_.at(thread_ids[index]);
+    thread_sample_data->exclusive_count.clear();
+    thread_sample_data->address_count.clear();
+    AddResolvedCounts(thread_sample_data->callstack_count, thread_sample_data);
+    UpdateThreadSampleDataReport(capture_data, thread_sample_data);
+  });
 
-    ComputeAverageThreadUsage(thread_sample_data);
+  SortByThreadUsage(thread_ids);
+}
 
-    // Address count per sample per thread
-    for (const auto& callstack_count_it : thread_sample_data->callstack_count) {
-      const CallstackID callstack_id = callstack_count_it.first;
-      const uint32_t callstack_count = callstack_count_it.second;
+void SamplingProfiler::ResolveCallstacks(const CallstackTrie& unique_callstacks,
+                                         const std::vector<CallstackID>& callstack_ids,
+                                         const CaptureData& capture_data,
+                                         ThreadPool* thread_pool) {
+  if (callstack_ids.empty()) return;
+
+  // A "resolved callstack" is a callstack where every address is replaced
+  // by the start address of the function (if known). The shards are resolved
+  // in parallel, only reading the members, and then merged into them.
+  struct ResolvedCallstack {
+    CallstackID callstack_id;
+    CallStack resolved_callstack;
+    std::vector<uint64_t> unique_function_addresses;
+  };
+  struct Shard {
+    std::vector<CallstackID> callstack_ids;
+    absl::flat_hash_map<uint64_t, uint64_t> exact_address_to_function_address;
+    std::vector<ResolvedCallstack> resolved_callstacks;
+  };
+
+  std::vector<Shard> shards(std::min(callstack_ids.size(), kCallstackShardCount));
+  for (CallstackID callstack_id : callstack_ids) {
+    CHECK(unique_callstacks.HasCallstack(callstack_id));
+    shards[callstack_id % shards.size()].callstack_ids.push_back(callstack_id);
+  }
 
-      CallstackID resolved_callstack_id = original_to_resolved_callstack_[callstack_id];
-      std::shared_ptr<CallStack>& resolved_callstack =
-          unique_resolved_callstacks_[resolved_callstack_id];
+  auto resolve_shard = [this, &unique_callstacks, &capture_data](Shard* shard) {
+    shard->resolved_callstacks.reserve(shard->callstack_ids.size());
+    for (CallstackID callstack_id : shard->callstack_ids) {
+      uint32_t leaf_node_index = unique_callstacks.GetNodeIndex(callstack_id);
+      std::vector<uint64_t> resolved_callstack_data;
+      resolved_callstack_data.reserve(unique_callstacks.GetDepth(leaf_node_index));
+      for (uint32_t node_index = leaf_node_index; node_index != CallstackTrie::kRootNodeIndex;
+           node_index = unique_callstacks.GetParentNodeIndex(node_index)) {
+        uint64_t address = unique_callstacks.GetFrame(node_index);
+        auto function_address_it = exact_address_to_function_address_.find(address);
+        if (function_address_it != exact_address_to_function_address_.end()) {
+          resolved_callstack_data.push_back(function_address_it->second);
+          continue;
+        }
+        auto [shard_function_address_it, inserted] =
+            shard->exact_address_to_function_address.try_emplace(address, 0);
+        if (inserted) {
+          shard_function_address_it->second = ComputeFunctionAddress(address, capture_data);
+        }
+        resolved_callstack_data.push_back(shard_function_address_it->second);
+      }
 
-      // exclusive stat
-      thread_sample_data->exclusive_count[resolved_callstack->GetFrame(0)] += callstack_count;
+      CallStack resolved_callstack(std::move(resolved_callstack_data));
+      std::vector<uint64_t> unique_function_addresses = GetUniqueFrames(resolved_callstack);
+      shard->resolved_callstacks.push_back(ResolvedCallstack{callstack_id,
+                                                             std::move(resolved_callstack),
+                                                             std::move(unique_function_addresses)});
+    }
+  };
+  ParallelFor(thread_pool, shards.size(),
+              [&shards, &resolve_shard](size_t index) { resolve_shard(&shards[index]); });
+
+  for (Shard& shard : shards) {
+    for (const auto& [address, function_address] : shard.exact_address_to_function_address) {
+      if (exact_address_to_function_address_.try_emplace(address, function_address).second) {
+        function_address_to_exact_addresses_[function_address].insert(address);
+      }
+    }
 
-      std::set<uint64_t> unique_addresses;
-      for (uint64_t address : resolved_callstack->GetFrames()) {
-        unique_addresses.insert(address);
+    for (ResolvedCallstack& resolved : shard.resolved_callstacks) {
+      for (uint64_t function_address : resolved.unique_function_addresses) {
+        function_address_to_callstack_[function_address].push_back(resolved.callstack_id);
       }
 
-      for (uint64_t address : unique_addresses) {
-        thread_sample_data->address_count[address] += callstack_count;
+      CallstackID resolved_callstack_id = resolved.resolved_callstack.GetHash();
+      std::shared_ptr<CallStack>& unique_resolved_callstack =
+          unique_resolved_callstacks_[resolved_callstack_id];
+      if (unique_resolved_callstack == nullptr) {
+        unique_resolved_callstack =
+            std::make_shared<CallStack>(std::move(resolved.resolved_callstack));
       }
-    }
 
-    // sort thread addresses by count
-    for (const auto& address_count_it : thread_sample_data->address_count) {
-      const uint64_t address = address_count_it.first;
-      const uint32_t count = address_count_it.second;
-      thread_sample_data->address_count_sorted.insert(std::make_pair(count, address));
+      original_to_resolved_callstack_[resolved.callstack_id] = resolved_callstack_id;
     }
   }
-
-  FillThreadSampleDataSampleReports(capture_data);
-
-  SortByThreadUsage();
 }
 
-void SamplingProfiler::ResolveCallstacks(const CallstackData& callstack_data,
-                                         const CaptureData& capture_data) {
-  callstack_data.ForEachUniqueCallstack([this, &capture_data](const CallStack& call_stack) {
-    // A "resolved callstack" is a callstack where every address is replaced
-    // by the start address of the function (if known).
-    std::vector<uint64_t> resolved_callstack_data;
-
-    for (uint64_t address : call_stack.GetFrames()) {
-      if (exact_address_to_function_address_.find(address) ==
-          exact_address_to_function_address_.end()) {
-        MapAddressToFunctionAddress(address, capture_data);
-      }
-      uint64_t function_address = exact_address_to_function_address_.at(address);
+void SamplingProfiler::AddResolvedCounts(
+    const absl::flat_hash_map<CallstackID, uint32_t>& callstack_counts,
+    ThreadSampleData* thread_sample_data) const {
+  for (const auto& [callstack_id, count] : callstack_counts) {
+    const CallStack& resolved_callstack = GetResolvedCallstack(callstack_id);
 
-      resolved_callstack_data.push_back(function_address);
-      function_address_to_callstack_[function_address].insert(call_stack.GetHash());
+    // exclusive stat
+    thread_sample_data->exclusive_count[resolved_callstack.GetFrame(0)] += count;
+
+    for (uint64_t address : GetUniqueFrames(resolved_callstack)) {
+      thread_sample_data->address_count[address] += count;
     }
+  }
+}
+
+void SamplingProfiler::UpdateThreadSampleDataReport(const CaptureData& capture_data,
+                                                    ThreadSampleData* thread_sample_data) {
+  ComputeAverageThreadUsage(thread_sample_data);
+  // If "All" exists, set to 100% usage
+  if (thread_sample_data->thread_id == kAllThreadsFakeTid) {
+    thread_sample_data->average_thread_usage = 100.f;
+  }
+  FillThreadSampleDataSampleReport(capture_data, thread_sample_data);
+}
 
-    CallStack resolved_callstack(std::move(resolved_callstack_data));
+void SamplingProfiler::SortByThreadUsage(const std::vector<ThreadID>& updated_thread_ids) {
+  absl::flat_hash_map<ThreadID, size_t> thread_id_to_sorted_index;
+  for (size_t i = 0; i < sorted_thread_sample_data_.size(); ++i) {
+    thread_id_to_sorted_index[sorted_thread_sample_data_[i].thread_id] = i;
+  }
 
-    CallstackID resolved_callstack_id = resolved_callstack.GetHash();
-    if (unique_resolved_callstacks_.find(resolved_callstack_id) ==
-        unique_resolved_callstacks_.end()) {
-      unique_resolved_callstacks_[resolved_callstack_id] =
-          std::make_shared<CallStack>(resolved_callstack);
+  for (ThreadID thread_id : updated_thread_ids) {
+    const ThreadSampleData& data = thread_id_to_sample_data_.at(thread_id);
+    auto sorted_index_it = thread_id_to_sorted_index.find(thread_id);
+    if (sorted_index_it == thread_id_to_sorted_index.end()) {
+      sorted_thread_sample_data_.push_back(data);
+    } else {
+      sorted_thread_sample_data_[sorted_index_it->second] = data;
     }
+  }
 
-    original_to_resolved_callstack_[call_stack.GetHash()] = resolved_callstack_id;
-  });
+  sort(sorted_thread_sample_data_.begin(), sorted_thread_sample_data_.end(),
+       [](const ThreadSampleData& a, const ThreadSampleData& b) {
+         if (a.average_thread_usage != b.average_thread_usage) {
+           return a.average_thread_usage > b.average_thread_usage;
+         }
+         return a.thread_id < b.thread_id;
+       });
 }
 
 const ThreadSampleData* SamplingProfiler::GetSummary() const {
@@ -237,63 +512,3 @@ uint32_t SamplingProfiler::GetCountOfFunction(uint64_t function_address) const {
   }
   return result;
 }
-
-void SamplingProfiler::MapAddressToFunctionAddress(uint64_t absolute_address,
-                                                   const CaptureData& capture_data) {
-  const LinuxAddressInfo* address_info = capture_data.GetAddressInfo(absolute_address);
-  const FunctionInfo* function =
-      capture_data.process()->GetFunctionFromAddress(absolute_address, false);
-
-  // Find the start address of the function this address falls inside.
-  // Use the Function returned by Process::GetFunctionFromAddress, and
-  // when this fails (e.g., the module containing the function has not
-  // been loaded) use (for now) the LinuxAddressInfo that is collected
-  // for every address in a callstack. SamplingProfiler relies heavily
-  // on the association between address and function address held by
-  // exact_address_to_function_address_, otherwise each address is
-  // considered a different function.
-  uint64_t absolute_function_address;
-  if (function != nullptr) {
-    absolute_function_address = FunctionUtils::GetAbsoluteAddress(*function);
-  } else if (address_info != nullptr) {
-    absolute_function_address = absolute_address - address_info->offset_in_function();
-  } else {
-    absolute_function_address = absolute_address;
-  }
-
-  exact_address_to_function_address_[absolute_address] = absolute_function_address;
-  function_address_to_exact_addresses_[absolute_function_address].insert(absolute_address);
-}
-
-void SamplingProfiler::FillThreadSampleDataSampleReports(const CaptureData& capture_data) {
-  for (auto& data : thread_id_to_sample_data_) {
-    ThreadSampleData* thread_sample_data = &data.second;
-    std::vector<SampledFunction>* sampled_functions = &thread_sample_data->sampled_function;
-
-    for (auto sortedIt = thread_sample_data->address_count_sorted.rbegin();
-         sortedIt != thread_sample_data->address_count_sorted.rend(); ++sortedIt) {
-      uint32_t numOccurences = sortedIt->first;
-      uint64_t absolute_address = sortedIt->second;
-      float inclusive_percent = 100.f * numOccurences / thread_sample_data->samples_count;
-
-      SampledFunction function;
-      function.name = capture_data.GetFunctionNameByAddress(absolute_address);
-      function.inclusive = inclusive_percent;
-      function.exclusive = 0.f;
-      auto it = thread_sample_data->exclusive_count.find(absolute_address);
-      if (it != thread_sample_data->exclusive_count.end()) {
-        function.exclusive = 100.f * it->second / thread_sample_data->samples_count;
-      }
-      function.absolute_address = absolute_address;
-      function.module_path = capture_data.GetModulePathByAddress(absolute_address);
-
-      const FunctionInfo* function_info = capture_data.GetFunctionInfoByAddress(absolute_address);
-      if (function_info != nullptr) {
-        function.line = function_info->line();
-        function.file = function_info->file();
-      }
-
-      sampled_functions->push_back(function);
-    }
-  }
-}
@@ -7,14 +7,15 @@
 
 #include <cstdint>
 #include <cstring>
-#include <map>
 #include <memory>
-#include <set>
+#include <utility>
 #include <vector>
 
 #include "Callstack.h"
 #include "CallstackData.h"
+#include "CallstackTrie.h"
 #include "CallstackTypes.h"
+#include "OrbitBase/ThreadPool.h"
 #include "OrbitProcess.h"
 #include "absl/container/flat_hash_map.h"
 #include "absl/container/flat_hash_set.h"
@@ -43,7 +44,8 @@ struct ThreadSampleData {
   absl::flat_hash_map<uint64_t, uint32_t> address_count;
   absl::flat_hash_map<uint64_t, uint32_t> raw_address_count;
   absl::flat_hash_map<uint64_t, uint32_t> exclusive_count;
-  std::multimap<uint32_t, uint64_t> address_count_sorted;
+  // Pairs of count and address, sorted by count and then by address.
+  std::vector<std::pair<uint32_t, uint64_t>> address_count_sorted;
   uint32_t samples_count = 0;
   std::vector<SampledFunction> sampled_function;
   std::vector<float> thread_usage;
@@ -56,6 +58,10 @@ struct CallstackCount {
 
   int count = 0;
   CallstackID callstack_id = 0;
+
+  bool operator==(const CallstackCount& other) const {
+    return count == other.count && callstack_id == other.callstack_id;
+  }
 };
 
 struct SortedCallstackReport {
@@ -66,10 +72,14 @@ struct SortedCallstackReport {
 
 class SamplingProfiler {
  public:
-  explicit SamplingProfiler() = default;
+  explicit SamplingProfiler(bool generate_summary = true) : generate_summary_(generate_summary) {}
+  // The samples are processed on the calling thread and on the threads of
+  // thread_pool, if any. The same holds for ProcessNewSamples and
+  // ResolveCallstacksAgain.
   explicit SamplingProfiler(const CallstackData& callstack_data, const CaptureData& capture_data,
-                            bool generate_summary = true) {
-    ProcessSamples(callstack_data, capture_data, generate_summary);
+                            bool generate_summary = true, ThreadPool* thread_pool = nullptr)
+      : generate_summary_(generate_summary) {
+    ProcessSamples(callstack_data, capture_data, thread_pool);
   }
   SamplingProfiler& operator=(const SamplingProfiler& other) = default;
   SamplingProfiler(const SamplingProfiler& other) = default;
@@ -77,10 +87,26 @@ class SamplingProfiler {
   SamplingProfiler(SamplingProfiler&& other) = default;
   SamplingProfiler& operator=(SamplingProfiler&& other) = default;
 
+  // Counts a sample, e.g., of a capture that is still running. The sample is
+  // only part of the results after the next call to ProcessNewSamples.
+  void AddCallstackEvent(const orbit_client_protos::CallstackEvent& event);
+  // Adds the samples counted since the last call to the results. Only the new
+  // callstacks are resolved, and only the threads with new samples are sorted
+  // and reported again. The callstacks of the samples must be in
+  // callstack_data. Returns the ids of these threads.
+  std::vector<ThreadID> ProcessNewSamples(const CallstackData& callstack_data,
+                                          const CaptureData& capture_data,
+                                          ThreadPool* thread_pool = nullptr);
+  // Resolves all callstacks again from the counts of the samples, e.g., after
+  // symbols were loaded.
+  void ResolveCallstacksAgain(const CallstackData& callstack_data, const CaptureData& capture_data,
+                              ThreadPool* thread_pool = nullptr);
+
   [[nodiscard]] const CallStack& GetResolvedCallstack(CallstackID raw_callstack_id) const;
 
-  [[nodiscard]] std::multimap<int, CallstackID> GetCallstacksFromAddress(uint64_t address,
-                                                                         ThreadID thread_id) const;
+  // Sorted by decreasing count, and then by decreasing id.
+  [[nodiscard]] std::vector<CallstackCount> GetCallstacksFromAddress(uint64_t address,
+                                                                     ThreadID thread_id) const;
   [[nodiscard]] std::unique_ptr<SortedCallstackReport> GetSortedCallstacksFromAddress(
       uint64_t address, ThreadID thread_id) const;
 
@@ -96,7 +122,6 @@ class SamplingProfiler {
     return &it->second;
   }
 
-  void SortByThreadUsage();
   [[nodiscard]] const ThreadSampleData* GetSummary() const;
   [[nodiscard]] uint32_t GetCountOfFunction(uint64_t function_address) const;
 
@@ -104,16 +129,26 @@ class SamplingProfiler {
 
  private:
   void ProcessSamples(const CallstackData& callstack_data, const CaptureData& capture_data,
-                      bool generate_summary);
-  void ResolveCallstacks(const CallstackData& callstack_data, const CaptureData& capture_data);
-  void MapAddressToFunctionAddress(uint64_t absolute_address, const CaptureData& capture_data);
-  void FillThreadSampleDataSampleReports(const CaptureData& capture_data);
-
-  // Filled by ProcessSamples.
+                      ThreadPool* thread_pool);
+  // Resolves callstacks that are not resolved yet.
+  void ResolveCallstacks(const CallstackTrie& unique_callstacks,
+                         const std::vector<CallstackID>& callstack_ids,
+                         const CaptureData& capture_data, ThreadPool* thread_pool);
+  void AddResolvedCounts(const absl::flat_hash_map<CallstackID, uint32_t>& callstack_counts,
+                         ThreadSampleData* thread_sample_data) const;
+  static void UpdateThreadSampleDataReport(const CaptureData& capture_data,
+                                           ThreadSampleData* thread_sample_data);
+  void SortByThreadUsage(const std::vector<ThreadID>& updated_thread_ids);
+
+  bool generate_summary_;
+  // Filled by AddCallstackEvent, emptied by ProcessNewSamples.
+  absl::flat_hash_map<ThreadID, absl::flat_hash_map<CallstackID, uint32_t>> new_callstack_counts_;
+
+  // Filled by ProcessNewSamples.
   absl::flat_hash_map<ThreadID, ThreadSampleData> thread_id_to_sample_data_;
   absl::flat_hash_map<CallstackID, std::shared_ptr<CallStack>> unique_resolved_callstacks_;
   absl::flat_hash_map<CallstackID, CallstackID> original_to_resolved_callstack_;
-  absl::flat_hash_map<uint64_t, std::set<CallstackID>> function_address_to_callstack_;
+  absl::flat_hash_map<uint64_t, std::vector<CallstackID>> function_address_to_callstack_;
   absl::flat_hash_map<uint64_t, uint64_t> exact_address_to_function_address_;
   absl::flat_hash_map<uint64_t, absl::flat_hash_set<uint64_t>> function_address_to_exact_addresses_;
   std::vector<ThreadSampleData> sorted_thread_sample_data_;
@@ -0,0 +1,137 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// Fills a CallstackData with many synthetic samples and creates a
+// SamplingProfiler from them with 1, 2, 4, ... up to --max_threads threads.
+// Reports the time and the samples per second for each thread count.
+
+#include <OrbitBase/Logging.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "Callstack.h"
+#include "CallstackData.h"
+#include "CaptureData.h"
+#include "OrbitBase/ThreadPool.h"
+#include "SamplingProfiler.h"
+#include "absl/flags/flag.h"
+#include "absl/flags/parse.h"
+#include "capture_data.pb.h"
+
+ABSL_FLAG(uint64_t, samples, 20'000'000, "Number of samples in the capture");
+ABSL_FLAG(uint32_t, callstacks, 100'000, "Number of unique callstacks");
+ABSL_FLAG(uint32_t, sampled_threads, 64, "Number of threads the samples are from");
+ABSL_FLAG(uint32_t, max_threads, std::max(1u, std::thread::hardware_concurrency()),
+          "Maximum number of threads to create the SamplingProfiler with");
+
+namespace {
+
+using orbit_client_protos::CallstackEvent;
+using orbit_client_protos::LinuxAddressInfo;
+
+constexpr uint64_t kFirstFunctionAddress = 0x7f0000000000;
+constexpr uint64_t kFunctionCount = 20'000;
+constexpr uint64_t kFunctionSize = 0x400;
+constexpr uint64_t kAddressesPerFunction = 16;
+
+uint64_t Random(uint64_t index) {
+  uint64_t random = index * 0x9e3779b97f4a7c15;
+  return random ^ (random >> 29);
+}
+
+uint64_t GetAddress(uint64_t random) {
+  uint64_t function_index = random % kFunctionCount;
+  uint64_t address_index = (random >> 20) % kAddressesPerFunction;
+  return kFirstFunctionAddress + function_index * kFunctionSize + address_index * 0x10;
+}
+
+// Callstacks of 4 to 35 frames, with the functions close to the root shared
+// by many callstacks as in real programs.
+void AddCallstacks(uint32_t callstack_count, CaptureData* capture_data,
+                   std::vector<CallstackID>* callstack_ids) {
+  for (uint32_t i = 0; i < callstack_count; ++i) {
+    uint64_t random = Random(i);
+    size_t depth = 4 + random % 32;
+    std::vector<uint64_t> frames(depth);
+    for (size_t j = 0; j < depth; ++j) {
+      uint64_t frame_random = Random(j < depth / 2 ? i * 64 + j : j);
+      frames[j] = GetAddress(frame_random);
+    }
+    CallStack callstack(std::move(frames));
+    callstack_ids->push_back(callstack.GetHash());
+    capture_data->AddUniqueCallStack(std::move(callstack));
+  }
+
+  for (uint64_t function_index = 0; function_index < kFunctionCount; ++function_index) {
+    for (uint64_t address_index = 0; address_index < kAddressesPerFunction; ++address_index) {
+      LinuxAddressInfo address_info;
+      uint64_t offset = address_index * 0x10;
+      address_info.set_absolute_address(kFirstFunctionAddress + function_index * kFunctionSize +
+                                        offset);
+      address_info.set_offset_in_function(offset);
+      capture_data->InsertAddressInfo(std::move(address_info));
+    }
+  }
+}
+
+void AddSamples(uint64_t sample_count, uint32_t thread_count,
+                const std::vector<CallstackID>& callstack_ids, CaptureData* capture_data) {
+  for (uint64_t i = 0; i < sample_count; ++i) {
+    uint64_t random = Random(i);
+    CallstackEvent event;
+    event.set_time(1'000'000'000 + i * 1000);
+    event.set_thread_id(static_cast<int32_t>(100 + random % thread_count));
+    // Few callstacks are sampled often.
+    uint64_t callstack_index = (random >> 16) % callstack_ids.size();
+    callstack_index = callstack_index * callstack_index / callstack_ids.size();
+    event.set_callstack_hash(callstack_ids[callstack_index]);
+    capture_data->AddCallstackEvent(std::move(event));
+  }
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  absl::ParseCommandLine(argc, argv);
+  uint64_t sample_count = absl::GetFlag(FLAGS_samples);
+  uint32_t callstack_count = absl::GetFlag(FLAGS_callstacks);
+  uint32_t sampled_thread_count = absl::GetFlag(FLAGS_sampled_threads);
+  uint32_t max_thread_count = absl::GetFlag(FLAGS_max_threads);
+  FAIL_IF(callstack_count == 0 || sampled_thread_count == 0, "Invalid flags");
+
+  CaptureData capture_data;
+  std::vector<CallstackID> callstack_ids;
+  AddCallstacks(callstack_count, &capture_data, &callstack_ids);
+  AddSamples(sample_count, sampled_thread_count, callstack_ids, &capture_data);
+  printf("%lu samples of %u callstacks from %u threads\n", sample_count, callstack_count,
+         sampled_thread_count);
+
+  for (uint32_t thread_count = 1; thread_count <= max_thread_count; thread_count *= 2) {
+    std::unique_ptr<ThreadPool> thread_pool;
+    if (thread_count > 1) {
+      thread_pool = ThreadPool::Create(thread_count - 1, thread_count - 1, absl::Seconds(1));
+    }
+
+    auto begin = std::chrono::steady_clock::now();
+    SamplingProfiler sampling_profiler(*capture_data.GetCallstackData(), capture_data, true,
+                                       thread_pool.get());
+    double duration_s =
+        std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+    FAIL_IF(sampling_profiler.GetSummary() == nullptr ||
+                sampling_profiler.GetSummary()->samples_count != sample_count,
+            "Not all samples were processed");
+    printf("%u threads: %.2f s, %.0f samples/s\n", thread_count, duration_s,
+           sample_count / duration_s);
+
+    if (thread_pool != nullptr) {
+      thread_pool->ShutdownAndWait();
+    }
+  }
+  return 0;
+}
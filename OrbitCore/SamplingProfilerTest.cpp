@@ -0,0 +1,228 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <memory>
+#include <random>
+#include <vector>
+
+#include "Callstack.h"
+#include "CallstackData.h"
+#include "CaptureData.h"
+#include "OrbitBase/ThreadPool.h"
+#include "SamplingProfiler.h"
+#include "capture_data.pb.h"
+
+using orbit_client_protos::CallstackEvent;
+using orbit_client_protos::LinuxAddressInfo;
+
+namespace {
+
+constexpr uint64_t kFirstFunctionAddress = 0x10000;
+constexpr uint64_t kFunctionSize = 0x100;
+constexpr uint64_t kFunctionCount = 20;
+constexpr uint64_t kAddressesPerFunction = 4;
+constexpr size_t kCallstackCount = 60;
+constexpr size_t kEventCount = 10000;
+constexpr int32_t kThreadCount = 6;
+
+uint64_t GetAddress(uint64_t function_index, uint64_t address_index) {
+  return kFirstFunctionAddress + function_index * kFunctionSize + address_index * 0x10;
+}
+
+void InsertAddressInfos(CaptureData* capture_data) {
+  for (uint64_t function_index = 0; function_index < kFunctionCount; ++function_index) {
+    for (uint64_t address_index = 0; address_index < kAddressesPerFunction; ++address_index) {
+      LinuxAddressInfo address_info;
+      address_info.set_absolute_address(GetAddress(function_index, address_index));
+      address_info.set_offset_in_function(address_index * 0x10);
+      address_info.set_function_name("function" + std::to_string(function_index));
+      capture_data->InsertAddressInfo(address_info);
+    }
+  }
+}
+
+std::vector<CallStack> CreateCallstacks(std::mt19937* random) {
+  std::uniform_int_distribution<uint64_t> function_distribution(0, kFunctionCount - 1);
+  std::uniform_int_distribution<uint64_t> address_distribution(0, kAddressesPerFunction - 1);
+  std::uniform_int_distribution<size_t> depth_distribution(1, 8);
+  std::vector<CallStack> callstacks;
+  for (size_t i = 0; i < kCallstackCount; ++i) {
+    std::vector<uint64_t> frames;
+    size_t depth = depth_distribution(*random);
+    for (size_t j = 0; j < depth; ++j) {
+      frames.push_back(GetAddress(function_distribution(*random), address_distribution(*random)));
+    }
+    callstacks.emplace_back(std::move(frames));
+  }
+  return callstacks;
+}
+
+std::vector<CallstackEvent> CreateCallstackEvents(const std::vector<CallStack>& callstacks,
+                                                  std::mt19937* random) {
+  std::uniform_int_distribution<size_t> callstack_distribution(0, callstacks.size() - 1);
+  std::uniform_int_distribution<int32_t> thread_distribution(1, kThreadCount);
+  std::vector<CallstackEvent> events;
+  for (size_t i = 0; i < kEventCount; ++i) {
+    CallstackEvent event;
+    event.set_time(1000 + i);
+    event.set_thread_id(thread_distribution(*random));
+    event.set_callstack_hash(callstacks[callstack_distribution(*random)].GetHash());
+    events.push_back(event);
+  }
+  return events;
+}
+
+void ExpectSameThreadSampleData(const ThreadSampleData& actual, const ThreadSampleData& expected) {
+  EXPECT_EQ(actual.thread_id, expected.thread_id);
+  EXPECT_EQ(actual.samples_count, expected.samples_count);
+  EXPECT_EQ(actual.callstack_count, expected.callstack_count);
+  EXPECT_EQ(actual.address_count, expected.address_count);
+  EXPECT_EQ(actual.raw_address_count, expected.raw_address_count);
+  EXPECT_EQ(actual.exclusive_count, expected.exclusive_count);
+  EXPECT_EQ(actual.address_count_sorted, expected.address_count_sorted);
+  EXPECT_EQ(actual.average_thread_usage, expected.average_thread_usage);
+  ASSERT_EQ(actual.sampled_function.size(), expected.sampled_function.size());
+  for (size_t i = 0; i < actual.sampled_function.size(); ++i) {
+    const SampledFunction& actual_function = actual.sampled_function[i];
+    const SampledFunction& expected_function = expected.sampled_function[i];
+    EXPECT_EQ(actual_function.name, expected_function.name);
+    EXPECT_EQ(actual_function.absolute_address, expected_function.absolute_address);
+    EXPECT_EQ(actual_function.inclusive, expected_function.inclusive);
+    EXPECT_EQ(actual_function.exclusive, expected_function.exclusive);
+  }
+}
+
+void ExpectSameResults(const SamplingProfiler& actual, const SamplingProfiler& expected,
+                       const std::vector<CallStack>& callstacks) {
+  const std::vector<ThreadSampleData>& actual_data = actual.GetThreadSampleData();
+  const std::vector<ThreadSampleData>& expected_data = expected.GetThreadSampleData();
+  ASSERT_EQ(actual_data.size(), expected_data.size());
+  for (size_t i = 0; i < actual_data.size(); ++i) {
+    ExpectSameThreadSampleData(actual_data[i], expected_data[i]);
+    const ThreadSampleData* by_thread_id =
+        actual.GetThreadSampleDataByThreadId(actual_data[i].thread_id);
+    ASSERT_NE(by_thread_id, nullptr);
+    ExpectSameThreadSampleData(*by_thread_id, expected_data[i]);
+  }
+
+  const ThreadSampleData* summary = expected.GetSummary();
+  ASSERT_NE(summary, nullptr);
+  for (const CallStack& callstack : callstacks) {
+    if (!summary->callstack_count.contains(callstack.GetHash())) continue;
+    EXPECT_EQ(actual.GetResolvedCallstack(callstack.GetHash()).GetFrames(),
+              expected.GetResolvedCallstack(callstack.GetHash()).GetFrames());
+  }
+  for (uint64_t function_index = 0; function_index < kFunctionCount; ++function_index) {
+    uint64_t function_address = GetAddress(function_index, 0);
+    EXPECT_EQ(actual.GetCountOfFunction(function_address),
+              expected.GetCountOfFunction(function_address));
+    for (int32_t thread_id = SamplingProfiler::kAllThreadsFakeTid; thread_id <= kThreadCount;
+         ++thread_id) {
+      EXPECT_EQ(actual.GetCallstacksFromAddress(function_address, thread_id),
+                expected.GetCallstacksFromAddress(function_address, thread_id));
+    }
+  }
+}
+
+}  // namespace
+
+TEST(SamplingProfiler, NewSamplesAreOnlyReportedWhenProcessed) {
+  std::mt19937 random(1);
+  std::vector<CallStack> callstacks = CreateCallstacks(&random);
+  CaptureData capture_data;
+  InsertAddressInfos(&capture_data);
+  for (const CallStack& callstack : callstacks) capture_data.AddUniqueCallStack(callstack);
+
+  SamplingProfiler sampling_profiler;
+  CallstackEvent event;
+  event.set_time(1000);
+  event.set_thread_id(42);
+  event.set_callstack_hash(callstacks[0].GetHash());
+  capture_data.AddCallstackEvent(event);
+  sampling_profiler.AddCallstackEvent(event);
+  EXPECT_TRUE(sampling_profiler.GetThreadSampleData().empty());
+  EXPECT_EQ(sampling_profiler.GetSummary(), nullptr);
+
+  std::vector<ThreadID> updated_thread_ids =
+      sampling_profiler.ProcessNewSamples(*capture_data.GetCallstackData(), capture_data);
+  EXPECT_EQ(updated_thread_ids, (std::vector<ThreadID>{SamplingProfiler::kAllThreadsFakeTid, 42}));
+  ASSERT_EQ(sampling_profiler.GetThreadSampleData().size(), 2);
+  ASSERT_NE(sampling_profiler.GetSummary(), nullptr);
+  EXPECT_EQ(sampling_profiler.GetSummary()->samples_count, 1);
+  ASSERT_NE(sampling_profiler.GetThreadSampleDataByThreadId(42), nullptr);
+  EXPECT_EQ(sampling_profiler.GetThreadSampleDataByThreadId(42)->samples_count, 1);
+
+  event.set_time(2000);
+  event.set_thread_id(43);
+  capture_data.AddCallstackEvent(event);
+  sampling_profiler.AddCallstackEvent(event);
+  updated_thread_ids =
+      sampling_profiler.ProcessNewSamples(*capture_data.GetCallstackData(), capture_data);
+  EXPECT_EQ(updated_thread_ids, (std::vector<ThreadID>{SamplingProfiler::kAllThreadsFakeTid, 43}));
+  EXPECT_EQ(sampling_profiler.GetThreadSampleDataByThreadId(42)->samples_count, 1);
+}
+
+TEST(SamplingProfiler, ProcessingNewSamplesIncrementallyEqualsProcessingAllSamples) {
+  std::mt19937 random(2);
+  std::vector<CallStack> callstacks = CreateCallstacks(&random);
+  std::vector<CallstackEvent> events = CreateCallstackEvents(callstacks, &random);
+  CaptureData capture_data;
+  InsertAddressInfos(&capture_data);
+  for (const CallStack& callstack : callstacks) capture_data.AddUniqueCallStack(callstack);
+
+  SamplingProfiler sampling_profiler;
+  for (size_t i = 0; i < events.size(); ++i) {
+    capture_data.AddCallstackEvent(events[i]);
+    sampling_profiler.AddCallstackEvent(events[i]);
+    if (i % 777 == 0) {
+      sampling_profiler.ProcessNewSamples(*capture_data.GetCallstackData(), capture_data);
+    }
+  }
+  sampling_profiler.ProcessNewSamples(*capture_data.GetCallstackData(), capture_data);
+
+  SamplingProfiler expected(*capture_data.GetCallstackData(), capture_data);
+  ExpectSameResults(sampling_profiler, expected, callstacks);
+}
+
+TEST(SamplingProfiler, ResolvingCallstacksAgainEqualsProcessingAllSamples) {
+  std::mt19937 random(3);
+  std::vector<CallStack> callstacks = CreateCallstacks(&random);
+  std::vector<CallstackEvent> events = CreateCallstackEvents(callstacks, &random);
+  CaptureData capture_data;
+  for (const CallStack& callstack : callstacks) capture_data.AddUniqueCallStack(callstack);
+  for (const CallstackEvent& event : events) capture_data.AddCallstackEvent(event);
+
+  SamplingProfiler sampling_profiler(*capture_data.GetCallstackData(), capture_data);
+  InsertAddressInfos(&capture_data);
+  sampling_profiler.ResolveCallstacksAgain(*capture_data.GetCallstackData(), capture_data);
+
+  SamplingProfiler expected(*capture_data.GetCallstackData(), capture_data);
+  ExpectSameResults(sampling_profiler, expected, callstacks);
+}
+
+TEST(SamplingProfiler, ProcessingOnAThreadPoolEqualsProcessingOnTheCallingThread) {
+  std::mt19937 random(4);
+  std::vector<CallStack> callstacks = CreateCallstacks(&random);
+  std::vector<CallstackEvent> events = CreateCallstackEvents(callstacks, &random);
+  CaptureData capture_data;
+  for (const CallStack& callstack : callstacks) capture_data.AddUniqueCallStack(callstack);
+  for (const CallstackEvent& event : events) capture_data.AddCallstackEvent(event);
+  std::unique_ptr<ThreadPool> thread_pool = ThreadPool::Create(4, 4, absl::Seconds(1));
+
+  SamplingProfiler sampling_profiler(*capture_data.GetCallstackData(), capture_data, true,
+                                     thread_pool.get());
+  SamplingProfiler expected(*capture_data.GetCallstackData(), capture_data);
+  ExpectSameResults(sampling_profiler, expected, callstacks);
+
+  InsertAddressInfos(&capture_data);
+  sampling_profiler.ResolveCallstacksAgain(*capture_data.GetCallstackData(), capture_data,
+                                           thread_pool.get());
+  SamplingProfiler expected_resolved_again(*capture_data.GetCallstackData(), capture_data);
+  ExpectSameResults(sampling_profiler, expected_resolved_again, callstacks);
+
+  thread_pool->ShutdownAndWait();
+}
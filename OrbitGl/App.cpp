@@ -47,6 +47,9 @@ ABSL_DECLARE_FLAG(bool, devmode);
 ABSL_DECLARE_FLAG(bool, local);
 ABSL_FLAG(bool, enable_tracepoint_feature, false,
           "Enable the setting of the panel of kernel tracepoints");
+ABSL_FLAG(bool, compress_captures, false,
+          "Compress the captures that are saved; they are about three times smaller, but take "
+          "longer to save");
 
 using orbit_client_protos::CallstackEvent;
 using orbit_client_protos::FunctionInfo;
@@ -62,6 +65,8 @@ using orbit_grpc_protos::ProcessInfo;
 using orbit_grpc_protos::TracepointInfo;
 
 namespace {
+constexpr absl::Duration kLiveSamplingReportInterval = absl::Seconds(1);
+
 PresetLoadState GetPresetLoadStateForProcess(
     const std::shared_ptr<orbit_client_protos::PresetFile>& preset,
     const std::shared_ptr<Process>& process) {
@@ -130,6 +135,8 @@ void OrbitApp::OnCaptureStarted(int32_t process_id, std::string process_name,
         // this task is completely executed.
         capture_data_ = CaptureData(process_id, std::move(process_name), std::move(process),
                                     std::move(selected_functions), std::move(selected_tracepoints));
+        live_sampling_profiler_ =
+            std::make_shared<SharedSamplingProfiler>(capture_data_.GetCallstackData());
 
         CHECK(capture_started_callback_);
         capture_started_callback_();
@@ -150,14 +157,20 @@ void OrbitApp::OnCaptureStarted(int32_t process_id, std::string process_name,
 }
 
 void OrbitApp::OnCaptureComplete() {
-  SamplingProfiler sampling_profiler(*capture_data_.GetCallstackData(), capture_data_);
+  ProcessNewLiveSamples();
+  SamplingProfiler sampling_profiler;
+  {
+    // The live report reads the profiler until it is replaced by this one.
+    absl::MutexLock lock(&live_sampling_profiler_->mutex);
+    sampling_profiler = std::move(live_sampling_profiler_->profiler);
+  }
   capture_data_.set_sampling_profiler(sampling_profiler);
   main_thread_executor_->Schedule(
       [this, sampling_profiler = std::move(sampling_profiler)]() mutable {
         RefreshCaptureView();
 
         SetSamplingReport(std::move(sampling_profiler),
-                          GetCaptureData().GetCallstackData()->GetUniqueCallstacksCopy());
+                          GetCaptureData().GetCallstackData()->GetUniqueCallstacks());
         SetTopDownView(GetCaptureData());
 
         CHECK(capture_stopped_callback_);
@@ -216,7 +229,57 @@ void OrbitApp::OnUniqueCallStack(CallStack callstack) {
 }
 
 void OrbitApp::OnCallstackEvent(CallstackEvent callstack_event) {
+  {
+    absl::MutexLock lock(&live_sampling_profiler_->mutex);
+    live_sampling_profiler_->profiler.AddCallstackEvent(callstack_event);
+  }
   capture_data_.AddCallstackEvent(std::move(callstack_event));
+
+  absl::Time now = absl::Now();
+  if (now - last_live_sampling_report_time_ >= kLiveSamplingReportInterval) {
+    last_live_sampling_report_time_ = now;
+    UpdateLiveSamplingReport();
+  }
+}
+
+std::vector<ThreadID> OrbitApp::ProcessNewLiveSamples() {
+  // This runs on the capture thread, which is the one that writes the address
+  // infos the callstacks are resolved with.
+  absl::MutexLock lock(&live_sampling_profiler_->mutex);
+  SamplingProfiler* sampling_profiler = &live_sampling_profiler_->profiler;
+  if (resolve_live_sampling_callstacks_again_.exchange(false)) {
+    sampling_profiler->ResolveCallstacksAgain(*capture_data_.GetCallstackData(), capture_data_,
+                                              thread_pool_.get());
+    sampling_profiler->ProcessNewSamples(*capture_data_.GetCallstackData(), capture_data_,
+                                         thread_pool_.get());
+    std::vector<ThreadID> thread_ids;
+    for (const ThreadSampleData& thread_sample_data : sampling_profiler->GetThreadSampleData()) {
+      thread_ids.push_back(thread_sample_data.thread_id);
+    }
+    return thread_ids;
+  }
+  return sampling_profiler->ProcessNewSamples(*capture_data_.GetCallstackData(), capture_data_,
+                                              thread_pool_.get());
+}
+
+void OrbitApp::UpdateLiveSamplingReport() {
+  std::vector<ThreadID> updated_thread_ids = ProcessNewLiveSamples();
+  main_thread_executor_->Schedule([this, shared_profiler = live_sampling_profiler_,
+                                   updated_thread_ids = std::move(updated_thread_ids)]() mutable {
+    size_t thread_count;
+    {
+      absl::MutexLock lock(&shared_profiler->mutex);
+      thread_count = shared_profiler->profiler.GetThreadSampleData().size();
+    }
+    if (sampling_report_ != nullptr && thread_count == live_sampling_report_thread_count_) {
+      sampling_report_->UpdateReport(updated_thread_ids);
+    } else {
+      // The report only has a tab per thread it was created with.
+      live_sampling_report_thread_count_ = thread_count;
+      SetSamplingReport(std::make_shared<SamplingReport>(std::move(shared_profiler)));
+    }
+    FireRefreshCallbacks();
+  });
 }
 
 void OrbitApp::OnThreadName(int32_t thread_id, std::string thread_name) {
@@ -492,9 +555,12 @@ void OrbitApp::NeedsRedraw() {
 
 void OrbitApp::SetSamplingReport(
     SamplingProfiler sampling_profiler,
-    absl::flat_hash_map<CallstackID, std::shared_ptr<CallStack>> unique_callstacks) {
-  auto report =
-      std::make_shared<SamplingReport>(std::move(sampling_profiler), std::move(unique_callstacks));
+    std::shared_ptr<const CallstackTrie> unique_callstacks) {
+  SetSamplingReport(
+      std::make_shared<SamplingReport>(std::move(sampling_profiler), std::move(unique_callstacks)));
+}
+
+void OrbitApp::SetSamplingReport(std::shared_ptr<SamplingReport> report) {
   CHECK(sampling_reports_callback_);
   DataView* callstack_data_view = GetOrCreateDataView(DataViewType::kCallstack);
   sampling_reports_callback_(callstack_data_view, report);
@@ -508,7 +574,7 @@ void OrbitApp::SetSamplingReport(
 
 void OrbitApp::SetSelectionReport(
     SamplingProfiler sampling_profiler,
-    absl::flat_hash_map<CallstackID, std::shared_ptr<CallStack>> unique_callstacks,
+    std::shared_ptr<const CallstackTrie> unique_callstacks,
     bool has_summary) {
   CHECK(selection_report_callback_);
   auto report = std::make_shared<SamplingReport>(std::move(sampling_profiler),
@@ -648,8 +714,11 @@ ErrorMessageOr<void> OrbitApp::OnSaveCapture(const std::string& file_name) {
   TimerInfosIterator timers_it_begin(chains.begin(), chains.end());
   TimerInfosIterator timers_it_end(chains.end(), chains.end());
 
+  capture_serializer::ChunkCompression compression =
+      absl::GetFlag(FLAGS_compress_captures) ? capture_serializer::ChunkCompression::kZlib
+                                             : capture_serializer::ChunkCompression::kNone;
   return capture_serializer::Save(file_name, GetCaptureData(), key_to_string_map, timers_it_begin,
-                                  timers_it_end);
+                                  timers_it_end, compression);
 }
 
 void OrbitApp::OnLoadCapture(const std::string& file_name) {
@@ -729,6 +798,11 @@ void OrbitApp::StopCapture() {
 
 void OrbitApp::ClearCapture() {
   capture_data_ = CaptureData();
+  live_sampling_profiler_ =
+      std::make_shared<SharedSamplingProfiler>(capture_data_.GetCallstackData());
+  last_live_sampling_report_time_ = absl::InfinitePast();
+  resolve_live_sampling_callstacks_again_ = false;
+  live_sampling_report_thread_count_ = 0;
   set_selected_thread_id(-1);
   SelectTextBox(nullptr);
 
@@ -1134,22 +1208,30 @@ void OrbitApp::SelectCallstackEvents(const std::vector<CallstackEvent>& selected
   // Generate selection report.
   bool generate_summary = thread_id == SamplingProfiler::kAllThreadsFakeTid;
   SamplingProfiler sampling_profiler(*capture_data_.GetSelectionCallstackData(), GetCaptureData(),
-                                     generate_summary);
+                                     generate_summary, thread_pool_.get());
 
   SetSelectionTopDownView(sampling_profiler, GetCaptureData());
 
   SetSelectionReport(std::move(sampling_profiler),
-                     capture_data_.GetSelectionCallstackData()->GetUniqueCallstacksCopy(),
+                     capture_data_.GetSelectionCallstackData()->GetUniqueCallstacks(),
                      generate_summary);
 }
 
 void OrbitApp::UpdateAfterSymbolLoading() {
   const CaptureData& capture_data = GetCaptureData();
 
-  if (sampling_report_ != nullptr) {
-    SamplingProfiler sampling_profiler(*capture_data.GetCallstackData(), capture_data);
+  if (IsCapturing()) {
+    // The capture thread owns the live profiler, the next live update resolves
+    // its callstacks again.
+    resolve_live_sampling_callstacks_again_ = true;
+  } else if (sampling_report_ != nullptr) {
+    // The samples were already counted, only their callstacks need to be
+    // resolved again with the new symbols.
+    SamplingProfiler sampling_profiler = capture_data.sampling_profiler();
+    sampling_profiler.ResolveCallstacksAgain(*capture_data.GetCallstackData(), capture_data,
+                                             thread_pool_.get());
     sampling_report_->UpdateReport(sampling_profiler,
-                                   capture_data.GetCallstackData()->GetUniqueCallstacksCopy());
+                                   capture_data.GetCallstackData()->GetUniqueCallstacks());
     capture_data_.set_sampling_profiler(sampling_profiler);
   }
 
@@ -1161,17 +1243,17 @@ void OrbitApp::UpdateAfterSymbolLoading() {
 
   // TODO(kuebler): propagate this information
   SamplingProfiler selection_profiler(*capture_data.GetSelectionCallstackData(), capture_data,
-                                      selection_report_->has_summary());
+                                      selection_report_->has_summary(), thread_pool_.get());
 
   SetSelectionTopDownView(selection_profiler, GetCaptureData());
   selection_report_->UpdateReport(
       std::move(selection_profiler),
-      capture_data.GetSelectionCallstackData()->GetUniqueCallstacksCopy());
+      capture_data.GetSelectionCallstackData()->GetUniqueCallstacks());
 }
 
 void OrbitApp::UpdateAfterCaptureCleared() {
   SamplingProfiler empty_profiler;
-  absl::flat_hash_map<CallstackID, std::shared_ptr<CallStack>> empty_unique_callstacks;
+  auto empty_unique_callstacks = std::make_shared<const CallstackTrie>();
 
   SetSamplingReport(empty_profiler, empty_unique_callstacks);
   SetTopDownView(GetCaptureData());
@@ -12,11 +12,13 @@
 #include <queue>
 #include <string>
 #include <utility>
+#include <vector>
 
 #include "ApplicationOptions.h"
 #include "CallStackDataView.h"
 #include "Callstack.h"
 #include "CallstackData.h"
+#include "CallstackTrie.h"
 #include "CaptureWindow.h"
 #include "DataManager.h"
 #include "DataView.h"
@@ -52,6 +54,7 @@
 #include "absl/container/flat_hash_map.h"
 #include "absl/container/flat_hash_set.h"
 #include "absl/flags/flag.h"
+#include "absl/time/time.h"
 #include "capture_data.pb.h"
 #include "grpcpp/grpcpp.h"
 #include "preset.pb.h"
@@ -118,10 +121,11 @@ class OrbitApp final : public DataViewFactory, public CaptureListener {
 
   void SetSamplingReport(
       SamplingProfiler sampling_profiler,
-      absl::flat_hash_map<CallstackID, std::shared_ptr<CallStack>> unique_callstacks);
+      std::shared_ptr<const CallstackTrie> unique_callstacks);
+  void SetSamplingReport(std::shared_ptr<SamplingReport> report);
   void SetSelectionReport(
       SamplingProfiler sampling_profiler,
-      absl::flat_hash_map<CallstackID, std::shared_ptr<CallStack>> unique_callstacks,
+      std::shared_ptr<const CallstackTrie> unique_callstacks,
       bool has_summary);
   void SetTopDownView(const CaptureData& capture_data);
   void SetSelectionTopDownView(const SamplingProfiler& selection_sampling_profiler,
@@ -305,6 +309,10 @@ class OrbitApp final : public DataViewFactory, public CaptureListener {
   GetSelectedFunctionsAndOrbitFunctions() const;
   ErrorMessageOr<void> SavePreset(const std::string& filename);
   [[nodiscard]] ScopedStatus CreateScopedStatus(const std::string& initial_message);
+  // Called on the capture thread. Returns the ids of the threads whose samples
+  // changed.
+  std::vector<ThreadID> ProcessNewLiveSamples();
+  void UpdateLiveSamplingReport();
 
   ApplicationOptions options_;
 
@@ -377,6 +385,18 @@ class OrbitApp final : public DataViewFactory, public CaptureListener {
   //  CaptureListener parts of App, but may be read also during capturing by all threads.
   //  Currently, it is not properly synchronized (and thus it can't live at DataManager).
   CaptureData capture_data_;
+
+  // Counts the samples of the running capture on the capture thread, so that
+  // the sampling report can be updated during the capture and is complete as
+  // soon as the capture is. The live sampling report reads from it, instead of
+  // getting a copy of it at every update.
+  std::shared_ptr<SharedSamplingProfiler> live_sampling_profiler_ =
+      std::make_shared<SharedSamplingProfiler>(capture_data_.GetCallstackData());
+  absl::Time last_live_sampling_report_time_ = absl::InfinitePast();
+  // Set when symbols were loaded during the capture.
+  std::atomic<bool> resolve_live_sampling_callstacks_again_ = false;
+  // Main thread only.
+  size_t live_sampling_report_thread_count_ = 0;
 };
 
 extern std::unique_ptr<OrbitApp> GOrbitApp;
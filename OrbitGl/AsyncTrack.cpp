@@ -28,7 +28,7 @@ AsyncTrack::AsyncTrack(TimeGraph* time_graph, const std::string& name) : TimerTr
   // The FunctionInfo here corresponds to one of the automatically instrumented empty stubs from
   // Orbit.h. Use it to retrieve the module from which the manually instrumented scope originated.
   const FunctionInfo* func =
-      GOrbitApp->GetCaptureData().GetSelectedFunction(text_box->GetTimerInfo().function_address());
+      GOrbitApp->GetCaptureData().GetSelectedFunction(text_box->GetTimerFunctionAddress());
   std::string module_name = FunctionUtils::GetLoadedModuleName(*func);
   std::string function_name = manual_inst_manager->GetString(event.id);
 
@@ -39,8 +39,7 @@ AsyncTrack::AsyncTrack(TimeGraph* time_graph, const std::string& name) : TimerTr
       "<b>Module:</b> %s<br/>"
       "<b>Time:</b> %s",
       function_name, module_name,
-      GetPrettyTime(
-          TicksToDuration(text_box->GetTimerInfo().start(), text_box->GetTimerInfo().end())));
+      GetPrettyTime(TicksToDuration(text_box->GetTimerStart(), text_box->GetTimerEnd())));
 }
 
 void AsyncTrack::UpdateBoxHeight() {
@@ -63,24 +62,22 @@ void AsyncTrack::OnTimer(const orbit_client_protos::TimerInfo& timer_info) {
 }
 
 void AsyncTrack::SetTimesliceText(const TimerInfo& timer_info, double elapsed_us, float min_x,
-                                  TextBox* text_box) {
+                                  TextBox* text_box, PrimitiveBatch* batch) {
   TimeGraphLayout layout = time_graph_->GetLayout();
   std::string time = GetPrettyTime(absl::Microseconds(elapsed_us));
-  text_box->SetElapsedTimeTextLength(time.length());
 
   orbit_api::Event event = ManualInstrumentationManager::ApiEventFromTimerInfo(timer_info);
   std::string name = GOrbitApp->GetManualInstrumentationManager()->GetString(event.id);
   std::string text = absl::StrFormat("%s %s", name, time.c_str());
-  text_box->SetText(text);
 
   const Color kTextWhite(255, 255, 255, 255);
   const Vec2& box_pos = text_box->GetPos();
   const Vec2& box_size = text_box->GetSize();
   float pos_x = std::max(box_pos[0], min_x);
   float max_size = box_pos[0] + box_size[0] - pos_x;
-  text_renderer_->AddTextTrailingCharsPrioritized(
-      text_box->GetText().c_str(), pos_x, text_box->GetPos()[1] + layout.GetTextOffset(),
-      GlCanvas::kZValueText, kTextWhite, text_box->GetElapsedTimeTextLength(), max_size);
+  batch->AddTextTrailingCharsPrioritized(
+      std::move(text), pos_x, text_box->GetPos()[1] + layout.GetTextOffset(),
+      GlCanvas::kZValueText, kTextWhite, time.length(), max_size);
 }
 
 Color AsyncTrack::GetTimerColor(const TimerInfo& timer_info, bool is_selected) const {
@@ -4,14 +4,47 @@
 
 #include "Batcher.h"
 
+#include <vector>
+
+#include "GpuUploadPlanner.h"
 #include "OpenGl.h"
 #include "Utils.h"
+#include "absl/base/casts.h"
+
+namespace {
+
+template <typename T, uint32_t BlockSize>
+void AppendRange(const BlockChain<T, BlockSize>& from, uint32_t begin, uint32_t end,
+                 BlockChain<T, BlockSize>* to) {
+  from.ForEachInRange(begin, end, [to](const T& element) { to->push_back(element); });
+}
+
+// Picking colors of elements picked by their user data encode the index of the
+// user data, which changes when the elements move to another Batcher.
+template <uint32_t BlockSize>
+void AppendPickingColorRange(const BlockChain<Color, BlockSize>& from, uint32_t begin,
+                             uint32_t end, uint32_t from_first_user_data,
+                             uint32_t to_first_user_data, BlockChain<Color, BlockSize>* to) {
+  from.ForEachInRange(begin, end, [&](const Color& color) {
+    std::array<uint8_t, 4> color_values{color[0], color[1], color[2], color[3]};
+    PickingId id = PickingId::FromPixelValue(absl::bit_cast<uint32_t>(color_values));
+    if (id.type == PickingType::kPickable) {
+      to->push_back(color);
+      return;
+    }
+    to->push_back(PickingId::ToColor(id.type,
+                                     id.element_id - from_first_user_data + to_first_user_data,
+                                     id.batcher_id));
+  });
+}
+
+}  // namespace
 
 void Batcher::AddLine(Vec2 from, Vec2 to, float z, const Color& color,
-                      std::unique_ptr<PickingUserData> user_data) {
+                      const PickingUserData& user_data) {
   Color picking_color = PickingId::ToColor(PickingType::kLine, user_data_.size(), batcher_id_);
 
-  AddLine(from, to, z, color, picking_color, std::move(user_data));
+  AddLine(from, to, z, color, picking_color, user_data);
 }
 
 void Batcher::AddLine(Vec2 from, Vec2 to, float z, const Color& color,
@@ -20,16 +53,16 @@ void Batcher::AddLine(Vec2 from, Vec2 to, float z, const Color& color,
 
   Color picking_color = picking_manager_->GetPickableColor(pickable, batcher_id_);
 
-  AddLine(from, to, z, color, picking_color, nullptr);
+  AddLine(from, to, z, color, picking_color, PickingUserData());
 }
 
 void Batcher::AddVerticalLine(Vec2 pos, float size, float z, const Color& color,
-                              std::unique_ptr<PickingUserData> user_data) {
-  AddLine(pos, pos + Vec2(0, size), z, color, std::move(user_data));
+                              const PickingUserData& user_data) {
+  AddLine(pos, pos + Vec2(0, size), z, color, user_data);
 }
 
 void Batcher::AddLine(Vec2 from, Vec2 to, float z, const Color& color, const Color& picking_color,
-                      std::unique_ptr<PickingUserData> user_data) {
+                      const PickingUserData& user_data) {
   Line line;
   line.start_point = Vec3(from[0], from[1], z);
   line.end_point = Vec3(to[0], to[1], z);
@@ -37,20 +70,20 @@ void Batcher::AddLine(Vec2 from, Vec2 to, float z, const Color& color, const Col
   line_buffer_.lines_.push_back(line);
   line_buffer_.colors_.push_back_n(color, 2);
   line_buffer_.picking_colors_.push_back_n(picking_color, 2);
-  user_data_.push_back(std::move(user_data));
+  user_data_.push_back(user_data);
 }
 
 void Batcher::AddBox(const Box& box, const std::array<Color, 4>& colors,
-                     std::unique_ptr<PickingUserData> user_data) {
+                     const PickingUserData& user_data) {
   Color picking_color = PickingId::ToColor(PickingType::kBox, user_data_.size(), batcher_id_);
-  AddBox(box, colors, picking_color, std::move(user_data));
+  AddBox(box, colors, picking_color, user_data);
 }
 
 void Batcher::AddBox(const Box& box, const Color& color,
-                     std::unique_ptr<PickingUserData> user_data) {
+                     const PickingUserData& user_data) {
   std::array<Color, 4> colors;
   Fill(colors, color);
-  AddBox(box, colors, std::move(user_data));
+  AddBox(box, colors, user_data);
 }
 
 void Batcher::AddBox(const Box& box, const Color& color, std::shared_ptr<Pickable> pickable) {
@@ -60,30 +93,30 @@ void Batcher::AddBox(const Box& box, const Color& color, std::shared_ptr<Pickabl
   std::array<Color, 4> colors;
   Fill(colors, color);
 
-  AddBox(box, colors, picking_color, nullptr);
+  AddBox(box, colors, picking_color, PickingUserData());
 }
 
 void Batcher::AddShadedBox(Vec2 pos, Vec2 size, float z, const Color& color,
-                           std::unique_ptr<PickingUserData> user_data) {
+                           const PickingUserData& user_data) {
   std::array<Color, 4> colors;
   GetBoxGradientColors(color, &colors);
   Box box(pos, size, z);
-  AddBox(box, colors, std::move(user_data));
+  AddBox(box, colors, user_data);
 }
 
 void Batcher::AddBox(const Box& box, const std::array<Color, 4>& colors, const Color& picking_color,
-                     std::unique_ptr<PickingUserData> user_data) {
+                     const PickingUserData& user_data) {
   box_buffer_.boxes_.push_back(box);
   box_buffer_.colors_.push_back(colors);
   box_buffer_.picking_colors_.push_back_n(picking_color, 4);
-  user_data_.push_back(std::move(user_data));
+  user_data_.push_back(user_data);
 }
 
 void Batcher::AddTriangle(const Triangle& triangle, const Color& color,
-                          std::unique_ptr<PickingUserData> user_data) {
+                          const PickingUserData& user_data) {
   Color picking_color = PickingId::ToColor(PickingType::kTriangle, user_data_.size(), batcher_id_);
 
-  AddTriangle(triangle, color, picking_color, std::move(user_data));
+  AddTriangle(triangle, color, picking_color, user_data);
 }
 
 void Batcher::AddTriangle(const Triangle& triangle, const Color& color,
@@ -92,15 +125,15 @@ void Batcher::AddTriangle(const Triangle& triangle, const Color& color,
 
   Color picking_color = picking_manager_->GetPickableColor(pickable, batcher_id_);
 
-  AddTriangle(triangle, color, picking_color, nullptr);
+  AddTriangle(triangle, color, picking_color, PickingUserData());
 }
 
 void Batcher::AddTriangle(const Triangle& triangle, const Color& color, const Color& picking_color,
-                          std::unique_ptr<PickingUserData> user_data) {
+                          const PickingUserData& user_data) {
   triangle_buffer_.triangles_.push_back(triangle);
   triangle_buffer_.colors_.push_back_n(color, 3);
   triangle_buffer_.picking_colors_.push_back_n(picking_color, 3);
-  user_data_.push_back(std::move(user_data));
+  user_data_.push_back(user_data);
 }
 
 const PickingUserData* Batcher::GetUserData(PickingId id) const {
@@ -114,7 +147,7 @@ const PickingUserData* Batcher::GetUserData(PickingId id) const {
     case PickingType::kTriangle:
     case PickingType::kLine:
       CHECK(id.element_id < user_data_.size());
-      return user_data_[id.element_id].get();
+      return &user_data_[id.element_id];
     case PickingType::kPickable:
       return nullptr;
   }
@@ -157,6 +190,43 @@ void Batcher::StartNewFrame() {
   user_data_.clear();
 }
 
+Batcher::Mark Batcher::GetMark() const {
+  Mark mark;
+  mark.lines = line_buffer_.lines_.size();
+  mark.boxes = box_buffer_.boxes_.size();
+  mark.triangles = triangle_buffer_.triangles_.size();
+  mark.user_data = static_cast<uint32_t>(user_data_.size());
+  return mark;
+}
+
+void Batcher::MoveElementsFrom(Batcher* other, const Mark& begin, const Mark& end) {
+  CHECK(other != this);
+  CHECK(end.user_data <= other->user_data_.size());
+  const uint32_t first_user_data = static_cast<uint32_t>(user_data_.size());
+
+  const LineBuffer& lines = other->line_buffer_;
+  AppendRange(lines.lines_, begin.lines, end.lines, &line_buffer_.lines_);
+  AppendRange(lines.colors_, 2 * begin.lines, 2 * end.lines, &line_buffer_.colors_);
+  AppendPickingColorRange(lines.picking_colors_, 2 * begin.lines, 2 * end.lines, begin.user_data,
+                          first_user_data, &line_buffer_.picking_colors_);
+
+  const BoxBuffer& boxes = other->box_buffer_;
+  AppendRange(boxes.boxes_, begin.boxes, end.boxes, &box_buffer_.boxes_);
+  AppendRange(boxes.colors_, 4 * begin.boxes, 4 * end.boxes, &box_buffer_.colors_);
+  AppendPickingColorRange(boxes.picking_colors_, 4 * begin.boxes, 4 * end.boxes, begin.user_data,
+                          first_user_data, &box_buffer_.picking_colors_);
+
+  const TriangleBuffer& triangles = other->triangle_buffer_;
+  AppendRange(triangles.triangles_, begin.triangles, end.triangles, &triangle_buffer_.triangles_);
+  AppendRange(triangles.colors_, 3 * begin.triangles, 3 * end.triangles,
+              &triangle_buffer_.colors_);
+  AppendPickingColorRange(triangles.picking_colors_, 3 * begin.triangles, 3 * end.triangles,
+                          begin.user_data, first_user_data, &triangle_buffer_.picking_colors_);
+
+  user_data_.insert(user_data_.end(), other->user_data_.begin() + begin.user_data,
+                    other->user_data_.begin() + end.user_data);
+}
+
 void Batcher::Draw(bool picking) const {
   glPushAttrib(GL_ENABLE_BIT | GL_COLOR_BUFFER_BIT);
   if (picking) {
@@ -173,6 +243,7 @@ void Batcher::Draw(bool picking) const {
   DrawBoxBuffer(picking);
   DrawLineBuffer(picking);
   DrawTriangleBuffer(picking);
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
 
   glDisableClientState(GL_COLOR_ARRAY);
   glDisableClientState(GL_VERTEX_ARRAY);
@@ -180,33 +251,53 @@ void Batcher::Draw(bool picking) const {
 }
 
 void Batcher::DrawBoxBuffer(bool picking) const {
+  if (box_index_buffer_ == 0) {
+    std::vector<uint32_t> indices = GetBoxTriangleIndices(BoxBuffer::NUM_BOXES_PER_BLOCK);
+    glGenBuffers(1, &box_index_buffer_);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, box_index_buffer_);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(uint32_t), indices.data(),
+                 GL_STATIC_DRAW);
+  } else {
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, box_index_buffer_);
+  }
+
   const Block<Box, BoxBuffer::NUM_BOXES_PER_BLOCK>* box_block = box_buffer_.boxes_.root();
   const Block<Color, BoxBuffer::NUM_BOXES_PER_BLOCK * 4>* color_block;
+  GpuBlockBuffers* gpu_colors;
 
   color_block = !picking ? box_buffer_.colors_.root() : box_buffer_.picking_colors_.root();
+  gpu_colors = !picking ? &box_buffer_.gpu_colors_ : &box_buffer_.gpu_picking_colors_;
 
-  while (box_block != nullptr) {
+  for (size_t block_index = 0; box_block != nullptr; ++block_index) {
     if (auto num_elems = box_block->size()) {
-      glVertexPointer(3, GL_FLOAT, sizeof(Vec3), box_block->data());
-      glColorPointer(4, GL_UNSIGNED_BYTE, sizeof(Color), color_block->data());
-      glDrawArrays(GL_QUADS, 0, num_elems * 4);
+      box_buffer_.gpu_boxes_.BindBlock(block_index, *box_block);
+      glVertexPointer(3, GL_FLOAT, sizeof(Vec3), nullptr);
+      gpu_colors->BindBlock(block_index, *color_block);
+      glColorPointer(4, GL_UNSIGNED_BYTE, sizeof(Color), nullptr);
+      glDrawElements(GL_TRIANGLES, num_elems * 6, GL_UNSIGNED_INT, nullptr);
     }
 
     box_block = box_block->next();
     color_block = color_block->next();
   }
+
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
 }
 
 void Batcher::DrawLineBuffer(bool picking) const {
   const Block<Line, LineBuffer::NUM_LINES_PER_BLOCK>* line_block = line_buffer_.lines_.root();
   const Block<Color, LineBuffer::NUM_LINES_PER_BLOCK * 2>* color_block;
+  GpuBlockBuffers* gpu_colors;
 
   color_block = !picking ? line_buffer_.colors_.root() : line_buffer_.picking_colors_.root();
+  gpu_colors = !picking ? &line_buffer_.gpu_colors_ : &line_buffer_.gpu_picking_colors_;
 
-  while (line_block != nullptr) {
+  for (size_t block_index = 0; line_block != nullptr; ++block_index) {
     if (auto num_elems = line_block->size()) {
-      glVertexPointer(3, GL_FLOAT, sizeof(Vec3), line_block->data());
-      glColorPointer(4, GL_UNSIGNED_BYTE, sizeof(Color), color_block->data());
+      line_buffer_.gpu_lines_.BindBlock(block_index, *line_block);
+      glVertexPointer(3, GL_FLOAT, sizeof(Vec3), nullptr);
+      gpu_colors->BindBlock(block_index, *color_block);
+      glColorPointer(4, GL_UNSIGNED_BYTE, sizeof(Color), nullptr);
       glDrawArrays(GL_LINES, 0, num_elems * 2);
     }
 
@@ -219,14 +310,18 @@ void Batcher::DrawTriangleBuffer(bool picking) const {
   const Block<Triangle, TriangleBuffer::NUM_TRIANGLES_PER_BLOCK>* triangle_block =
       triangle_buffer_.triangles_.root();
   const Block<Color, TriangleBuffer::NUM_TRIANGLES_PER_BLOCK * 3>* color_block;
+  GpuBlockBuffers* gpu_colors;
 
   color_block =
       !picking ? triangle_buffer_.colors_.root() : triangle_buffer_.picking_colors_.root();
+  gpu_colors = !picking ? &triangle_buffer_.gpu_colors_ : &triangle_buffer_.gpu_picking_colors_;
 
-  while (triangle_block != nullptr) {
+  for (size_t block_index = 0; triangle_block != nullptr; ++block_index) {
     if (int num_elems = triangle_block->size()) {
-      glVertexPointer(3, GL_FLOAT, sizeof(Vec3), triangle_block->data());
-      glColorPointer(4, GL_UNSIGNED_BYTE, sizeof(Color), color_block->data());
+      triangle_buffer_.gpu_triangles_.BindBlock(block_index, *triangle_block);
+      glVertexPointer(3, GL_FLOAT, sizeof(Vec3), nullptr);
+      gpu_colors->BindBlock(block_index, *color_block);
+      glColorPointer(4, GL_UNSIGNED_BYTE, sizeof(Color), nullptr);
       glDrawArrays(GL_TRIANGLES, 0, num_elems * 3);
     }
 
@@ -234,3 +329,21 @@ void Batcher::DrawTriangleBuffer(bool picking) const {
     color_block = color_block->next();
   }
 }
+
+std::array<GpuBlockBuffers*, 9> Batcher::GetGpuBlockBuffers() const {
+  return {&line_buffer_.gpu_lines_,         &line_buffer_.gpu_colors_,
+          &line_buffer_.gpu_picking_colors_, &box_buffer_.gpu_boxes_,
+          &box_buffer_.gpu_colors_,          &box_buffer_.gpu_picking_colors_,
+          &triangle_buffer_.gpu_triangles_,  &triangle_buffer_.gpu_colors_,
+          &triangle_buffer_.gpu_picking_colors_};
+}
+
+void Batcher::ReleaseGpuBuffers() {
+  for (GpuBlockBuffers* buffers : GetGpuBlockBuffers()) {
+    buffers->Release();
+  }
+  if (box_index_buffer_ != 0) {
+    glDeleteBuffers(1, &box_index_buffer_);
+    box_index_buffer_ = 0;
+  }
+}
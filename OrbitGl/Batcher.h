@@ -5,23 +5,35 @@
 #ifndef ORBIT_GL_BATCHER_H_
 #define ORBIT_GL_BATCHER_H_
 
-#include <utility>
+#include <array>
+#include <string>
 #include <vector>
 
 #include "BlockChain.h"
 #include "Geometry.h"
+#include "GpuBlockBuffers.h"
 #include "PickingManager.h"
 #include "TextBox.h"
 
-using TooltipCallback = std::function<std::string(PickingId)>;
+// Generates the tooltips of the elements it adds to a Batcher. Tooltips are
+// only generated when an element is hovered, from its PickingId.
+class PickingTooltipProvider {
+ public:
+  virtual ~PickingTooltipProvider() = default;
+  [[nodiscard]] virtual std::string GetPickingTooltip(PickingId id) const = 0;
+};
 
+// What an element that is picked by its user data refers to. It only holds
+// pointers and is stored by value, so that adding elements does not allocate
+// once the Batcher has grown to the size of a frame.
 struct PickingUserData {
-  TextBox* text_box_;
-  TooltipCallback generate_tooltip_;
+  const TextBox* text_box_;
+  const PickingTooltipProvider* tooltip_provider_;
   const void* custom_data_ = nullptr;
 
-  explicit PickingUserData(TextBox* text_box = nullptr, TooltipCallback generate_tooltip = nullptr)
-      : text_box_(text_box), generate_tooltip_(std::move(generate_tooltip)) {}
+  explicit PickingUserData(const TextBox* text_box = nullptr,
+                           const PickingTooltipProvider* tooltip_provider = nullptr)
+      : text_box_(text_box), tooltip_provider_(tooltip_provider) {}
 };
 
 struct LineBuffer {
@@ -29,12 +41,19 @@ struct LineBuffer {
     lines_.Reset();
     colors_.Reset();
     picking_colors_.Reset();
+    gpu_lines_.OnChainReset();
+    gpu_colors_.OnChainReset();
+    gpu_picking_colors_.OnChainReset();
   }
 
   static const int NUM_LINES_PER_BLOCK = 64 * 1024;
   BlockChain<Line, NUM_LINES_PER_BLOCK> lines_;
   BlockChain<Color, 2 * NUM_LINES_PER_BLOCK> colors_;
   BlockChain<Color, 2 * NUM_LINES_PER_BLOCK> picking_colors_;
+  // The blocks on the GPU, updated by Batcher::Draw.
+  mutable GpuBlockBuffers gpu_lines_;
+  mutable GpuBlockBuffers gpu_colors_;
+  mutable GpuBlockBuffers gpu_picking_colors_;
 };
 
 struct BoxBuffer {
@@ -42,12 +61,19 @@ struct BoxBuffer {
     boxes_.Reset();
     colors_.Reset();
     picking_colors_.Reset();
+    gpu_boxes_.OnChainReset();
+    gpu_colors_.OnChainReset();
+    gpu_picking_colors_.OnChainReset();
   }
 
   static const int NUM_BOXES_PER_BLOCK = 64 * 1024;
   BlockChain<Box, NUM_BOXES_PER_BLOCK> boxes_;
   BlockChain<Color, 4 * NUM_BOXES_PER_BLOCK> colors_;
   BlockChain<Color, 4 * NUM_BOXES_PER_BLOCK> picking_colors_;
+  // The blocks on the GPU, updated by Batcher::Draw.
+  mutable GpuBlockBuffers gpu_boxes_;
+  mutable GpuBlockBuffers gpu_colors_;
+  mutable GpuBlockBuffers gpu_picking_colors_;
 };
 
 struct TriangleBuffer {
@@ -55,12 +81,19 @@ struct TriangleBuffer {
     triangles_.Reset();
     colors_.Reset();
     picking_colors_.Reset();
+    gpu_triangles_.OnChainReset();
+    gpu_colors_.OnChainReset();
+    gpu_picking_colors_.OnChainReset();
   }
 
   static const int NUM_TRIANGLES_PER_BLOCK = 64 * 1024;
   BlockChain<Triangle, NUM_TRIANGLES_PER_BLOCK> triangles_;
   BlockChain<Color, 3 * NUM_TRIANGLES_PER_BLOCK> colors_;
   BlockChain<Color, 3 * NUM_TRIANGLES_PER_BLOCK> picking_colors_;
+  // The blocks on the GPU, updated by Batcher::Draw.
+  mutable GpuBlockBuffers gpu_triangles_;
+  mutable GpuBlockBuffers gpu_colors_;
+  mutable GpuBlockBuffers gpu_picking_colors_;
 };
 
 class Batcher {
@@ -73,31 +106,50 @@ class Batcher {
   Batcher(Batcher&&) = delete;
 
   void AddLine(Vec2 from, Vec2 to, float z, const Color& color,
-               std::unique_ptr<PickingUserData> user_data = nullptr);
+               const PickingUserData& user_data = PickingUserData());
   void AddVerticalLine(Vec2 pos, float size, float z, const Color& color,
-                       std::unique_ptr<PickingUserData> user_data = nullptr);
+                       const PickingUserData& user_data = PickingUserData());
   void AddLine(Vec2 from, Vec2 to, float z, const Color& color, std::shared_ptr<Pickable> pickable);
   void AddVerticalLine(Vec2 pos, float size, float z, const Color& color,
                        std::shared_ptr<Pickable> pickable);
 
   void AddBox(const Box& box, const std::array<Color, 4>& colors,
-              std::unique_ptr<PickingUserData> user_data = nullptr);
+              const PickingUserData& user_data = PickingUserData());
   void AddBox(const Box& box, const Color& color,
-              std::unique_ptr<PickingUserData> user_data = nullptr);
+              const PickingUserData& user_data = PickingUserData());
   void AddBox(const Box& box, const Color& color, std::shared_ptr<Pickable> pickable);
   void AddShadedBox(Vec2 pos, Vec2 size, float z, const Color& color,
-                    std::unique_ptr<PickingUserData> user_data = nullptr);
+                    const PickingUserData& user_data = PickingUserData());
 
   void AddTriangle(const Triangle& triangle, const Color& color,
-                   std::unique_ptr<PickingUserData> user_data = nullptr);
+                   const PickingUserData& user_data = PickingUserData());
   void AddTriangle(const Triangle& triangle, const Color& color,
                    std::shared_ptr<Pickable> pickable);
 
+  // Requires a current GL context, which must be the same for all calls.
   virtual void Draw(bool picking = false) const;
+  // Deletes the buffers that Draw created on the GPU. Call it while the GL
+  // context of Draw is current, before destroying the Batcher.
+  void ReleaseGpuBuffers();
 
   void ResetElements();
   void StartNewFrame();
 
+  // The numbers of elements of each kind added to a Batcher, and of their user
+  // data, which refer to the elements added between two points in time.
+  struct Mark {
+    uint32_t lines = 0;
+    uint32_t boxes = 0;
+    uint32_t triangles = 0;
+    uint32_t user_data = 0;
+  };
+  [[nodiscard]] Mark GetMark() const;
+  // Moves the elements that were added to other between begin and end, and
+  // their user data, to the end of this Batcher. Elements picked by their user
+  // data get the picking colors they would have had if they had been added to
+  // this Batcher directly. The elements stay in other until its next frame.
+  void MoveElementsFrom(Batcher* other, const Mark& begin, const Mark& end);
+
   [[nodiscard]] PickingManager* GetPickingManager() { return picking_manager_; }
   void SetPickingManager(PickingManager* picking_manager) { picking_manager_ = picking_manager; }
 
@@ -110,15 +162,16 @@ class Batcher {
   void DrawLineBuffer(bool picking) const;
   void DrawBoxBuffer(bool picking) const;
   void DrawTriangleBuffer(bool picking) const;
+  [[nodiscard]] std::array<GpuBlockBuffers*, 9> GetGpuBlockBuffers() const;
 
   void GetBoxGradientColors(const Color& color, std::array<Color, 4>* colors);
 
   void AddLine(Vec2 from, Vec2 to, float z, const Color& color, const Color& picking_color,
-               std::unique_ptr<PickingUserData> user_data = nullptr);
+               const PickingUserData& user_data = PickingUserData());
   void AddBox(const Box& box, const std::array<Color, 4>& colors, const Color& picking_color,
-              std::unique_ptr<PickingUserData> user_data = nullptr);
+              const PickingUserData& user_data = PickingUserData());
   void AddTriangle(const Triangle& triangle, const Color& color, const Color& picking_color,
-                   std::unique_ptr<PickingUserData> user_data = nullptr);
+                   const PickingUserData& user_data = PickingUserData());
 
   BatcherId batcher_id_;
   PickingManager* picking_manager_;
@@ -126,7 +179,9 @@ class Batcher {
   BoxBuffer box_buffer_;
   TriangleBuffer triangle_buffer_;
 
-  std::vector<std::unique_ptr<PickingUserData>> user_data_;
+  std::vector<PickingUserData> user_data_;
+  // The triangles of the boxes of a block, shared by all blocks.
+  mutable uint32_t box_index_buffer_ = 0;
 };
 
 #endif
@@ -0,0 +1,171 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// Adds the visible timers of a TimerChain with --timers timers to a Batcher,
+// with the user data that TimerTrack::UpdatePrimitives gives them, for
+// --frames frames, and counts the heap allocations of each frame and the bytes
+// that Batcher::Draw uploads to the GPU, which is all the elements of a frame
+// that changed. Then generates the tooltip of a hovered timer, as
+// CaptureWindow::Hover does.
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <string>
+#include <vector>
+
+#include "Batcher.h"
+#include "TextBox.h"
+#include "TimerChain.h"
+#include "absl/base/casts.h"
+#include "absl/flags/flag.h"
+#include "absl/flags/parse.h"
+#include "absl/strings/str_format.h"
+#include "capture_data.pb.h"
+
+ABSL_FLAG(uint64_t, timers, 1'000'000, "Number of timers in the chain");
+ABSL_FLAG(uint64_t, frames, 10, "Number of frames");
+
+namespace {
+
+std::atomic<uint64_t> allocation_count = 0;
+
+}  // namespace
+
+void* operator new(size_t size) {
+  ++allocation_count;
+  void* memory = std::malloc(size);
+  if (memory == nullptr) throw std::bad_alloc();
+  return memory;
+}
+
+void operator delete(void* memory) noexcept { std::free(memory); }
+
+void operator delete(void* memory, size_t /*size*/) noexcept { std::free(memory); }
+
+namespace {
+
+using orbit_client_protos::TimerInfo;
+
+constexpr uint64_t kTimerPeriodNs = 1000;
+constexpr uint64_t kPixelCount = 1920;
+
+class TimerTooltipProvider : public PickingTooltipProvider {
+ public:
+  explicit TimerTooltipProvider(const Batcher* batcher) : batcher_(batcher) {}
+
+  [[nodiscard]] std::string GetPickingTooltip(PickingId id) const override {
+    const TextBox* text_box = batcher_->GetUserData(id)->text_box_;
+    return absl::StrFormat("timer from %lu ns to %lu ns", text_box->GetTimerStart(),
+                           text_box->GetTimerEnd());
+  }
+
+ private:
+  const Batcher* batcher_;
+};
+
+// The bytes of the vertices and the colors of the elements, without the
+// picking colors, which are only uploaded by picking passes.
+uint64_t GetElementByteCount(const Batcher::Mark& mark) {
+  return mark.lines * (sizeof(Line) + 2 * sizeof(Color)) +
+         mark.boxes * (sizeof(Box) + 4 * sizeof(Color));
+}
+
+double SecondsSince(std::chrono::steady_clock::time_point begin) {
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+}
+
+// Wide timers are drawn as boxes, timers narrower than a pixel as lines, like
+// in TimerTrack::UpdatePrimitives.
+uint64_t AddVisibleTimers(TimerChain* chain, uint64_t min_tick, uint64_t max_tick,
+                          const PickingTooltipProvider* tooltip_provider, Batcher* batcher) {
+  uint64_t pixel_delta_in_ticks = (max_tick - min_tick) / kPixelCount;
+  float world_per_tick = static_cast<float>(kPixelCount) / static_cast<float>(max_tick - min_tick);
+  Color color(255, 0, 0, 255);
+  uint64_t count = 0;
+  chain->ForEachVisibleTimer(
+      min_tick, max_tick, min_tick, pixel_delta_in_ticks, [&](TimerBlock& block, size_t k) {
+        ++count;
+        uint64_t start = block.GetStart(k);
+        uint64_t end = block.GetEnd(k);
+        Vec2 pos(static_cast<float>(start - std::min(start, min_tick)) * world_per_tick, 0);
+        Vec2 size(static_cast<float>(end - start) * world_per_tick, 20);
+        PickingUserData user_data(&block[k], tooltip_provider);
+        if (end - start >= pixel_delta_in_ticks) {
+          batcher->AddShadedBox(pos, size, 0, color, user_data);
+          return false;
+        }
+        batcher->AddVerticalLine(pos, size[1], 0, color, user_data);
+        return true;
+      });
+  return count;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  absl::ParseCommandLine(argc, argv);
+  uint64_t timer_count = absl::GetFlag(FLAGS_timers);
+  uint64_t frame_count = absl::GetFlag(FLAGS_frames);
+
+  TimerChain chain;
+  TimerInfo timer;
+  for (uint64_t i = 0; i < timer_count; ++i) {
+    timer.set_start(i * kTimerPeriodNs);
+    timer.set_end(i * kTimerPeriodNs + kTimerPeriodNs / 2);
+    chain.push_back(timer);
+  }
+
+  Batcher batcher(BatcherId::kTimeGraph);
+  TimerTooltipProvider tooltip_provider(&batcher);
+  // Zoomed in on 10'000 timers and zoomed out over the whole chain. The same
+  // frame is generated again, e.g., after a vertical scroll, or the time window
+  // is panned by a pixel every frame.
+  uint64_t zoomed_in_timer_count = std::min<uint64_t>(10'000, timer_count);
+  for (uint64_t window_timer_count : {zoomed_in_timer_count, timer_count}) {
+    for (bool panning : {false, true}) {
+      uint64_t window_ticks = window_timer_count * kTimerPeriodNs;
+      uint64_t max_allocation_count = 0;
+      uint64_t drawn_count = 0;
+      uint64_t uploaded_byte_count = 0;
+      auto begin = std::chrono::steady_clock::now();
+      for (uint64_t frame = 0; frame < frame_count; ++frame) {
+        uint64_t min_tick = panning ? frame * window_ticks / kPixelCount : 0;
+        uint64_t allocation_count_before = allocation_count;
+        batcher.StartNewFrame();
+        drawn_count = AddVisibleTimers(&chain, min_tick, min_tick + window_ticks,
+                                       &tooltip_provider, &batcher);
+        // The first frame grows the Batcher and uploads everything.
+        if (frame > 0) {
+          max_allocation_count =
+              std::max(max_allocation_count, allocation_count - allocation_count_before);
+        }
+        if (frame > 0) uploaded_byte_count += GetElementByteCount(batcher.GetMark());
+      }
+      double uploaded_kb = uploaded_byte_count / 1024.0 / std::max<uint64_t>(1, frame_count - 1);
+      printf(
+          "%lu timers drawn%s: %.3f ms and at most %lu allocations per frame, %.1f KB uploaded "
+          "per frame, after the first one\n",
+          drawn_count, panning ? " while panning" : "", SecondsSince(begin) * 1e3 / frame_count,
+          max_allocation_count, uploaded_kb);
+    }
+  }
+
+  // Hovers the last added element.
+  Color color = PickingId::ToColor(PickingType::kLine, batcher.GetMark().user_data - 1,
+                                   BatcherId::kTimeGraph);
+  std::array<uint8_t, 4> color_values{color[0], color[1], color[2], color[3]};
+  PickingId id = PickingId::FromPixelValue(absl::bit_cast<uint32_t>(color_values));
+  const PickingUserData* user_data = batcher.GetUserData(id);
+  if (user_data == nullptr || user_data->tooltip_provider_ == nullptr) {
+    printf("The hovered timer has no tooltip\n");
+    return 1;
+  }
+  printf("Hovered: %s\n", user_data->tooltip_provider_->GetPickingTooltip(id).c_str());
+  return 0;
+}
@@ -4,8 +4,11 @@
 
 #include <gtest/gtest.h>
 
+#include <string>
+
 #include "Batcher.h"
 #include "PickingManagerTest.h"
+#include "absl/strings/str_format.h"
 
 namespace {
 
@@ -132,21 +135,21 @@ TEST(Batcher, PickingSimpleElements) {
   MockBatcher batcher(BatcherId::kUi);
 
   std::string line_custom_data = "line custom data";
-  auto line_user_data = std::make_unique<PickingUserData>();
-  line_user_data->custom_data_ = &line_custom_data;
+  PickingUserData line_user_data;
+  line_user_data.custom_data_ = &line_custom_data;
 
   std::string triangle_custom_data = "triangle custom data";
-  auto triangle_user_data = std::make_unique<PickingUserData>();
-  triangle_user_data->custom_data_ = &triangle_custom_data;
+  PickingUserData triangle_user_data;
+  triangle_user_data.custom_data_ = &triangle_custom_data;
 
   std::string box_custom_data = "box custom data";
-  auto box_user_data = std::make_unique<PickingUserData>();
-  box_user_data->custom_data_ = &box_custom_data;
+  PickingUserData box_user_data;
+  box_user_data.custom_data_ = &box_custom_data;
 
-  batcher.AddLine(Vec2(0, 0), Vec2(1, 0), 0, Color(255, 255, 255, 255), std::move(line_user_data));
+  batcher.AddLine(Vec2(0, 0), Vec2(1, 0), 0, Color(255, 255, 255, 255), line_user_data);
   batcher.AddTriangle(Triangle(Vec3(0, 0, 0), Vec3(0, 1, 0), Vec3(1, 0, 0)), Color(0, 255, 0, 255),
-                      std::move(triangle_user_data));
-  batcher.AddBox(Box(Vec2(0, 0), Vec2(1, 1), 0), Color(255, 0, 0, 255), std::move(box_user_data));
+                      triangle_user_data);
+  batcher.AddBox(Box(Vec2(0, 0), Vec2(1, 1), 0), Color(255, 0, 0, 255), box_user_data);
 
   batcher.Draw(true);
   ExpectCustomDataEq(batcher, batcher.GetDrawnLineColors()[0], line_custom_data);
@@ -185,21 +188,21 @@ TEST(Batcher, MultipleDrawCalls) {
   MockBatcher batcher(BatcherId::kUi);
 
   std::string line_custom_data = "line custom data";
-  auto line_user_data = std::make_unique<PickingUserData>();
-  line_user_data->custom_data_ = &line_custom_data;
+  PickingUserData line_user_data;
+  line_user_data.custom_data_ = &line_custom_data;
 
   std::string triangle_custom_data = "triangle custom data";
-  auto triangle_user_data = std::make_unique<PickingUserData>();
-  triangle_user_data->custom_data_ = &triangle_custom_data;
+  PickingUserData triangle_user_data;
+  triangle_user_data.custom_data_ = &triangle_custom_data;
 
   std::string box_custom_data = "box custom data";
-  auto box_user_data = std::make_unique<PickingUserData>();
-  box_user_data->custom_data_ = &box_custom_data;
+  PickingUserData box_user_data;
+  box_user_data.custom_data_ = &box_custom_data;
 
-  batcher.AddLine(Vec2(0, 0), Vec2(1, 0), 0, Color(255, 255, 255, 255), std::move(line_user_data));
+  batcher.AddLine(Vec2(0, 0), Vec2(1, 0), 0, Color(255, 255, 255, 255), line_user_data);
   batcher.AddTriangle(Triangle(Vec3(0, 0, 0), Vec3(0, 1, 0), Vec3(1, 0, 0)), Color(0, 255, 0, 255),
-                      std::move(triangle_user_data));
-  batcher.AddBox(Box(Vec2(0, 0), Vec2(1, 1), 0), Color(255, 0, 0, 255), std::move(box_user_data));
+                      triangle_user_data);
+  batcher.AddBox(Box(Vec2(0, 0), Vec2(1, 1), 0), Color(255, 0, 0, 255), box_user_data);
 
   batcher.Draw(true);
 
@@ -226,4 +229,32 @@ TEST(Batcher, MultipleDrawCalls) {
   UNUSED(rendered_data);
 }
 
+class TooltipProviderMock : public PickingTooltipProvider {
+ public:
+  [[nodiscard]] std::string GetPickingTooltip(PickingId id) const override {
+    return absl::StrFormat("tooltip of element %u", id.element_id);
+  }
+};
+
+TEST(Batcher, PickingTooltipsAreGeneratedWhenHovered) {
+  MockBatcher batcher(BatcherId::kUi);
+  TooltipProviderMock tooltip_provider;
+
+  batcher.AddLine(Vec2(0, 0), Vec2(1, 0), 0, Color(255, 255, 255, 255));
+  batcher.AddBox(Box(Vec2(0, 0), Vec2(1, 1), 0), Color(255, 0, 0, 255),
+                 PickingUserData(nullptr, &tooltip_provider));
+
+  batcher.Draw(true);
+  PickingId id = MockRenderPickingColor(batcher.GetDrawnBoxColors()[0]);
+  const PickingUserData* rendered_data = batcher.GetUserData(id);
+  ASSERT_NE(rendered_data, nullptr);
+  ASSERT_EQ(rendered_data->tooltip_provider_, &tooltip_provider);
+  EXPECT_EQ(rendered_data->tooltip_provider_->GetPickingTooltip(id), "tooltip of element 1");
+
+  id = MockRenderPickingColor(batcher.GetDrawnLineColors()[0]);
+  rendered_data = batcher.GetUserData(id);
+  ASSERT_NE(rendered_data, nullptr);
+  EXPECT_EQ(rendered_data->tooltip_provider_, nullptr);
+}
+
 }  // namespace
\ No newline at end of file
@@ -0,0 +1,128 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "BottomUpView.h"
+
+#include "OrbitBase/Logging.h"
+#include "absl/strings/str_format.h"
+
+BottomUpNode::~BottomUpNode() = default;
+
+uint64_t BottomUpNode::child_count() const {
+  ExpandIfNeeded();
+  return children_.size();
+}
+
+std::vector<const BottomUpNode*> BottomUpNode::children() const {
+  ExpandIfNeeded();
+  std::vector<const BottomUpNode*> ret;
+  ret.reserve(children_.size());
+  for (const auto& address_and_node : children_) {
+    ret.push_back(address_and_node.second.get());
+  }
+  return ret;
+}
+
+const BottomUpFunction* BottomUpNode::GetChildOrNull(uint64_t function_absolute_address) const {
+  ExpandIfNeeded();
+  auto child_it = children_.find(function_absolute_address);
+  if (child_it == children_.end()) {
+    return nullptr;
+  }
+  return child_it->second.get();
+}
+
+void BottomUpNode::AddCallstack(uint32_t callstack_index, uint64_t sample_count) {
+  CHECK(!is_expanded_);
+  callstack_indices_.push_back(callstack_index);
+  sample_count_ += sample_count;
+}
+
+void BottomUpNode::ExpandIfNeeded() const {
+  if (is_expanded_) {
+    return;
+  }
+  is_expanded_ = true;
+
+  // Callstacks that end with this node have no caller to add.
+  const size_t frame_index = GetChildFrameIndex();
+  for (uint32_t callstack_index : callstack_indices_) {
+    const BottomUpView::Callstack& callstack = view_->callstacks_[callstack_index];
+    if (frame_index >= callstack.frames.size()) {
+      continue;
+    }
+    const uint64_t function_absolute_address = callstack.frames[frame_index];
+    std::unique_ptr<BottomUpFunction>& child = children_[function_absolute_address];
+    if (child == nullptr) {
+      child = std::make_unique<BottomUpFunction>(view_, this, function_absolute_address,
+                                                 frame_index);
+    }
+    child->AddCallstack(callstack_index, callstack.sample_count);
+  }
+  callstack_indices_.clear();
+  callstack_indices_.shrink_to_fit();
+}
+
+const std::string& BottomUpFunction::function_name() const {
+  return view()->GetFunctionName(function_absolute_address_).function_name;
+}
+
+const std::string& BottomUpFunction::module_path() const {
+  return view()->GetFunctionName(function_absolute_address_).module_path;
+}
+
+const BottomUpView::FunctionName& BottomUpView::GetFunctionName(
+    uint64_t function_absolute_address) const {
+  return function_names_.at(function_absolute_address);
+}
+
+std::unique_ptr<BottomUpView> BottomUpView::CreateFromSamplingProfiler(
+    const SamplingProfiler& sampling_profiler, const CaptureData& capture_data) {
+  auto bottom_up_view = std::make_unique<BottomUpView>();
+
+  std::vector<const ThreadSampleData*> thread_sample_datas;
+  if (const ThreadSampleData* summary = sampling_profiler.GetSummary(); summary != nullptr) {
+    thread_sample_datas.push_back(summary);
+  } else {
+    for (const ThreadSampleData& thread_sample_data : sampling_profiler.GetThreadSampleData()) {
+      thread_sample_datas.push_back(&thread_sample_data);
+    }
+  }
+
+  // Different callstacks can have the same resolved callstack, which then
+  // only goes into the tree once, with the samples of all of them.
+  absl::flat_hash_map<CallstackID, uint32_t> resolved_callstack_id_to_index;
+  for (const ThreadSampleData* thread_sample_data : thread_sample_datas) {
+    for (const auto& [callstack_id, sample_count] : thread_sample_data->callstack_count) {
+      const CallStack& resolved_callstack = sampling_profiler.GetResolvedCallstack(callstack_id);
+      auto [index_it, inserted] = resolved_callstack_id_to_index.try_emplace(
+          resolved_callstack.GetHash(), bottom_up_view->callstacks_.size());
+      if (inserted) {
+        bottom_up_view->callstacks_.push_back(Callstack{resolved_callstack.GetFrames(), 0});
+      }
+      bottom_up_view->callstacks_[index_it->second].sample_count += sample_count;
+    }
+  }
+
+  for (uint32_t i = 0; i < bottom_up_view->callstacks_.size(); ++i) {
+    const Callstack& callstack = bottom_up_view->callstacks_[i];
+    bottom_up_view->AddCallstack(i, callstack.sample_count);
+
+    for (uint64_t frame : callstack.frames) {
+      auto [function_name_it, inserted] = bottom_up_view->function_names_.try_emplace(frame);
+      if (!inserted) {
+        continue;
+      }
+      FunctionName* function_name = &function_name_it->second;
+      const std::string& name = capture_data.GetFunctionNameByAddress(frame);
+      if (name != CaptureData::kUnknownFunctionOrModuleName) {
+        function_name->function_name = name;
+      } else {
+        function_name->function_name = absl::StrFormat("[unknown@%#llx]", frame);
+      }
+      function_name->module_path = capture_data.GetModulePathByAddress(frame);
+    }
+  }
+  return bottom_up_view;
+}
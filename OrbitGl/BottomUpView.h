@@ -0,0 +1,130 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef ORBIT_GL_BOTTOM_UP_VIEW_H_
+#define ORBIT_GL_BOTTOM_UP_VIEW_H_
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "CaptureData.h"
+#include "Path.h"
+#include "SamplingProfiler.h"
+#include "absl/container/flat_hash_map.h"
+
+class BottomUpFunction;
+class BottomUpView;
+
+// A node of the inverted call tree: the children of a function are the
+// functions that called it in the samples of the node. The children of a node
+// are only created the first time they are requested, from the callstacks
+// that go through the node, so that creating the view and expanding a node
+// take time proportional to the unique callstacks involved, independently of
+// the number of samples.
+class BottomUpNode {
+ public:
+  explicit BottomUpNode(const BottomUpView* view, const BottomUpNode* parent)
+      : view_{view}, parent_{parent} {}
+  virtual ~BottomUpNode();
+
+  [[nodiscard]] uint64_t sample_count() const { return sample_count_; }
+
+  [[nodiscard]] const BottomUpNode* parent() const { return parent_; }
+
+  [[nodiscard]] uint64_t child_count() const;
+
+  [[nodiscard]] std::vector<const BottomUpNode*> children() const;
+
+  [[nodiscard]] const BottomUpFunction* GetChildOrNull(uint64_t function_absolute_address) const;
+
+ protected:
+  [[nodiscard]] const BottomUpView* view() const { return view_; }
+
+  // Adds a callstack that goes through this node, before the node is expanded.
+  void AddCallstack(uint32_t callstack_index, uint64_t sample_count);
+
+ private:
+  // Creates the children from the frames at GetChildFrameIndex() of the
+  // callstacks that go through this node, if not done yet.
+  void ExpandIfNeeded() const;
+  [[nodiscard]] virtual size_t GetChildFrameIndex() const = 0;
+
+  const BottomUpView* view_;
+  const BottomUpNode* parent_;
+  uint64_t sample_count_ = 0;
+  // Indices into BottomUpView::callstacks_, released once the node is expanded.
+  mutable std::vector<uint32_t> callstack_indices_;
+  mutable bool is_expanded_ = false;
+  mutable absl::flat_hash_map<uint64_t, std::unique_ptr<BottomUpFunction>> children_;
+};
+
+class BottomUpFunction : public BottomUpNode {
+ public:
+  explicit BottomUpFunction(const BottomUpView* view, const BottomUpNode* parent,
+                            uint64_t function_absolute_address, size_t frame_index)
+      : BottomUpNode{view, parent},
+        function_absolute_address_{function_absolute_address},
+        frame_index_{frame_index} {}
+
+  [[nodiscard]] uint64_t function_absolute_address() const { return function_absolute_address_; }
+
+  [[nodiscard]] const std::string& function_name() const;
+
+  [[nodiscard]] const std::string& module_path() const;
+
+  [[nodiscard]] std::string GetModuleName() const { return Path::GetFileName(module_path()); }
+
+  [[nodiscard]] float GetInclusivePercent(uint64_t total_sample_count) const {
+    return 100.0f * sample_count() / total_sample_count;
+  }
+
+  [[nodiscard]] float GetPercentOfParent() const {
+    return 100.0f * sample_count() / parent()->sample_count();
+  }
+
+ private:
+  [[nodiscard]] size_t GetChildFrameIndex() const override { return frame_index_ + 1; }
+
+  uint64_t function_absolute_address_;
+  // The index of the frame of this function in the callstacks of the node,
+  // counted from the innermost frame.
+  size_t frame_index_;
+};
+
+// The root of the inverted call tree. Its children are the functions the
+// samples were taken in, i.e., the innermost frames of the callstacks, with
+// their exclusive sample counts.
+class BottomUpView : public BottomUpNode {
+ public:
+  // Uses the summary of sampling_profiler if it has one, and the samples of
+  // all its threads otherwise.
+  [[nodiscard]] static std::unique_ptr<BottomUpView> CreateFromSamplingProfiler(
+      const SamplingProfiler& sampling_profiler, const CaptureData& capture_data);
+
+  BottomUpView() : BottomUpNode{this, nullptr} {}
+
+ private:
+  friend class BottomUpNode;
+  friend class BottomUpFunction;
+
+  struct Callstack {
+    // Resolved frames, starting from the innermost one.
+    std::vector<uint64_t> frames;
+    uint64_t sample_count = 0;
+  };
+  struct FunctionName {
+    std::string function_name;
+    std::string module_path;
+  };
+
+  [[nodiscard]] size_t GetChildFrameIndex() const override { return 0; }
+  [[nodiscard]] const FunctionName& GetFunctionName(uint64_t function_absolute_address) const;
+
+  std::vector<Callstack> callstacks_;
+  absl::flat_hash_map<uint64_t, FunctionName> function_names_;
+};
+
+#endif  // ORBIT_GL_BOTTOM_UP_VIEW_H_
@@ -0,0 +1,210 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "BottomUpView.h"
+#include "Callstack.h"
+#include "CaptureData.h"
+#include "SamplingProfiler.h"
+#include "capture_data.pb.h"
+
+using orbit_client_protos::CallstackEvent;
+using orbit_client_protos::LinuxAddressInfo;
+
+namespace {
+
+constexpr uint64_t kFunctionA = 0x1000;
+constexpr uint64_t kFunctionB = 0x2000;
+constexpr uint64_t kFunctionC = 0x3000;
+constexpr uint64_t kFunctionD = 0x4000;
+constexpr uint64_t kUnknownFunction = 0x5000;
+
+void AddFunction(uint64_t function_address, const std::string& name, CaptureData* capture_data) {
+  // Two addresses in each function, to check that they are resolved to the
+  // function.
+  for (uint64_t offset : {0, 0x10}) {
+    LinuxAddressInfo address_info;
+    address_info.set_absolute_address(function_address + offset);
+    address_info.set_offset_in_function(offset);
+    address_info.set_function_name(name);
+    address_info.set_module_path("/path/to/module");
+    capture_data->InsertAddressInfo(address_info);
+  }
+}
+
+class BottomUpViewTest : public testing::Test {
+ protected:
+  BottomUpViewTest() {
+    AddFunction(kFunctionA, "A", &capture_data_);
+    AddFunction(kFunctionB, "B", &capture_data_);
+    AddFunction(kFunctionC, "C", &capture_data_);
+    AddFunction(kFunctionD, "D", &capture_data_);
+  }
+
+  // frames start from the innermost frame.
+  void AddSamples(int32_t thread_id, std::vector<uint64_t> frames, size_t count) {
+    CallStack callstack(std::move(frames));
+    CallstackID callstack_id = callstack.GetHash();
+    if (!capture_data_.GetCallstackData()->HasCallStack(callstack_id)) {
+      capture_data_.AddUniqueCallStack(std::move(callstack));
+    }
+    for (size_t i = 0; i < count; ++i) {
+      CallstackEvent event;
+      event.set_time(++time_);
+      event.set_thread_id(thread_id);
+      event.set_callstack_hash(callstack_id);
+      capture_data_.AddCallstackEvent(event);
+    }
+  }
+
+  [[nodiscard]] std::unique_ptr<BottomUpView> CreateBottomUpView(bool generate_summary = true) {
+    SamplingProfiler sampling_profiler(*capture_data_.GetCallstackData(), capture_data_,
+                                       generate_summary);
+    return BottomUpView::CreateFromSamplingProfiler(sampling_profiler, capture_data_);
+  }
+
+  CaptureData capture_data_;
+  uint64_t time_ = 0;
+};
+
+const BottomUpFunction* GetChild(const BottomUpNode& node, uint64_t function_address) {
+  const BottomUpFunction* child = node.GetChildOrNull(function_address);
+  EXPECT_NE(child, nullptr);
+  return child;
+}
+
+}  // namespace
+
+TEST_F(BottomUpViewTest, EmptyProfilerGivesEmptyView) {
+  std::unique_ptr<BottomUpView> view = CreateBottomUpView();
+  EXPECT_EQ(view->sample_count(), 0);
+  EXPECT_EQ(view->child_count(), 0);
+  EXPECT_TRUE(view->children().empty());
+  EXPECT_EQ(view->parent(), nullptr);
+}
+
+TEST_F(BottomUpViewTest, CallersAreTheChildrenOfTheirCallees) {
+  AddSamples(1, {kFunctionA, kFunctionB, kFunctionC}, 3);
+  AddSamples(2, {kFunctionA, kFunctionC}, 2);
+  AddSamples(2, {kFunctionD, kFunctionB, kFunctionC}, 1);
+  std::unique_ptr<BottomUpView> view = CreateBottomUpView();
+
+  EXPECT_EQ(view->sample_count(), 6);
+  ASSERT_EQ(view->child_count(), 2);
+
+  const BottomUpFunction* a = GetChild(*view, kFunctionA);
+  ASSERT_NE(a, nullptr);
+  EXPECT_EQ(a->parent(), view.get());
+  EXPECT_EQ(a->sample_count(), 5);
+  EXPECT_EQ(a->function_absolute_address(), kFunctionA);
+  EXPECT_EQ(a->function_name(), "A");
+  EXPECT_EQ(a->module_path(), "/path/to/module");
+  EXPECT_EQ(a->GetModuleName(), "module");
+  EXPECT_FLOAT_EQ(a->GetInclusivePercent(view->sample_count()), 100.0f * 5 / 6);
+  EXPECT_FLOAT_EQ(a->GetPercentOfParent(), 100.0f * 5 / 6);
+  ASSERT_EQ(a->child_count(), 2);
+
+  const BottomUpFunction* a_b = GetChild(*a, kFunctionB);
+  ASSERT_NE(a_b, nullptr);
+  EXPECT_EQ(a_b->parent(), a);
+  EXPECT_EQ(a_b->sample_count(), 3);
+  EXPECT_FLOAT_EQ(a_b->GetPercentOfParent(), 100.0f * 3 / 5);
+  ASSERT_EQ(a_b->child_count(), 1);
+  const BottomUpFunction* a_b_c = GetChild(*a_b, kFunctionC);
+  ASSERT_NE(a_b_c, nullptr);
+  EXPECT_EQ(a_b_c->sample_count(), 3);
+  EXPECT_EQ(a_b_c->child_count(), 0);
+
+  const BottomUpFunction* a_c = GetChild(*a, kFunctionC);
+  ASSERT_NE(a_c, nullptr);
+  EXPECT_EQ(a_c->sample_count(), 2);
+  EXPECT_EQ(a_c->child_count(), 0);
+
+  const BottomUpFunction* d = GetChild(*view, kFunctionD);
+  ASSERT_NE(d, nullptr);
+  EXPECT_EQ(d->sample_count(), 1);
+  ASSERT_EQ(d->child_count(), 1);
+  const BottomUpFunction* d_b = GetChild(*d, kFunctionB);
+  ASSERT_NE(d_b, nullptr);
+  EXPECT_EQ(d_b->sample_count(), 1);
+  ASSERT_EQ(d_b->child_count(), 1);
+  EXPECT_EQ(GetChild(*d_b, kFunctionC)->sample_count(), 1);
+
+  EXPECT_EQ(view->GetChildOrNull(kFunctionB), nullptr);
+  EXPECT_EQ(view->GetChildOrNull(kFunctionC), nullptr);
+}
+
+TEST_F(BottomUpViewTest, ChildrenAreTheSameEachTimeTheyAreRequested) {
+  AddSamples(1, {kFunctionA, kFunctionB}, 1);
+  AddSamples(1, {kFunctionA, kFunctionC}, 1);
+  std::unique_ptr<BottomUpView> view = CreateBottomUpView();
+
+  const BottomUpFunction* a = GetChild(*view, kFunctionA);
+  ASSERT_NE(a, nullptr);
+  std::vector<const BottomUpNode*> children = a->children();
+  EXPECT_EQ(children.size(), 2);
+  EXPECT_EQ(a->children(), children);
+  EXPECT_EQ(GetChild(*view, kFunctionA), a);
+  for (const BottomUpNode* child : children) {
+    EXPECT_EQ(child->parent(), a);
+  }
+}
+
+TEST_F(BottomUpViewTest, CallstacksOfTheSameFunctionsAreMerged) {
+  AddSamples(1, {kFunctionA, kFunctionB}, 2);
+  AddSamples(1, {kFunctionA + 0x10, kFunctionB + 0x10}, 3);
+  std::unique_ptr<BottomUpView> view = CreateBottomUpView();
+
+  ASSERT_EQ(view->child_count(), 1);
+  const BottomUpFunction* a = GetChild(*view, kFunctionA);
+  ASSERT_NE(a, nullptr);
+  EXPECT_EQ(a->sample_count(), 5);
+  ASSERT_EQ(a->child_count(), 1);
+  EXPECT_EQ(GetChild(*a, kFunctionB)->sample_count(), 5);
+}
+
+TEST_F(BottomUpViewTest, RecursiveCallsAreSeparateNodes) {
+  AddSamples(1, {kFunctionA, kFunctionA, kFunctionB}, 1);
+  std::unique_ptr<BottomUpView> view = CreateBottomUpView();
+
+  const BottomUpFunction* a = GetChild(*view, kFunctionA);
+  ASSERT_NE(a, nullptr);
+  const BottomUpFunction* a_a = GetChild(*a, kFunctionA);
+  ASSERT_NE(a_a, nullptr);
+  EXPECT_EQ(a_a->sample_count(), 1);
+  EXPECT_EQ(GetChild(*a_a, kFunctionB)->sample_count(), 1);
+}
+
+TEST_F(BottomUpViewTest, SamplesOfAllThreadsAreUsedWithoutSummary) {
+  AddSamples(1, {kFunctionA, kFunctionB}, 2);
+  AddSamples(2, {kFunctionA, kFunctionB}, 3);
+  AddSamples(3, {kFunctionC}, 1);
+  std::unique_ptr<BottomUpView> view = CreateBottomUpView(false);
+
+  EXPECT_EQ(view->sample_count(), 6);
+  ASSERT_EQ(view->child_count(), 2);
+  const BottomUpFunction* a = GetChild(*view, kFunctionA);
+  ASSERT_NE(a, nullptr);
+  EXPECT_EQ(a->sample_count(), 5);
+  EXPECT_EQ(GetChild(*a, kFunctionB)->sample_count(), 5);
+  EXPECT_EQ(GetChild(*view, kFunctionC)->sample_count(), 1);
+}
+
+TEST_F(BottomUpViewTest, UnknownFunctionsAreNamedByAddress) {
+  AddSamples(1, {kUnknownFunction, kFunctionA}, 1);
+  std::unique_ptr<BottomUpView> view = CreateBottomUpView();
+
+  const BottomUpFunction* unknown = GetChild(*view, kUnknownFunction);
+  ASSERT_NE(unknown, nullptr);
+  EXPECT_EQ(unknown->function_name(), "[unknown@0x5000]");
+  EXPECT_EQ(unknown->module_path(), CaptureData::kUnknownFunctionOrModuleName);
+  EXPECT_EQ(GetChild(*unknown, kFunctionA)->function_name(), "A");
+}
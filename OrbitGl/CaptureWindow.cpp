@@ -168,7 +168,7 @@ void CaptureWindow::Pick(PickingId a_PickingID, int a_X, int a_Y) {
 void CaptureWindow::SelectTextBox(const TextBox* text_box) {
   if (text_box == nullptr) return;
   GOrbitApp->SelectTextBox(text_box);
-  GOrbitApp->set_selected_thread_id(text_box->GetTimerInfo().thread_id());
+  GOrbitApp->set_selected_thread_id(text_box->GetTimerThreadId());
 
   const TimerInfo& timer_info = text_box->GetTimerInfo();
   uint64_t address = timer_info.function_address();
@@ -195,10 +195,10 @@ void CaptureWindow::Hover(int a_X, int a_Y) {
       tooltip = pickable->GetTooltip();
     }
   } else {
-    PickingUserData* user_data = batcher.GetUserData(pickId);
+    const PickingUserData* user_data = batcher.GetUserData(pickId);
 
-    if (user_data && user_data->generate_tooltip_) {
-      tooltip = user_data->generate_tooltip_(pickId);
+    if (user_data && user_data->tooltip_provider_) {
+      tooltip = user_data->tooltip_provider_->GetPickingTooltip(pickId);
     }
   }
 
@@ -817,3 +817,8 @@ void CaptureWindow::RenderSelectionOverlay() {
 }
 
 void CaptureWindow::Initialize() { GlCanvas::Initialize(); }
+
+void CaptureWindow::ReleaseGpuResources() {
+  GlCanvas::ReleaseGpuResources();
+  time_graph_.GetBatcher().ReleaseGpuBuffers();
+}
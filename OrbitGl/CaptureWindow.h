@@ -15,6 +15,7 @@ class CaptureWindow : public GlCanvas {
   ~CaptureWindow() override;
 
   void Initialize() override;
+  void ReleaseGpuResources() override;
   void ZoomAll();
   void Zoom(int a_Delta);
   void Pan(float a_Ratio);
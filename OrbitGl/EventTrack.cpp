@@ -61,8 +61,9 @@ void EventTrack::Draw(GlCanvas* canvas, PickingMode picking_mode) {
   canvas_ = canvas;
 }
 
-void EventTrack::UpdatePrimitives(uint64_t min_tick, uint64_t max_tick, PickingMode picking_mode) {
-  Batcher* batcher = &time_graph_->GetBatcher();
+void EventTrack::UpdatePrimitives(PrimitiveBatch* batch, uint64_t min_tick, uint64_t max_tick,
+                                  PickingMode picking_mode) {
+  Batcher* batcher = batch->GetBatcher();
   const TimeGraphLayout& layout = time_graph_->GetLayout();
   float z = GlCanvas::kZValueEvent;
   float track_height = layout.GetEventTrackHeight();
@@ -81,11 +82,11 @@ void EventTrack::UpdatePrimitives(uint64_t min_tick, uint64_t max_tick, PickingM
       }
     };
     if (thread_id_ == SamplingProfiler::kAllThreadsFakeTid) {
-      GOrbitApp->GetCaptureData().GetCallstackData()->ForEachCallstackEvent(
-          action_on_callstack_events);
+      GOrbitApp->GetCaptureData().GetCallstackData()->ForEachCallstackEventInTimeRange(
+          min_tick, max_tick, action_on_callstack_events);
     } else {
-      GOrbitApp->GetCaptureData().GetCallstackData()->ForEachCallstackEventOfTid(
-          thread_id_, action_on_callstack_events);
+      GOrbitApp->GetCaptureData().GetCallstackData()->ForEachCallstackEventOfTidInTimeRange(
+          thread_id_, min_tick, max_tick, action_on_callstack_events);
     }
 
     // Draw selected events
@@ -101,24 +102,30 @@ void EventTrack::UpdatePrimitives(uint64_t min_tick, uint64_t max_tick, PickingM
     constexpr const float kPickingBoxWidth = 9.0f;
     constexpr const float kPickingBoxOffset = (kPickingBoxWidth - 1.0f) / 2.0f;
 
-    auto action_on_callstack_events = [=](const orbit_client_protos::CallstackEvent& event) {
+    // The events passed to the action only live during the call, so they are
+    // copied to outlive the picking user data that points to them.
+    picking_callstack_events_.clear();
+    auto action_on_callstack_events = [this](const orbit_client_protos::CallstackEvent& event) {
+      picking_callstack_events_.push_back(event);
+    };
+    if (thread_id_ == SamplingProfiler::kAllThreadsFakeTid) {
+      GOrbitApp->GetCaptureData().GetCallstackData()->ForEachCallstackEventInTimeRange(
+          min_tick, max_tick, action_on_callstack_events);
+    } else {
+      GOrbitApp->GetCaptureData().GetCallstackData()->ForEachCallstackEventOfTidInTimeRange(
+          thread_id_, min_tick, max_tick, action_on_callstack_events);
+    }
+
+    for (const CallstackEvent& event : picking_callstack_events_) {
       uint64_t time = event.time();
       if (time > min_tick && time < max_tick) {
         Vec2 pos(time_graph_->GetWorldFromTick(time) - kPickingBoxOffset,
                  pos_[1] - track_height + 1);
         Vec2 size(kPickingBoxWidth, track_height);
-        auto user_data = std::make_unique<PickingUserData>(
-            nullptr, [&](PickingId id) -> std::string { return GetSampleTooltip(id); });
-        user_data->custom_data_ = &event;
-        batcher->AddShadedBox(pos, size, z, kGreenSelection, std::move(user_data));
+        PickingUserData user_data(nullptr, this);
+        user_data.custom_data_ = &event;
+        batcher->AddShadedBox(pos, size, z, kGreenSelection, user_data);
       }
-    };
-    if (thread_id_ == SamplingProfiler::kAllThreadsFakeTid) {
-      GOrbitApp->GetCaptureData().GetCallstackData()->ForEachCallstackEvent(
-          action_on_callstack_events);
-    } else {
-      GOrbitApp->GetCaptureData().GetCallstackData()->ForEachCallstackEventOfTid(
-          thread_id_, action_on_callstack_events);
     }
   }
 }
@@ -222,8 +229,8 @@ std::string EventTrack::GetSampleTooltip(PickingId id) const {
   const auto* callstack_event = static_cast<const CallstackEvent*>(user_data->custom_data_);
 
   uint64_t callstack_hash = callstack_event->callstack_hash();
-  const CallStack* callstack = callstack_data->GetCallStack(callstack_hash);
-  if (callstack == nullptr) {
+  std::optional<CallStack> callstack = callstack_data->GetCallStack(callstack_hash);
+  if (!callstack.has_value()) {
     return unknown_return_text;
   }
 
@@ -4,21 +4,26 @@
 
 #pragma once
 
+#include <vector>
+
 #include "CallstackTypes.h"
 #include "Track.h"
+#include "capture_data.pb.h"
 
 class GlCanvas;
 class TimeGraph;
 
-class EventTrack : public Track {
+class EventTrack : public Track, public PickingTooltipProvider {
  public:
   explicit EventTrack(TimeGraph* a_TimeGraph);
   Type GetType() const override { return kEventTrack; }
 
   std::string GetTooltip() const override;
+  std::string GetPickingTooltip(PickingId id) const override { return GetSampleTooltip(id); }
 
   void Draw(GlCanvas* canvas, PickingMode picking_mode) override;
-  void UpdatePrimitives(uint64_t min_tick, uint64_t max_tick, PickingMode picking_mode) override;
+  void UpdatePrimitives(PrimitiveBatch* batch, uint64_t min_tick, uint64_t max_tick,
+                        PickingMode picking_mode) override;
 
   void OnPick(int x, int y) override;
   void OnRelease() override;
@@ -37,4 +42,6 @@ class EventTrack : public Track {
   void SelectEvents();
   std::string GetSampleTooltip(PickingId id) const;
 
+  // The events of the last picking update, which its picking user data points to.
+  std::vector<orbit_client_protos::CallstackEvent> picking_callstack_events_;
 };
@@ -88,6 +88,8 @@ GlCanvas::~GlCanvas() {
   ScopeImguiContext state(m_ImGuiContext);
 }
 
+void GlCanvas::ReleaseGpuResources() { ui_batcher_.ReleaseGpuBuffers(); }
+
 void GlCanvas::Initialize() {
   static bool firstInit = true;
   if (firstInit) {
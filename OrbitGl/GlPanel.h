@@ -19,6 +19,9 @@ class GlPanel {
   virtual void Initialize();
   virtual void Resize(int a_Width, int a_Height);
   virtual void Render(int a_Width, int a_Height);
+  // Deletes what Render created on the GPU. Requires the GL context of Render
+  // to be current.
+  virtual void ReleaseGpuResources() {}
   virtual void PreRender(){};
   virtual void SetWindowOffset(int a_X, int a_Y) {
     m_WindowOffset[0] = a_X;
@@ -0,0 +1,31 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "GpuBlockBuffers.h"
+
+#include "OpenGl.h"
+
+void GpuBlockBuffers::BindBlock(size_t block_index, const void* data, uint32_t size,
+                                size_t element_size, uint32_t capacity) {
+  if (buffer_ids_.size() <= block_index) buffer_ids_.resize(block_index + 1, 0);
+  uint32_t& buffer_id = buffer_ids_[block_index];
+
+  if (buffer_id == 0) glGenBuffers(1, &buffer_id);
+  glBindBuffer(GL_ARRAY_BUFFER, buffer_id);
+  if (!upload_planner_.NeedsUpload(block_index, size)) return;
+
+  // Reallocating the storage lets the driver keep the previous one for the
+  // draw calls that still use it, instead of waiting for them.
+  glBufferData(GL_ARRAY_BUFFER, capacity * element_size, nullptr, GL_STREAM_DRAW);
+  glBufferSubData(GL_ARRAY_BUFFER, 0, size * element_size, data);
+  upload_planner_.OnUploaded(block_index, size);
+}
+
+void GpuBlockBuffers::Release() {
+  for (uint32_t buffer_id : buffer_ids_) {
+    if (buffer_id != 0) glDeleteBuffers(1, &buffer_id);
+  }
+  buffer_ids_.clear();
+  upload_planner_.Clear();
+}
@@ -0,0 +1,48 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef ORBIT_GL_GPU_BLOCK_BUFFERS_H_
+#define ORBIT_GL_GPU_BLOCK_BUFFERS_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "BlockChain.h"
+#include "GpuUploadPlanner.h"
+
+// Vertex buffer objects that keep a copy of each block of a BlockChain on the
+// GPU between frames. When a block is bound, it is only uploaded if it changed
+// since it was last uploaded, see GpuUploadPlanner, so that drawing the same
+// elements again uploads nothing, and appending elements only uploads the
+// blocks they were appended to. The buffers are not deleted on destruction, as
+// there is no GL context there: call Release while the GL context is current.
+class GpuBlockBuffers {
+ public:
+  GpuBlockBuffers() = default;
+  GpuBlockBuffers(const GpuBlockBuffers&) = delete;
+  GpuBlockBuffers& operator=(const GpuBlockBuffers&) = delete;
+
+  // Binds the buffer of the block_index-th block of a BlockChain, which is
+  // block, to GL_ARRAY_BUFFER. Requires a current GL context.
+  template <typename T, uint32_t BlockSize>
+  void BindBlock(size_t block_index, const Block<T, BlockSize>& block) {
+    BindBlock(block_index, block.data(), block.size(), sizeof(T), BlockSize);
+  }
+
+  // The BlockChain was reset.
+  void OnChainReset() { upload_planner_.OnReset(); }
+  // Deletes the buffers. Requires the GL context they were created in to be
+  // current.
+  void Release();
+
+ private:
+  void BindBlock(size_t block_index, const void* data, uint32_t size, size_t element_size,
+                 uint32_t capacity);
+
+  std::vector<uint32_t> buffer_ids_;
+  GpuUploadPlanner upload_planner_;
+};
+
+#endif  // ORBIT_GL_GPU_BLOCK_BUFFERS_H_
@@ -40,7 +40,6 @@ std::string MapGpuTimelineToTrackLabel(std::string_view timeline) {
 GpuTrack::GpuTrack(TimeGraph* time_graph, std::shared_ptr<StringManager> string_manager,
                    uint64_t timeline_hash)
     : TimerTrack(time_graph) {
-  text_renderer_ = time_graph->GetTextRenderer();
   timeline_hash_ = timeline_hash;
   string_manager_ = string_manager;
 
@@ -118,29 +117,24 @@ bool GpuTrack::TimerFilter(const TimerInfo& timer_info) const {
 }
 
 void GpuTrack::SetTimesliceText(const TimerInfo& timer_info, double elapsed_us, float min_x,
-                                TextBox* text_box) {
+                                TextBox* text_box, PrimitiveBatch* batch) {
   TimeGraphLayout layout = time_graph_->GetLayout();
-  if (text_box->GetText().empty()) {
-    std::string time = GetPrettyTime(absl::Microseconds(elapsed_us));
+  std::string time = GetPrettyTime(absl::Microseconds(elapsed_us));
 
-    text_box->SetElapsedTimeTextLength(time.length());
+  CHECK(timer_info.type() == TimerInfo::kGpuActivity);
 
-    CHECK(timer_info.type() == TimerInfo::kGpuActivity);
-
-    std::string text = absl::StrFormat(
-        "%s  %s", time_graph_->GetStringManager()->Get(timer_info.user_data_key()).value_or(""),
-        time.c_str());
-    text_box->SetText(text);
-  }
+  std::string text = absl::StrFormat(
+      "%s  %s", time_graph_->GetStringManager()->Get(timer_info.user_data_key()).value_or(""),
+      time.c_str());
 
   const Color kTextWhite(255, 255, 255, 255);
   const Vec2& box_pos = text_box->GetPos();
   const Vec2& box_size = text_box->GetSize();
   float pos_x = std::max(box_pos[0], min_x);
   float max_size = box_pos[0] + box_size[0] - pos_x;
-  text_renderer_->AddTextTrailingCharsPrioritized(
-      text_box->GetText().c_str(), pos_x, text_box->GetPos()[1] + layout.GetTextOffset(),
-      GlCanvas::kZValueText, kTextWhite, text_box->GetElapsedTimeTextLength(), max_size);
+  batch->AddTextTrailingCharsPrioritized(
+      std::move(text), pos_x, text_box->GetPos()[1] + layout.GetTextOffset(),
+      GlCanvas::kZValueText, kTextWhite, time.length(), max_size);
 }
 
 std::string GpuTrack::GetTooltip() const {
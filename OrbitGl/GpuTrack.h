@@ -13,8 +13,6 @@
 #include "TimerTrack.h"
 #include "capture_data.pb.h"
 
-class TextRenderer;
-
 namespace OrbitGl {
 
 // Maps the Linux kernel timeline names (like "gfx", "sdma0") to a more
@@ -43,7 +41,7 @@ class GpuTrack : public TimerTrack {
                                     bool is_selected) const override;
   [[nodiscard]] bool TimerFilter(const orbit_client_protos::TimerInfo& timer) const override;
   void SetTimesliceText(const orbit_client_protos::TimerInfo& timer, double elapsed_us, float min_x,
-                        TextBox* text_box) override;
+                        TextBox* text_box, PrimitiveBatch* batch) override;
   [[nodiscard]] std::string GetBoxTooltip(PickingId id) const override;
 
  private:
@@ -0,0 +1,33 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "GpuUploadPlanner.h"
+
+#include <algorithm>
+
+bool GpuUploadPlanner::NeedsUpload(size_t block_index, uint32_t size) const {
+  return block_index >= uploaded_sizes_.size() || uploaded_sizes_[block_index] != size;
+}
+
+void GpuUploadPlanner::OnUploaded(size_t block_index, uint32_t size) {
+  if (uploaded_sizes_.size() <= block_index) {
+    uploaded_sizes_.resize(block_index + 1, kNotUploaded);
+  }
+  uploaded_sizes_[block_index] = size;
+}
+
+void GpuUploadPlanner::OnReset() {
+  std::fill(uploaded_sizes_.begin(), uploaded_sizes_.end(), kNotUploaded);
+}
+
+std::vector<uint32_t> GetBoxTriangleIndices(uint32_t box_count) {
+  std::vector<uint32_t> indices;
+  indices.reserve(6 * box_count);
+  for (uint32_t first_vertex = 0; first_vertex < 4 * box_count; first_vertex += 4) {
+    for (uint32_t vertex : {0u, 1u, 2u, 0u, 2u, 3u}) {
+      indices.push_back(first_vertex + vertex);
+    }
+  }
+  return indices;
+}
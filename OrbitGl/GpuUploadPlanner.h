@@ -0,0 +1,42 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef ORBIT_GL_GPU_UPLOAD_PLANNER_H_
+#define ORBIT_GL_GPU_UPLOAD_PLANNER_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+// Decides which blocks of a BlockChain have to be uploaded again to keep their
+// copy on the GPU up to date. A BlockChain is only appended to or reset: after
+// appending, only the blocks whose size changed, from the first modified one
+// on, are uploaded again. After a reset, every block is, as new elements can
+// replace old ones without changing the size of a block. This does not use GL.
+class GpuUploadPlanner {
+ public:
+  // Returns whether the block_index-th block, which now has size elements,
+  // differs from what was last uploaded of it.
+  [[nodiscard]] bool NeedsUpload(size_t block_index, uint32_t size) const;
+  void OnUploaded(size_t block_index, uint32_t size);
+
+  // The BlockChain was reset.
+  void OnReset();
+  // The copies on the GPU are gone.
+  void Clear() { uploaded_sizes_.clear(); }
+
+ private:
+  static constexpr uint32_t kNotUploaded = std::numeric_limits<uint32_t>::max();
+
+  // The number of elements of each block when it was last uploaded, or
+  // kNotUploaded.
+  std::vector<uint32_t> uploaded_sizes_;
+};
+
+// The indices of the two triangles of each of box_count boxes of four
+// vertices, which share the diagonal from the first to the third vertex.
+[[nodiscard]] std::vector<uint32_t> GetBoxTriangleIndices(uint32_t box_count);
+
+#endif  // ORBIT_GL_GPU_UPLOAD_PLANNER_H_
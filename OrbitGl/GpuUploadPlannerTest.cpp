@@ -0,0 +1,60 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <vector>
+
+#include "GpuUploadPlanner.h"
+
+TEST(GpuUploadPlanner, UploadsNewBlocks) {
+  GpuUploadPlanner planner;
+  EXPECT_TRUE(planner.NeedsUpload(0, 10));
+  planner.OnUploaded(0, 10);
+  EXPECT_FALSE(planner.NeedsUpload(0, 10));
+  EXPECT_TRUE(planner.NeedsUpload(1, 10));
+  EXPECT_TRUE(planner.NeedsUpload(2, 0));
+}
+
+TEST(GpuUploadPlanner, OnlyUploadsBlocksAppendedTo) {
+  GpuUploadPlanner planner;
+  planner.OnUploaded(0, 100);
+  planner.OnUploaded(1, 100);
+  planner.OnUploaded(2, 40);
+
+  // An element is appended to the last block.
+  EXPECT_FALSE(planner.NeedsUpload(0, 100));
+  EXPECT_FALSE(planner.NeedsUpload(1, 100));
+  EXPECT_TRUE(planner.NeedsUpload(2, 41));
+  planner.OnUploaded(2, 41);
+  EXPECT_FALSE(planner.NeedsUpload(2, 41));
+}
+
+TEST(GpuUploadPlanner, UploadsEverythingAfterReset) {
+  GpuUploadPlanner planner;
+  planner.OnUploaded(0, 100);
+  planner.OnUploaded(1, 40);
+  planner.OnReset();
+
+  // The same number of elements was added again, which can be other elements.
+  EXPECT_TRUE(planner.NeedsUpload(0, 100));
+  EXPECT_TRUE(planner.NeedsUpload(1, 40));
+  planner.OnUploaded(0, 100);
+  EXPECT_FALSE(planner.NeedsUpload(0, 100));
+  EXPECT_TRUE(planner.NeedsUpload(1, 40));
+}
+
+TEST(GpuUploadPlanner, UploadsEverythingAfterClear) {
+  GpuUploadPlanner planner;
+  planner.OnUploaded(0, 100);
+  planner.Clear();
+  EXPECT_TRUE(planner.NeedsUpload(0, 100));
+}
+
+TEST(GpuUploadPlanner, GetBoxTriangleIndices) {
+  EXPECT_TRUE(GetBoxTriangleIndices(0).empty());
+  std::vector<uint32_t> expected{0, 1, 2, 0, 2, 3, 4, 5, 6, 4, 6, 7};
+  EXPECT_EQ(GetBoxTriangleIndices(2), expected);
+}
@@ -19,8 +19,8 @@ std::pair<uint64_t, uint64_t> ComputeMinMaxTime(
   uint64_t min_time = std::numeric_limits<uint64_t>::max();
   uint64_t max_time = std::numeric_limits<uint64_t>::min();
   for (auto& text_box : text_boxes) {
-    min_time = std::min(min_time, text_box.second->GetTimerInfo().start());
-    max_time = std::max(max_time, text_box.second->GetTimerInfo().start());
+    min_time = std::min(min_time, text_box.second->GetTimerStart());
+    max_time = std::max(max_time, text_box.second->GetTimerStart());
   }
   return std::make_pair(min_time, max_time);
 }
@@ -34,8 +34,8 @@ uint64_t AbsDiff(uint64_t a, uint64_t b) {
 }
 
 const TextBox* ClosestTo(uint64_t point, const TextBox* box_a, const TextBox* box_b) {
-  uint64_t a_diff = AbsDiff(point, box_a->GetTimerInfo().start());
-  uint64_t b_diff = AbsDiff(point, box_b->GetTimerInfo().start());
+  uint64_t a_diff = AbsDiff(point, box_a->GetTimerStart());
+  uint64_t b_diff = AbsDiff(point, box_b->GetTimerStart());
   if (a_diff <= b_diff) {
     return box_a;
   }
@@ -65,16 +65,16 @@ const TextBox* SnapToClosestStart(uint64_t absolute_function_address) {
   // marker of 'box'. In this case, the closest box can be any of two boxes:
   // 'box' or the next one. It cannot be any box before 'box' because we are
   // using the start marker to measure the distance.
-  if (box->GetTimerInfo().start() <= center) {
-    const TextBox* next_box = GCurrentTimeGraph->FindNextFunctionCall(absolute_function_address,
-                                                                      box->GetTimerInfo().end());
+  if (box->GetTimerStart() <= center) {
+    const TextBox* next_box =
+        GCurrentTimeGraph->FindNextFunctionCall(absolute_function_address, box->GetTimerEnd());
     return ClosestTo(center, box, next_box);
   }
 
   // The center is to the left of 'box', so the closest box is either 'box' or
   // the next box to the left of the center.
-  const TextBox* previous_box = GCurrentTimeGraph->FindPreviousFunctionCall(
-      absolute_function_address, box->GetTimerInfo().start());
+  const TextBox* previous_box =
+      GCurrentTimeGraph->FindPreviousFunctionCall(absolute_function_address, box->GetTimerStart());
 
   if (!previous_box) {
     return box;
@@ -102,13 +102,13 @@ bool LiveFunctionsController::OnAllNextButton() {
     const FunctionInfo* function = it.second;
     auto function_address = FunctionUtils::GetAbsoluteAddress(*function);
     const TextBox* current_box = current_textboxes_.find(it.first)->second;
-    const TextBox* box = GCurrentTimeGraph->FindNextFunctionCall(function_address,
-                                                                 current_box->GetTimerInfo().end());
+    const TextBox* box =
+        GCurrentTimeGraph->FindNextFunctionCall(function_address, current_box->GetTimerEnd());
     if (box == nullptr) {
       return false;
     }
-    if (box->GetTimerInfo().start() < min_timestamp) {
-      min_timestamp = box->GetTimerInfo().start();
+    if (box->GetTimerStart() < min_timestamp) {
+      min_timestamp = box->GetTimerStart();
       id_with_min_timestamp = it.first;
     }
     next_boxes.insert(std::make_pair(it.first, box));
@@ -129,13 +129,13 @@ bool LiveFunctionsController::OnAllPreviousButton() {
     const FunctionInfo* function = it.second;
     auto function_address = FunctionUtils::GetAbsoluteAddress(*function);
     const TextBox* current_box = current_textboxes_.find(it.first)->second;
-    const TextBox* box = GCurrentTimeGraph->FindPreviousFunctionCall(
-        function_address, current_box->GetTimerInfo().end());
+    const TextBox* box =
+        GCurrentTimeGraph->FindPreviousFunctionCall(function_address, current_box->GetTimerEnd());
     if (box == nullptr) {
       return false;
     }
-    if (box->GetTimerInfo().start() < min_timestamp) {
-      min_timestamp = box->GetTimerInfo().start();
+    if (box->GetTimerStart() < min_timestamp) {
+      min_timestamp = box->GetTimerStart();
       id_with_min_timestamp = it.first;
     }
     next_boxes.insert(std::make_pair(it.first, box));
@@ -151,7 +151,7 @@ bool LiveFunctionsController::OnAllPreviousButton() {
 void LiveFunctionsController::OnNextButton(uint64_t id) {
   auto function_address = FunctionUtils::GetAbsoluteAddress(*(function_iterators_[id]));
   const TextBox* text_box = GCurrentTimeGraph->FindNextFunctionCall(
-      function_address, current_textboxes_[id]->GetTimerInfo().end());
+      function_address, current_textboxes_[id]->GetTimerEnd());
   // If text_box is nullptr, then we have reached the right end of the timeline.
   if (text_box != nullptr) {
     current_textboxes_[id] = text_box;
@@ -162,7 +162,7 @@ void LiveFunctionsController::OnNextButton(uint64_t id) {
 void LiveFunctionsController::OnPreviousButton(uint64_t id) {
   auto function_address = FunctionUtils::GetAbsoluteAddress(*(function_iterators_[id]));
   const TextBox* text_box = GCurrentTimeGraph->FindPreviousFunctionCall(
-      function_address, current_textboxes_[id]->GetTimerInfo().end());
+      function_address, current_textboxes_[id]->GetTimerEnd());
   // If text_box is nullptr, then we have reached the left end of the timeline.
   if (text_box != nullptr) {
     current_textboxes_[id] = text_box;
@@ -194,7 +194,7 @@ void LiveFunctionsController::AddIterator(FunctionInfo* function) {
   // If no box is currently selected or the selected box is a different
   // function, we search for the closest box to the current center of the
   // screen.
-  if (!box || box->GetTimerInfo().function_address() != function_address) {
+  if (!box || box->GetTimerFunctionAddress() != function_address) {
     box = SnapToClosestStart(function_address);
   }
 
@@ -210,7 +210,7 @@ void LiveFunctionsController::AddIterator(FunctionInfo* function) {
 uint64_t LiveFunctionsController::GetStartTime(uint64_t index) {
   const auto& it = current_textboxes_.find(index);
   if (it != current_textboxes_.end()) {
-    return it->second->GetTimerInfo().start();
+    return it->second->GetTimerStart();
   }
   return GetCaptureMin();
 }
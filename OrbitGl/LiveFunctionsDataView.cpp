@@ -316,14 +316,14 @@ std::pair<TextBox*, TextBox*> LiveFunctionsDataView::GetMinMax(const FunctionInf
     for (auto& block : *chain) {
       for (size_t i = 0; i < block.size(); i++) {
         TextBox& box = block[i];
-        if (box.GetTimerInfo().function_address() == function_address) {
-          uint64_t elapsed_nanos = box.GetTimerInfo().end() - box.GetTimerInfo().start();
+        if (block.GetFunctionAddress(i) == function_address) {
+          uint64_t elapsed_nanos = block.GetEnd(i) - block.GetStart(i);
           if (min_box == nullptr ||
-              elapsed_nanos < (min_box->GetTimerInfo().end() - min_box->GetTimerInfo().start())) {
+              elapsed_nanos < (min_box->GetTimerEnd() - min_box->GetTimerStart())) {
             min_box = &box;
           }
           if (max_box == nullptr ||
-              elapsed_nanos > (max_box->GetTimerInfo().end() - max_box->GetTimerInfo().start())) {
+              elapsed_nanos > (max_box->GetTimerEnd() - max_box->GetTimerStart())) {
             max_box = &box;
           }
         }
@@ -0,0 +1,112 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "PrimitiveBatch.h"
+
+#include <algorithm>
+#include <atomic>
+#include <utility>
+
+#include "OrbitBase/Logging.h"
+#include "absl/time/time.h"
+
+void PrimitiveBatch::AddTextTrailingCharsPrioritized(std::string text, float x, float y, float z,
+                                                     const Color& color,
+                                                     size_t trailing_chars_length, float max_size) {
+  texts_.push_back(Text{std::move(text), x, y, z, color, trailing_chars_length, max_size});
+}
+
+PrimitiveBatch::Mark PrimitiveBatch::GetMark() const {
+  Mark mark;
+  mark.batcher_mark = batcher_.GetMark();
+  mark.text_count = texts_.size();
+  return mark;
+}
+
+void PrimitiveBatch::MoveTo(const Mark& begin, const Mark& end, Batcher* batcher,
+                            const std::function<void(const Text&)>& add_text) {
+  batcher->MoveElementsFrom(&batcher_, begin.batcher_mark, end.batcher_mark);
+  CHECK(end.text_count <= texts_.size());
+  for (size_t i = begin.text_count; i < end.text_count; ++i) {
+    add_text(texts_[i]);
+  }
+}
+
+void PrimitiveBatch::StartNewFrame() {
+  batcher_.StartNewFrame();
+  texts_.clear();
+}
+
+ParallelPrimitiveGenerator::ParallelPrimitiveGenerator(size_t thread_count) {
+  CHECK(thread_count > 0);
+  for (size_t i = 0; i < thread_count; ++i) {
+    batches_.push_back(std::make_unique<PrimitiveBatch>());
+  }
+  if (thread_count > 1) {
+    thread_pool_ = ThreadPool::Create(thread_count - 1, thread_count - 1, absl::Seconds(1));
+  }
+}
+
+ParallelPrimitiveGenerator::~ParallelPrimitiveGenerator() {
+  if (thread_pool_ != nullptr) {
+    thread_pool_->ShutdownAndWait();
+  }
+}
+
+void ParallelPrimitiveGenerator::SetPickingManager(PickingManager* picking_manager) {
+  for (auto& batch : batches_) {
+    batch->GetBatcher()->SetPickingManager(picking_manager);
+  }
+}
+
+void ParallelPrimitiveGenerator::StartNewFrame(size_t item_count) {
+  for (auto& batch : batches_) {
+    batch->StartNewFrame();
+  }
+  item_primitives_.assign(item_count, ItemPrimitives{});
+}
+
+void ParallelPrimitiveGenerator::Generate(
+    size_t begin, size_t end,
+    const std::function<void(size_t item, PrimitiveBatch* batch)>& generate) {
+  CHECK(begin <= end && end <= item_primitives_.size());
+  std::atomic<size_t> next_item = begin;
+  auto generate_items = [this, end, &next_item, &generate](size_t batch_index) {
+    PrimitiveBatch* batch = batches_[batch_index].get();
+    for (size_t item = next_item++; item < end; item = next_item++) {
+      ItemPrimitives& item_primitives = item_primitives_[item];
+      item_primitives.batch_index = batch_index;
+      item_primitives.begin = batch->GetMark();
+      generate(item, batch);
+      item_primitives.end = batch->GetMark();
+    }
+  };
+
+  size_t thread_count = std::min(batches_.size(), end - begin);
+  {
+    absl::MutexLock lock{&mutex_};
+    running_helper_count_ = thread_count > 0 ? thread_count - 1 : 0;
+  }
+  for (size_t batch_index = 1; batch_index < thread_count; ++batch_index) {
+    thread_pool_->Schedule([this, &generate_items, batch_index] {
+      generate_items(batch_index);
+      absl::MutexLock lock{&mutex_};
+      --running_helper_count_;
+    });
+  }
+  generate_items(0);
+
+  absl::MutexLock lock{&mutex_};
+  mutex_.Await(absl::Condition(
+      +[](size_t* running_helper_count) { return *running_helper_count == 0; },
+      &running_helper_count_));
+}
+
+void ParallelPrimitiveGenerator::MergeInto(
+    Batcher* batcher, const std::function<void(const PrimitiveBatch::Text&)>& add_text) {
+  for (const ItemPrimitives& item_primitives : item_primitives_) {
+    batches_[item_primitives.batch_index]->MoveTo(item_primitives.begin, item_primitives.end,
+                                                  batcher, add_text);
+  }
+}
@@ -0,0 +1,105 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef ORBIT_GL_PRIMITIVE_BATCH_H_
+#define ORBIT_GL_PRIMITIVE_BATCH_H_
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "Batcher.h"
+#include "CoreMath.h"
+#include "OrbitBase/ThreadPool.h"
+#include "PickingManager.h"
+#include "absl/synchronization/mutex.h"
+
+// Primitives that are generated on a worker thread, to be merged later into the
+// Batcher and the TextRenderer of the main thread. Text is only recorded, as a
+// TextRenderer can only be used on the main thread.
+class PrimitiveBatch {
+ public:
+  struct Text {
+    std::string text;
+    float x;
+    float y;
+    float z;
+    Color color;
+    size_t trailing_chars_length;
+    float max_size;
+  };
+
+  struct Mark {
+    Batcher::Mark batcher_mark;
+    size_t text_count = 0;
+  };
+
+  explicit PrimitiveBatch(PickingManager* picking_manager = nullptr)
+      : batcher_(BatcherId::kTimeGraph, picking_manager) {}
+
+  [[nodiscard]] Batcher* GetBatcher() { return &batcher_; }
+  // Records the arguments of TextRenderer::AddTextTrailingCharsPrioritized.
+  void AddTextTrailingCharsPrioritized(std::string text, float x, float y, float z,
+                                       const Color& color, size_t trailing_chars_length,
+                                       float max_size);
+
+  [[nodiscard]] Mark GetMark() const;
+  // Moves the elements added between begin and end to batcher, and passes the
+  // texts added between begin and end to add_text.
+  void MoveTo(const Mark& begin, const Mark& end, Batcher* batcher,
+              const std::function<void(const Text&)>& add_text);
+
+  void StartNewFrame();
+
+ private:
+  Batcher batcher_;
+  std::vector<Text> texts_;
+};
+
+// Generates the primitives of a sequence of items, e.g., the tracks of the
+// TimeGraph, on several threads, each into its own PrimitiveBatch. The threads
+// take the next item when they are done with one. The primitives are then
+// merged in the order of the items, which gives the same result as generating
+// the items one after the other into one Batcher.
+class ParallelPrimitiveGenerator {
+ public:
+  // The calling thread is one of the thread_count threads.
+  explicit ParallelPrimitiveGenerator(size_t thread_count);
+  ParallelPrimitiveGenerator(const ParallelPrimitiveGenerator&) = delete;
+  ParallelPrimitiveGenerator& operator=(const ParallelPrimitiveGenerator&) = delete;
+  ~ParallelPrimitiveGenerator();
+
+  void SetPickingManager(PickingManager* picking_manager);
+
+  // Discards the primitives of the previous frame. The items of the new frame
+  // are 0 to item_count, excluded.
+  void StartNewFrame(size_t item_count);
+  // Calls generate for the items from begin to end, excluded, and returns when
+  // all are generated. What was generated before for these items in the frame
+  // is replaced.
+  void Generate(size_t begin, size_t end,
+                const std::function<void(size_t item, PrimitiveBatch* batch)>& generate);
+  // Moves the primitives of all items to batcher, and passes their texts to
+  // add_text, in the order of the items.
+  void MergeInto(Batcher* batcher,
+                 const std::function<void(const PrimitiveBatch::Text&)>& add_text);
+
+ private:
+  struct ItemPrimitives {
+    size_t batch_index = 0;
+    PrimitiveBatch::Mark begin;
+    PrimitiveBatch::Mark end;
+  };
+
+  std::vector<std::unique_ptr<PrimitiveBatch>> batches_;
+  std::unique_ptr<ThreadPool> thread_pool_;
+  std::vector<ItemPrimitives> item_primitives_;
+
+  absl::Mutex mutex_;
+  // The threads of the pool that are still generating in Generate.
+  size_t running_helper_count_ ABSL_GUARDED_BY(mutex_) = 0;
+};
+
+#endif  // ORBIT_GL_PRIMITIVE_BATCH_H_
@@ -0,0 +1,211 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Batcher.h"
+#include "PickingManagerTest.h"
+#include "PrimitiveBatch.h"
+#include "absl/strings/str_format.h"
+
+namespace {
+
+constexpr size_t kItemCount = 200;
+constexpr size_t kMaxElementsPerItem = 13;
+
+// Exposes what was added to a Batcher, in the order it is drawn.
+class InspectableBatcher : public Batcher {
+ public:
+  explicit InspectableBatcher(PickingManager* picking_manager)
+      : Batcher(BatcherId::kTimeGraph, picking_manager) {}
+
+  [[nodiscard]] std::vector<Vec3> GetVertices() const {
+    std::vector<Vec3> vertices;
+    for (const Line& line : line_buffer_.lines_) {
+      vertices.push_back(line.start_point);
+      vertices.push_back(line.end_point);
+    }
+    for (const Box& box : box_buffer_.boxes_) {
+      vertices.insert(vertices.end(), std::begin(box.vertices), std::end(box.vertices));
+    }
+    for (const Triangle& triangle : triangle_buffer_.triangles_) {
+      vertices.insert(vertices.end(), std::begin(triangle.vertices), std::end(triangle.vertices));
+    }
+    return vertices;
+  }
+
+  [[nodiscard]] std::vector<Color> GetColors(bool picking) const {
+    std::vector<Color> colors;
+    for (const Color& color : picking ? line_buffer_.picking_colors_ : line_buffer_.colors_) {
+      colors.push_back(color);
+    }
+    for (const Color& color : picking ? box_buffer_.picking_colors_ : box_buffer_.colors_) {
+      colors.push_back(color);
+    }
+    for (const Color& color :
+         picking ? triangle_buffer_.picking_colors_ : triangle_buffer_.colors_) {
+      colors.push_back(color);
+    }
+    return colors;
+  }
+
+  [[nodiscard]] std::vector<const void*> GetCustomData() const {
+    std::vector<const void*> custom_data;
+    for (const PickingUserData& user_data : user_data_) {
+      custom_data.push_back(user_data.custom_data_);
+    }
+    return custom_data;
+  }
+};
+
+// Adds a different mix of lines, boxes and triangles, picked by their user data
+// or by a Pickable, and of texts for every item. Some items add nothing.
+template <typename AddText>
+void AddItemPrimitives(size_t item, const std::vector<int>& custom_data,
+                       const std::shared_ptr<Pickable>& pickable, Batcher* batcher,
+                       AddText add_text) {
+  float y = static_cast<float>(item);
+  for (size_t k = 0; k < item % kMaxElementsPerItem; ++k) {
+    float x = static_cast<float>(k);
+    Color color(static_cast<uint8_t>(item), static_cast<uint8_t>(k), 0, 255);
+    PickingUserData user_data;
+    user_data.custom_data_ = &custom_data[item * kMaxElementsPerItem + k];
+    switch ((item + k) % 5) {
+      case 0:
+        batcher->AddLine(Vec2(x, y), Vec2(x + 1, y), 0, color, user_data);
+        break;
+      case 1:
+        batcher->AddShadedBox(Vec2(x, y), Vec2(1, 1), 0, color, user_data);
+        break;
+      case 2:
+        batcher->AddTriangle(Triangle(Vec3(x, y, 0), Vec3(x + 1, y, 0), Vec3(x, y + 1, 0)), color,
+                             user_data);
+        break;
+      case 3:
+        batcher->AddBox(Box(Vec2(x, y), Vec2(1, 1), 0), color, pickable);
+        break;
+      case 4:
+        batcher->AddLine(Vec2(x, y), Vec2(x, y + 1), 0, color, pickable);
+        break;
+    }
+    if (k % 4 == 0) {
+      add_text(absl::StrFormat("item %u element %u", item, k), x, y);
+    }
+  }
+}
+
+struct AddedText {
+  std::string text;
+  float x;
+  float y;
+
+  bool operator==(const AddedText& other) const {
+    return text == other.text && x == other.x && y == other.y;
+  }
+};
+
+void ExpectSamePrimitives(const InspectableBatcher& batcher,
+                          const InspectableBatcher& expected_batcher) {
+  EXPECT_EQ(batcher.GetVertices(), expected_batcher.GetVertices());
+  EXPECT_EQ(batcher.GetColors(false), expected_batcher.GetColors(false));
+  EXPECT_EQ(batcher.GetColors(true), expected_batcher.GetColors(true));
+  EXPECT_EQ(batcher.GetCustomData(), expected_batcher.GetCustomData());
+}
+
+class ParallelPrimitiveGeneratorTest : public testing::Test {
+ protected:
+  ParallelPrimitiveGeneratorTest()
+      : custom_data_(kItemCount * kMaxElementsPerItem),
+        pickable_(std::make_shared<PickableMock>()),
+        serial_batcher_(&picking_manager_),
+        merged_batcher_(&picking_manager_) {
+    for (size_t item = 0; item < kItemCount; ++item) {
+      AddItemPrimitives(item, custom_data_, pickable_, &serial_batcher_,
+                        [this](std::string text, float x, float y) {
+                          serial_texts_.push_back(AddedText{std::move(text), x, y});
+                        });
+    }
+  }
+
+  void Generate(ParallelPrimitiveGenerator* generator, size_t begin, size_t end) {
+    generator->Generate(begin, end, [this](size_t item, PrimitiveBatch* batch) {
+      // Lets the other threads take items too, even on a single core.
+      std::this_thread::sleep_for(std::chrono::microseconds(10));
+      AddItemPrimitives(item, custom_data_, pickable_, batch->GetBatcher(),
+                        [batch](std::string text, float x, float y) {
+                          batch->AddTextTrailingCharsPrioritized(std::move(text), x, y, 0,
+                                                                 Color(255, 255, 255, 255), 0, -1);
+                        });
+    });
+  }
+
+  void MergeAndExpectSameAsSerial(ParallelPrimitiveGenerator* generator) {
+    std::vector<AddedText> merged_texts;
+    generator->MergeInto(&merged_batcher_, [&merged_texts](const PrimitiveBatch::Text& text) {
+      merged_texts.push_back(AddedText{text.text, text.x, text.y});
+    });
+    ExpectSamePrimitives(merged_batcher_, serial_batcher_);
+    EXPECT_EQ(merged_texts, serial_texts_);
+  }
+
+  std::vector<int> custom_data_;
+  PickingManager picking_manager_;
+  std::shared_ptr<Pickable> pickable_;
+  InspectableBatcher serial_batcher_;
+  std::vector<AddedText> serial_texts_;
+  InspectableBatcher merged_batcher_;
+};
+
+}  // namespace
+
+TEST_F(ParallelPrimitiveGeneratorTest, MergedPrimitivesAreTheSerialPrimitives) {
+  for (size_t thread_count : {1, 2, 4, 16}) {
+    ParallelPrimitiveGenerator generator{thread_count};
+    generator.SetPickingManager(&picking_manager_);
+    // The second frame reuses the batches of the first one.
+    for (int frame = 0; frame < 2; ++frame) {
+      merged_batcher_.StartNewFrame();
+      generator.StartNewFrame(kItemCount);
+      Generate(&generator, 0, kItemCount);
+      MergeAndExpectSameAsSerial(&generator);
+    }
+  }
+}
+
+TEST_F(ParallelPrimitiveGeneratorTest, GeneratingItemsAgainReplacesTheirPrimitives) {
+  ParallelPrimitiveGenerator generator{4};
+  generator.SetPickingManager(&picking_manager_);
+  generator.StartNewFrame(kItemCount);
+  Generate(&generator, 0, kItemCount);
+  Generate(&generator, kItemCount / 3, kItemCount);
+  Generate(&generator, kItemCount - 1, kItemCount);
+  MergeAndExpectSameAsSerial(&generator);
+}
+
+TEST_F(ParallelPrimitiveGeneratorTest, PickingColorsOfMergedPrimitivesFindTheirUserData) {
+  ParallelPrimitiveGenerator generator{4};
+  generator.SetPickingManager(&picking_manager_);
+  generator.StartNewFrame(kItemCount);
+  Generate(&generator, 0, kItemCount);
+  generator.MergeInto(&merged_batcher_, [](const PrimitiveBatch::Text& /*text*/) {});
+
+  std::vector<Color> picking_colors = merged_batcher_.GetColors(true);
+  ASSERT_FALSE(picking_colors.empty());
+  for (const Color& picking_color : picking_colors) {
+    PickingId id = MockRenderPickingColor(picking_color);
+    if (id.type == PickingType::kPickable) {
+      EXPECT_EQ(picking_manager_.GetPickableFromId(id), pickable_);
+    } else {
+      const PickingUserData* user_data = merged_batcher_.GetUserData(id);
+      ASSERT_NE(user_data, nullptr);
+      EXPECT_NE(user_data->custom_data_, nullptr);
+    }
+  }
+}
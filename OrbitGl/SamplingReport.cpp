@@ -5,11 +5,12 @@
 #include "SamplingReport.h"
 
 #include "CallStackDataView.h"
+#include "absl/container/flat_hash_set.h"
 #include "absl/strings/str_format.h"
 
 SamplingReport::SamplingReport(
     SamplingProfiler sampling_profiler,
-    absl::flat_hash_map<CallstackID, std::shared_ptr<CallStack>> unique_callstacks,
+    std::shared_ptr<const CallstackTrie> unique_callstacks,
     bool has_summary)
     : profiler_{std::move(sampling_profiler)},
       unique_callstacks_{std::move(unique_callstacks)},
@@ -19,7 +20,18 @@ SamplingReport::SamplingReport(
   callstack_data_view_ = nullptr;
   selected_sorted_callstack_report_ = nullptr;
   selected_callstack_index_ = 0;
-  FillReport();
+  FillReport(profiler_);
+}
+
+SamplingReport::SamplingReport(std::shared_ptr<SharedSamplingProfiler> shared_profiler)
+    : shared_profiler_{std::move(shared_profiler)}, has_summary_{true} {
+  selected_address_ = 0;
+  selected_thread_id_ = 0;
+  callstack_data_view_ = nullptr;
+  selected_sorted_callstack_report_ = nullptr;
+  selected_callstack_index_ = 0;
+  absl::MutexLock lock(&shared_profiler_->mutex);
+  FillReport(shared_profiler_->profiler);
 }
 
 void SamplingReport::ClearReport() {
@@ -30,8 +42,8 @@ void SamplingReport::ClearReport() {
   }
 }
 
-void SamplingReport::FillReport() {
-  const auto& sample_data = profiler_.GetThreadSampleData();
+void SamplingReport::FillReport(const SamplingProfiler& profiler) {
+  const auto& sample_data = profiler.GetThreadSampleData();
 
   for (const ThreadSampleData& thread_sample_data : sample_data) {
     SamplingReportDataView thread_report;
@@ -43,8 +55,14 @@ void SamplingReport::FillReport() {
 }
 
 void SamplingReport::UpdateDisplayedCallstack() {
-  selected_sorted_callstack_report_ =
-      profiler_.GetSortedCallstacksFromAddress(selected_address_, selected_thread_id_);
+  if (shared_profiler_ != nullptr) {
+    absl::MutexLock lock(&shared_profiler_->mutex);
+    selected_sorted_callstack_report_ = shared_profiler_->profiler.GetSortedCallstacksFromAddress(
+        selected_address_, selected_thread_id_);
+  } else {
+    selected_sorted_callstack_report_ =
+        profiler_.GetSortedCallstacksFromAddress(selected_address_, selected_thread_id_);
+  }
   if (selected_sorted_callstack_report_->callstacks_count.empty()) {
     ClearReport();
   } else {
@@ -54,9 +72,10 @@ void SamplingReport::UpdateDisplayedCallstack() {
 
 void SamplingReport::UpdateReport(
     SamplingProfiler profiler,
-    absl::flat_hash_map<CallstackID, std::shared_ptr<CallStack>> unique_callstacks) {
+    std::shared_ptr<const CallstackTrie> unique_callstacks) {
   unique_callstacks_ = std::move(unique_callstacks);
   profiler_ = std::move(profiler);
+  shared_profiler_ = nullptr;
 
   for (SamplingReportDataView& thread_report : thread_reports_) {
     ThreadID thread_id = thread_report.GetThreadID();
@@ -73,6 +92,26 @@ void SamplingReport::UpdateReport(
   UpdateDisplayedCallstack();
 }
 
+void SamplingReport::UpdateReport(const std::vector<ThreadID>& updated_thread_ids) {
+  CHECK(shared_profiler_ != nullptr);
+  absl::flat_hash_set<ThreadID> updated_thread_id_set(updated_thread_ids.begin(),
+                                                      updated_thread_ids.end());
+  {
+    absl::MutexLock lock(&shared_profiler_->mutex);
+    for (SamplingReportDataView& thread_report : thread_reports_) {
+      ThreadID thread_id = thread_report.GetThreadID();
+      if (!updated_thread_id_set.contains(thread_id)) continue;
+      const ThreadSampleData* thread_sample_data =
+          shared_profiler_->profiler.GetThreadSampleDataByThreadId(thread_id);
+      if (thread_sample_data != nullptr) {
+        thread_report.SetSampledFunctions(thread_sample_data->sampled_function);
+      }
+    }
+  }
+
+  UpdateDisplayedCallstack();
+}
+
 void SamplingReport::OnSelectAddress(uint64_t address, ThreadID thread_id) {
   if (callstack_data_view_) {
     if (selected_address_ != address || selected_thread_id_ != thread_id) {
@@ -128,10 +167,17 @@ void SamplingReport::OnCallstackIndexChanged(size_t index) {
   if (index < selected_sorted_callstack_report_->callstacks_count.size()) {
     const CallstackCount& cs = selected_sorted_callstack_report_->callstacks_count[index];
     selected_callstack_index_ = index;
-    auto it = unique_callstacks_.find(cs.callstack_id);
-    CHECK(it != unique_callstacks_.end());
-    callstack_data_view_->SetCallStack(*it->second);
+    std::optional<CallStack> callstack = GetUniqueCallstacks()->GetCallstack(cs.callstack_id);
+    CHECK(callstack.has_value());
+    callstack_data_view_->SetCallStack(callstack.value());
   } else {
     selected_callstack_index_ = 0;
   }
 }
+
+std::shared_ptr<const CallstackTrie> SamplingReport::GetUniqueCallstacks() const {
+  if (shared_profiler_ != nullptr) {
+    return shared_profiler_->callstack_data->GetUniqueCallstacks();
+  }
+  return unique_callstacks_;
+}
@@ -12,18 +12,37 @@
 #include <vector>
 
 #include "CallstackData.h"
+#include "CallstackTrie.h"
 #include "CallstackTypes.h"
 #include "SamplingProfiler.h"
 #include "SamplingReportDataView.h"
+#include "absl/base/thread_annotations.h"
+#include "absl/synchronization/mutex.h"
+
+// A SamplingProfiler that a thread keeps updating, e.g., during a capture, and
+// that reports read from. The callstacks of its samples are in callstack_data.
+struct SharedSamplingProfiler {
+  explicit SharedSamplingProfiler(const CallstackData* callstack_data)
+      : callstack_data{callstack_data} {}
+
+  absl::Mutex mutex;
+  SamplingProfiler profiler ABSL_GUARDED_BY(mutex);
+  const CallstackData* callstack_data;
+};
 
 class SamplingReport {
  public:
   explicit SamplingReport(
       SamplingProfiler sampling_profiler,
-      absl::flat_hash_map<CallstackID, std::shared_ptr<CallStack>> unique_callstacks,
+      std::shared_ptr<const CallstackTrie> unique_callstacks,
       bool has_summary = true);
+  // Reads the profiler and the callstacks when it needs them, instead of
+  // holding copies of them.
+  explicit SamplingReport(std::shared_ptr<SharedSamplingProfiler> shared_profiler);
   void UpdateReport(SamplingProfiler profiler,
-                    absl::flat_hash_map<CallstackID, std::shared_ptr<CallStack>> unique_callstacks);
+                    std::shared_ptr<const CallstackTrie> unique_callstacks);
+  // Updates the threads of updated_thread_ids from the shared profiler.
+  void UpdateReport(const std::vector<ThreadID>& updated_thread_ids);
   [[nodiscard]] std::vector<SamplingReportDataView>& GetThreadReports() { return thread_reports_; };
   void SetCallstackDataView(CallStackDataView* data_view) { callstack_data_view_ = data_view; };
   void OnSelectAddress(uint64_t address, ThreadID thread_id);
@@ -32,18 +51,21 @@ class SamplingReport {
   [[nodiscard]] std::string GetSelectedCallstackString() const;
   void SetUiRefreshFunc(std::function<void()> func) { ui_refresh_func_ = std::move(func); };
   [[nodiscard]] bool HasCallstacks() const { return selected_sorted_callstack_report_ != nullptr; };
-  [[nodiscard]] bool HasSamples() const { return !unique_callstacks_.empty(); }
+  [[nodiscard]] bool HasSamples() const { return GetUniqueCallstacks()->GetCallstackCount() > 0; }
   [[nodiscard]] bool has_summary() const { return has_summary_; }
   void ClearReport();
 
  protected:
-  void FillReport();
+  void FillReport(const SamplingProfiler& profiler);
   void OnCallstackIndexChanged(size_t index);
   void UpdateDisplayedCallstack();
+  [[nodiscard]] std::shared_ptr<const CallstackTrie> GetUniqueCallstacks() const;
 
  protected:
   SamplingProfiler profiler_;
-  absl::flat_hash_map<CallstackID, std::shared_ptr<CallStack>> unique_callstacks_;
+  std::shared_ptr<const CallstackTrie> unique_callstacks_;
+  // Replaces profiler_ and unique_callstacks_ when set.
+  std::shared_ptr<SharedSamplingProfiler> shared_profiler_;
   std::vector<SamplingReportDataView> thread_reports_;
   CallStackDataView* callstack_data_view_;
 
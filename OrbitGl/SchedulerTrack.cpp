@@ -71,6 +71,6 @@ std::string SchedulerTrack::GetBoxTooltip(PickingId id) const {
       "<b>Core:</b> %d<br/>"
       "<b>Thread:</b> %s [%d]<br/>",
       text_box->GetTimerInfo().processor(),
-      GOrbitApp->GetCaptureData().GetThreadName(text_box->GetTimerInfo().thread_id()),
-      text_box->GetTimerInfo().thread_id());
+      GOrbitApp->GetCaptureData().GetThreadName(text_box->GetTimerThreadId()),
+      text_box->GetTimerThreadId());
 }
@@ -4,7 +4,32 @@
 
 #include "TextBox.h"
 
-TextBox::TextBox() : pos_(Vec2::Zero()), size_(Vec2(100.f, 10.f)), elapsed_time_text_length_(0) {}
+#include "TimerChain.h"
 
-TextBox::TextBox(const Vec2& pos, const Vec2& size, const std::string& text)
-    : pos_(pos), size_(size), text_(text), elapsed_time_text_length_(0) {}
\ No newline at end of file
+using orbit_client_protos::TimerInfo;
+
+size_t TextBox::GetIndexInBlock() const { return this - &(*block_)[0]; }
+
+TimerInfo TextBox::GetTimerInfo() const {
+  TimerInfo timer_info;
+  if (block_ != nullptr) {
+    block_->GetTimerInfo(GetIndexInBlock(), &timer_info);
+  }
+  return timer_info;
+}
+
+uint64_t TextBox::GetTimerStart() const {
+  return block_ != nullptr ? block_->GetStart(GetIndexInBlock()) : 0;
+}
+
+uint64_t TextBox::GetTimerEnd() const {
+  return block_ != nullptr ? block_->GetEnd(GetIndexInBlock()) : 0;
+}
+
+uint64_t TextBox::GetTimerFunctionAddress() const {
+  return block_ != nullptr ? block_->GetFunctionAddress(GetIndexInBlock()) : 0;
+}
+
+int32_t TextBox::GetTimerThreadId() const {
+  return block_ != nullptr ? block_->GetThreadId(GetIndexInBlock()) : 0;
+}
@@ -8,13 +8,14 @@
 #include "CoreMath.h"
 #include "capture_data.pb.h"
 
-class TextRenderer;
+class TimerBlock;
 
+// A box on screen. The boxes of the timers of a TimerTrack are owned by a
+// TimerBlock (see TimerChain.h), which stores the timers themselves.
 class TextBox {
  public:
-  TextBox() : pos_(Vec2::Zero()), size_(Vec2(100.f, 10.f)), elapsed_time_text_length_(0){};
-  TextBox(const Vec2& pos, const Vec2& size, const std::string& text = "")
-      : pos_(pos), size_(size), text_(text), elapsed_time_text_length_(0) {}
+  TextBox() : pos_(Vec2::Zero()), size_(Vec2(100.f, 10.f)) {}
+  TextBox(const Vec2& pos, const Vec2& size) : pos_(pos), size_(size) {}
 
   void SetSize(const Vec2& size) { size_ = size; }
   void SetPos(const Vec2& pos) { pos_ = pos; }
@@ -22,26 +23,24 @@ class TextBox {
   const Vec2& GetSize() const { return size_; }
   const Vec2& GetPos() const { return pos_; }
 
-  const std::string& GetText() const { return text_; }
-  void SetText(std::string text) { text_ = std::move(text); }
+  // Materializes the timer of this box, or returns an empty TimerInfo if the
+  // box has no timer.
+  [[nodiscard]] orbit_client_protos::TimerInfo GetTimerInfo() const;
+  // Cheaper than GetTimerInfo() for code that only needs a few fields.
+  [[nodiscard]] uint64_t GetTimerStart() const;
+  [[nodiscard]] uint64_t GetTimerEnd() const;
+  [[nodiscard]] uint64_t GetTimerFunctionAddress() const;
+  [[nodiscard]] int32_t GetTimerThreadId() const;
 
-  void SetTimerInfo(const orbit_client_protos::TimerInfo& timer_info) {
-    if (timer_info.end() == 0 && timer_info.start() == 0) {
-      return;
-    }
-    timer_info_ = timer_info;
-  }
-  const orbit_client_protos::TimerInfo& GetTimerInfo() const { return timer_info_; }
+ protected:
+  friend class TimerBlock;
+  friend class TimerChain;
 
-  void SetElapsedTimeTextLength(size_t length) { elapsed_time_text_length_ = length; }
-  size_t GetElapsedTimeTextLength() const { return elapsed_time_text_length_; }
+  [[nodiscard]] size_t GetIndexInBlock() const;
 
- protected:
   Vec2 pos_;
   Vec2 size_;
-  std::string text_;
-  orbit_client_protos::TimerInfo timer_info_;
-  size_t elapsed_time_text_length_;
+  TimerBlock* block_ = nullptr;
 };
 
 #endif  // ORBIT_GL_TEXT_BOX_H_
@@ -49,11 +49,11 @@ std::string ThreadTrack::GetBoxTooltip(PickingId id) const {
   }
 
   const FunctionInfo* func =
-      GOrbitApp->GetCaptureData().GetSelectedFunction(text_box->GetTimerInfo().function_address());
+      GOrbitApp->GetCaptureData().GetSelectedFunction(text_box->GetTimerFunctionAddress());
   CHECK(func != nullptr);
 
   if (!func) {
-    return text_box->GetText();
+    return "";
   }
 
   std::string function_name;
@@ -73,8 +73,7 @@ std::string ThreadTrack::GetBoxTooltip(PickingId id) const {
       "<b>Module:</b> %s<br/>"
       "<b>Time:</b> %s",
       function_name, is_manual ? "manual" : "dynamic", FunctionUtils::GetLoadedModuleName(*func),
-      GetPrettyTime(
-          TicksToDuration(text_box->GetTimerInfo().start(), text_box->GetTimerInfo().end())));
+      GetPrettyTime(TicksToDuration(text_box->GetTimerStart(), text_box->GetTimerEnd())));
 }
 
 bool ThreadTrack::IsTimerActive(const TimerInfo& timer_info) const {
@@ -149,14 +148,15 @@ void ThreadTrack::Draw(GlCanvas* canvas, PickingMode picking_mode) {
   tracepoint_track_->Draw(canvas, picking_mode);
 }
 
-void ThreadTrack::UpdatePrimitives(uint64_t min_tick, uint64_t max_tick, PickingMode picking_mode) {
+void ThreadTrack::UpdatePrimitives(PrimitiveBatch* batch, uint64_t min_tick, uint64_t max_tick,
+                                   PickingMode picking_mode) {
   event_track_->SetPos(pos_[0], pos_[1]);
-  event_track_->UpdatePrimitives(min_tick, max_tick, picking_mode);
+  event_track_->UpdatePrimitives(batch, min_tick, max_tick, picking_mode);
 
   tracepoint_track_->SetPos(pos_[0], pos_[1]);
-  tracepoint_track_->UpdatePrimitives(min_tick, max_tick, picking_mode);
+  tracepoint_track_->UpdatePrimitives(batch, min_tick, max_tick, picking_mode);
 
-  TimerTrack::UpdatePrimitives(min_tick, max_tick, picking_mode);
+  TimerTrack::UpdatePrimitives(batch, min_tick, max_tick, picking_mode);
 }
 
 void ThreadTrack::SetTrackColor(Color color) {
@@ -166,39 +166,34 @@ void ThreadTrack::SetTrackColor(Color color) {
 }
 
 void ThreadTrack::SetTimesliceText(const TimerInfo& timer_info, double elapsed_us, float min_x,
-                                   TextBox* text_box) {
+                                   TextBox* text_box, PrimitiveBatch* batch) {
   TimeGraphLayout layout = time_graph_->GetLayout();
-  if (text_box->GetText().empty()) {
-    std::string time = GetPrettyTime(absl::Microseconds(elapsed_us));
-    const FunctionInfo* func =
-        GOrbitApp->GetCaptureData().GetSelectedFunction(timer_info.function_address());
-
-    text_box->SetElapsedTimeTextLength(time.length());
-
-    if (func) {
-      std::string extra_info = GetExtraInfo(timer_info);
-      std::string name;
-      if (func->orbit_type() == FunctionInfo::kOrbitTimerStart) {
-        auto api_event = ManualInstrumentationManager::ApiEventFromTimerInfo(timer_info);
-        name = api_event.name;
-      } else {
-        name = FunctionUtils::GetDisplayName(*func);
-      }
-
-      std::string text = absl::StrFormat("%s %s %s", name, extra_info.c_str(), time.c_str());
-
-      text_box->SetText(text);
-    } else if (timer_info.type() == TimerInfo::kIntrospection) {
-      std::string text = absl::StrFormat(
-          "%s %s", time_graph_->GetStringManager()->Get(timer_info.user_data_key()).value_or(""),
-          time.c_str());
-      text_box->SetText(text);
+  // The text is not kept, it is only built for the timers that are drawn.
+  std::string time = GetPrettyTime(absl::Microseconds(elapsed_us));
+  const FunctionInfo* func =
+      GOrbitApp->GetCaptureData().GetSelectedFunction(timer_info.function_address());
+
+  std::string text;
+  if (func) {
+    std::string extra_info = GetExtraInfo(timer_info);
+    std::string name;
+    if (func->orbit_type() == FunctionInfo::kOrbitTimerStart) {
+      auto api_event = ManualInstrumentationManager::ApiEventFromTimerInfo(timer_info);
+      name = api_event.name;
     } else {
-      ERROR(
-          "Unexpected case in ThreadTrack::SetTimesliceText, function=\"%s\", "
-          "type=%d",
-          func->name(), static_cast<int>(timer_info.type()));
+      name = FunctionUtils::GetDisplayName(*func);
     }
+
+    text = absl::StrFormat("%s %s %s", name, extra_info.c_str(), time.c_str());
+  } else if (timer_info.type() == TimerInfo::kIntrospection) {
+    text = absl::StrFormat(
+        "%s %s", time_graph_->GetStringManager()->Get(timer_info.user_data_key()).value_or(""),
+        time.c_str());
+  } else {
+    ERROR(
+        "Unexpected case in ThreadTrack::SetTimesliceText, function=\"%s\", "
+        "type=%d",
+        func->name(), static_cast<int>(timer_info.type()));
   }
 
   const Color kTextWhite(255, 255, 255, 255);
@@ -206,9 +201,9 @@ void ThreadTrack::SetTimesliceText(const TimerInfo& timer_info, double elapsed_u
   const Vec2& box_size = text_box->GetSize();
   float pos_x = std::max(box_pos[0], min_x);
   float max_size = box_pos[0] + box_size[0] - pos_x;
-  text_renderer_->AddTextTrailingCharsPrioritized(
-      text_box->GetText().c_str(), pos_x, text_box->GetPos()[1] + layout.GetTextOffset(),
-      GlCanvas::kZValueText, kTextWhite, text_box->GetElapsedTimeTextLength(), max_size);
+  batch->AddTextTrailingCharsPrioritized(
+      std::move(text), pos_x, text_box->GetPos()[1] + layout.GetTextOffset(),
+      GlCanvas::kZValueText, kTextWhite, time.length(), max_size);
 }
 
 std::string ThreadTrack::GetTooltip() const {
@@ -9,6 +9,7 @@
 #include <OrbitBase/Tracing.h>
 
 #include <algorithm>
+#include <thread>
 #include <utility>
 
 #include "../Orbit.h"
@@ -38,7 +39,9 @@ using orbit_client_protos::TimerInfo;
 
 TimeGraph* GCurrentTimeGraph = nullptr;
 
-TimeGraph::TimeGraph() : batcher_(BatcherId::kTimeGraph) {
+TimeGraph::TimeGraph()
+    : batcher_(BatcherId::kTimeGraph),
+      primitive_generator_(std::max(1u, std::thread::hardware_concurrency())) {
   last_thread_reorder_.Start();
   scheduler_track_ = GetOrCreateSchedulerTrack();
 
@@ -86,6 +89,7 @@ void TimeGraph::SetCanvas(GlCanvas* a_Canvas) {
   text_renderer_->SetCanvas(a_Canvas);
   text_renderer_static_.SetCanvas(a_Canvas);
   batcher_.SetPickingManager(&a_Canvas->GetPickingManager());
+  primitive_generator_.SetPickingManager(&a_Canvas->GetPickingManager());
 }
 
 void TimeGraph::SetFontSize(int a_FontSize) {
@@ -97,6 +101,7 @@ void TimeGraph::Clear() {
   ScopeLock lock(mutex_);
 
   batcher_.StartNewFrame();
+  primitive_generator_.StartNewFrame(0);
   capture_min_timestamp_ = std::numeric_limits<uint64_t>::max();
   capture_max_timestamp_ = 0;
   thread_count_map_.clear();
@@ -280,8 +285,7 @@ void TimeGraph::HorizontallyMoveIntoView(VisibilityType vis_type, uint64_t min,
 
 void TimeGraph::HorizontallyMoveIntoView(VisibilityType vis_type, const TextBox* text_box,
                                          double distance) {
-  HorizontallyMoveIntoView(vis_type, text_box->GetTimerInfo().start(),
-                           text_box->GetTimerInfo().end(), distance);
+  HorizontallyMoveIntoView(vis_type, text_box->GetTimerStart(), text_box->GetTimerEnd(), distance);
 }
 
 void TimeGraph::VerticallyMoveIntoView(const TextBox* text_box) {
@@ -500,12 +504,11 @@ const TextBox* TimeGraph::FindPreviousFunctionCall(uint64_t function_address, ui
       TimerBlock& block = *it;
       if (!block.Intersects(previous_box_time, current_time)) continue;
       for (uint64_t i = 0; i < block.size(); i++) {
-        TextBox& box = block[i];
-        auto box_time = box.GetTimerInfo().end();
-        if ((box.GetTimerInfo().function_address() == function_address) &&
-            (!thread_ID || thread_ID.value() == box.GetTimerInfo().thread_id()) &&
+        auto box_time = block.GetEnd(i);
+        if ((block.GetFunctionAddress(i) == function_address) &&
+            (!thread_ID || thread_ID.value() == block.GetThreadId(i)) &&
             (box_time < current_time) && (previous_box_time < box_time)) {
-          previous_box = &box;
+          previous_box = &block[i];
           previous_box_time = box_time;
         }
       }
@@ -525,12 +528,11 @@ const TextBox* TimeGraph::FindNextFunctionCall(uint64_t function_address, uint64
       TimerBlock& block = *it;
       if (!block.Intersects(current_time, next_box_time)) continue;
       for (uint64_t i = 0; i < block.size(); i++) {
-        TextBox& box = block[i];
-        auto box_time = box.GetTimerInfo().end();
-        if ((box.GetTimerInfo().function_address() == function_address) &&
-            (!thread_ID || thread_ID.value() == box.GetTimerInfo().thread_id()) &&
+        auto box_time = block.GetEnd(i);
+        if ((block.GetFunctionAddress(i) == function_address) &&
+            (!thread_ID || thread_ID.value() == block.GetThreadId(i)) &&
             (box_time > current_time) && (next_box_time > box_time)) {
-          next_box = &box;
+          next_box = &block[i];
           next_box_time = box_time;
         }
       }
@@ -561,14 +563,53 @@ void TimeGraph::UpdatePrimitives(PickingMode picking_mode) {
 
   SortTracks();
 
-  float current_y = -layout_.GetSchedulerTrackOffset();
-
-  for (auto& track : sorted_tracks_) {
-    track->SetY(current_y);
-    track->UpdatePrimitives(min_tick, max_tick, picking_mode);
-    current_y -= (track->GetHeight() + layout_.GetSpaceBetweenTracks());
+  // The tracks generate their primitives on several threads. The primitives are
+  // merged in the order of the tracks, as if the tracks had been updated one
+  // after the other.
+  const size_t track_count = sorted_tracks_.size();
+  std::vector<float> track_heights(track_count);
+  for (size_t i = 0; i < track_count; ++i) {
+    track_heights[i] = sorted_tracks_[i]->GetHeight();
+  }
+  auto update_track = [this, min_tick, max_tick, picking_mode](size_t i, PrimitiveBatch* batch) {
+    sorted_tracks_[i]->UpdatePrimitives(batch, min_tick, max_tick, picking_mode);
+  };
+  primitive_generator_.StartNewFrame(track_count);
+  size_t first_track_to_update = 0;
+  while (first_track_to_update < track_count) {
+    float current_y = -layout_.GetSchedulerTrackOffset();
+    for (size_t i = 0; i < track_count; ++i) {
+      if (i >= first_track_to_update) {
+        sorted_tracks_[i]->SetY(current_y);
+      }
+      current_y -= (track_heights[i] + layout_.GetSpaceBetweenTracks());
+    }
+    primitive_generator_.Generate(first_track_to_update, track_count, update_track);
+
+    // Updating a track can make it higher, e.g., the scheduler track when the
+    // timers of a core are drawn for the first time. The tracks below it move
+    // down and are updated again.
+    size_t first_moved_track = track_count;
+    for (size_t i = first_track_to_update; i < track_count; ++i) {
+      float height = sorted_tracks_[i]->GetHeight();
+      if (height != track_heights[i] && first_moved_track == track_count) {
+        first_moved_track = i + 1;
+      }
+      track_heights[i] = height;
+    }
+    first_track_to_update = first_moved_track;
   }
 
+  primitive_generator_.MergeInto(&batcher_, [this](const PrimitiveBatch::Text& text) {
+    text_renderer_static_.AddTextTrailingCharsPrioritized(
+        text.text.c_str(), text.x, text.y, text.z, text.color, text.trailing_chars_length,
+        text.max_size);
+  });
+
+  float current_y = -layout_.GetSchedulerTrackOffset();
+  for (float track_height : track_heights) {
+    current_y -= (track_height + layout_.GetSpaceBetweenTracks());
+  }
   min_y_ = current_y;
   needs_update_primitives_ = false;
 }
@@ -601,8 +642,11 @@ std::vector<CallstackEvent> TimeGraph::SelectEvents(float world_start, float wor
   return selected_callstack_events;
 }
 
-const std::vector<CallstackEvent>& TimeGraph::GetSelectedCallstackEvents(int32_t tid) {
-  return selected_callstack_events_per_thread_[tid];
+const std::vector<CallstackEvent>& TimeGraph::GetSelectedCallstackEvents(int32_t tid) const {
+  // Called by the tracks while they are updated on several threads.
+  static const std::vector<CallstackEvent> kNoEvents;
+  auto it = selected_callstack_events_per_thread_.find(tid);
+  return it != selected_callstack_events_per_thread_.end() ? it->second : kNoEvents;
 }
 
 void TimeGraph::Draw(GlCanvas* canvas, PickingMode picking_mode) {
@@ -630,8 +674,7 @@ namespace {
 }
 
 std::string GetTimeString(const TextBox* box_a, const TextBox* box_b) {
-  absl::Duration duration =
-      TicksToDuration(box_a->GetTimerInfo().start(), box_b->GetTimerInfo().start());
+  absl::Duration duration = TicksToDuration(box_a->GetTimerStart(), box_b->GetTimerStart());
 
   return GetPrettyTime(duration);
 }
@@ -680,7 +723,7 @@ void TimeGraph::DrawOverlay(GlCanvas* canvas, PickingMode picking_mode) {
   std::sort(boxes.begin(), boxes.end(),
             [](const std::pair<uint64_t, const TextBox*>& box_a,
                const std::pair<uint64_t, const TextBox*>& box_b) -> bool {
-              return box_a.second->GetTimerInfo().start() < box_b.second->GetTimerInfo().start();
+              return box_a.second->GetTimerStart() < box_b.second->GetTimerStart();
             });
 
   // We will need the world x coordinates for the timers multiple times, so
@@ -962,9 +1005,9 @@ void TimeGraph::JumpToNeighborBox(const TextBox* from, JumpDirection jump_direct
   if (!from) {
     return;
   }
-  auto function_address = from->GetTimerInfo().function_address();
-  auto current_time = from->GetTimerInfo().end();
-  auto thread_id = from->GetTimerInfo().thread_id();
+  auto function_address = from->GetTimerFunctionAddress();
+  auto current_time = from->GetTimerEnd();
+  auto thread_id = from->GetTimerThreadId();
   if (jump_direction == JumpDirection::kPrevious) {
     switch (jump_scope) {
       case JumpScope::kSameDepth:
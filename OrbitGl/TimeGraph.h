@@ -17,6 +17,7 @@
 #include "GraphTrack.h"
 #include "ManualInstrumentationManager.h"
 #include "OrbitBase/Profiling.h"
+#include "PrimitiveBatch.h"
 #include "SchedulerTrack.h"
 #include "ScopeTimer.h"
 #include "StringManager.h"
@@ -43,7 +44,8 @@ class TimeGraph {
   void SortTracks();
   std::vector<orbit_client_protos::CallstackEvent> SelectEvents(float world_start, float world_end,
                                                                 int32_t thread_id);
-  const std::vector<orbit_client_protos::CallstackEvent>& GetSelectedCallstackEvents(int32_t tid);
+  const std::vector<orbit_client_protos::CallstackEvent>& GetSelectedCallstackEvents(
+      int32_t tid) const;
 
   void ProcessTimer(const orbit_client_protos::TimerInfo& timer_info,
                     const orbit_client_protos::FunctionInfo* function);
@@ -204,6 +206,7 @@ class TimeGraph {
   bool draw_text_ = true;
 
   Batcher batcher_;
+  ParallelPrimitiveGenerator primitive_generator_;
   Timer last_thread_reorder_;
 
   mutable Mutex mutex_;
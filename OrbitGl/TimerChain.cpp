@@ -8,7 +8,9 @@
 
 #include "OrbitBase/Logging.h"
 
-void TimerBlock::Add(const TextBox& item) {
+using orbit_client_protos::TimerInfo;
+
+void TimerBlock::Add(const TimerInfo& timer_info) {
   if (size_ == kBlockSize) {
     if (next_ == nullptr) {
       next_ = new TimerBlock(chain_, this);
@@ -16,16 +18,108 @@ void TimerBlock::Add(const TextBox& item) {
 
     chain_->current_ = next_;
     ++chain_->num_blocks_;
-    next_->Add(item);
+    next_->Add(timer_info);
     return;
   }
 
   CHECK(size_ < kBlockSize);
-  data_[size_] = item;
+  text_boxes_[size_].block_ = this;
+  starts_[size_] = timer_info.start();
+  ends_[size_] = timer_info.end();
+  function_addresses_[size_] = timer_info.function_address();
+  user_data_keys_[size_] = timer_info.user_data_key();
+  process_ids_[size_] = timer_info.process_id();
+  thread_ids_[size_] = timer_info.thread_id();
+  depths_[size_] = timer_info.depth();
+  processors_[size_] = timer_info.processor();
+  types_[size_] = static_cast<uint8_t>(timer_info.type());
+  if (timer_info.callstack_id() != 0 || timer_info.timeline_hash() != 0 ||
+      timer_info.registers_size() != 0) {
+    TimerInfo& sparse_fields = sparse_fields_[size_];
+    sparse_fields.set_callstack_id(timer_info.callstack_id());
+    sparse_fields.set_timeline_hash(timer_info.timeline_hash());
+    *sparse_fields.mutable_registers() = timer_info.registers();
+  }
+  UpdateLodBuckets();
   ++size_;
+  min_timestamp_ = std::min(timer_info.start(), min_timestamp_);
+  max_timestamp_ = std::max(timer_info.end(), max_timestamp_);
+  prefix_max_start_ = std::max(timer_info.start(), prefix_max_start_);
+  prefix_max_end_ = std::max(timer_info.end(), prefix_max_end_);
+  if (chain_->num_items_ > 0 && timer_info.start() < chain_->last_start_) {
+    chain_->sorted_by_start_ = false;
+  }
+  chain_->last_start_ = timer_info.start();
   ++chain_->num_items_;
-  min_timestamp_ = std::min(item.GetTimerInfo().start(), min_timestamp_);
-  max_timestamp_ = std::max(item.GetTimerInfo().end(), max_timestamp_);
+}
+
+void TimerBlock::GetTimerInfo(std::size_t idx, TimerInfo* timer_info) const {
+  CHECK(idx < size_);
+  auto sparse_fields_it = sparse_fields_.find(idx);
+  if (sparse_fields_it != sparse_fields_.end()) {
+    *timer_info = sparse_fields_it->second;
+  } else {
+    timer_info->set_callstack_id(0);
+    timer_info->set_timeline_hash(0);
+    timer_info->clear_registers();
+  }
+  timer_info->set_start(starts_[idx]);
+  timer_info->set_end(ends_[idx]);
+  timer_info->set_function_address(function_addresses_[idx]);
+  timer_info->set_user_data_key(user_data_keys_[idx]);
+  timer_info->set_process_id(process_ids_[idx]);
+  timer_info->set_thread_id(thread_ids_[idx]);
+  timer_info->set_depth(depths_[idx]);
+  timer_info->set_processor(processors_[idx]);
+  timer_info->set_type(static_cast<TimerInfo::Type>(types_[idx]));
+}
+
+void TimerBlock::UpdateLodBuckets() {
+  // Completes the buckets that end with the timer being added.
+  std::size_t end_idx = size_ + 1;
+  for (int level = 0; level < kLodLevels && end_idx % (kLodBucketSize << level) == 0; ++level) {
+    std::size_t idx_in_level = end_idx / (kLodBucketSize << level) - 1;
+    uint64_t min_start;
+    uint64_t max_end;
+    if (level == 0) {
+      std::size_t begin_idx = end_idx - kLodBucketSize;
+      min_start = *std::min_element(starts_ + begin_idx, starts_ + end_idx);
+      max_end = *std::max_element(ends_ + begin_idx, ends_ + end_idx);
+    } else {
+      std::size_t first_child = GetLodBucket(level - 1, 2 * idx_in_level);
+      min_start = std::min(lod_min_starts_[first_child], lod_min_starts_[first_child + 1]);
+      max_end = std::max(lod_max_ends_[first_child], lod_max_ends_[first_child + 1]);
+    }
+    std::size_t bucket = GetLodBucket(level, idx_in_level);
+    lod_min_starts_[bucket] = min_start;
+    lod_max_ends_[bucket] = max_end;
+  }
+}
+
+std::size_t TimerBlock::SkipTimersWithin(std::size_t idx, uint64_t min, uint64_t max) const {
+  while (idx < size_) {
+    // Skips the largest complete bucket starting at idx that is within.
+    std::size_t skipped_timers = 0;
+    if (idx % kLodBucketSize == 0) {
+      for (int level = kLodLevels - 1; level >= 0; --level) {
+        std::size_t bucket_size = kLodBucketSize << level;
+        if (idx % bucket_size != 0 || idx + bucket_size > size_) continue;
+        std::size_t bucket = GetLodBucket(level, idx / bucket_size);
+        if (lod_min_starts_[bucket] >= min && lod_max_ends_[bucket] <= max) {
+          skipped_timers = bucket_size;
+          break;
+        }
+      }
+    }
+    if (skipped_timers > 0) {
+      idx += skipped_timers;
+      continue;
+    }
+
+    if (starts_[idx] < min || ends_[idx] > max) return idx;
+    ++idx;
+  }
+  return size_;
 }
 
 bool TimerBlock::Intersects(uint64_t min, uint64_t max) {
@@ -44,32 +138,64 @@ TimerChain::~TimerChain() {
   }
 }
 
-TimerBlock* TimerChain::GetBlockContaining(const TextBox* element) {
-  TimerBlock* block = root_;
-  while (block) {
-    uint32_t size = block->size_;
-    if (size) {
-      TextBox* begin = &block->data_[0];
-      TextBox* end = &block->data_[size - 1];
-      if (begin <= element && end >= element) {
-        return block;
-      }
+template <typename Predicate>
+TimerBlock* TimerChain::FindFirstBlock(Predicate predicate) {
+  // Binary lifting over the skip pointers, from the last block backwards.
+  TimerBlock* block = current_;
+  if (!predicate(*block)) return nullptr;
+  for (int level = kMaxSkipLevels - 1; level >= 0; --level) {
+    TimerBlock* candidate = block->skips_[level];
+    if (candidate != nullptr && predicate(*candidate)) {
+      block = candidate;
     }
-    block = block->next_;
   }
+  return block;
+}
 
-  return nullptr;
+TimerChainIterator TimerChain::FindFirstBlockEndingAtOrAfter(uint64_t time) {
+  return TimerChainIterator(
+      FindFirstBlock([time](const TimerBlock& block) { return block.prefix_max_end_ >= time; }));
+}
+
+TextBox* TimerChain::FindFirstStartingAfter(uint64_t time) {
+  // The first block with a prefix maximum start after time is the first block
+  // with a timer that starts after time.
+  TimerBlock* block =
+      FindFirstBlock([time](const TimerBlock& block) { return block.prefix_max_start_ > time; });
+  if (block == nullptr) return nullptr;
+
+  const uint64_t* starts_begin = block->starts_;
+  const uint64_t* starts_end = starts_begin + block->size_;
+  const uint64_t* it =
+      sorted_by_start_ ? std::upper_bound(starts_begin, starts_end, time)
+                       : std::find_if(starts_begin, starts_end,
+                                      [time](uint64_t start) { return start > time; });
+  if (it == starts_end) return nullptr;
+  return &block->text_boxes_[it - starts_begin];
+}
+
+TextBox* TimerChain::FindLastBeforeFirstStartingAfter(uint64_t time) {
+  TextBox* first_after = FindFirstStartingAfter(time);
+  if (first_after != nullptr) return GetElementBefore(first_after);
+  if (current_->size_ == 0) return nullptr;
+  return &current_->text_boxes_[current_->size_ - 1];
+}
+
+TimerBlock* TimerChain::GetBlockContaining(const TextBox* element) {
+  // The boxes of the timers know their block.
+  if (element->block_ == nullptr || element->block_->chain_ != this) return nullptr;
+  return element->block_;
 }
 
 TextBox* TimerChain::GetElementAfter(const TextBox* element) {
   auto block = GetBlockContaining(element);
   if (block) {
-    TextBox* begin = &block->data_[0];
+    TextBox* begin = &block->text_boxes_[0];
     uint32_t index = element - begin;
     if (index < block->size_ - 1)
-      return &block->data_[++index];
+      return &block->text_boxes_[++index];
     else if (block->next_ && block->next_->size_)
-      return &block->next_->data_[0];
+      return &block->next_->text_boxes_[0];
   }
   return nullptr;
 }
@@ -77,12 +203,12 @@ TextBox* TimerChain::GetElementAfter(const TextBox* element) {
 TextBox* TimerChain::GetElementBefore(const TextBox* element) {
   auto block = GetBlockContaining(element);
   if (block) {
-    TextBox* begin = &block->data_[0];
+    TextBox* begin = &block->text_boxes_[0];
     uint32_t index = element - begin;
     if (index > 0)
-      return &block->data_[--index];
+      return &block->text_boxes_[--index];
     else if (block->prev_)
-      return &block->prev_->data_[block->prev_->size_ - 1];
+      return &block->prev_->text_boxes_[block->prev_->size_ - 1];
   }
   return nullptr;
 }
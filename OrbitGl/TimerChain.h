@@ -11,8 +11,18 @@
 #include <limits>
 
 #include "TextBox.h"
+#include "absl/container/flat_hash_map.h"
+#include "capture_data.pb.h"
 
 static constexpr int kBlockSize = 1024;
+// Enough levels of skip pointers for 2^32 blocks, see TimerBlock::skips_.
+static constexpr int kMaxSkipLevels = 32;
+// The summary of a TimerBlock has buckets of 16, 32, ... up to kBlockSize
+// timers, see TimerBlock::lod_min_starts_.
+static constexpr int kLodBucketSize = 16;
+static constexpr int kLodLevels = 7;
+static constexpr int kLodBucketCount = 2 * kBlockSize / kLodBucketSize - 1;
+static_assert(kLodBucketSize << (kLodLevels - 1) == kBlockSize);
 class TimerChain;
 
 // TimerBlock is a straightforward specialization of Block (see BlockChain.h)
@@ -21,6 +31,18 @@ class TimerChain;
 // entire block by using the Intersects(t_min, t_max) method. This effectively
 // tests if any of the timers stored in this block intersects with the [t_min,
 // t_max] interval.
+//
+// The timers are stored as columns of their fields rather than as TimerInfos,
+// which keeps them compact and lets UpdatePrimitives scan the timestamps
+// without touching the other fields. The few fields that most timers leave
+// empty are stored apart. The TextBox of each timer is its handle for picking
+// and selection; TimerInfos are only materialized on demand.
+//
+// Each block also keeps the maximum start and end timestamps of itself and all
+// the blocks before it. These never decrease along the chain, which lets
+// TimerChain binary search its blocks by time. Inside the block, a summary of
+// the minimum start and maximum end of aligned buckets of 16, 32, ... timers
+// lets zoomed out drawing skip all the timers that fall into one pixel at once.
 class TimerBlock {
   friend class TimerChain;
   friend class TimerChainIterator;
@@ -32,11 +54,20 @@ class TimerBlock {
         chain_(chain),
         size_(0),
         min_timestamp_(std::numeric_limits<uint64_t>::max()),
-        max_timestamp_(std::numeric_limits<uint64_t>::min()) {}
+        max_timestamp_(std::numeric_limits<uint64_t>::min()),
+        prefix_max_start_(prev != nullptr ? prev->prefix_max_start_ : 0),
+        prefix_max_end_(prev != nullptr ? prev->prefix_max_end_ : 0) {
+    skips_[0] = prev;
+    for (int level = 1; level < kMaxSkipLevels; ++level) {
+      skips_[level] = skips_[level - 1] != nullptr ? skips_[level - 1]->skips_[level - 1] : nullptr;
+    }
+  }
+  TimerBlock(const TimerBlock&) = delete;
+  TimerBlock& operator=(const TimerBlock&) = delete;
 
-  // Adds an item to the block. If capacity of this block is reached, a new
-  // blocked is allocated and the item is added to the new block.
-  void Add(const TextBox& item);
+  // Adds a timer to the block. If capacity of this block is reached, a new
+  // blocked is allocated and the timer is added to the new block.
+  void Add(const orbit_client_protos::TimerInfo& timer_info);
 
   // Tests if [min, max] intersects with [min_timestamp, max_timestamp], where
   // {min, max}_timestamp are the minimum and maximum timestamp of the timers
@@ -44,20 +75,67 @@ class TimerBlock {
   bool Intersects(uint64_t min, uint64_t max);
 
   uint64_t size() const { return size_; }
+  [[nodiscard]] uint64_t GetMinTimestamp() const { return min_timestamp_; }
+  [[nodiscard]] uint64_t GetMaxTimestamp() const { return max_timestamp_; }
+
+  TextBox& operator[](std::size_t idx) { return text_boxes_[idx]; }
+
+  const TextBox& operator[](std::size_t idx) const { return text_boxes_[idx]; }
+
+  [[nodiscard]] uint64_t GetStart(std::size_t idx) const { return starts_[idx]; }
+  [[nodiscard]] uint64_t GetEnd(std::size_t idx) const { return ends_[idx]; }
+  [[nodiscard]] uint64_t GetFunctionAddress(std::size_t idx) const {
+    return function_addresses_[idx];
+  }
+  [[nodiscard]] int32_t GetThreadId(std::size_t idx) const { return thread_ids_[idx]; }
 
-  TextBox& operator[](std::size_t idx) { return data_[idx]; }
+  // Fills timer_info with the timer at idx, reusing its allocations.
+  void GetTimerInfo(std::size_t idx, orbit_client_protos::TimerInfo* timer_info) const;
 
-  const TextBox& operator[](std::size_t idx) const { return data_[idx]; }
+  // Returns the index of the first timer from idx on that is not within
+  // [min, max], or size().
+  [[nodiscard]] std::size_t SkipTimersWithin(std::size_t idx, uint64_t min, uint64_t max) const;
 
  private:
+  static constexpr std::size_t GetLodBucket(int level, std::size_t idx_in_level) {
+    return 2 * kBlockSize / kLodBucketSize - (2 * kBlockSize / kLodBucketSize >> level) +
+           idx_in_level;
+  }
+  void UpdateLodBuckets();
+
   TimerBlock* prev_;
   TimerBlock* next_;
   TimerChain* chain_;
   uint64_t size_;
-  TextBox data_[kBlockSize];
+  TextBox text_boxes_[kBlockSize];
+
+  uint64_t starts_[kBlockSize];
+  uint64_t ends_[kBlockSize];
+  uint64_t function_addresses_[kBlockSize];
+  uint64_t user_data_keys_[kBlockSize];
+  int32_t process_ids_[kBlockSize];
+  int32_t thread_ids_[kBlockSize];
+  uint32_t depths_[kBlockSize];
+  int32_t processors_[kBlockSize];
+  uint8_t types_[kBlockSize];
+  // The callstack_id, timeline_hash and registers of the timers that have
+  // any, by index.
+  absl::flat_hash_map<uint32_t, orbit_client_protos::TimerInfo> sparse_fields_;
 
   uint64_t min_timestamp_;
   uint64_t max_timestamp_;
+  // Over this block and all the blocks before it.
+  uint64_t prefix_max_start_;
+  uint64_t prefix_max_end_;
+  // skips_[level] is the block 2^level blocks before this one, or nullptr. As
+  // blocks never change once they have been linked, timers can be added while
+  // the chain is being searched, like with the prev_ and next_ pointers.
+  TimerBlock* skips_[kMaxSkipLevels];
+  // The minimum start and maximum end of the timers of each complete bucket,
+  // level by level, from the buckets of kLodBucketSize timers to the one of
+  // kBlockSize timers. The number of timers of a bucket follows from its level.
+  uint64_t lod_min_starts_[kLodBucketCount];
+  uint64_t lod_max_ends_[kLodBucketCount];
 };
 
 // TimerChainIterator iterates over all *blocks* of the chain, not the
@@ -95,6 +173,11 @@ class TimerChainIterator {
 // is a difference compared with BlockChain in how the iterators work: Here,
 // the iterator runs over blocks, in BlockChain the iterator runs over the
 // individually stored elements.
+//
+// The timers of a chain usually have been added in the order of their start
+// timestamps, as the timers of one depth of a track do not overlap. The
+// searches by time visit O(log(blocks)) blocks and are correct whatever the
+// order, but only binary search inside a block if the chain IsSortedByStart().
 class TimerChain {
   friend class TimerBlock;
 
@@ -103,10 +186,36 @@ class TimerChain {
 
   ~TimerChain();
 
-  void push_back(const TextBox& item) { current_->Add(item); }
+  void push_back(const orbit_client_protos::TimerInfo& timer_info) { current_->Add(timer_info); }
   bool empty() const { return num_items_ == 0; }
   uint64_t size() const { return num_items_; }
 
+  // Returns whether the timers have been added in the order of their start
+  // timestamps.
+  [[nodiscard]] bool IsSortedByStart() const { return sorted_by_start_; }
+
+  // Returns the first block that has a timer ending at or after time. All the
+  // blocks before it only have timers that end before time.
+  TimerChainIterator FindFirstBlockEndingAtOrAfter(uint64_t time);
+  // Returns the first timer that starts after time, in the order in which the
+  // timers were added, or nullptr.
+  TextBox* FindFirstStartingAfter(uint64_t time);
+  // Returns the timer before the one returned by FindFirstStartingAfter, or
+  // the last timer if no timer starts after time. If the chain is sorted by
+  // start, this is the last timer that starts at or before time.
+  TextBox* FindLastBeforeFirstStartingAfter(uint64_t time);
+
+  // Calls draw_timer(block, idx) for the timers that TimerTrack draws between
+  // min_tick and max_tick, in order. draw_timer returns whether it drew the
+  // timer as a line, i.e., narrower than a pixel. The following timers that
+  // fall entirely into the pixel of that line, which starts at
+  // min_timegraph_tick + n * pixel_delta_in_ticks, are not drawn. They are
+  // skipped by buckets of the summaries of the blocks, so that zoomed out, the
+  // cost is in the number of pixels and blocks rather than of timers.
+  template <typename DrawTimer>
+  void ForEachVisibleTimer(uint64_t min_tick, uint64_t max_tick, uint64_t min_timegraph_tick,
+                           uint64_t pixel_delta_in_ticks, DrawTimer draw_timer);
+
   TimerBlock* GetBlockContaining(const TextBox* element);
 
   TextBox* GetElementAfter(const TextBox* element);
@@ -118,10 +227,60 @@ class TimerChain {
   TimerChainIterator end() { return TimerChainIterator(nullptr); }
 
  private:
+  // Returns the first block for which predicate is true, or nullptr. The
+  // predicate has to be false for the blocks before some block, and true from
+  // that block on.
+  template <typename Predicate>
+  TimerBlock* FindFirstBlock(Predicate predicate);
+
   TimerBlock* root_;
   TimerBlock* current_;
   uint64_t num_blocks_;
   uint64_t num_items_;
+  uint64_t last_start_ = 0;
+  bool sorted_by_start_ = true;
 };
 
+template <typename DrawTimer>
+void TimerChain::ForEachVisibleTimer(uint64_t min_tick, uint64_t max_tick,
+                                     uint64_t min_timegraph_tick, uint64_t pixel_delta_in_ticks,
+                                     DrawTimer draw_timer) {
+  bool is_sorted_by_start = sorted_by_start_;
+  for (TimerChainIterator it = FindFirstBlockEndingAtOrAfter(min_tick); it != end(); ++it) {
+    TimerBlock& block = *it;
+    // All the following blocks start after max_tick as well.
+    if (is_sorted_by_start && block.GetMinTimestamp() > max_tick) break;
+    if (!block.Intersects(min_tick, max_tick)) continue;
+
+    // We have to reset this when we go to the next depth, as otherwise we
+    // would miss drawing events that should be drawn.
+    uint64_t min_ignore = std::numeric_limits<uint64_t>::max();
+    uint64_t max_ignore = std::numeric_limits<uint64_t>::min();
+    for (std::size_t k = 0; k < block.size(); ++k) {
+      uint64_t timer_start = block.GetStart(k);
+      uint64_t timer_end = block.GetEnd(k);
+      if (is_sorted_by_start && timer_start > max_tick) break;
+      if (min_tick > timer_end || max_tick < timer_start) continue;
+      if (timer_start >= min_ignore && timer_end <= max_ignore) {
+        // The loop increments k to the first timer that is not skipped.
+        k = block.SkipTimersWithin(k, min_ignore, max_ignore) - 1;
+        continue;
+      }
+      if (!draw_timer(block, k)) continue;
+
+      // For lines, we can ignore the entire pixel into which this event
+      // falls. We align this precisely on the pixel x-coordinate of the
+      // current line being drawn (in ticks). If pixel_delta_in_ticks is
+      // zero, we need to avoid dividing by zero, but we also wouldn't
+      // gain anything here.
+      if (pixel_delta_in_ticks != 0) {
+        min_ignore = min_timegraph_tick +
+                     ((timer_start - min_timegraph_tick) / pixel_delta_in_ticks) *
+                         pixel_delta_in_ticks;
+        max_ignore = min_ignore + pixel_delta_in_ticks;
+      }
+    }
+  }
+}
+
 #endif
@@ -0,0 +1,172 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// Fills a TimerChain with --timers timers, like one depth of a track, and
+// compares the searches by time of TimerChain with linear scans over all its
+// blocks: the neighbour lookups of the keyboard navigation, the blocks that
+// UpdatePrimitives visits when zoomed in, and the timers it draws when zoomed
+// out over the whole chain.
+
+#include <chrono>
+#include <cstdio>
+#include <limits>
+#include <random>
+#include <vector>
+
+#include "TextBox.h"
+#include "TimerChain.h"
+#include "absl/flags/flag.h"
+#include "absl/flags/parse.h"
+#include "capture_data.pb.h"
+
+ABSL_FLAG(uint64_t, timers, 10'000'000, "Number of timers in the chain");
+ABSL_FLAG(uint64_t, queries, 1000, "Number of queries of each kind");
+
+namespace {
+
+using orbit_client_protos::TimerInfo;
+
+constexpr uint64_t kTimerPeriodNs = 1000;
+
+double SecondsSince(std::chrono::steady_clock::time_point begin) {
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+}
+
+const TextBox* FindFirstStartingAfterLinearly(TimerChain* chain, uint64_t time) {
+  for (TimerBlock& block : *chain) {
+    for (size_t i = 0; i < block.size(); ++i) {
+      if (block.GetStart(i) > time) return &block[i];
+    }
+  }
+  return nullptr;
+}
+
+uint64_t CountIntersectingBlocksLinearly(TimerChain* chain, uint64_t min_tick, uint64_t max_tick) {
+  uint64_t count = 0;
+  for (TimerBlock& block : *chain) {
+    if (block.Intersects(min_tick, max_tick)) ++count;
+  }
+  return count;
+}
+
+uint64_t CountIntersectingBlocks(TimerChain* chain, uint64_t min_tick, uint64_t max_tick) {
+  uint64_t count = 0;
+  for (TimerChainIterator it = chain->FindFirstBlockEndingAtOrAfter(min_tick); it != chain->end();
+       ++it) {
+    if (it->GetMinTimestamp() > max_tick) break;
+    if (it->Intersects(min_tick, max_tick)) ++count;
+  }
+  return count;
+}
+
+// The loop of TimerTrack::UpdatePrimitives before the blocks had summaries.
+uint64_t CountVisibleTimersOneByOne(TimerChain* chain, uint64_t min_tick, uint64_t max_tick,
+                                    uint64_t pixel_delta_in_ticks) {
+  uint64_t count = 0;
+  for (TimerBlock& block : *chain) {
+    if (!block.Intersects(min_tick, max_tick)) continue;
+    uint64_t min_ignore = std::numeric_limits<uint64_t>::max();
+    uint64_t max_ignore = std::numeric_limits<uint64_t>::min();
+    for (size_t k = 0; k < block.size(); ++k) {
+      uint64_t start = block.GetStart(k);
+      uint64_t end = block.GetEnd(k);
+      if (min_tick > end || max_tick < start) continue;
+      if (start >= min_ignore && end <= max_ignore) continue;
+      ++count;
+      if (end - start >= pixel_delta_in_ticks) continue;
+      min_ignore = min_tick + ((start - min_tick) / pixel_delta_in_ticks) * pixel_delta_in_ticks;
+      max_ignore = min_ignore + pixel_delta_in_ticks;
+    }
+  }
+  return count;
+}
+
+uint64_t CountVisibleTimers(TimerChain* chain, uint64_t min_tick, uint64_t max_tick,
+                            uint64_t pixel_delta_in_ticks) {
+  uint64_t count = 0;
+  chain->ForEachVisibleTimer(min_tick, max_tick, min_tick, pixel_delta_in_ticks,
+                             [&count, pixel_delta_in_ticks](TimerBlock& block, size_t k) {
+                               ++count;
+                               return block.GetEnd(k) - block.GetStart(k) < pixel_delta_in_ticks;
+                             });
+  return count;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  absl::ParseCommandLine(argc, argv);
+  uint64_t timer_count = absl::GetFlag(FLAGS_timers);
+  uint64_t query_count = absl::GetFlag(FLAGS_queries);
+
+  TimerChain chain;
+  auto begin = std::chrono::steady_clock::now();
+  TimerInfo timer;
+  for (uint64_t i = 0; i < timer_count; ++i) {
+    timer.set_start(i * kTimerPeriodNs);
+    timer.set_end(i * kTimerPeriodNs + kTimerPeriodNs / 2);
+    chain.push_back(timer);
+  }
+  printf("Added %lu timers: %.2f s\n", timer_count, SecondsSince(begin));
+
+  std::mt19937_64 random{42};
+  std::uniform_int_distribution<uint64_t> times{0, timer_count * kTimerPeriodNs};
+  std::vector<uint64_t> query_times(query_count);
+  for (uint64_t& time : query_times) {
+    time = times(random);
+  }
+
+  std::vector<const TextBox*> linear_results;
+  std::vector<const TextBox*> indexed_results;
+  begin = std::chrono::steady_clock::now();
+  for (uint64_t time : query_times) {
+    linear_results.push_back(FindFirstStartingAfterLinearly(&chain, time));
+  }
+  double linear_s = SecondsSince(begin);
+  begin = std::chrono::steady_clock::now();
+  for (uint64_t time : query_times) {
+    indexed_results.push_back(chain.FindFirstStartingAfter(time));
+  }
+  double indexed_s = SecondsSince(begin);
+  bool results_differ = linear_results != indexed_results;
+  printf("FindFirstStartingAfter: linear %.3f us, indexed %.3f us per query\n",
+         linear_s * 1e6 / query_count, indexed_s * 1e6 / query_count);
+
+  // A time window of 100 timers.
+  constexpr uint64_t kWindowNs = 100 * kTimerPeriodNs;
+  uint64_t linear_blocks = 0;
+  uint64_t indexed_blocks = 0;
+  begin = std::chrono::steady_clock::now();
+  for (uint64_t time : query_times) {
+    linear_blocks += CountIntersectingBlocksLinearly(&chain, time, time + kWindowNs);
+  }
+  linear_s = SecondsSince(begin);
+  begin = std::chrono::steady_clock::now();
+  for (uint64_t time : query_times) {
+    indexed_blocks += CountIntersectingBlocks(&chain, time, time + kWindowNs);
+  }
+  indexed_s = SecondsSince(begin);
+  results_differ |= linear_blocks != indexed_blocks;
+  printf("Blocks intersecting a window of %lu ns: linear %.3f us, indexed %.3f us per query\n",
+         kWindowNs, linear_s * 1e6 / query_count, indexed_s * 1e6 / query_count);
+
+  constexpr uint64_t kPixelCount = 1920;
+  uint64_t max_tick = timer_count * kTimerPeriodNs;
+  uint64_t pixel_delta_in_ticks = max_tick / kPixelCount;
+  begin = std::chrono::steady_clock::now();
+  uint64_t linear_count = CountVisibleTimersOneByOne(&chain, 0, max_tick, pixel_delta_in_ticks);
+  linear_s = SecondsSince(begin);
+  begin = std::chrono::steady_clock::now();
+  uint64_t indexed_count = CountVisibleTimers(&chain, 0, max_tick, pixel_delta_in_ticks);
+  indexed_s = SecondsSince(begin);
+  results_differ |= linear_count != indexed_count;
+  printf("Zoomed out over %lu pixels, %lu timers drawn: one by one %.3f ms, summaries %.3f ms\n",
+         kPixelCount, indexed_count, linear_s * 1e3, indexed_s * 1e3);
+
+  if (results_differ) {
+    printf("The linear and the indexed results differ\n");
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,310 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <limits>
+#include <random>
+#include <vector>
+
+#include "TextBox.h"
+#include "TimerChain.h"
+#include "capture_data.pb.h"
+
+using orbit_client_protos::TimerInfo;
+
+namespace {
+
+// Adds count timers starting at 10, 20, 30, ... and lasting 5 each, so that the
+// chain spans several blocks, the last one not full.
+void AddSortedTimers(TimerChain* chain, uint64_t count) {
+  for (uint64_t i = 1; i <= count; ++i) {
+    TimerInfo timer;
+    timer.set_start(10 * i);
+    timer.set_end(10 * i + 5);
+    chain->push_back(timer);
+  }
+}
+
+const TextBox* FindFirstStartingAfterLinearly(TimerChain* chain, uint64_t time) {
+  for (TimerBlock& block : *chain) {
+    for (size_t i = 0; i < block.size(); ++i) {
+      if (block.GetStart(i) > time) return &block[i];
+    }
+  }
+  return nullptr;
+}
+
+}  // namespace
+
+TEST(TimerChain, EmptyChain) {
+  TimerChain chain;
+  EXPECT_TRUE(chain.IsSortedByStart());
+  EXPECT_EQ(chain.FindFirstStartingAfter(0), nullptr);
+  EXPECT_EQ(chain.FindLastBeforeFirstStartingAfter(0), nullptr);
+  TimerChainIterator it = chain.FindFirstBlockEndingAtOrAfter(0);
+  ASSERT_NE(it, chain.end());
+  EXPECT_EQ(it->size(), 0);
+  EXPECT_EQ(chain.FindFirstBlockEndingAtOrAfter(1), chain.end());
+}
+
+TEST(TimerChain, FindFirstStartingAfter) {
+  TimerChain chain;
+  AddSortedTimers(&chain, 3 * kBlockSize + 10);
+  EXPECT_TRUE(chain.IsSortedByStart());
+
+  EXPECT_EQ(chain.FindFirstStartingAfter(0)->GetTimerStart(), 10);
+  EXPECT_EQ(chain.FindFirstStartingAfter(9)->GetTimerStart(), 10);
+  EXPECT_EQ(chain.FindFirstStartingAfter(10)->GetTimerStart(), 20);
+  EXPECT_EQ(chain.FindFirstStartingAfter(15)->GetTimerStart(), 20);
+  // The last timer of the first block, and the first timer of the second one.
+  EXPECT_EQ(chain.FindFirstStartingAfter(10 * kBlockSize - 1)->GetTimerStart(),
+            10 * kBlockSize);
+  EXPECT_EQ(chain.FindFirstStartingAfter(10 * kBlockSize)->GetTimerStart(),
+            10 * (kBlockSize + 1));
+  EXPECT_EQ(chain.FindFirstStartingAfter(10 * (3 * kBlockSize + 9))->GetTimerStart(),
+            10 * (3 * kBlockSize + 10));
+  EXPECT_EQ(chain.FindFirstStartingAfter(10 * (3 * kBlockSize + 10)), nullptr);
+  EXPECT_EQ(chain.FindFirstStartingAfter(std::numeric_limits<uint64_t>::max()), nullptr);
+}
+
+TEST(TimerChain, FindLastBeforeFirstStartingAfter) {
+  TimerChain chain;
+  AddSortedTimers(&chain, 3 * kBlockSize + 10);
+
+  EXPECT_EQ(chain.FindLastBeforeFirstStartingAfter(9), nullptr);
+  EXPECT_EQ(chain.FindLastBeforeFirstStartingAfter(10)->GetTimerStart(), 10);
+  EXPECT_EQ(chain.FindLastBeforeFirstStartingAfter(19)->GetTimerStart(), 10);
+  EXPECT_EQ(chain.FindLastBeforeFirstStartingAfter(10 * kBlockSize)->GetTimerStart(),
+            10 * kBlockSize);
+  EXPECT_EQ(chain.FindLastBeforeFirstStartingAfter(10 * kBlockSize + 9)->GetTimerStart(),
+            10 * kBlockSize);
+  EXPECT_EQ(chain.FindLastBeforeFirstStartingAfter(10 * (kBlockSize + 1))->GetTimerStart(),
+            10 * (kBlockSize + 1));
+  // Past the last timer.
+  EXPECT_EQ(chain.FindLastBeforeFirstStartingAfter(std::numeric_limits<uint64_t>::max())
+                ->GetTimerStart(),
+            10 * (3 * kBlockSize + 10));
+}
+
+TEST(TimerChain, FindFirstBlockEndingAtOrAfter) {
+  TimerChain chain;
+  AddSortedTimers(&chain, 3 * kBlockSize + 10);
+  std::vector<const TimerBlock*> blocks;
+  for (TimerBlock& block : chain) {
+    blocks.push_back(&block);
+  }
+  ASSERT_EQ(blocks.size(), 4);
+
+  EXPECT_EQ(&*chain.FindFirstBlockEndingAtOrAfter(0), blocks[0]);
+  // The end of the last timer of the first block.
+  EXPECT_EQ(&*chain.FindFirstBlockEndingAtOrAfter(10 * kBlockSize + 5), blocks[0]);
+  EXPECT_EQ(&*chain.FindFirstBlockEndingAtOrAfter(10 * kBlockSize + 6), blocks[1]);
+  EXPECT_EQ(&*chain.FindFirstBlockEndingAtOrAfter(10 * 3 * kBlockSize + 6), blocks[3]);
+  EXPECT_EQ(&*chain.FindFirstBlockEndingAtOrAfter(10 * (3 * kBlockSize + 10) + 5), blocks[3]);
+  EXPECT_EQ(chain.FindFirstBlockEndingAtOrAfter(10 * (3 * kBlockSize + 10) + 6), chain.end());
+}
+
+TEST(TimerChain, FindFirstBlockEndingAtOrAfterWithLongTimer) {
+  TimerChain chain;
+  AddSortedTimers(&chain, kBlockSize - 1);
+  // A timer of the first block ends after all the timers of the second one.
+  TimerInfo long_timer;
+  long_timer.set_start(10 * kBlockSize);
+  long_timer.set_end(1'000'000);
+  chain.push_back(long_timer);
+  AddSortedTimers(&chain, kBlockSize);
+
+  EXPECT_EQ(&*chain.FindFirstBlockEndingAtOrAfter(999'999), &*chain.begin());
+  EXPECT_EQ(chain.FindFirstBlockEndingAtOrAfter(1'000'001), chain.end());
+}
+
+TEST(TimerChain, UnsortedChainIsSearchedInAdditionOrder) {
+  TimerChain chain;
+  std::mt19937_64 random{42};
+  std::uniform_int_distribution<uint64_t> starts{0, 100'000};
+  for (int i = 0; i < 5 * kBlockSize; ++i) {
+    TimerInfo timer;
+    timer.set_start(starts(random));
+    timer.set_end(timer.start() + 10);
+    chain.push_back(timer);
+  }
+  EXPECT_FALSE(chain.IsSortedByStart());
+
+  for (uint64_t time = 0; time <= 100'000; time += 997) {
+    const TextBox* expected = FindFirstStartingAfterLinearly(&chain, time);
+    EXPECT_EQ(chain.FindFirstStartingAfter(time), expected);
+    if (expected != nullptr) {
+      EXPECT_EQ(chain.FindLastBeforeFirstStartingAfter(time), chain.GetElementBefore(expected));
+    }
+  }
+  EXPECT_EQ(chain.FindFirstStartingAfter(100'000), nullptr);
+}
+
+TEST(TimerChain, GetElementAfterAndBefore) {
+  TimerChain chain;
+  AddSortedTimers(&chain, kBlockSize + 1);
+  const TextBox* last_of_first_block = chain.FindFirstStartingAfter(10 * kBlockSize - 1);
+  const TextBox* first_of_second_block = chain.FindFirstStartingAfter(10 * kBlockSize);
+  ASSERT_NE(last_of_first_block, nullptr);
+  ASSERT_NE(first_of_second_block, nullptr);
+
+  EXPECT_EQ(chain.GetElementAfter(last_of_first_block), first_of_second_block);
+  EXPECT_EQ(chain.GetElementBefore(first_of_second_block), last_of_first_block);
+  EXPECT_EQ(chain.GetElementAfter(first_of_second_block), nullptr);
+  EXPECT_EQ(chain.GetElementBefore(&(*chain.begin())[0]), nullptr);
+
+  TimerChain other_chain;
+  AddSortedTimers(&other_chain, 1);
+  EXPECT_EQ(chain.GetBlockContaining(&(*other_chain.begin())[0]), nullptr);
+  EXPECT_EQ(chain.GetElementAfter(&(*other_chain.begin())[0]), nullptr);
+}
+
+namespace {
+
+struct DrawnTimer {
+  const TimerBlock* block;
+  size_t index;
+  bool is_line;
+
+  bool operator==(const DrawnTimer& other) const {
+    return block == other.block && index == other.index && is_line == other.is_line;
+  }
+};
+
+// Draws timers narrower than a pixel as lines, and does not draw the timers of
+// every seventh function, like TimerTrack::TimerFilter could.
+class FakeTimerDrawer {
+ public:
+  explicit FakeTimerDrawer(uint64_t pixel_delta_in_ticks)
+      : pixel_delta_in_ticks_{pixel_delta_in_ticks} {}
+
+  bool operator()(TimerBlock& block, size_t index) {
+    if (block.GetFunctionAddress(index) % 7 == 0) return false;
+    bool is_line = block.GetEnd(index) - block.GetStart(index) < pixel_delta_in_ticks_;
+    drawn_timers.push_back({&block, index, is_line});
+    return is_line;
+  }
+
+  std::vector<DrawnTimer> drawn_timers;
+
+ private:
+  uint64_t pixel_delta_in_ticks_;
+};
+
+// The loop of TimerTrack::UpdatePrimitives before the blocks had summaries: it
+// visits every timer.
+void ForEachVisibleTimerOneByOne(TimerChain* chain, uint64_t min_tick, uint64_t max_tick,
+                                 uint64_t min_timegraph_tick, uint64_t pixel_delta_in_ticks,
+                                 FakeTimerDrawer* draw_timer) {
+  for (TimerBlock& block : *chain) {
+    if (!block.Intersects(min_tick, max_tick)) continue;
+    uint64_t min_ignore = std::numeric_limits<uint64_t>::max();
+    uint64_t max_ignore = std::numeric_limits<uint64_t>::min();
+    for (size_t k = 0; k < block.size(); ++k) {
+      uint64_t start = block.GetStart(k);
+      uint64_t end = block.GetEnd(k);
+      if (min_tick > end || max_tick < start) continue;
+      if (start >= min_ignore && end <= max_ignore) continue;
+      if (!(*draw_timer)(block, k)) continue;
+      if (pixel_delta_in_ticks != 0) {
+        min_ignore = min_timegraph_tick +
+                     ((start - min_timegraph_tick) / pixel_delta_in_ticks) * pixel_delta_in_ticks;
+        max_ignore = min_ignore + pixel_delta_in_ticks;
+      }
+    }
+  }
+}
+
+// Adds back to back timers of random durations, mostly much shorter than the
+// longest ones, as seen in real captures.
+void AddTimersOfRandomDurations(TimerChain* chain, uint64_t count, std::mt19937_64* random) {
+  std::uniform_int_distribution<uint64_t> magnitudes{0, 5};
+  std::uniform_int_distribution<uint64_t> function_addresses{0, 100};
+  uint64_t start = 1000;
+  for (uint64_t i = 0; i < count; ++i) {
+    uint64_t magnitude = magnitudes(*random);
+    uint64_t duration = 1 + (*random)() % (magnitude == 0 ? 100'000 : 100);
+    TimerInfo timer;
+    timer.set_start(start);
+    timer.set_end(start + duration);
+    timer.set_function_address(function_addresses(*random));
+    chain->push_back(timer);
+    start += duration + (*random)() % 20;
+  }
+}
+
+void ExpectSameTimersDrawn(TimerChain* chain, uint64_t min_tick, uint64_t max_tick,
+                           uint64_t pixel_count) {
+  uint64_t min_timegraph_tick = 1000;
+  uint64_t pixel_delta_in_ticks = (max_tick - min_tick) / pixel_count;
+  FakeTimerDrawer expected{pixel_delta_in_ticks};
+  ForEachVisibleTimerOneByOne(chain, min_tick, max_tick, min_timegraph_tick, pixel_delta_in_ticks,
+                              &expected);
+  FakeTimerDrawer actual{pixel_delta_in_ticks};
+  chain->ForEachVisibleTimer(min_tick, max_tick, min_timegraph_tick, pixel_delta_in_ticks,
+                             [&actual](TimerBlock& block, size_t index) {
+                               return actual(block, index);
+                             });
+  EXPECT_TRUE(actual.drawn_timers == expected.drawn_timers)
+      << "[" << min_tick << ", " << max_tick << "] in " << pixel_count << " pixels: drew "
+      << actual.drawn_timers.size() << " timers instead of " << expected.drawn_timers.size();
+}
+
+}  // namespace
+
+TEST(TimerChain, SkipTimersWithin) {
+  TimerChain chain;
+  AddSortedTimers(&chain, kBlockSize - 3);
+  const TimerBlock& block = *chain.begin();
+
+  EXPECT_EQ(block.SkipTimersWithin(0, 0, 5), 0);
+  EXPECT_EQ(block.SkipTimersWithin(0, 10, 15), 1);
+  EXPECT_EQ(block.SkipTimersWithin(0, 10, 10 * 17 + 5), 17);
+  EXPECT_EQ(block.SkipTimersWithin(3, 10, 10 * 700 + 5), 700);
+  EXPECT_EQ(block.SkipTimersWithin(3, 0, std::numeric_limits<uint64_t>::max()), kBlockSize - 3);
+  EXPECT_EQ(block.SkipTimersWithin(kBlockSize - 3, 0, std::numeric_limits<uint64_t>::max()),
+            kBlockSize - 3);
+}
+
+TEST(TimerChain, ForEachVisibleTimerDrawsLikeVisitingEveryTimer) {
+  std::mt19937_64 random{42};
+  TimerChain chain;
+  AddTimersOfRandomDurations(&chain, 20 * kBlockSize + 100, &random);
+  uint64_t max_time = chain.FindLastBeforeFirstStartingAfter(
+                               std::numeric_limits<uint64_t>::max())
+                          ->GetTimerEnd();
+
+  for (uint64_t pixel_count : {1, 100, 1920, 100'000}) {
+    ExpectSameTimersDrawn(&chain, 0, max_time, pixel_count);
+    ExpectSameTimersDrawn(&chain, max_time / 3, max_time / 2, pixel_count);
+  }
+  std::uniform_int_distribution<uint64_t> times{0, max_time};
+  for (int i = 0; i < 100; ++i) {
+    uint64_t min_tick = times(random);
+    uint64_t max_tick = min_tick + times(random) / 10 + 1;
+    ExpectSameTimersDrawn(&chain, min_tick, max_tick, 1920);
+  }
+}
+
+TEST(TimerChain, ForEachVisibleTimerDrawsLikeVisitingEveryTimerWhenUnsorted) {
+  std::mt19937_64 random{42};
+  TimerChain chain;
+  std::uniform_int_distribution<uint64_t> starts{1000, 1'000'000};
+  std::uniform_int_distribution<uint64_t> durations{1, 1000};
+  for (int i = 0; i < 10 * kBlockSize; ++i) {
+    TimerInfo timer;
+    timer.set_start(starts(random));
+    timer.set_end(timer.start() + durations(random));
+    timer.set_function_address(i % 100);
+    chain.push_back(timer);
+  }
+  ASSERT_FALSE(chain.IsSortedByStart());
+
+  for (uint64_t pixel_count : {1, 100, 1920, 100'000}) {
+    ExpectSameTimersDrawn(&chain, 0, 1'001'000, pixel_count);
+    ExpectSameTimersDrawn(&chain, 300'000, 400'000, pixel_count);
+  }
+}
@@ -28,13 +28,19 @@ class TimerInfosIterator {
 
   TimerInfosIterator& operator++();
 
-  const orbit_client_protos::TimerInfo& operator*() const {
-    return (*blocks_it_)[timer_index_].GetTimerInfo();
+  // The timers are materialized from their TimerBlock, so they are returned
+  // by value.
+  orbit_client_protos::TimerInfo operator*() const {
+    orbit_client_protos::TimerInfo timer_info;
+    blocks_it_->GetTimerInfo(timer_index_, &timer_info);
+    return timer_info;
   }
 
-  const orbit_client_protos::TimerInfo* operator->() const {
-    return &(*blocks_it_)[timer_index_].GetTimerInfo();
-  }
+  struct TimerInfoProxy {
+    const orbit_client_protos::TimerInfo* operator->() const { return &timer_info; }
+    orbit_client_protos::TimerInfo timer_info;
+  };
+  TimerInfoProxy operator->() const { return TimerInfoProxy{**this}; }
 
   bool operator==(const TimerInfosIterator& other) const {
     return chains_it_ == other.chains_it_ && blocks_it_ == other.blocks_it_ &&
@@ -21,9 +21,7 @@ using orbit_client_protos::TimerInfo;
 // TODO: Remove this flag once we have a way to toggle the display return values
 ABSL_FLAG(bool, show_return_values, false, "Show return values on time slices");
 
-TimerTrack::TimerTrack(TimeGraph* time_graph) : Track(time_graph) {
-  text_renderer_ = time_graph->GetTextRenderer();
-}
+TimerTrack::TimerTrack(TimeGraph* time_graph) : Track(time_graph) {}
 
 void TimerTrack::Draw(GlCanvas* canvas, PickingMode picking_mode) {
   float track_height = GetHeight();
@@ -57,11 +55,11 @@ float TimerTrack::GetYFromDepth(uint32_t depth) const {
 
 void TimerTrack::UpdateBoxHeight() { box_height_ = time_graph_->GetLayout().GetTextBoxHeight(); }
 
-void TimerTrack::UpdatePrimitives(uint64_t min_tick, uint64_t max_tick,
+void TimerTrack::UpdatePrimitives(PrimitiveBatch* batch, uint64_t min_tick, uint64_t max_tick,
                                   PickingMode /*picking_mode*/) {
   UpdateBoxHeight();
 
-  Batcher* batcher = &time_graph_->GetBatcher();
+  Batcher* batcher = batch->GetBatcher();
   GlCanvas* canvas = time_graph_->GetCanvas();
 
   float world_start_x = canvas->GetWorldTopLeftX();
@@ -75,74 +73,56 @@ void TimerTrack::UpdatePrimitives(uint64_t min_tick, uint64_t max_tick,
   // events that would just draw over an already drawn line. When zoomed in
   // enough that all events are drawn as boxes, this has no effect. When zoomed
   // out, many events will be discarded quickly.
-  uint64_t min_ignore = std::numeric_limits<uint64_t>::max();
-  uint64_t max_ignore = std::numeric_limits<uint64_t>::min();
   uint64_t time_window_ns = static_cast<uint64_t>(1000 * time_graph_->GetTimeWindowUs());
   uint64_t pixel_delta_in_ticks = time_window_ns / canvas->getWidth();
   uint64_t min_timegraph_tick = time_graph_->GetTickFromUs(time_graph_->GetMinTimeUs());
 
-  for (auto& chain : chains_by_depth) {
-    if (!chain) continue;
-    for (TimerChainIterator it = chain->begin(); it != chain->end(); ++it) {
-      TimerBlock& block = *it;
-      if (!block.Intersects(min_tick, max_tick)) continue;
-
-      // We have to reset this when we go to the next depth, as otherwise we
-      // would miss drawing events that should be drawn.
-      min_ignore = std::numeric_limits<uint64_t>::max();
-      max_ignore = std::numeric_limits<uint64_t>::min();
-
-      for (size_t k = 0; k < block.size(); ++k) {
-        TextBox& text_box = block[k];
-        const TimerInfo& timer_info = text_box.GetTimerInfo();
-        if (min_tick > timer_info.end() || max_tick < timer_info.start()) continue;
-        if (timer_info.start() >= min_ignore && timer_info.end() <= max_ignore) continue;
-        if (!TimerFilter(timer_info)) continue;
-
-        UpdateDepth(timer_info.depth() + 1);
-        double start_us = time_graph_->GetUsFromTick(timer_info.start());
-        double end_us = time_graph_->GetUsFromTick(timer_info.end());
-        double elapsed_us = end_us - start_us;
-        double normalized_start = start_us * inv_time_window;
-        double normalized_length = elapsed_us * inv_time_window;
-        float world_timer_width = static_cast<float>(normalized_length * world_width);
-        float world_timer_x = static_cast<float>(world_start_x + normalized_start * world_width);
-        float world_timer_y = GetYFromDepth(timer_info.depth());
-
-        bool is_visible_width = normalized_length * canvas->getWidth() > 1;
-        bool is_selected = &text_box == GOrbitApp->selected_text_box();
-
-        Vec2 pos(world_timer_x, world_timer_y);
-        Vec2 size(world_timer_width, box_height_);
-        float z = GlCanvas::kZValueBox;
-        Color color = GetTimerColor(timer_info, is_selected);
-        text_box.SetPos(pos);
-        text_box.SetSize(size);
-
-        auto user_data = std::make_unique<PickingUserData>(
-            &text_box, [&](PickingId id) { return this->GetBoxTooltip(id); });
-
-        if (is_visible_width) {
-          if (!is_collapsed) {
-            SetTimesliceText(timer_info, elapsed_us, world_start_x, &text_box);
-          }
-          batcher->AddShadedBox(pos, size, z, color, std::move(user_data));
-        } else {
-          batcher->AddVerticalLine(pos, size[1], z, color, std::move(user_data));
-          // For lines, we can ignore the entire pixel into which this event
-          // falls. We align this precisely on the pixel x-coordinate of the
-          // current line being drawn (in ticks). If pixel_delta_in_ticks is
-          // zero, we need to avoid dividing by zero, but we also wouldn't
-          // gain anything here.
-          if (pixel_delta_in_ticks != 0) {
-            min_ignore = min_timegraph_tick +
-                         ((timer_info.start() - min_timegraph_tick) / pixel_delta_in_ticks) *
-                             pixel_delta_in_ticks;
-            max_ignore = min_ignore + pixel_delta_in_ticks;
-          }
-        }
+  // Only the timers that are drawn are materialized, always into the same
+  // TimerInfo.
+  TimerInfo timer_info;
+  auto draw_timer = [&](TimerBlock& block, size_t k) {
+    block.GetTimerInfo(k, &timer_info);
+    if (!TimerFilter(timer_info)) return false;
+
+    TextBox& text_box = block[k];
+
+    UpdateDepth(timer_info.depth() + 1);
+    double start_us = time_graph_->GetUsFromTick(timer_info.start());
+    double end_us = time_graph_->GetUsFromTick(timer_info.end());
+    double elapsed_us = end_us - start_us;
+    double normalized_start = start_us * inv_time_window;
+    double normalized_length = elapsed_us * inv_time_window;
+    float world_timer_width = static_cast<float>(normalized_length * world_width);
+    float world_timer_x = static_cast<float>(world_start_x + normalized_start * world_width);
+    float world_timer_y = GetYFromDepth(timer_info.depth());
+
+    bool is_visible_width = normalized_length * canvas->getWidth() > 1;
+    bool is_selected = &text_box == GOrbitApp->selected_text_box();
+
+    Vec2 pos(world_timer_x, world_timer_y);
+    Vec2 size(world_timer_width, box_height_);
+    float z = GlCanvas::kZValueBox;
+    Color color = GetTimerColor(timer_info, is_selected);
+    text_box.SetPos(pos);
+    text_box.SetSize(size);
+
+    PickingUserData user_data(&text_box, this);
+
+    if (is_visible_width) {
+      if (!is_collapsed) {
+        SetTimesliceText(timer_info, elapsed_us, world_start_x, &text_box, batch);
       }
+      batcher->AddShadedBox(pos, size, z, color, user_data);
+      return false;
     }
+    batcher->AddVerticalLine(pos, size[1], z, color, user_data);
+    return true;
+  };
+
+  for (auto& chain : chains_by_depth) {
+    if (!chain) continue;
+    chain->ForEachVisibleTimer(min_tick, max_tick, min_timegraph_tick, pixel_delta_in_ticks,
+                               draw_timer);
   }
 }
 
@@ -151,15 +131,12 @@ void TimerTrack::OnTimer(const TimerInfo& timer_info) {
     UpdateDepth(timer_info.depth() + 1);
   }
 
-  TextBox text_box(Vec2(0, 0), Vec2(0, 0), "");
-  text_box.SetTimerInfo(timer_info);
-
   std::shared_ptr<TimerChain> timer_chain = timers_[timer_info.depth()];
   if (timer_chain == nullptr) {
     timer_chain = std::make_shared<TimerChain>();
     timers_[timer_info.depth()] = timer_chain;
   }
-  timer_chain->push_back(text_box);
+  timer_chain->push_back(timer_info);
   ++num_timers_;
   if (timer_info.start() < min_time_) min_time_ = timer_info.start();
   if (timer_info.end() > max_time_) max_time_ = timer_info.end();
@@ -192,37 +169,13 @@ std::vector<std::shared_ptr<TimerChain>> TimerTrack::GetTimers() {
 const TextBox* TimerTrack::GetFirstAfterTime(uint64_t time, uint32_t depth) const {
   std::shared_ptr<TimerChain> chain = GetTimers(depth);
   if (chain == nullptr) return nullptr;
-
-  // TODO: do better than linear search...
-  for (TimerChainIterator it = chain->begin(); it != chain->end(); ++it) {
-    for (size_t k = 0; k < it->size(); ++k) {
-      const TextBox& text_box = (*it)[k];
-      if (text_box.GetTimerInfo().start() > time) {
-        return &text_box;
-      }
-    }
-  }
-  return nullptr;
+  return chain->FindFirstStartingAfter(time);
 }
 
 const TextBox* TimerTrack::GetFirstBeforeTime(uint64_t time, uint32_t depth) const {
   std::shared_ptr<TimerChain> chain = GetTimers(depth);
   if (chain == nullptr) return nullptr;
-
-  const TextBox* text_box = nullptr;
-
-  // TODO: do better than linear search...
-  for (TimerChainIterator it = chain->begin(); it != chain->end(); ++it) {
-    for (size_t k = 0; k < it->size(); ++k) {
-      const TextBox& box = (*it)[k];
-      if (box.GetTimerInfo().start() > time) {
-        return text_box;
-      }
-      text_box = &box;
-    }
-  }
-
-  return nullptr;
+  return chain->FindLastBeforeFirstStartingAfter(time);
 }
 
 std::shared_ptr<TimerChain> TimerTrack::GetTimers(uint32_t depth) const {
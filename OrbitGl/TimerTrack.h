@@ -18,9 +18,7 @@
 #include "Track.h"
 #include "capture_data.pb.h"
 
-class TextRenderer;
-
-class TimerTrack : public Track {
+class TimerTrack : public Track, public PickingTooltipProvider {
  public:
   explicit TimerTrack(TimeGraph* time_graph);
   ~TimerTrack() override = default;
@@ -31,10 +29,15 @@ class TimerTrack : public Track {
   [[nodiscard]] std::string GetTooltip() const override;
 
   // Track
-  void UpdatePrimitives(uint64_t min_tick, uint64_t max_tick,
+  void UpdatePrimitives(PrimitiveBatch* batch, uint64_t min_tick, uint64_t max_tick,
                         PickingMode /*picking_mode*/) override;
   [[nodiscard]] Type GetType() const override { return kTimerTrack; }
 
+  // PickingTooltipProvider
+  [[nodiscard]] std::string GetPickingTooltip(PickingId id) const override {
+    return GetBoxTooltip(id);
+  }
+
   [[nodiscard]] std::vector<std::shared_ptr<TimerChain>> GetTimers() override;
   [[nodiscard]] uint32_t GetDepth() const { return depth_; }
   [[nodiscard]] std::string GetExtraInfo(const orbit_client_protos::TimerInfo& timer);
@@ -86,8 +89,8 @@ class TimerTrack : public Track {
   [[nodiscard]] std::shared_ptr<TimerChain> GetTimers(uint32_t depth) const;
 
   virtual void SetTimesliceText(const orbit_client_protos::TimerInfo& /*timer*/,
-                                double /*elapsed_us*/, float /*min_x*/, TextBox* /*text_box*/) {}
-  TextRenderer* text_renderer_ = nullptr;
+                                double /*elapsed_us*/, float /*min_x*/, TextBox* /*text_box*/,
+                                PrimitiveBatch* /*batch*/) {}
   uint32_t depth_ = 0;
   mutable Mutex mutex_;
   std::map<int, std::shared_ptr<TimerChain>> timers_;
@@ -54,9 +54,9 @@ void TracepointTrack::Draw(GlCanvas* canvas, PickingMode picking_mode) {
   canvas_ = canvas;
 }
 
-void TracepointTrack::UpdatePrimitives(uint64_t min_tick, uint64_t max_tick,
-                                       PickingMode picking_mode) {
-  Batcher* batcher = &time_graph_->GetBatcher();
+void TracepointTrack::UpdatePrimitives(PrimitiveBatch* batch, uint64_t min_tick,
+                                       uint64_t max_tick, PickingMode picking_mode) {
+  Batcher* batcher = batch->GetBatcher();
   const TimeGraphLayout& layout = time_graph_->GetLayout();
   float z = GlCanvas::kZValueEvent;
   float track_height = layout.GetEventTrackHeight();
@@ -88,10 +88,9 @@ void TracepointTrack::UpdatePrimitives(uint64_t min_tick, uint64_t max_tick,
 
       Vec2 pos(time_graph_->GetWorldFromTick(time) - kPickingBoxOffset, pos_[1] - track_height + 1);
       Vec2 size(kPickingBoxWidth, track_height);
-      auto user_data = std::make_unique<PickingUserData>(
-          nullptr, [&](PickingId id) -> std::string { return GetSampleTooltip(id); });
-      user_data->custom_data_ = &it->second;
-      batcher->AddShadedBox(pos, size, z, kGreenSelection, std::move(user_data));
+      PickingUserData user_data(nullptr, this);
+      user_data.custom_data_ = &it->second;
+      batcher->AddShadedBox(pos, size, z, kGreenSelection, user_data);
     }
   }
 }
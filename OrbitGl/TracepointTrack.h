@@ -13,7 +13,8 @@ class TracepointTrack : public EventTrack {
 
   void Draw(GlCanvas* canvas, PickingMode picking_mode) override;
 
-  void UpdatePrimitives(uint64_t min_tick, uint64_t max_tick, PickingMode picking_mode) override;
+  void UpdatePrimitives(PrimitiveBatch* batch, uint64_t min_tick, uint64_t max_tick,
+                        PickingMode picking_mode) override;
 
   void SetPos(float x, float y);
 
@@ -23,6 +24,7 @@ class TracepointTrack : public EventTrack {
   void OnRelease() override;
 
   std::string GetSampleTooltip(PickingId id) const;
+  std::string GetPickingTooltip(PickingId id) const override { return GetSampleTooltip(id); }
 
  private:
   [[nodiscard]] bool HasTracepoints() const;
@@ -159,7 +159,7 @@ void Track::Draw(GlCanvas* canvas, PickingMode picking_mode) {
   canvas_ = canvas;
 }
 
-void Track::UpdatePrimitives(uint64_t /*t_min*/, uint64_t /*t_max*/,
+void Track::UpdatePrimitives(PrimitiveBatch* /*batch*/, uint64_t /*t_min*/, uint64_t /*t_max*/,
                              PickingMode /*  picking_mode*/) {}
 
 void Track::SetPos(float a_X, float a_Y) {
@@ -13,6 +13,7 @@
 #include "CoreMath.h"
 #include "OrbitBase/Profiling.h"
 #include "PickingManager.h"
+#include "PrimitiveBatch.h"
 #include "TextBox.h"
 #include "TextRenderer.h"
 #include "TimeGraphLayout.h"
@@ -40,7 +41,10 @@ class Track : public Pickable, public std::enable_shared_from_this<Track> {
 
   // Pickable
   void Draw(GlCanvas* a_Canvas, PickingMode a_PickingMode) override;
-  virtual void UpdatePrimitives(uint64_t min_tick, uint64_t max_tick, PickingMode picking_mode);
+  // Adds the primitives of the track to batch. Can be called on any thread, for
+  // one track at a time.
+  virtual void UpdatePrimitives(PrimitiveBatch* batch, uint64_t min_tick, uint64_t max_tick,
+                                PickingMode picking_mode);
   void OnPick(int a_X, int a_Y) override;
   void OnRelease() override;
   void OnDrag(int a_X, int a_Y) override;
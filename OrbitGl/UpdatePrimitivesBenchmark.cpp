@@ -0,0 +1,246 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// Compares the loop of TimerTrack::UpdatePrimitives over --timers timers in
+// the storage that held a TimerInfo and a label in every TextBox, and in the
+// columns of TimerBlock: the timers that intersect the time window are visited
+// and the drawn ones are added to a Batcher, zoomed in on 10'000 timers and
+// zoomed out over all of them. With the columns, both the one by one loop that
+// UpdatePrimitives had with the old storage and TimerChain::ForEachVisibleTimer
+// are measured. The labels are not generated, as that needs a TextRenderer.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <limits>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "Batcher.h"
+#include "TextBox.h"
+#include "TimerChain.h"
+#include "absl/flags/flag.h"
+#include "absl/flags/parse.h"
+#include "capture_data.pb.h"
+
+ABSL_FLAG(uint64_t, timers, 50'000'000, "Number of timers in the track");
+ABSL_FLAG(uint64_t, frames, 10, "Number of frames of each kind");
+ABSL_FLAG(bool, old_storage, true,
+          "Also measure the old storage, which takes about 170 bytes per timer");
+
+namespace {
+
+using orbit_client_protos::TimerInfo;
+
+constexpr uint64_t kTimerPeriodNs = 1000;
+constexpr uint64_t kPixelCount = 1920;
+constexpr uint32_t kDepthCount = 8;
+
+// The TextBox of a timer before the timers were stored in columns.
+class OldTextBox : public TextBox {
+ public:
+  [[nodiscard]] const TimerInfo& GetTimerInfo() const { return timer_info_; }
+  void SetTimerInfo(const TimerInfo& timer_info) { timer_info_ = timer_info; }
+
+ private:
+  std::string text_;
+  TimerInfo timer_info_;
+  size_t elapsed_time_text_length_ = 0;
+};
+
+struct OldTimerBlock {
+  uint64_t size = 0;
+  uint64_t min_timestamp = std::numeric_limits<uint64_t>::max();
+  uint64_t max_timestamp = std::numeric_limits<uint64_t>::min();
+  OldTextBox text_boxes[kBlockSize];
+
+  [[nodiscard]] bool Intersects(uint64_t min, uint64_t max) const {
+    return min <= max_timestamp && max >= min_timestamp;
+  }
+};
+
+using OldTimerChain = std::vector<std::unique_ptr<OldTimerBlock>>;
+
+double SecondsSince(std::chrono::steady_clock::time_point begin) {
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+}
+
+// Timers of about half their period, whose fields are all set, like the
+// timers of dynamically instrumented functions.
+void FillTimer(uint64_t index, TimerInfo* timer) {
+  timer->set_start(index * kTimerPeriodNs);
+  timer->set_end(index * kTimerPeriodNs + kTimerPeriodNs / 2 + index % 7 * 10);
+  timer->set_function_address(0x400000 + index % 1000 * 0x40);
+  timer->set_process_id(1000);
+  timer->set_thread_id(1000 + static_cast<int32_t>(index % 4));
+  timer->set_depth(static_cast<uint32_t>(index % kDepthCount));
+  timer->set_processor(static_cast<int32_t>(index % 16));
+  timer->set_type(TimerInfo::kNone);
+}
+
+// What UpdatePrimitives does with a timer that it draws: wide timers are
+// boxes, timers narrower than a pixel are lines. Returns whether it drew a
+// line.
+bool AddTimer(const TimerInfo& timer_info, TextBox* text_box, uint64_t min_tick,
+              uint64_t pixel_delta_in_ticks, float world_per_tick, Batcher* batcher) {
+  uint64_t start = timer_info.start();
+  uint64_t end = timer_info.end();
+  Color color(static_cast<uint8_t>(timer_info.function_address()), 0, 0, 255);
+  Vec2 pos(static_cast<float>(start - std::min(start, min_tick)) * world_per_tick,
+           static_cast<float>(timer_info.depth()) * 20);
+  Vec2 size(static_cast<float>(end - start) * world_per_tick, 20);
+  text_box->SetPos(pos);
+  text_box->SetSize(size);
+  PickingUserData user_data(text_box, nullptr);
+  if (end - start >= pixel_delta_in_ticks) {
+    batcher->AddShadedBox(pos, size, 0, color, user_data);
+    return false;
+  }
+  batcher->AddVerticalLine(pos, size[1], 0, color, user_data);
+  return true;
+}
+
+// The loop of TimerTrack::UpdatePrimitives before the timers were stored in
+// columns.
+uint64_t AddVisibleTimersOld(OldTimerChain* chain, uint64_t min_tick, uint64_t max_tick,
+                             Batcher* batcher) {
+  uint64_t pixel_delta_in_ticks = (max_tick - min_tick) / kPixelCount;
+  float world_per_tick = static_cast<float>(kPixelCount) / static_cast<float>(max_tick - min_tick);
+  uint64_t count = 0;
+  for (std::unique_ptr<OldTimerBlock>& block : *chain) {
+    if (!block->Intersects(min_tick, max_tick)) continue;
+    uint64_t min_ignore = std::numeric_limits<uint64_t>::max();
+    uint64_t max_ignore = std::numeric_limits<uint64_t>::min();
+    for (size_t k = 0; k < block->size; ++k) {
+      OldTextBox& text_box = block->text_boxes[k];
+      const TimerInfo& timer_info = text_box.GetTimerInfo();
+      if (min_tick > timer_info.end() || max_tick < timer_info.start()) continue;
+      if (timer_info.start() >= min_ignore && timer_info.end() <= max_ignore) continue;
+      ++count;
+      if (!AddTimer(timer_info, &text_box, min_tick, pixel_delta_in_ticks, world_per_tick,
+                    batcher)) {
+        continue;
+      }
+      if (pixel_delta_in_ticks != 0) {
+        min_ignore = min_tick + ((timer_info.start() - min_tick) / pixel_delta_in_ticks) *
+                                    pixel_delta_in_ticks;
+        max_ignore = min_ignore + pixel_delta_in_ticks;
+      }
+    }
+  }
+  return count;
+}
+
+// The same loop over the columns, which only materializes the drawn timers.
+uint64_t AddVisibleTimersOneByOne(TimerChain* chain, uint64_t min_tick, uint64_t max_tick,
+                                  Batcher* batcher) {
+  uint64_t pixel_delta_in_ticks = (max_tick - min_tick) / kPixelCount;
+  float world_per_tick = static_cast<float>(kPixelCount) / static_cast<float>(max_tick - min_tick);
+  uint64_t count = 0;
+  TimerInfo timer_info;
+  for (TimerBlock& block : *chain) {
+    if (!block.Intersects(min_tick, max_tick)) continue;
+    uint64_t min_ignore = std::numeric_limits<uint64_t>::max();
+    uint64_t max_ignore = std::numeric_limits<uint64_t>::min();
+    for (size_t k = 0; k < block.size(); ++k) {
+      uint64_t start = block.GetStart(k);
+      uint64_t end = block.GetEnd(k);
+      if (min_tick > end || max_tick < start) continue;
+      if (start >= min_ignore && end <= max_ignore) continue;
+      ++count;
+      block.GetTimerInfo(k, &timer_info);
+      if (!AddTimer(timer_info, &block[k], min_tick, pixel_delta_in_ticks, world_per_tick,
+                    batcher)) {
+        continue;
+      }
+      if (pixel_delta_in_ticks != 0) {
+        min_ignore = min_tick + ((start - min_tick) / pixel_delta_in_ticks) * pixel_delta_in_ticks;
+        max_ignore = min_ignore + pixel_delta_in_ticks;
+      }
+    }
+  }
+  return count;
+}
+
+uint64_t AddVisibleTimers(TimerChain* chain, uint64_t min_tick, uint64_t max_tick,
+                          Batcher* batcher) {
+  uint64_t pixel_delta_in_ticks = (max_tick - min_tick) / kPixelCount;
+  float world_per_tick = static_cast<float>(kPixelCount) / static_cast<float>(max_tick - min_tick);
+  uint64_t count = 0;
+  TimerInfo timer_info;
+  chain->ForEachVisibleTimer(min_tick, max_tick, min_tick, pixel_delta_in_ticks,
+                             [&](TimerBlock& block, size_t k) {
+                               ++count;
+                               block.GetTimerInfo(k, &timer_info);
+                               return AddTimer(timer_info, &block[k], min_tick,
+                                               pixel_delta_in_ticks, world_per_tick, batcher);
+                             });
+  return count;
+}
+
+// Runs --frames frames zoomed in on 10'000 timers in the middle of the track,
+// and as many zoomed out over the whole track, and prints the time per frame.
+template <typename AddVisibleTimersFunction>
+void RunFrames(const char* name, uint64_t timer_count,
+               AddVisibleTimersFunction add_visible_timers) {
+  uint64_t frame_count = absl::GetFlag(FLAGS_frames);
+  Batcher batcher(BatcherId::kTimeGraph);
+  uint64_t zoomed_in_timer_count = std::min<uint64_t>(10'000, timer_count);
+  uint64_t zoomed_in_min_tick = (timer_count - zoomed_in_timer_count) / 2 * kTimerPeriodNs;
+  for (uint64_t window_timer_count : {zoomed_in_timer_count, timer_count}) {
+    uint64_t min_tick = window_timer_count == timer_count ? 0 : zoomed_in_min_tick;
+    uint64_t max_tick = min_tick + window_timer_count * kTimerPeriodNs;
+    uint64_t drawn_count = 0;
+    auto begin = std::chrono::steady_clock::now();
+    for (uint64_t frame = 0; frame < frame_count; ++frame) {
+      batcher.StartNewFrame();
+      drawn_count = add_visible_timers(min_tick, max_tick, &batcher);
+    }
+    printf("%-28s %10lu timers in window %8lu drawn %10.3f ms per frame\n", name,
+           window_timer_count, drawn_count, SecondsSince(begin) * 1e3 / frame_count);
+  }
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  absl::ParseCommandLine(argc, argv);
+  uint64_t timer_count = absl::GetFlag(FLAGS_timers);
+  TimerInfo timer;
+
+  // One storage at a time, to fit in memory.
+  if (absl::GetFlag(FLAGS_old_storage)) {
+    OldTimerChain old_chain;
+    for (uint64_t i = 0; i < timer_count; ++i) {
+      if (old_chain.empty() || old_chain.back()->size == kBlockSize) {
+        old_chain.push_back(std::make_unique<OldTimerBlock>());
+      }
+      OldTimerBlock& block = *old_chain.back();
+      FillTimer(i, &timer);
+      block.text_boxes[block.size++].SetTimerInfo(timer);
+      block.min_timestamp = std::min(block.min_timestamp, timer.start());
+      block.max_timestamp = std::max(block.max_timestamp, timer.end());
+    }
+    RunFrames("TimerInfo per TextBox", timer_count,
+              [&old_chain](uint64_t min_tick, uint64_t max_tick, Batcher* batcher) {
+                return AddVisibleTimersOld(&old_chain, min_tick, max_tick, batcher);
+              });
+  }
+
+  TimerChain chain;
+  for (uint64_t i = 0; i < timer_count; ++i) {
+    FillTimer(i, &timer);
+    chain.push_back(timer);
+  }
+  RunFrames("Columns, one by one", timer_count,
+            [&chain](uint64_t min_tick, uint64_t max_tick, Batcher* batcher) {
+              return AddVisibleTimersOneByOne(&chain, min_tick, max_tick, batcher);
+            });
+  RunFrames("Columns, ForEachVisibleTimer", timer_count,
+            [&chain](uint64_t min_tick, uint64_t max_tick, Batcher* batcher) {
+              return AddVisibleTimers(&chain, min_tick, max_tick, batcher);
+            });
+  return 0;
+}
@@ -0,0 +1,191 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// Measures the throughput, in events per second, of the handoff of deferred
+// events from the ring buffer readers to the deferred events thread, as done
+// by TracerThread::DeferEvent and TracerThread::ProcessDeferredEvents.
+// "mutex" reproduces the previous implementation: a vector per reader guarded
+// by a mutex, swapped out by the consumer, which sleeps for 1 ms when there are
+// no events. "spsc" uses SpscQueue and FutexNotifier, with notifications in
+// batches, like TracerThread does.
+// The consumer only destroys the events, so that the handoff itself is
+// measured.
+
+#include <OrbitBase/Logging.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "PerfEvent.h"
+#include "SpscQueue.h"
+#include "absl/flags/flag.h"
+#include "absl/flags/parse.h"
+
+ABSL_FLAG(uint32_t, max_producers, 4, "Benchmark from 1 up to this number of producers");
+ABSL_FLAG(uint64_t, events_per_producer, 5'000'000, "Number of events each producer defers");
+
+namespace {
+
+using LinuxTracing::FutexNotifier;
+using LinuxTracing::PerfEvent;
+using LinuxTracing::SpscQueue;
+using LinuxTracing::UprobesPerfEvent;
+
+constexpr uint32_t IDLE_TIME_ON_EMPTY_DEFERRED_EVENTS_US = 1000;
+constexpr size_t DEFERRED_EVENTS_QUEUE_CAPACITY = 64 * 1024;
+constexpr uint64_t DEFERRED_EVENTS_NOTIFY_BATCH_SIZE = 1024;
+constexpr uint32_t DEFERRED_EVENTS_WAIT_TIMEOUT_MS = 10;
+
+std::unique_ptr<PerfEvent> MakeEvent(uint64_t timestamp) {
+  auto event = std::make_unique<UprobesPerfEvent>();
+  event->ring_buffer_record.sample_id.time = timestamp;
+  return event;
+}
+
+class MutexHandoff {
+ public:
+  explicit MutexHandoff(uint32_t producer_count) : producers_(producer_count) {}
+
+  void Defer(uint32_t producer_index, std::unique_ptr<PerfEvent> event) {
+    Producer& producer = producers_[producer_index];
+    std::lock_guard<std::mutex> lock(producer.mutex);
+    producer.events.emplace_back(std::move(event));
+  }
+
+  void Consume(const std::atomic<bool>& stop) {
+    bool should_exit = false;
+    while (!should_exit) {
+      should_exit = stop;
+      std::vector<std::unique_ptr<PerfEvent>> events;
+      for (Producer& producer : producers_) {
+        std::lock_guard<std::mutex> lock(producer.mutex);
+        if (events.empty()) {
+          events = std::move(producer.events);
+        } else {
+          std::move(producer.events.begin(), producer.events.end(), std::back_inserter(events));
+        }
+        producer.events.clear();
+      }
+      if (events.empty()) {
+        usleep(IDLE_TIME_ON_EMPTY_DEFERRED_EVENTS_US);
+      }
+    }
+  }
+
+  void NotifyStop() {}
+
+ private:
+  struct Producer {
+    std::vector<std::unique_ptr<PerfEvent>> events;
+    std::mutex mutex;
+  };
+  std::vector<Producer> producers_;
+};
+
+class SpscHandoff {
+ public:
+  explicit SpscHandoff(uint32_t producer_count) {
+    for (uint32_t i = 0; i < producer_count; ++i) {
+      producers_.emplace_back(std::make_unique<Producer>());
+    }
+  }
+
+  void Defer(uint32_t producer_index, std::unique_ptr<PerfEvent> event) {
+    Producer* producer = producers_[producer_index].get();
+    while (!producer->queue.TryPush(std::move(event))) {
+      notifier_.Notify();
+      std::this_thread::yield();
+    }
+    if (++producer->event_count % DEFERRED_EVENTS_NOTIFY_BATCH_SIZE == 0) {
+      notifier_.Notify();
+    }
+  }
+
+  void Consume(const std::atomic<bool>& stop) {
+    bool should_exit = false;
+    while (!should_exit) {
+      should_exit = stop;
+      size_t event_count = 0;
+      for (const auto& producer : producers_) {
+        std::unique_ptr<PerfEvent> event;
+        while (producer->queue.TryPop(&event)) {
+          ++event_count;
+        }
+      }
+      if (event_count == 0 && !should_exit) {
+        uint32_t token = notifier_.PrepareWait();
+        bool has_events = false;
+        for (const auto& producer : producers_) {
+          has_events |= !producer->queue.IsEmpty();
+        }
+        if (has_events || stop) {
+          notifier_.CancelWait();
+        } else {
+          notifier_.Wait(token, DEFERRED_EVENTS_WAIT_TIMEOUT_MS);
+        }
+      }
+    }
+  }
+
+  void NotifyStop() { notifier_.Notify(); }
+
+ private:
+  struct Producer {
+    SpscQueue<std::unique_ptr<PerfEvent>> queue{DEFERRED_EVENTS_QUEUE_CAPACITY};
+    uint64_t event_count = 0;
+  };
+  std::vector<std::unique_ptr<Producer>> producers_;
+  FutexNotifier notifier_;
+};
+
+template <typename Handoff>
+void RunBenchmark(const char* name, uint32_t producer_count, uint64_t events_per_producer) {
+  Handoff handoff{producer_count};
+  std::atomic<bool> stop = false;
+
+  auto begin = std::chrono::steady_clock::now();
+  std::thread consumer([&handoff, &stop] { handoff.Consume(stop); });
+  std::vector<std::thread> producers;
+  for (uint32_t producer_index = 0; producer_index < producer_count; ++producer_index) {
+    producers.emplace_back([&handoff, producer_index, events_per_producer] {
+      for (uint64_t i = 0; i < events_per_producer; ++i) {
+        handoff.Defer(producer_index, MakeEvent(i));
+      }
+    });
+  }
+  for (std::thread& producer : producers) {
+    producer.join();
+  }
+  stop = true;
+  handoff.NotifyStop();
+  consumer.join();
+  double duration_s =
+      std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+
+  uint64_t event_count = producer_count * events_per_producer;
+  printf("%-6s %10u %14.0f\n", name, producer_count, event_count / duration_s);
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  absl::ParseCommandLine(argc, argv);
+  uint32_t max_producers = absl::GetFlag(FLAGS_max_producers);
+  uint64_t events_per_producer = absl::GetFlag(FLAGS_events_per_producer);
+  FAIL_IF(max_producers == 0, "--max_producers must be at least 1");
+
+  printf("%-6s %10s %14s\n", "impl", "producers", "events/s");
+  for (uint32_t producer_count = 1; producer_count <= max_producers; ++producer_count) {
+    RunBenchmark<MutexHandoff>("mutex", producer_count, events_per_producer);
+    RunBenchmark<SpscHandoff>("spsc", producer_count, events_per_producer);
+  }
+  return 0;
+}
@@ -79,18 +79,17 @@ void GpuTracepointEventProcessor::CreateGpuExecutionEventIfComplete(const Key& k
 
   int depth =
       ComputeDepthForEvent(timeline, cs_it->second.timestamp_ns, dma_it->second.timestamp_ns);
-  GpuJob gpu_job;
-  gpu_job.set_tid(tid);
-  gpu_job.set_context(cs_it->second.context);
-  gpu_job.set_seqno(cs_it->second.seqno);
-  gpu_job.set_timeline(cs_it->second.timeline);
-  gpu_job.set_depth(depth);
-  gpu_job.set_amdgpu_cs_ioctl_time_ns(cs_it->second.timestamp_ns);
-  gpu_job.set_amdgpu_sched_run_job_time_ns(sched_it->second.timestamp_ns);
-  gpu_job.set_gpu_hardware_start_time_ns(hw_start_time);
-  gpu_job.set_dma_fence_signaled_time_ns(dma_it->second.timestamp_ns);
-
-  listener_->OnGpuJob(std::move(gpu_job));
+  listener_->OnGpuJob([tid, depth, hw_start_time, &cs_it, &sched_it, &dma_it](GpuJob* gpu_job) {
+    gpu_job->set_tid(tid);
+    gpu_job->set_context(cs_it->second.context);
+    gpu_job->set_seqno(cs_it->second.seqno);
+    gpu_job->set_timeline(cs_it->second.timeline);
+    gpu_job->set_depth(depth);
+    gpu_job->set_amdgpu_cs_ioctl_time_ns(cs_it->second.timestamp_ns);
+    gpu_job->set_amdgpu_sched_run_job_time_ns(sched_it->second.timestamp_ns);
+    gpu_job->set_gpu_hardware_start_time_ns(hw_start_time);
+    gpu_job->set_dma_fence_signaled_time_ns(dma_it->second.timestamp_ns);
+  });
 
   // We need to update the timestamp when the last GPU job so far seen
   // finishes on this timeline.
@@ -6,10 +6,49 @@
 
 #include <OrbitBase/Logging.h>
 
+#include <algorithm>
 #include <array>
+#include <cstring>
 
 namespace LinuxTracing {
 
+namespace {
+// Like the unwindstack::Memory returned by
+// unwindstack::Memory::CreateOfflineMemory, but also records the accesses to
+// the stack dump.
+class StackDumpMemory : public unwindstack::Memory {
+ public:
+  StackDumpMemory(const uint8_t* stack_dump, uint64_t start, uint64_t end)
+      : stack_dump_{stack_dump}, start_{start}, end_{end} {}
+
+  size_t Read(uint64_t addr, void* dst, size_t size) override {
+    if (addr < start_) {
+      return 0;
+    }
+    if (addr + size > end_) {
+      access_.failed_read_offset = std::min(access_.failed_read_offset, addr - start_);
+    }
+    if (addr >= end_) {
+      return 0;
+    }
+    size_t read_size = std::min<uint64_t>(size, end_ - addr);
+    memcpy(dst, stack_dump_ + (addr - start_), read_size);
+    access_.read_size = std::max(access_.read_size, addr + read_size - start_);
+    return read_size;
+  }
+
+  [[nodiscard]] const LibunwindstackUnwinder::StackDumpAccess& GetAccess() const {
+    return access_;
+  }
+
+ private:
+  const uint8_t* stack_dump_;
+  uint64_t start_;
+  uint64_t end_;
+  LibunwindstackUnwinder::StackDumpAccess access_;
+};
+}  // namespace
+
 std::unique_ptr<unwindstack::BufferMaps> LibunwindstackUnwinder::ParseMaps(
     const std::string& maps_buffer) {
   auto maps = std::make_unique<unwindstack::BufferMaps>(maps_buffer.c_str());
@@ -29,26 +68,45 @@ const std::array<size_t, unwindstack::X86_64_REG_LAST>
 
 std::vector<unwindstack::FrameData> LibunwindstackUnwinder::Unwind(
     unwindstack::Maps* maps, const std::array<uint64_t, PERF_REG_X86_64_MAX>& perf_regs,
-    const void* stack_dump, uint64_t stack_dump_size) {
+    const void* stack_dump, uint64_t stack_dump_size, StackDumpAccess* stack_dump_access,
+    const FunctionNameSelector& select_function_names_to_resolve) {
   unwindstack::RegsX86_64 regs{};
   for (size_t perf_reg = 0; perf_reg < unwindstack::X86_64_REG_LAST; ++perf_reg) {
     regs[perf_reg] = perf_regs.at(UNWINDSTACK_REGS_TO_PERF_REGS[perf_reg]);
   }
 
-  std::shared_ptr<unwindstack::Memory> memory = unwindstack::Memory::CreateOfflineMemory(
-      static_cast<const uint8_t*>(stack_dump), regs[unwindstack::X86_64_REG_RSP],
-      regs[unwindstack::X86_64_REG_RSP] + stack_dump_size);
+  uint64_t stack_pointer = regs[unwindstack::X86_64_REG_RSP];
+  auto memory = std::make_shared<StackDumpMemory>(static_cast<const uint8_t*>(stack_dump),
+                                                  stack_pointer, stack_pointer + stack_dump_size);
 
+  const bool resolve_all_names = select_function_names_to_resolve == nullptr;
   unwindstack::Unwinder unwinder{MAX_FRAMES, maps, &regs, memory};
+  unwinder.SetResolveNames(resolve_all_names);
   // Careful: regs are modified. Use regs.Clone() if you need to reuse regs
   // later.
   unwinder.Unwind();
+  if (stack_dump_access != nullptr) {
+    *stack_dump_access = memory->GetAccess();
+  }
+
+  std::vector<unwindstack::FrameData> frames = unwinder.frames();
+  if (!resolve_all_names) {
+    // Without name resolution, libunwindstack doesn't fill in the map names
+    // either, but they are needed to recognize the [uprobes] frames.
+    for (unwindstack::FrameData& frame : frames) {
+      unwindstack::MapInfo* map_info = maps->Find(frame.pc);
+      if (map_info != nullptr) {
+        frame.map_name = map_info->name;
+      }
+    }
+  }
 
   // Samples that fall inside a function dynamically-instrumented with
   // uretprobes often result in unwinding errors when hitting the trampoline
   // inserted by the uretprobe. Do not treat them as errors as we might want
   // those callstacks.
-  if (unwinder.LastErrorCode() != 0 && unwinder.frames().back().map_name != "[uprobes]") {
+  if (unwinder.LastErrorCode() != 0 &&
+      (frames.empty() || frames.back().map_name != "[uprobes]")) {
 #ifndef NDEBUG
     ERROR("%s at %#016lx", LibunwindstackErrorString(unwinder.LastErrorCode()).c_str(),
           unwinder.LastErrorAddress());
@@ -56,7 +114,27 @@ std::vector<unwindstack::FrameData> LibunwindstackUnwinder::Unwind(
     return {};
   }
 
-  return unwinder.frames();
+  if (!resolve_all_names) {
+    std::vector<bool> resolve_function_names = select_function_names_to_resolve(frames);
+    CHECK(resolve_function_names.size() == frames.size());
+    for (size_t i = 0; i < frames.size(); ++i) {
+      if (!resolve_function_names[i]) {
+        continue;
+      }
+      unwindstack::FrameData& frame = frames[i];
+      // Same as what unwindstack::Unwinder does when resolving names. The Elf
+      // has already been created while unwinding.
+      unwindstack::MapInfo* map_info = maps->Find(frame.pc);
+      unwindstack::Elf* elf =
+          map_info != nullptr ? map_info->GetElf(memory, unwindstack::ARCH_X86_64) : nullptr;
+      if (elf == nullptr ||
+          !elf->GetFunctionName(frame.rel_pc, &frame.function_name, &frame.function_offset)) {
+        frame.function_name = "";
+        frame.function_offset = 0;
+      }
+    }
+  }
+  return frames;
 }
 
 }  // namespace LinuxTracing
@@ -10,6 +10,8 @@
 #include <unwindstack/RegsX86_64.h>
 #include <unwindstack/Unwinder.h>
 
+#include <functional>
+#include <limits>
 #include <string>
 #include <vector>
 
@@ -19,9 +21,37 @@ class LibunwindstackUnwinder {
  public:
   static std::unique_ptr<unwindstack::BufferMaps> ParseMaps(const std::string& maps_buffer);
 
+  // While enabled, the unwindstack::Elf objects, together with the unwind
+  // information they have parsed so far, are cached by file path and offset
+  // across all maps, instead of belonging to the maps they were created from.
+  // Disabling clears the cache. Not thread-safe with respect to unwinding.
+  static void SetElfCachingEnabled(bool enabled) {
+    unwindstack::Elf::SetCachingEnabled(enabled);
+  }
+
+  // How unwinding accessed the stack dump, in bytes from the beginning of the
+  // dump, i.e., from the stack pointer.
+  struct StackDumpAccess {
+    // End of the furthest successful read.
+    uint64_t read_size = 0;
+    // Beginning of the nearest read that went past the end of the stack dump.
+    uint64_t failed_read_offset = std::numeric_limits<uint64_t>::max();
+  };
+
+  // Returns, for each of the unwound frames, whether to resolve its function
+  // name and offset.
+  using FunctionNameSelector =
+      std::function<std::vector<bool>(const std::vector<unwindstack::FrameData>& frames)>;
+
+  // Resolving the function name of a frame is expensive. If
+  // select_function_names_to_resolve is set, it is called once with all the
+  // unwound frames, and only the frames it selects get a function name and
+  // offset. The map name is always set.
   std::vector<unwindstack::FrameData> Unwind(
       unwindstack::Maps* maps, const std::array<uint64_t, PERF_REG_X86_64_MAX>& perf_regs,
-      const void* stack_dump, uint64_t stack_dump_size);
+      const void* stack_dump, uint64_t stack_dump_size,
+      StackDumpAccess* stack_dump_access = nullptr,
+      const FunctionNameSelector& select_function_names_to_resolve = nullptr);
 
  private:
   static constexpr size_t MAX_FRAMES = 1024;  // This is arbitrary.
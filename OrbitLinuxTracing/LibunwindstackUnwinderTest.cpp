@@ -0,0 +1,76 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <gtest/gtest.h>
+
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "LibunwindstackUnwinder.h"
+
+namespace LinuxTracing {
+
+namespace {
+
+const std::string kMapsString =
+    "7ffcae624000-7ffcae646000 rw-p 00000000 00:00 0                          "
+    "[stack]\n"
+    "7fffffffe000-7ffffffff000 --xp 00000000 00:00 0                          "
+    "[uprobes]";
+
+constexpr uint64_t kUprobesPc = 0x7fffffffe000;
+constexpr uint64_t kStackPointer = 0x7ffcae645000;
+
+}  // namespace
+
+// A sample that hits the uretprobes trampoline can't be unwound further, but
+// is only kept if its last frame is recognized by its map name, even when
+// function names are not resolved.
+TEST(LibunwindstackUnwinder, MapNamesAreSetWhenFunctionNamesAreSelected) {
+  std::unique_ptr<unwindstack::BufferMaps> maps = LibunwindstackUnwinder::ParseMaps(kMapsString);
+  ASSERT_NE(maps, nullptr);
+  std::array<uint64_t, PERF_REG_X86_64_MAX> perf_regs{};
+  perf_regs[PERF_REG_X86_IP] = kUprobesPc;
+  perf_regs[PERF_REG_X86_SP] = kStackPointer;
+  std::array<uint8_t, 8> stack_dump{};
+
+  size_t selector_call_count = 0;
+  auto select_no_function_names =
+      [&selector_call_count](const std::vector<unwindstack::FrameData>& frames) {
+        ++selector_call_count;
+        return std::vector<bool>(frames.size(), false);
+      };
+  LibunwindstackUnwinder unwinder;
+  std::vector<unwindstack::FrameData> frames =
+      unwinder.Unwind(maps.get(), perf_regs, stack_dump.data(), 0, nullptr,
+                      select_no_function_names);
+
+  ASSERT_FALSE(frames.empty());
+  EXPECT_EQ(selector_call_count, 1);
+  EXPECT_EQ(frames.front().pc, kUprobesPc);
+  EXPECT_EQ(frames.front().map_name, "[uprobes]");
+  EXPECT_EQ(frames.back().map_name, "[uprobes]");
+  EXPECT_EQ(frames.front().function_name, "");
+}
+
+TEST(LibunwindstackUnwinder, MapNamesAreSetWhenAllFunctionNamesAreResolved) {
+  std::unique_ptr<unwindstack::BufferMaps> maps = LibunwindstackUnwinder::ParseMaps(kMapsString);
+  ASSERT_NE(maps, nullptr);
+  std::array<uint64_t, PERF_REG_X86_64_MAX> perf_regs{};
+  perf_regs[PERF_REG_X86_IP] = kUprobesPc;
+  perf_regs[PERF_REG_X86_SP] = kStackPointer;
+  std::array<uint8_t, 8> stack_dump{};
+
+  LibunwindstackUnwinder unwinder;
+  std::vector<unwindstack::FrameData> frames =
+      unwinder.Unwind(maps.get(), perf_regs, stack_dump.data(), 0);
+
+  ASSERT_FALSE(frames.empty());
+  EXPECT_EQ(frames.front().map_name, "[uprobes]");
+}
+
+}  // namespace LinuxTracing
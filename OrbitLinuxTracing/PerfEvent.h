@@ -11,6 +11,7 @@
 #include "Function.h"
 #include "KernelTracepoints.h"
 #include "OrbitBase/MakeUniqueForOverwrite.h"
+#include "PerfEventAllocator.h"
 #include "PerfEventRecords.h"
 
 namespace LinuxTracing {
@@ -22,9 +23,15 @@ class PerfEventVisitor;
 // perf_event_open records will be copied from the ring buffer directly into the
 // concrete subclass (depending on the event type), in general into a
 // "ring_buffer_record" field.
+// PerfEvents are allocated with AllocatePerfEventMemory, as one is created for
+// each sample and uprobe.
 
 class PerfEvent {
  public:
+  static void* operator new(size_t size) { return AllocatePerfEventMemory(size); }
+  // As the destructor is virtual, size is the size of the dynamic type.
+  static void operator delete(void* ptr, size_t size) { FreePerfEventMemory(ptr, size); }
+
   virtual ~PerfEvent() = default;
   virtual uint64_t GetTimestamp() const = 0;
   virtual void Accept(PerfEventVisitor* visitor) = 0;
@@ -144,11 +151,14 @@ class LostPerfEvent : public PerfEvent {
 
 struct dynamically_sized_perf_event_stack_sample {
   struct dynamically_sized_perf_event_sample_stack_user {
+    // Bytes of stack that the kernel has dumped.
     uint64_t dyn_size;
-    std::unique_ptr<char[]> data;
+    // Only the first copy_size <= dyn_size bytes of the dump are copied to data.
+    uint64_t copy_size;
+    PerfEventPayload<char> data;
 
-    explicit dynamically_sized_perf_event_sample_stack_user(uint64_t dyn_size)
-        : dyn_size{dyn_size}, data{make_unique_for_overwrite<char[]>(dyn_size)} {}
+    dynamically_sized_perf_event_sample_stack_user(uint64_t dyn_size, uint64_t copy_size)
+        : dyn_size{dyn_size}, copy_size{copy_size}, data{MakePerfEventPayload<char>(copy_size)} {}
   };
 
   perf_event_header header;
@@ -156,34 +166,38 @@ struct dynamically_sized_perf_event_stack_sample {
   perf_event_sample_regs_user_all regs;
   dynamically_sized_perf_event_sample_stack_user stack;
 
-  explicit dynamically_sized_perf_event_stack_sample(uint64_t dyn_size) : stack{dyn_size} {}
+  dynamically_sized_perf_event_stack_sample(uint64_t dyn_size, uint64_t copy_size)
+      : stack{dyn_size, copy_size} {}
 };
 
 class StackSamplePerfEvent : public PerfEvent {
  public:
-  std::unique_ptr<dynamically_sized_perf_event_stack_sample> ring_buffer_record;
+  dynamically_sized_perf_event_stack_sample ring_buffer_record;
 
-  explicit StackSamplePerfEvent(uint64_t dyn_size)
-      : ring_buffer_record{std::make_unique<dynamically_sized_perf_event_stack_sample>(dyn_size)} {}
+  StackSamplePerfEvent(uint64_t dyn_size, uint64_t copy_size)
+      : ring_buffer_record{dyn_size, copy_size} {}
+  explicit StackSamplePerfEvent(uint64_t dyn_size) : StackSamplePerfEvent{dyn_size, dyn_size} {}
 
-  uint64_t GetTimestamp() const override { return ring_buffer_record->sample_id.time; }
+  uint64_t GetTimestamp() const override { return ring_buffer_record.sample_id.time; }
 
   void Accept(PerfEventVisitor* visitor) override;
 
-  pid_t GetPid() const { return ring_buffer_record->sample_id.pid; }
-  pid_t GetTid() const { return ring_buffer_record->sample_id.tid; }
+  pid_t GetPid() const { return ring_buffer_record.sample_id.pid; }
+  pid_t GetTid() const { return ring_buffer_record.sample_id.tid; }
 
-  uint64_t GetStreamId() const { return ring_buffer_record->sample_id.stream_id; }
+  uint64_t GetStreamId() const { return ring_buffer_record.sample_id.stream_id; }
 
-  uint32_t GetCpu() const { return ring_buffer_record->sample_id.cpu; }
+  uint32_t GetCpu() const { return ring_buffer_record.sample_id.cpu; }
 
   std::array<uint64_t, PERF_REG_X86_64_MAX> GetRegisters() const {
-    return perf_event_sample_regs_user_all_to_register_array(ring_buffer_record->regs);
+    return perf_event_sample_regs_user_all_to_register_array(ring_buffer_record.regs);
   }
 
-  const char* GetStackData() const { return ring_buffer_record->stack.data.get(); }
-  char* GetStackData() { return ring_buffer_record->stack.data.get(); }
-  uint64_t GetStackSize() const { return ring_buffer_record->stack.dyn_size; }
+  const char* GetStackData() const { return ring_buffer_record.stack.data.get(); }
+  char* GetStackData() { return ring_buffer_record.stack.data.get(); }
+  // Size of the data returned by GetStackData.
+  uint64_t GetStackSize() const { return ring_buffer_record.stack.copy_size; }
+  uint64_t GetDumpedStackSize() const { return ring_buffer_record.stack.dyn_size; }
 
  private:
   static std::array<uint64_t, PERF_REG_X86_64_MAX>
@@ -221,8 +235,9 @@ class StackSamplePerfEvent : public PerfEvent {
 class CallchainSamplePerfEvent : public PerfEvent {
  public:
   perf_event_callchain_sample_fixed ring_buffer_record;
-  std::vector<uint64_t> ips;
-  explicit CallchainSamplePerfEvent(uint64_t callchain_size) : ips(callchain_size) {
+  PerfEventPayload<uint64_t> ips;
+  explicit CallchainSamplePerfEvent(uint64_t callchain_size)
+      : ips{MakePerfEventPayload<uint64_t>(callchain_size)} {
     ring_buffer_record.nr = callchain_size;
   }
 
@@ -237,8 +252,8 @@ class CallchainSamplePerfEvent : public PerfEvent {
 
   uint32_t GetCpu() const { return ring_buffer_record.sample_id.cpu; }
 
-  uint64_t* GetCallchain() { return ips.data(); }
-  const uint64_t* GetCallchain() const { return ips.data(); }
+  uint64_t* GetCallchain() { return ips.get(); }
+  const uint64_t* GetCallchain() const { return ips.get(); }
 
   uint64_t GetCallchainSize() const { return ring_buffer_record.nr; }
 };
@@ -334,10 +349,10 @@ class GenericTracepointPerfEvent : public PerfEvent {
 class TracepointPerfEvent : public PerfEvent {
  public:
   explicit TracepointPerfEvent(uint32_t size)
-      : tracepoint_data{make_unique_for_overwrite<uint8_t[]>(size)} {}
+      : tracepoint_data{MakePerfEventPayload<uint8_t>(size)} {}
 
   perf_event_raw_sample_fixed ring_buffer_record;
-  std::unique_ptr<uint8_t[]> tracepoint_data;
+  PerfEventPayload<uint8_t> tracepoint_data;
 
   uint64_t GetTimestamp() const override { return ring_buffer_record.sample_id.time; }
 
@@ -0,0 +1,195 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "PerfEventAllocator.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <mutex>
+#include <new>
+#include <vector>
+
+namespace LinuxTracing {
+
+namespace {
+
+constexpr size_t MIN_SIZE_CLASS_LOG2 = 6;
+constexpr size_t MAX_SIZE_CLASS_LOG2 = 17;
+static_assert((1ul << MAX_SIZE_CLASS_LOG2) == MAX_POOLED_PERF_EVENT_MEMORY_SIZE);
+constexpr size_t SIZE_CLASS_COUNT = MAX_SIZE_CLASS_LOG2 - MIN_SIZE_CLASS_LOG2 + 1;
+
+// Number of blocks moved at once between a thread's cache and the shared free
+// list. A thread's cache holds at most twice as many blocks per size class.
+constexpr size_t BATCH_SIZE = 32;
+// The shared free lists can hold at least one batch of the largest blocks.
+static_assert(BATCH_SIZE * MAX_POOLED_PERF_EVENT_MEMORY_SIZE <= MAX_SHARED_PERF_EVENT_MEMORY_SIZE);
+
+size_t GetSizeClass(size_t size) {
+  if (size <= (1ul << MIN_SIZE_CLASS_LOG2)) {
+    return 0;
+  }
+  // Index of the smallest power of two that is at least size.
+  size_t size_log2 = 64 - __builtin_clzl(size - 1);
+  return size_log2 - MIN_SIZE_CLASS_LOG2;
+}
+
+size_t GetBlockSize(size_t size_class) { return 1ul << (size_class + MIN_SIZE_CLASS_LOG2); }
+
+struct SharedFreeList {
+  std::mutex mutex;
+  std::vector<void*> blocks;
+};
+
+std::array<SharedFreeList, SIZE_CLASS_COUNT>& GetSharedFreeLists() {
+  // Never destroyed, as threads return the blocks in their caches to the shared
+  // free lists when they exit, which can happen during static destruction.
+  static auto* shared_free_lists = new std::array<SharedFreeList, SIZE_CLASS_COUNT>;
+  return *shared_free_lists;
+}
+
+std::atomic<uint64_t> system_allocation_count = 0;
+// Bytes in the shared free lists of all size classes.
+std::atomic<size_t> shared_free_list_size = 0;
+
+// Reserves room in the shared free lists for up to count blocks of size_class
+// and returns for how many blocks.
+size_t ReserveSharedBlocks(size_t size_class, size_t count) {
+  size_t block_size = GetBlockSize(size_class);
+  size_t size = shared_free_list_size.load(std::memory_order_relaxed);
+  size_t reserved_count;
+  do {
+    size_t room =
+        size < MAX_SHARED_PERF_EVENT_MEMORY_SIZE ? MAX_SHARED_PERF_EVENT_MEMORY_SIZE - size : 0;
+    reserved_count = std::min(count, room / block_size);
+    if (reserved_count == 0) {
+      return 0;
+    }
+  } while (!shared_free_list_size.compare_exchange_weak(size, size + reserved_count * block_size,
+                                                        std::memory_order_relaxed));
+  return reserved_count;
+}
+
+class ThreadCache {
+ public:
+  ThreadCache() {
+    for (std::vector<void*>& blocks : blocks_) {
+      blocks.reserve(2 * BATCH_SIZE);
+    }
+  }
+
+  ~ThreadCache() {
+    for (size_t size_class = 0; size_class < SIZE_CLASS_COUNT; ++size_class) {
+      ReleaseBlocks(size_class, blocks_[size_class].size());
+    }
+  }
+
+  ThreadCache(const ThreadCache&) = delete;
+  ThreadCache& operator=(const ThreadCache&) = delete;
+
+  void* Allocate(size_t size_class) {
+    std::vector<void*>& blocks = blocks_[size_class];
+    if (blocks.empty()) {
+      AcquireBlocks(size_class);
+    }
+    if (blocks.empty()) {
+      system_allocation_count.fetch_add(1, std::memory_order_relaxed);
+      return ::operator new(GetBlockSize(size_class));
+    }
+    void* block = blocks.back();
+    blocks.pop_back();
+    return block;
+  }
+
+  void Free(void* ptr, size_t size_class) {
+    std::vector<void*>& blocks = blocks_[size_class];
+    blocks.push_back(ptr);
+    if (blocks.size() >= 2 * BATCH_SIZE) {
+      ReleaseBlocks(size_class, BATCH_SIZE);
+    }
+  }
+
+ private:
+  void AcquireBlocks(size_t size_class) {
+    SharedFreeList& shared_free_list = GetSharedFreeLists()[size_class];
+    std::vector<void*>& blocks = blocks_[size_class];
+    std::lock_guard<std::mutex> lock(shared_free_list.mutex);
+    size_t count = std::min(BATCH_SIZE, shared_free_list.blocks.size());
+    blocks.insert(blocks.end(), shared_free_list.blocks.end() - count,
+                  shared_free_list.blocks.end());
+    shared_free_list.blocks.resize(shared_free_list.blocks.size() - count);
+    shared_free_list_size.fetch_sub(count * GetBlockSize(size_class), std::memory_order_relaxed);
+  }
+
+  // Moves the last count blocks of this cache to the shared free list, and
+  // frees those that don't fit there.
+  void ReleaseBlocks(size_t size_class, size_t count) {
+    SharedFreeList& shared_free_list = GetSharedFreeLists()[size_class];
+    std::vector<void*>& blocks = blocks_[size_class];
+    {
+      std::lock_guard<std::mutex> lock(shared_free_list.mutex);
+      size_t shared_count = ReserveSharedBlocks(size_class, count);
+      shared_free_list.blocks.insert(shared_free_list.blocks.end(), blocks.end() - shared_count,
+                                     blocks.end());
+      blocks.resize(blocks.size() - shared_count);
+      count -= shared_count;
+    }
+    for (; count > 0; --count) {
+      ::operator delete(blocks.back());
+      blocks.pop_back();
+    }
+  }
+
+  std::array<std::vector<void*>, SIZE_CLASS_COUNT> blocks_;
+};
+
+ThreadCache& GetThreadCache() {
+  thread_local ThreadCache thread_cache;
+  return thread_cache;
+}
+
+}  // namespace
+
+void* AllocatePerfEventMemory(size_t size) {
+  if (size > MAX_POOLED_PERF_EVENT_MEMORY_SIZE) {
+    system_allocation_count.fetch_add(1, std::memory_order_relaxed);
+    return ::operator new(size);
+  }
+  return GetThreadCache().Allocate(GetSizeClass(size));
+}
+
+void FreePerfEventMemory(void* ptr, size_t size) {
+  if (ptr == nullptr) {
+    return;
+  }
+  if (size > MAX_POOLED_PERF_EVENT_MEMORY_SIZE) {
+    ::operator delete(ptr);
+    return;
+  }
+  GetThreadCache().Free(ptr, GetSizeClass(size));
+}
+
+void ReleaseSharedPerfEventMemory() {
+  for (size_t size_class = 0; size_class < SIZE_CLASS_COUNT; ++size_class) {
+    SharedFreeList& shared_free_list = GetSharedFreeLists()[size_class];
+    std::lock_guard<std::mutex> lock(shared_free_list.mutex);
+    for (void* block : shared_free_list.blocks) {
+      ::operator delete(block);
+    }
+    shared_free_list_size.fetch_sub(shared_free_list.blocks.size() * GetBlockSize(size_class),
+                                    std::memory_order_relaxed);
+    shared_free_list.blocks.clear();
+    shared_free_list.blocks.shrink_to_fit();
+  }
+}
+
+uint64_t GetPerfEventMemorySystemAllocationCount() {
+  return system_allocation_count.load(std::memory_order_relaxed);
+}
+
+size_t GetSharedPerfEventMemorySize() {
+  return shared_free_list_size.load(std::memory_order_relaxed);
+}
+
+}  // namespace LinuxTracing
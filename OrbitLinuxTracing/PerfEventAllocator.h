@@ -0,0 +1,66 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef ORBIT_LINUX_TRACING_PERF_EVENT_ALLOCATOR_H_
+#define ORBIT_LINUX_TRACING_PERF_EVENT_ALLOCATOR_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <type_traits>
+
+namespace LinuxTracing {
+
+// PerfEvents, and their variable-size payloads like stack copies, are created
+// for every sample and uprobe on the ring buffer reading threads and destroyed
+// after having been processed, usually on a different thread. To keep
+// malloc/free out of this path, their memory comes from free lists with one
+// size class per power of two up to MAX_POOLED_PERF_EVENT_MEMORY_SIZE. Each
+// thread keeps a small cache of blocks per size class and exchanges them in
+// batches with a shared free list. Larger sizes fall back to operator new.
+// The shared free lists of all size classes keep at most
+// MAX_SHARED_PERF_EVENT_MEMORY_SIZE bytes, blocks beyond that are returned to
+// the system when freed.
+[[nodiscard]] void* AllocatePerfEventMemory(size_t size);
+void FreePerfEventMemory(void* ptr, size_t size);
+
+// Returns the blocks in the shared free lists to the system, e.g., when a
+// capture ends. Blocks in the caches of running threads are kept.
+void ReleaseSharedPerfEventMemory();
+
+// Number of calls to operator new that AllocatePerfEventMemory has made, and
+// bytes in the shared free lists, for tests and benchmarks.
+[[nodiscard]] uint64_t GetPerfEventMemorySystemAllocationCount();
+[[nodiscard]] size_t GetSharedPerfEventMemorySize();
+
+constexpr size_t MAX_POOLED_PERF_EVENT_MEMORY_SIZE = 128 * 1024;
+constexpr size_t MAX_SHARED_PERF_EVENT_MEMORY_SIZE = 8 * 1024 * 1024;
+
+class PerfEventPayloadDeleter {
+ public:
+  PerfEventPayloadDeleter() = default;
+  explicit PerfEventPayloadDeleter(size_t size) : size_{size} {}
+
+  void operator()(void* ptr) const { FreePerfEventMemory(ptr, size_); }
+
+ private:
+  size_t size_ = 0;
+};
+
+// Array of trivial elements, allocated with AllocatePerfEventMemory and left
+// uninitialized, like with make_unique_for_overwrite.
+template <typename T>
+using PerfEventPayload = std::unique_ptr<T[], PerfEventPayloadDeleter>;
+
+template <typename T>
+[[nodiscard]] PerfEventPayload<T> MakePerfEventPayload(size_t count) {
+  static_assert(std::is_trivial_v<T>);
+  size_t size = count * sizeof(T);
+  return PerfEventPayload<T>{static_cast<T*>(AllocatePerfEventMemory(size)),
+                             PerfEventPayloadDeleter{size}};
+}
+
+}  // namespace LinuxTracing
+
+#endif  // ORBIT_LINUX_TRACING_PERF_EVENT_ALLOCATOR_H_
@@ -0,0 +1,109 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <gtest/gtest.h>
+
+#include <cstring>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "PerfEvent.h"
+#include "PerfEventAllocator.h"
+
+namespace LinuxTracing {
+
+TEST(PerfEventAllocator, ReusesFreedMemory) {
+  void* first = AllocatePerfEventMemory(100);
+  FreePerfEventMemory(first, 100);
+
+  uint64_t system_allocation_count = GetPerfEventMemorySystemAllocationCount();
+  for (size_t i = 0; i < 1000; ++i) {
+    // Sizes in the same size class share blocks.
+    void* ptr = AllocatePerfEventMemory(65 + i % 64);
+    memset(ptr, 0xff, 65 + i % 64);
+    FreePerfEventMemory(ptr, 65 + i % 64);
+  }
+  EXPECT_EQ(GetPerfEventMemorySystemAllocationCount(), system_allocation_count);
+}
+
+TEST(PerfEventAllocator, LargeSizesAreNotPooled) {
+  constexpr size_t kSize = MAX_POOLED_PERF_EVENT_MEMORY_SIZE + 1;
+  uint64_t system_allocation_count = GetPerfEventMemorySystemAllocationCount();
+  for (size_t i = 0; i < 10; ++i) {
+    void* ptr = AllocatePerfEventMemory(kSize);
+    memset(ptr, 0xff, kSize);
+    FreePerfEventMemory(ptr, kSize);
+  }
+  EXPECT_EQ(GetPerfEventMemorySystemAllocationCount(), system_allocation_count + 10);
+}
+
+TEST(PerfEventAllocator, PerfEventsAndPayloadsAreRecycled) {
+  constexpr size_t kEventCount = 100;
+  auto create_and_destroy_events = [] {
+    std::vector<std::unique_ptr<PerfEvent>> events;
+    for (size_t i = 0; i < kEventCount; ++i) {
+      events.push_back(make_unique_for_overwrite<UprobesPerfEvent>());
+      events.push_back(std::make_unique<StackSamplePerfEvent>(SAMPLE_STACK_USER_SIZE));
+      auto callchain_sample = std::make_unique<CallchainSamplePerfEvent>(64);
+      callchain_sample->GetCallchain()[63] = 42;
+      events.push_back(std::move(callchain_sample));
+    }
+  };
+
+  // Make sure enough blocks have been allocated.
+  create_and_destroy_events();
+  uint64_t system_allocation_count = GetPerfEventMemorySystemAllocationCount();
+  for (size_t i = 0; i < 10; ++i) {
+    create_and_destroy_events();
+  }
+  EXPECT_EQ(GetPerfEventMemorySystemAllocationCount(), system_allocation_count);
+}
+
+TEST(PerfEventAllocator, MemoryFreedOnOtherThreadIsReused) {
+  constexpr size_t kSize = 4096;
+  constexpr size_t kBlockCount = 256;
+  constexpr size_t kRoundCount = 100;
+
+  uint64_t system_allocation_count = GetPerfEventMemorySystemAllocationCount();
+  for (size_t round = 0; round < kRoundCount; ++round) {
+    std::vector<void*> blocks;
+    for (size_t i = 0; i < kBlockCount; ++i) {
+      blocks.push_back(AllocatePerfEventMemory(kSize));
+    }
+    std::thread([&blocks] {
+      for (void* block : blocks) {
+        FreePerfEventMemory(block, kSize);
+      }
+    }).join();
+  }
+  // Blocks in the freeing threads' caches are returned to the shared free list
+  // when the threads exit, hence only the first round allocates.
+  EXPECT_LE(GetPerfEventMemorySystemAllocationCount(), system_allocation_count + kBlockCount);
+}
+
+TEST(PerfEventAllocator, SharedMemoryIsBoundedAndReleased) {
+  constexpr size_t kSize = MAX_POOLED_PERF_EVENT_MEMORY_SIZE;
+  constexpr size_t kBlockCount = 2 * MAX_SHARED_PERF_EVENT_MEMORY_SIZE / kSize;
+
+  std::vector<void*> blocks;
+  for (size_t i = 0; i < kBlockCount; ++i) {
+    blocks.push_back(AllocatePerfEventMemory(kSize));
+  }
+  std::thread([&blocks] {
+    for (void* block : blocks) {
+      FreePerfEventMemory(block, kSize);
+    }
+  }).join();
+  EXPECT_GT(GetSharedPerfEventMemorySize(), 0);
+  EXPECT_LE(GetSharedPerfEventMemorySize(), MAX_SHARED_PERF_EVENT_MEMORY_SIZE);
+
+  ReleaseSharedPerfEventMemory();
+  EXPECT_EQ(GetSharedPerfEventMemorySize(), 0);
+  uint64_t system_allocation_count = GetPerfEventMemorySystemAllocationCount();
+  std::thread([] { FreePerfEventMemory(AllocatePerfEventMemory(kSize), kSize); }).join();
+  EXPECT_EQ(GetPerfEventMemorySystemAllocationCount(), system_allocation_count + 1);
+}
+
+}  // namespace LinuxTracing
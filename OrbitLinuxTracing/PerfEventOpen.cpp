@@ -16,7 +16,7 @@
 
 namespace LinuxTracing {
 namespace {
-perf_event_attr generic_event_attr() {
+perf_event_attr generic_event_attr(uint32_t wakeup_watermark_bytes) {
   perf_event_attr pe{};
   pe.size = sizeof(struct perf_event_attr);
   pe.sample_period = 1;
@@ -25,6 +25,10 @@ perf_event_attr generic_event_attr() {
   pe.sample_id_all = 1;  // Also include timestamps for lost events.
   pe.disabled = 1;
   pe.sample_type = SAMPLE_TYPE_TID_TIME_STREAMID_CPU;
+  if (wakeup_watermark_bytes > 0) {
+    pe.watermark = 1;
+    pe.wakeup_watermark = wakeup_watermark_bytes;
+  }
 
   return pe;
 }
@@ -37,8 +41,9 @@ int generic_event_open(perf_event_attr* attr, pid_t pid, int32_t cpu) {
   return fd;
 }
 
-perf_event_attr uprobe_event_attr(const char* module, uint64_t function_offset) {
-  perf_event_attr pe = generic_event_attr();
+perf_event_attr uprobe_event_attr(const char* module, uint64_t function_offset,
+                                  uint32_t wakeup_watermark_bytes) {
+  perf_event_attr pe = generic_event_attr(wakeup_watermark_bytes);
 
   pe.type = 7;                                    // TODO: should be read from
                                                   //  "/sys/bus/event_source/devices/uprobe/type"
@@ -49,8 +54,8 @@ perf_event_attr uprobe_event_attr(const char* module, uint64_t function_offset)
 }
 }  // namespace
 
-int context_switch_event_open(pid_t pid, int32_t cpu) {
-  perf_event_attr pe = generic_event_attr();
+int context_switch_event_open(pid_t pid, int32_t cpu, uint32_t wakeup_watermark_bytes) {
+  perf_event_attr pe = generic_event_attr(wakeup_watermark_bytes);
   pe.type = PERF_TYPE_SOFTWARE;
   pe.config = PERF_COUNT_SW_DUMMY;
   pe.context_switch = 1;
@@ -58,8 +63,8 @@ int context_switch_event_open(pid_t pid, int32_t cpu) {
   return generic_event_open(&pe, pid, cpu);
 }
 
-int mmap_task_event_open(pid_t pid, int32_t cpu) {
-  perf_event_attr pe = generic_event_attr();
+int mmap_task_event_open(pid_t pid, int32_t cpu, uint32_t wakeup_watermark_bytes) {
+  perf_event_attr pe = generic_event_attr(wakeup_watermark_bytes);
   pe.type = PERF_TYPE_SOFTWARE;
   pe.config = PERF_COUNT_SW_DUMMY;
   pe.mmap = 1;
@@ -68,20 +73,22 @@ int mmap_task_event_open(pid_t pid, int32_t cpu) {
   return generic_event_open(&pe, pid, cpu);
 }
 
-int stack_sample_event_open(uint64_t period_ns, pid_t pid, int32_t cpu) {
-  perf_event_attr pe = generic_event_attr();
+int stack_sample_event_open(uint64_t period_ns, pid_t pid, int32_t cpu, uint16_t stack_dump_size,
+                            uint32_t wakeup_watermark_bytes) {
+  perf_event_attr pe = generic_event_attr(wakeup_watermark_bytes);
   pe.type = PERF_TYPE_SOFTWARE;
   pe.config = PERF_COUNT_SW_CPU_CLOCK;
   pe.sample_period = period_ns;
   pe.sample_type |= PERF_SAMPLE_REGS_USER | PERF_SAMPLE_STACK_USER;
   pe.sample_regs_user = SAMPLE_REGS_USER_ALL;
-  pe.sample_stack_user = SAMPLE_STACK_USER_SIZE;
+  pe.sample_stack_user = stack_dump_size;
 
   return generic_event_open(&pe, pid, cpu);
 }
 
-int callchain_sample_event_open(uint64_t period_ns, pid_t pid, int32_t cpu) {
-  perf_event_attr pe = generic_event_attr();
+int callchain_sample_event_open(uint64_t period_ns, pid_t pid, int32_t cpu,
+                                uint32_t wakeup_watermark_bytes) {
+  perf_event_attr pe = generic_event_attr(wakeup_watermark_bytes);
   pe.type = PERF_TYPE_SOFTWARE;
   pe.config = PERF_COUNT_SW_CPU_CLOCK;
   pe.sample_period = period_ns;
@@ -94,8 +101,8 @@ int callchain_sample_event_open(uint64_t period_ns, pid_t pid, int32_t cpu) {
 }
 
 int uprobes_retaddr_event_open(const char* module, uint64_t function_offset, pid_t pid,
-                               int32_t cpu) {
-  perf_event_attr pe = uprobe_event_attr(module, function_offset);
+                               int32_t cpu, uint32_t wakeup_watermark_bytes) {
+  perf_event_attr pe = uprobe_event_attr(module, function_offset, wakeup_watermark_bytes);
   pe.config = 0;
   pe.sample_type |= PERF_SAMPLE_REGS_USER | PERF_SAMPLE_STACK_USER;
   pe.sample_regs_user = SAMPLE_REGS_USER_SP_IP_ARGUMENTS;
@@ -108,8 +115,9 @@ int uprobes_retaddr_event_open(const char* module, uint64_t function_offset, pid
   return generic_event_open(&pe, pid, cpu);
 }
 
-int uretprobes_event_open(const char* module, uint64_t function_offset, pid_t pid, int32_t cpu) {
-  perf_event_attr pe = uprobe_event_attr(module, function_offset);
+int uretprobes_event_open(const char* module, uint64_t function_offset, pid_t pid, int32_t cpu,
+                          uint32_t wakeup_watermark_bytes) {
+  perf_event_attr pe = uprobe_event_attr(module, function_offset, wakeup_watermark_bytes);
   pe.config = 1;  // Set bit 0 of config for uretprobe.
 
   pe.sample_type |= PERF_SAMPLE_REGS_USER;
@@ -137,12 +145,12 @@ void* perf_event_open_mmap_ring_buffer(int fd, uint64_t mmap_length) {
 }
 
 int tracepoint_event_open(const char* tracepoint_category, const char* tracepoint_name, pid_t pid,
-                          int32_t cpu) {
+                          int32_t cpu, uint32_t wakeup_watermark_bytes) {
   int tp_id = GetTracepointId(tracepoint_category, tracepoint_name);
   if (tp_id == -1) {
     return -1;
   }
-  perf_event_attr pe = generic_event_attr();
+  perf_event_attr pe = generic_event_attr(wakeup_watermark_bytes);
   pe.type = PERF_TYPE_TRACEPOINT;
   pe.config = tp_id;
   pe.sample_type |= PERF_SAMPLE_RAW;
@@ -15,6 +15,7 @@
 #include <sys/mman.h>
 #include <unistd.h>
 
+#include <algorithm>
 #include <cerrno>
 #include <cstdint>
 #include <cstring>
@@ -99,33 +100,52 @@ static constexpr uint64_t SAMPLE_REGS_USER_SP_IP_ARGUMENTS =
 // But the size the kernel actually returns is smaller, because the maximum size
 // of the entire record the kernel is willing to return is (1u << 16u) - 8.
 // If we want the size we pass to coincide with the size we get, we need to pass
-// a lower value. For the current layout of perf_event_stack_sample, the maximum
-// size is 65312, but let's leave some extra room.
-// TODO: As this amount of memory has to be copied from the ring buffer for each
-//  sample, this constant should be a parameters and should be made available in
-//  some setting.
+// a lower value. For the layout of perf_event_stack_sample_fixed followed by
+// the stack and by dyn_size, the maximum size is 65304. By default, let's leave
+// some extra room.
+static constexpr uint16_t MAX_SAMPLE_STACK_USER_SIZE = 65304;
 static constexpr uint16_t SAMPLE_STACK_USER_SIZE = 65000;
 
 static_assert(sizeof(void*) == 8);
 static constexpr uint16_t SAMPLE_STACK_USER_SIZE_8BYTES = 8;
 
+// Returns the size of the stack dumps of stack samples for the size requested
+// in the capture options. 0 selects SAMPLE_STACK_USER_SIZE. Other sizes are
+// rounded down to a multiple of 8, as the kernel requires, and clamped to
+// [8, MAX_SAMPLE_STACK_USER_SIZE].
+inline uint16_t ComputeStackDumpSize(uint32_t requested_size) {
+  if (requested_size == 0) return SAMPLE_STACK_USER_SIZE;
+  uint32_t stack_dump_size = std::min<uint32_t>(requested_size, MAX_SAMPLE_STACK_USER_SIZE) & ~7u;
+  return std::max<uint32_t>(stack_dump_size, 8);
+}
+
+// All the *_event_open functions below take a wakeup_watermark_bytes argument:
+// if it is not zero, the ring buffer that gets mmapped on the returned file
+// descriptor notifies poll/epoll waiters every time at least that many bytes
+// have been written to it since the last notification. With zero, the kernel's
+// default of notifying at half the size of the ring buffer is kept.
+
 // perf_event_open for context switches.
-int context_switch_event_open(pid_t pid, int32_t cpu);
+int context_switch_event_open(pid_t pid, int32_t cpu, uint32_t wakeup_watermark_bytes);
 
 // perf_event_open for task (fork and exit) and mmap records in the same buffer.
-int mmap_task_event_open(pid_t pid, int32_t cpu);
+int mmap_task_event_open(pid_t pid, int32_t cpu, uint32_t wakeup_watermark_bytes);
 
-// perf_event_open for stack sampling.
-int stack_sample_event_open(uint64_t period_ns, pid_t pid, int32_t cpu);
+// perf_event_open for stack sampling. stack_dump_size must be a multiple of 8
+// and at most MAX_SAMPLE_STACK_USER_SIZE.
+int stack_sample_event_open(uint64_t period_ns, pid_t pid, int32_t cpu, uint16_t stack_dump_size,
+                            uint32_t wakeup_watermark_bytes);
 
 // perf_event_open for stack sampling using frame pointers.
-int callchain_sample_event_open(uint64_t period_ns, pid_t pid, int32_t cpu);
+int callchain_sample_event_open(uint64_t period_ns, pid_t pid, int32_t cpu,
+                                uint32_t wakeup_watermark_bytes);
 
 // perf_event_open for uprobes and uretprobes.
 int uprobes_retaddr_event_open(const char* module, uint64_t function_offset, pid_t pid,
-                               int32_t cpu);
+                               int32_t cpu, uint32_t wakeup_watermark_bytes);
 
-int uretprobes_event_open(const char* module, uint64_t function_offset, pid_t pid, int32_t cpu);
+int uretprobes_event_open(const char* module, uint64_t function_offset, pid_t pid, int32_t cpu,
+                          uint32_t wakeup_watermark_bytes);
 
 // Create the ring buffer to use perf_event_open in sampled mode.
 void* perf_event_open_mmap_ring_buffer(int fd, uint64_t mmap_length);
@@ -135,7 +155,7 @@ void* perf_event_open_mmap_ring_buffer(int fd, uint64_t mmap_length);
 // (for example, "sched_waking"). Returns the file descriptor for the
 // perf event or -1 in case of any errors.
 int tracepoint_event_open(const char* tracepoint_category, const char* tracepoint_name, pid_t pid,
-                          int32_t cpu);
+                          int32_t cpu, uint32_t wakeup_watermark_bytes);
 
 }  // namespace LinuxTracing
 
@@ -0,0 +1,36 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <gtest/gtest.h>
+
+#include <cstdint>
+
+#include "PerfEventOpen.h"
+
+namespace LinuxTracing {
+
+TEST(ComputeStackDumpSize, ZeroSelectsTheDefaultSize) {
+  EXPECT_EQ(ComputeStackDumpSize(0), SAMPLE_STACK_USER_SIZE);
+}
+
+TEST(ComputeStackDumpSize, SizesBelowEightAreRoundedUpToEight) {
+  for (uint32_t requested_size = 1; requested_size < 8; ++requested_size) {
+    EXPECT_EQ(ComputeStackDumpSize(requested_size), 8);
+  }
+}
+
+TEST(ComputeStackDumpSize, SizesAreRoundedDownToAMultipleOfEight) {
+  EXPECT_EQ(ComputeStackDumpSize(8), 8);
+  EXPECT_EQ(ComputeStackDumpSize(15), 8);
+  EXPECT_EQ(ComputeStackDumpSize(16), 16);
+  EXPECT_EQ(ComputeStackDumpSize(1001), 1000);
+}
+
+TEST(ComputeStackDumpSize, SizesAreClampedToTheMaximumSize) {
+  EXPECT_EQ(ComputeStackDumpSize(MAX_SAMPLE_STACK_USER_SIZE), MAX_SAMPLE_STACK_USER_SIZE);
+  EXPECT_EQ(ComputeStackDumpSize(MAX_SAMPLE_STACK_USER_SIZE + 100), MAX_SAMPLE_STACK_USER_SIZE);
+  EXPECT_EQ(ComputeStackDumpSize(UINT32_MAX), MAX_SAMPLE_STACK_USER_SIZE);
+}
+
+}  // namespace LinuxTracing
@@ -6,6 +6,8 @@
 
 #include <OrbitBase/Logging.h>
 
+#include <algorithm>
+
 #include "PerfEventRecords.h"
 #include "PerfEventRingBuffer.h"
 
@@ -50,20 +52,37 @@ pid_t ReadSampleRecordPid(PerfEventRingBuffer* ring_buffer) {
   return pid;
 }
 
+pid_t ReadSampleRecordTid(PerfEventRingBuffer* ring_buffer) {
+  pid_t tid;
+  // All PERF_RECORD_SAMPLEs start with
+  //   perf_event_header header;
+  //   perf_event_sample_id_tid_time_streamid_cpu sample_id;
+  ring_buffer->ReadValueAtOffset(
+      &tid, sizeof(perf_event_header) + offsetof(perf_event_sample_id_tid_time_streamid_cpu, tid));
+  return tid;
+}
+
 std::unique_ptr<StackSamplePerfEvent> ConsumeStackSamplePerfEvent(PerfEventRingBuffer* ring_buffer,
-                                                                  const perf_event_header& header) {
-  // Data in the ring buffer has the layout of perf_event_stack_sample, but we
-  // copy it into dynamically_sized_perf_event_stack_sample.
+                                                                  const perf_event_header& header,
+                                                                  uint64_t max_copy_size) {
+  // Data in the ring buffer has the layout of perf_event_stack_sample_fixed,
+  // followed by the stack dump and by dyn_size, but we copy it into
+  // dynamically_sized_perf_event_stack_sample.
+  uint64_t size;
+  ring_buffer->ReadValueAtOffset(&size, offsetof(perf_event_stack_sample_fixed, size));
   uint64_t dyn_size;
-  ring_buffer->ReadValueAtOffset(&dyn_size, offsetof(perf_event_stack_sample, stack.dyn_size));
-  auto event = std::make_unique<StackSamplePerfEvent>(dyn_size);
-  event->ring_buffer_record->header = header;
-  ring_buffer->ReadValueAtOffset(&event->ring_buffer_record->sample_id,
-                                 offsetof(perf_event_stack_sample, sample_id));
-  ring_buffer->ReadValueAtOffset(&event->ring_buffer_record->regs,
-                                 offsetof(perf_event_stack_sample, regs));
-  ring_buffer->ReadRawAtOffset(event->ring_buffer_record->stack.data.get(),
-                               offsetof(perf_event_stack_sample, stack.data), dyn_size);
+  ring_buffer->ReadValueAtOffset(&dyn_size, sizeof(perf_event_stack_sample_fixed) + size);
+  uint64_t copy_size = std::min(dyn_size, max_copy_size);
+  auto event = std::make_unique<StackSamplePerfEvent>(dyn_size, copy_size);
+  event->ring_buffer_record.header = header;
+  ring_buffer->ReadValueAtOffset(&event->ring_buffer_record.sample_id,
+                                 offsetof(perf_event_stack_sample_fixed, sample_id));
+  ring_buffer->ReadValueAtOffset(&event->ring_buffer_record.regs,
+                                 offsetof(perf_event_stack_sample_fixed, regs));
+  if (copy_size > 0) {
+    ring_buffer->ReadRawAtOffset(event->ring_buffer_record.stack.data.get(),
+                                 sizeof(perf_event_stack_sample_fixed), copy_size);
+  }
   ring_buffer->SkipRecord(header);
   return event;
 }
@@ -79,7 +98,7 @@ std::unique_ptr<CallchainSamplePerfEvent> ConsumeCallchainSamplePerfEvent(
 
   // TODO(kuebler): we should have templated read methods
   uint64_t size_in_bytes = nr * sizeof(uint64_t) / sizeof(char);
-  ring_buffer->ReadRawAtOffset(event->ips.data(),
+  ring_buffer->ReadRawAtOffset(event->ips.get(),
                                offsetof(perf_event_callchain_sample_fixed, nr) +
                                    sizeof(perf_event_callchain_sample_fixed::nr),
                                size_in_bytes);
@@ -5,6 +5,8 @@
 #ifndef ORBIT_LINUX_TRACING_PERF_EVENT_READERS_H_
 #define ORBIT_LINUX_TRACING_PERF_EVENT_READERS_H_
 
+#include <limits>
+
 #include "PerfEvent.h"
 #include "PerfEventRingBuffer.h"
 
@@ -18,8 +20,12 @@ uint64_t ReadSampleRecordStreamId(PerfEventRingBuffer* ring_buffer);
 
 pid_t ReadSampleRecordPid(PerfEventRingBuffer* ring_buffer);
 
-std::unique_ptr<StackSamplePerfEvent> ConsumeStackSamplePerfEvent(PerfEventRingBuffer* ring_buffer,
-                                                                  const perf_event_header& header);
+pid_t ReadSampleRecordTid(PerfEventRingBuffer* ring_buffer);
+
+// Only copies the first max_copy_size bytes of the stack dump, if it is larger.
+std::unique_ptr<StackSamplePerfEvent> ConsumeStackSamplePerfEvent(
+    PerfEventRingBuffer* ring_buffer, const perf_event_header& header,
+    uint64_t max_copy_size = std::numeric_limits<uint64_t>::max());
 
 std::unique_ptr<CallchainSamplePerfEvent> ConsumeCallchainSamplePerfEvent(
     PerfEventRingBuffer* ring_buffer, const perf_event_header& header);
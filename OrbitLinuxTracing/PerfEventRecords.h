@@ -86,23 +86,20 @@ struct __attribute__((__packed__)) perf_event_sample_regs_user_sp_ip_arguments {
   uint64_t r9;
 };
 
-struct __attribute__((__packed__)) perf_event_sample_stack_user {
-  uint64_t size;                     /* if PERF_SAMPLE_STACK_USER */
-  char data[SAMPLE_STACK_USER_SIZE]; /* if PERF_SAMPLE_STACK_USER */
-  uint64_t dyn_size;                 /* if PERF_SAMPLE_STACK_USER && size != 0 */
-};
-
 struct __attribute__((__packed__)) perf_event_sample_stack_user_8bytes {
   uint64_t size;
   uint64_t top8bytes;
   uint64_t dyn_size;
 };
 
-struct __attribute__((__packed__)) perf_event_stack_sample {
+struct __attribute__((__packed__)) perf_event_stack_sample_fixed {
   perf_event_header header;
   perf_event_sample_id_tid_time_streamid_cpu sample_id;
   perf_event_sample_regs_user_all regs;
-  perf_event_sample_stack_user stack;
+  uint64_t size;
+  // The rest of the sample is a char[size] followed by a uint64_t dyn_size,
+  // that we read dynamically. As the size of the stack dump is configurable,
+  // the layout is not fixed.
 };
 
 struct __attribute__((__packed__)) perf_event_callchain_sample_fixed {
@@ -0,0 +1,246 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// Replays synthetic uprobes, uretprobes, stack samples and callchain samples
+// through a PerfEventRingBuffer and creates PerfEvents from them like
+// TracerThread::ProcessSampleEvent does. The PerfEvents are handed to a second
+// thread that destroys them, like PerfEventProcessor does once it has visited
+// them. Reports events per second and heap allocations per event. The ring
+// buffer is backed by a memfd instead of perf_event_open, so this doesn't need
+// to run as root.
+
+#include <OrbitBase/Logging.h>
+#include <OrbitBase/SafeStrerror.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <thread>
+#include <vector>
+
+#include "PerfEvent.h"
+#include "PerfEventReaders.h"
+#include "PerfEventRecords.h"
+#include "PerfEventRingBuffer.h"
+#include "SpscQueue.h"
+#include "Utils.h"
+#include "absl/flags/flag.h"
+#include "absl/flags/parse.h"
+
+ABSL_FLAG(uint64_t, events, 2'000'000, "Number of events to replay per event type");
+ABSL_FLAG(uint64_t, stack_size, 16 * 1024, "Bytes of stack copied with each stack sample");
+ABSL_FLAG(uint64_t, callchain_size, 32, "Number of frames in each callchain sample");
+
+namespace {
+
+std::atomic<uint64_t> heap_allocation_count = 0;
+
+}  // namespace
+
+void* operator new(size_t size) {
+  heap_allocation_count.fetch_add(1, std::memory_order_relaxed);
+  void* ptr = malloc(size == 0 ? 1 : size);
+  if (ptr == nullptr) {
+    throw std::bad_alloc{};
+  }
+  return ptr;
+}
+
+void operator delete(void* ptr) noexcept { free(ptr); }
+
+void operator delete(void* ptr, size_t /*size*/) noexcept { free(ptr); }
+
+namespace {
+
+using LinuxTracing::CallchainSamplePerfEvent;
+using LinuxTracing::PerfEvent;
+using LinuxTracing::PerfEventRingBuffer;
+using LinuxTracing::SpscQueue;
+using LinuxTracing::StackSamplePerfEvent;
+using LinuxTracing::UprobesPerfEvent;
+using LinuxTracing::UretprobesPerfEvent;
+
+constexpr uint64_t RING_BUFFER_SIZE_KB = 16 * 1024;
+
+enum class EventType { kUprobes, kStackSample, kCallchainSample };
+
+// Plays the role of the kernel: writes records to the ring buffer.
+class RingBufferWriter {
+ public:
+  explicit RingBufferWriter(int fd) {
+    mmap_length_ = LinuxTracing::GetPageSize() + RING_BUFFER_SIZE_KB * 1024;
+    FAIL_IF(ftruncate(fd, mmap_length_) != 0, "ftruncate: %s", SafeStrerror(errno));
+    void* address = mmap(nullptr, mmap_length_, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    FAIL_IF(address == MAP_FAILED, "mmap: %s", SafeStrerror(errno));
+    metadata_page_ = static_cast<perf_event_mmap_page*>(address);
+    metadata_page_->data_offset = LinuxTracing::GetPageSize();
+    metadata_page_->data_size = RING_BUFFER_SIZE_KB * 1024;
+    data_ = static_cast<char*>(address) + LinuxTracing::GetPageSize();
+  }
+
+  ~RingBufferWriter() { munmap(metadata_page_, mmap_length_); }
+
+  RingBufferWriter(const RingBufferWriter&) = delete;
+  RingBufferWriter& operator=(const RingBufferWriter&) = delete;
+
+  // Returns false if the record doesn't fit.
+  bool Write(const void* record, uint64_t size) {
+    uint64_t head = metadata_page_->data_head;
+    uint64_t tail = smp_load_acquire(&metadata_page_->data_tail);
+    uint64_t capacity = metadata_page_->data_size;
+    if (head + size - tail > capacity) {
+      return false;
+    }
+    uint64_t index = head % capacity;
+    uint64_t first_part = std::min(size, capacity - index);
+    memcpy(data_ + index, record, first_part);
+    memcpy(data_, static_cast<const char*>(record) + first_part, size - first_part);
+    smp_store_release(&metadata_page_->data_head, head + size);
+    return true;
+  }
+
+ private:
+  uint64_t mmap_length_;
+  perf_event_mmap_page* metadata_page_;
+  char* data_;
+};
+
+std::vector<char> MakeRecord(EventType type, uint64_t timestamp_ns, uint64_t stack_size,
+                             uint64_t callchain_size) {
+  std::vector<char> record;
+  auto fill_header = [timestamp_ns](auto* fixed_record) {
+    fixed_record->header.type = PERF_RECORD_SAMPLE;
+    fixed_record->header.size = sizeof(*fixed_record);
+    fixed_record->sample_id.pid = 1;
+    fixed_record->sample_id.tid = 1;
+    fixed_record->sample_id.time = timestamp_ns;
+  };
+  switch (type) {
+    case EventType::kUprobes: {
+      LinuxTracing::perf_event_sp_ip_arguments_8bytes_sample uprobe{};
+      fill_header(&uprobe);
+      record.resize(sizeof(uprobe));
+      memcpy(record.data(), &uprobe, sizeof(uprobe));
+    } break;
+    case EventType::kStackSample: {
+      LinuxTracing::perf_event_stack_sample_fixed stack_sample{};
+      fill_header(&stack_sample);
+      stack_sample.size = LinuxTracing::SAMPLE_STACK_USER_SIZE;
+      stack_sample.header.size =
+          sizeof(stack_sample) + LinuxTracing::SAMPLE_STACK_USER_SIZE + sizeof(uint64_t);
+      record.resize(stack_sample.header.size, 0);
+      memcpy(record.data(), &stack_sample, sizeof(stack_sample));
+      uint64_t dyn_size = stack_size;
+      memcpy(record.data() + record.size() - sizeof(dyn_size), &dyn_size, sizeof(dyn_size));
+    } break;
+    case EventType::kCallchainSample: {
+      LinuxTracing::perf_event_callchain_sample_fixed callchain_sample{};
+      fill_header(&callchain_sample);
+      callchain_sample.nr = callchain_size;
+      callchain_sample.header.size = sizeof(callchain_sample) + callchain_size * sizeof(uint64_t);
+      record.resize(callchain_sample.header.size, 0);
+      memcpy(record.data(), &callchain_sample, sizeof(callchain_sample));
+    } break;
+  }
+  return record;
+}
+
+std::unique_ptr<PerfEvent> ConsumeEvent(EventType type, PerfEventRingBuffer* ring_buffer,
+                                        const perf_event_header& header, uint64_t index) {
+  switch (type) {
+    case EventType::kUprobes:
+      // Alternate uprobes and uretprobes, as they come in pairs.
+      if (index % 2 == 0) {
+        auto event = make_unique_for_overwrite<UprobesPerfEvent>();
+        ring_buffer->ConsumeRecord(header, &event->ring_buffer_record);
+        return event;
+      } else {
+        auto event = make_unique_for_overwrite<UretprobesPerfEvent>();
+        // The record is the one of a uprobe, only read the beginning.
+        ring_buffer->ReadRawAtOffset(&event->ring_buffer_record, 0,
+                                     sizeof(event->ring_buffer_record));
+        ring_buffer->SkipRecord(header);
+        return event;
+      }
+    case EventType::kStackSample:
+      return LinuxTracing::ConsumeStackSamplePerfEvent(ring_buffer, header);
+    case EventType::kCallchainSample:
+      return LinuxTracing::ConsumeCallchainSamplePerfEvent(ring_buffer, header);
+  }
+  return nullptr;
+}
+
+void RunBenchmark(const char* name, EventType type, uint64_t event_count, uint64_t stack_size,
+                  uint64_t callchain_size) {
+  int fd = memfd_create("PerfEventReplayBenchmark", 0);
+  FAIL_IF(fd < 0, "memfd_create: %s", SafeStrerror(errno));
+  RingBufferWriter writer{fd};
+  PerfEventRingBuffer ring_buffer{fd, RING_BUFFER_SIZE_KB, name};
+  FAIL_IF(!ring_buffer.IsOpen(), "Could not open ring buffer");
+  std::vector<char> record = MakeRecord(type, 1, stack_size, callchain_size);
+
+  SpscQueue<std::unique_ptr<PerfEvent>> queue{64 * 1024};
+  std::atomic<bool> done = false;
+  std::thread destroyer([&queue, &done] {
+    std::unique_ptr<PerfEvent> event;
+    while (!done || !queue.IsEmpty()) {
+      if (!queue.TryPop(&event)) {
+        std::this_thread::yield();
+      }
+      event.reset();
+    }
+  });
+
+  uint64_t heap_allocation_count_begin = heap_allocation_count;
+  auto begin = std::chrono::steady_clock::now();
+  uint64_t written_count = 0;
+  uint64_t read_count = 0;
+  while (read_count < event_count) {
+    while (written_count < event_count && writer.Write(record.data(), record.size())) {
+      ++written_count;
+    }
+    while (ring_buffer.HasNewData()) {
+      perf_event_header header;
+      ring_buffer.ReadHeader(&header);
+      std::unique_ptr<PerfEvent> event = ConsumeEvent(type, &ring_buffer, header, read_count);
+      while (!queue.TryPush(std::move(event))) {
+        std::this_thread::yield();
+      }
+      ++read_count;
+    }
+  }
+  done = true;
+  destroyer.join();
+  double duration_s =
+      std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+  uint64_t heap_allocations = heap_allocation_count - heap_allocation_count_begin;
+
+  printf("%-18s %12.0f %14.3f\n", name, event_count / duration_s,
+         static_cast<double>(heap_allocations) / event_count);
+  close(fd);
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  absl::ParseCommandLine(argc, argv);
+  uint64_t event_count = absl::GetFlag(FLAGS_events);
+  uint64_t stack_size = absl::GetFlag(FLAGS_stack_size);
+  uint64_t callchain_size = absl::GetFlag(FLAGS_callchain_size);
+  FAIL_IF(stack_size > LinuxTracing::SAMPLE_STACK_USER_SIZE, "--stack_size can be at most %u",
+          LinuxTracing::SAMPLE_STACK_USER_SIZE);
+
+  printf("%-18s %12s %14s\n", "events", "events/s", "allocs/event");
+  RunBenchmark("uprobes", EventType::kUprobes, event_count, stack_size, callchain_size);
+  RunBenchmark("stack samples", EventType::kStackSample, event_count, stack_size, callchain_size);
+  RunBenchmark("callchain samples", EventType::kCallchainSample, event_count, stack_size,
+               callchain_size);
+  return 0;
+}
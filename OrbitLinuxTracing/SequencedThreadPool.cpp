@@ -0,0 +1,95 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "SequencedThreadPool.h"
+
+#include <OrbitBase/Logging.h>
+
+namespace LinuxTracing {
+
+SequencedThreadPool::SequencedThreadPool(size_t thread_count, size_t max_pending_jobs)
+    : max_pending_jobs_{max_pending_jobs}, run_jobs_(max_pending_jobs) {
+  CHECK(thread_count > 0);
+  CHECK(max_pending_jobs > 0);
+  workers_.reserve(thread_count);
+  for (size_t i = 0; i < thread_count; ++i) {
+    workers_.emplace_back(&SequencedThreadPool::RunWorker, this);
+  }
+}
+
+SequencedThreadPool::~SequencedThreadPool() {
+  WaitForAllJobs();
+  {
+    std::lock_guard<std::mutex> lock{mutex_};
+    stop_ = true;
+  }
+  jobs_to_run_condition_.notify_all();
+  for (std::thread& worker : workers_) {
+    worker.join();
+  }
+}
+
+void SequencedThreadPool::Submit(std::unique_ptr<SequencedJob> job) {
+  {
+    std::unique_lock<std::mutex> lock{mutex_};
+    jobs_completed_condition_.wait(lock, [this] {
+      return next_sequence_number_ - next_sequence_number_to_complete_ < max_pending_jobs_;
+    });
+    jobs_to_run_.emplace_back(next_sequence_number_, std::move(job));
+    ++next_sequence_number_;
+  }
+  jobs_to_run_condition_.notify_one();
+}
+
+void SequencedThreadPool::WaitForAllJobs() {
+  std::unique_lock<std::mutex> lock{mutex_};
+  jobs_completed_condition_.wait(
+      lock, [this] { return next_sequence_number_to_complete_ == next_sequence_number_; });
+}
+
+void SequencedThreadPool::RunWorker() {
+  std::unique_lock<std::mutex> lock{mutex_};
+  while (true) {
+    jobs_to_run_condition_.wait(lock, [this] { return stop_ || !jobs_to_run_.empty(); });
+    if (jobs_to_run_.empty()) {
+      return;
+    }
+    auto [sequence_number, job] = std::move(jobs_to_run_.front());
+    jobs_to_run_.pop_front();
+
+    lock.unlock();
+    job->Run();
+    lock.lock();
+
+    run_jobs_[sequence_number % max_pending_jobs_] = std::move(job);
+    CompleteRunJobs(&lock);
+  }
+}
+
+void SequencedThreadPool::CompleteRunJobs(std::unique_lock<std::mutex>* lock) {
+  if (completing_) {
+    // The thread that is completing jobs will also complete this one once its
+    // turn has come.
+    return;
+  }
+  completing_ = true;
+  while (next_sequence_number_to_complete_ < next_sequence_number_) {
+    std::unique_ptr<SequencedJob> job =
+        std::move(run_jobs_[next_sequence_number_to_complete_ % max_pending_jobs_]);
+    if (job == nullptr) {
+      break;
+    }
+
+    lock->unlock();
+    job->Complete();
+    job.reset();
+    lock->lock();
+
+    ++next_sequence_number_to_complete_;
+    jobs_completed_condition_.notify_all();
+  }
+  completing_ = false;
+}
+
+}  // namespace LinuxTracing
@@ -0,0 +1,70 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef ORBIT_LINUX_TRACING_SEQUENCED_THREAD_POOL_H_
+#define ORBIT_LINUX_TRACING_SEQUENCED_THREAD_POOL_H_
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace LinuxTracing {
+
+// A job for SequencedThreadPool: Run does the expensive work and can run in
+// parallel with other jobs, Complete publishes the result.
+class SequencedJob {
+ public:
+  virtual ~SequencedJob() = default;
+  virtual void Run() = 0;
+  virtual void Complete() = 0;
+};
+
+// Runs jobs on a fixed number of worker threads. The jobs are run in any
+// order, but are completed in the order in which they were submitted, and
+// never more than one at a time. Completions happen on the worker threads.
+class SequencedThreadPool {
+ public:
+  // Submit blocks while max_pending_jobs are submitted but not completed.
+  SequencedThreadPool(size_t thread_count, size_t max_pending_jobs);
+  // Waits for all submitted jobs to be completed.
+  ~SequencedThreadPool();
+
+  SequencedThreadPool(const SequencedThreadPool&) = delete;
+  SequencedThreadPool& operator=(const SequencedThreadPool&) = delete;
+  SequencedThreadPool(SequencedThreadPool&&) = delete;
+  SequencedThreadPool& operator=(SequencedThreadPool&&) = delete;
+
+  void Submit(std::unique_ptr<SequencedJob> job);
+  void WaitForAllJobs();
+
+ private:
+  void RunWorker();
+  // Completes the jobs that are next in order and have been run, unless
+  // another thread is already doing so. Called with mutex_ held.
+  void CompleteRunJobs(std::unique_lock<std::mutex>* lock);
+
+  const size_t max_pending_jobs_;
+  std::vector<std::thread> workers_;
+
+  std::mutex mutex_;
+  std::condition_variable jobs_to_run_condition_;
+  std::condition_variable jobs_completed_condition_;
+  bool stop_ = false;
+  // Jobs that have been submitted but not started, with their sequence number.
+  std::deque<std::pair<uint64_t, std::unique_ptr<SequencedJob>>> jobs_to_run_;
+  // Jobs that have been run but not completed, indexed by sequence number
+  // modulo max_pending_jobs_.
+  std::vector<std::unique_ptr<SequencedJob>> run_jobs_;
+  uint64_t next_sequence_number_ = 0;
+  uint64_t next_sequence_number_to_complete_ = 0;
+  bool completing_ = false;
+};
+
+}  // namespace LinuxTracing
+
+#endif  // ORBIT_LINUX_TRACING_SEQUENCED_THREAD_POOL_H_
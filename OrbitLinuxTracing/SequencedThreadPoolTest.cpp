@@ -0,0 +1,105 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include "SequencedThreadPool.h"
+
+namespace LinuxTracing {
+
+namespace {
+
+class RecordingJob : public SequencedJob {
+ public:
+  RecordingJob(int id, std::chrono::microseconds run_duration, std::vector<int>* completed_ids,
+               std::atomic<int>* running_count, std::atomic<int>* max_running_count)
+      : id_{id},
+        run_duration_{run_duration},
+        completed_ids_{completed_ids},
+        running_count_{running_count},
+        max_running_count_{max_running_count} {}
+
+  void Run() override {
+    int running_count = ++(*running_count_);
+    int max_running_count = *max_running_count_;
+    while (running_count > max_running_count &&
+           !max_running_count_->compare_exchange_weak(max_running_count, running_count)) {
+    }
+    std::this_thread::sleep_for(run_duration_);
+    --(*running_count_);
+  }
+
+  // Completions never run concurrently, so completed_ids_ needs no lock.
+  void Complete() override { completed_ids_->push_back(id_); }
+
+ private:
+  int id_;
+  std::chrono::microseconds run_duration_;
+  std::vector<int>* completed_ids_;
+  std::atomic<int>* running_count_;
+  std::atomic<int>* max_running_count_;
+};
+
+}  // namespace
+
+TEST(SequencedThreadPool, CompletesJobsInSubmissionOrder) {
+  std::vector<int> completed_ids;
+  std::atomic<int> running_count = 0;
+  std::atomic<int> max_running_count = 0;
+  constexpr int kJobCount = 200;
+  {
+    SequencedThreadPool pool{4, 16};
+    for (int i = 0; i < kJobCount; ++i) {
+      // Make earlier jobs take longer, so that they finish running out of order.
+      auto run_duration = std::chrono::microseconds{(i % 5 == 0) ? 2000 : 10};
+      pool.Submit(std::make_unique<RecordingJob>(i, run_duration, &completed_ids, &running_count,
+                                                 &max_running_count));
+    }
+    pool.WaitForAllJobs();
+    EXPECT_EQ(completed_ids.size(), kJobCount);
+  }
+
+  ASSERT_EQ(completed_ids.size(), kJobCount);
+  for (int i = 0; i < kJobCount; ++i) {
+    EXPECT_EQ(completed_ids[i], i);
+  }
+  EXPECT_GT(max_running_count, 1);
+  EXPECT_LE(max_running_count, 4);
+}
+
+TEST(SequencedThreadPool, DestructorCompletesAllJobs) {
+  std::vector<int> completed_ids;
+  std::atomic<int> running_count = 0;
+  std::atomic<int> max_running_count = 0;
+  {
+    SequencedThreadPool pool{2, 4};
+    for (int i = 0; i < 10; ++i) {
+      pool.Submit(std::make_unique<RecordingJob>(i, std::chrono::microseconds{100}, &completed_ids,
+                                                 &running_count, &max_running_count));
+    }
+  }
+  EXPECT_EQ(completed_ids, std::vector<int>({0, 1, 2, 3, 4, 5, 6, 7, 8, 9}));
+}
+
+TEST(SequencedThreadPool, SingleThread) {
+  std::vector<int> completed_ids;
+  std::atomic<int> running_count = 0;
+  std::atomic<int> max_running_count = 0;
+  {
+    SequencedThreadPool pool{1, 1};
+    for (int i = 0; i < 10; ++i) {
+      pool.Submit(std::make_unique<RecordingJob>(i, std::chrono::microseconds{0}, &completed_ids,
+                                                 &running_count, &max_running_count));
+    }
+  }
+  EXPECT_EQ(completed_ids, std::vector<int>({0, 1, 2, 3, 4, 5, 6, 7, 8, 9}));
+  EXPECT_EQ(max_running_count, 1);
+}
+
+}  // namespace LinuxTracing
@@ -0,0 +1,147 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef ORBIT_LINUX_TRACING_SPSC_QUEUE_H_
+#define ORBIT_LINUX_TRACING_SPSC_QUEUE_H_
+
+#include <OrbitBase/Logging.h>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <cstdint>
+#include <ctime>
+#include <memory>
+
+namespace LinuxTracing {
+
+// Bounded, lock-free, single-producer/single-consumer queue. TryPush must only
+// be called by the one producer thread, TryPop and IsEmpty only by the one
+// consumer thread. The capacity is rounded up to a power of two.
+// The head (consumer side) and the tail (producer side) are on different cache
+// lines, and each side caches the last value it has read of the other side's
+// index, so that in the common case pushing and popping don't touch the cache
+// line written by the other thread.
+template <typename T>
+class SpscQueue {
+ public:
+  explicit SpscQueue(size_t capacity)
+      : capacity_{RoundUpToPowerOfTwo(capacity)},
+        slots_{std::make_unique<T[]>(capacity_)} {}
+
+  SpscQueue(const SpscQueue&) = delete;
+  SpscQueue& operator=(const SpscQueue&) = delete;
+  SpscQueue(SpscQueue&&) = delete;
+  SpscQueue& operator=(SpscQueue&&) = delete;
+
+  // Returns false, without moving from value, if the queue is full.
+  [[nodiscard]] bool TryPush(T&& value) {
+    uint64_t tail = tail_.load(std::memory_order_relaxed);
+    if (tail - producer_cached_head_ == capacity_) {
+      producer_cached_head_ = head_.load(std::memory_order_acquire);
+      if (tail - producer_cached_head_ == capacity_) {
+        return false;
+      }
+    }
+    slots_[tail & (capacity_ - 1)] = std::move(value);
+    tail_.store(tail + 1, std::memory_order_release);
+    return true;
+  }
+
+  // Returns false if the queue is empty.
+  [[nodiscard]] bool TryPop(T* value) {
+    uint64_t head = head_.load(std::memory_order_relaxed);
+    if (head == consumer_cached_tail_) {
+      consumer_cached_tail_ = tail_.load(std::memory_order_acquire);
+      if (head == consumer_cached_tail_) {
+        return false;
+      }
+    }
+    *value = std::move(slots_[head & (capacity_ - 1)]);
+    head_.store(head + 1, std::memory_order_release);
+    return true;
+  }
+
+  [[nodiscard]] bool IsEmpty() const {
+    return head_.load(std::memory_order_relaxed) == tail_.load(std::memory_order_acquire);
+  }
+
+  [[nodiscard]] size_t GetCapacity() const { return capacity_; }
+
+ private:
+  static size_t RoundUpToPowerOfTwo(size_t value) {
+    CHECK(value > 0);
+    size_t power_of_two = 1;
+    while (power_of_two < value) {
+      power_of_two <<= 1u;
+    }
+    return power_of_two;
+  }
+
+  static constexpr size_t CACHE_LINE_SIZE = 64;
+
+  const size_t capacity_;
+  const std::unique_ptr<T[]> slots_;
+
+  alignas(CACHE_LINE_SIZE) std::atomic<uint64_t> head_ = 0;
+  uint64_t consumer_cached_tail_ = 0;
+
+  alignas(CACHE_LINE_SIZE) std::atomic<uint64_t> tail_ = 0;
+  uint64_t producer_cached_head_ = 0;
+};
+
+// Lets a consumer thread sleep on a futex until a producer notifies it, while
+// keeping Notify cheap (a fence and a load) when the consumer is not sleeping.
+// The consumer must follow this protocol to avoid missing notifications:
+//   uint32_t token = notifier.PrepareWait();
+//   if (<there is something to consume>) {
+//     notifier.CancelWait();
+//   } else {
+//     notifier.Wait(token, timeout_ms);
+//   }
+// The producer calls Notify after having published what there is to consume.
+class FutexNotifier {
+ public:
+  [[nodiscard]] uint32_t PrepareWait() {
+    waiting_.store(true, std::memory_order_relaxed);
+    // Pairs with the fence in Notify: either the producer sees waiting_ or the
+    // consumer sees what the producer has published before calling Notify.
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    return epoch_.load(std::memory_order_relaxed);
+  }
+
+  void CancelWait() { waiting_.store(false, std::memory_order_relaxed); }
+
+  // Returns when Notify has been called after PrepareWait, or after timeout_ms,
+  // or spuriously.
+  void Wait(uint32_t token, uint32_t timeout_ms) {
+    timespec timeout{};
+    timeout.tv_sec = timeout_ms / 1000;
+    timeout.tv_nsec = (timeout_ms % 1000) * 1'000'000l;
+    // If epoch_ has already changed, this returns immediately with EAGAIN.
+    syscall(SYS_futex, reinterpret_cast<uint32_t*>(&epoch_), FUTEX_WAIT_PRIVATE, token, &timeout,
+            nullptr, 0);
+    waiting_.store(false, std::memory_order_relaxed);
+  }
+
+  void Notify() {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (!waiting_.load(std::memory_order_relaxed)) {
+      return;
+    }
+    epoch_.fetch_add(1, std::memory_order_relaxed);
+    syscall(SYS_futex, reinterpret_cast<uint32_t*>(&epoch_), FUTEX_WAKE_PRIVATE, 1, nullptr,
+            nullptr, 0);
+  }
+
+ private:
+  static_assert(sizeof(std::atomic<uint32_t>) == sizeof(uint32_t));
+  std::atomic<uint32_t> epoch_ = 0;
+  std::atomic<bool> waiting_ = false;
+};
+
+}  // namespace LinuxTracing
+
+#endif  // ORBIT_LINUX_TRACING_SPSC_QUEUE_H_
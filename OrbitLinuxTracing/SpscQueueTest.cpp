@@ -0,0 +1,130 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <memory>
+#include <thread>
+
+#include "SpscQueue.h"
+
+namespace LinuxTracing {
+
+TEST(SpscQueue, CapacityIsRoundedUpToPowerOfTwo) {
+  EXPECT_EQ(SpscQueue<int>(1).GetCapacity(), 1);
+  EXPECT_EQ(SpscQueue<int>(4).GetCapacity(), 4);
+  EXPECT_EQ(SpscQueue<int>(5).GetCapacity(), 8);
+}
+
+TEST(SpscQueue, PushPopInOrder) {
+  SpscQueue<int> queue(4);
+  int value = 0;
+
+  EXPECT_TRUE(queue.IsEmpty());
+  EXPECT_FALSE(queue.TryPop(&value));
+
+  EXPECT_TRUE(queue.TryPush(1));
+  EXPECT_TRUE(queue.TryPush(2));
+  EXPECT_FALSE(queue.IsEmpty());
+
+  ASSERT_TRUE(queue.TryPop(&value));
+  EXPECT_EQ(value, 1);
+  ASSERT_TRUE(queue.TryPop(&value));
+  EXPECT_EQ(value, 2);
+
+  EXPECT_TRUE(queue.IsEmpty());
+  EXPECT_FALSE(queue.TryPop(&value));
+}
+
+TEST(SpscQueue, FullQueueDoesNotMoveFromValue) {
+  SpscQueue<std::unique_ptr<int>> queue(2);
+  EXPECT_TRUE(queue.TryPush(std::make_unique<int>(1)));
+  EXPECT_TRUE(queue.TryPush(std::make_unique<int>(2)));
+
+  auto rejected = std::make_unique<int>(3);
+  EXPECT_FALSE(queue.TryPush(std::move(rejected)));
+  ASSERT_NE(rejected, nullptr);
+  EXPECT_EQ(*rejected, 3);
+
+  std::unique_ptr<int> value;
+  ASSERT_TRUE(queue.TryPop(&value));
+  EXPECT_EQ(*value, 1);
+  EXPECT_TRUE(queue.TryPush(std::move(rejected)));
+  ASSERT_TRUE(queue.TryPop(&value));
+  EXPECT_EQ(*value, 2);
+  ASSERT_TRUE(queue.TryPop(&value));
+  EXPECT_EQ(*value, 3);
+}
+
+TEST(SpscQueue, WrapsAround) {
+  SpscQueue<int> queue(4);
+  for (int i = 0; i < 100; ++i) {
+    EXPECT_TRUE(queue.TryPush(2 * i));
+    EXPECT_TRUE(queue.TryPush(2 * i + 1));
+    int value = -1;
+    ASSERT_TRUE(queue.TryPop(&value));
+    EXPECT_EQ(value, 2 * i);
+    ASSERT_TRUE(queue.TryPop(&value));
+    EXPECT_EQ(value, 2 * i + 1);
+  }
+}
+
+TEST(SpscQueue, ConcurrentProducerAndConsumer) {
+  constexpr uint64_t kValueCount = 1'000'000;
+  SpscQueue<uint64_t> queue(64);
+
+  std::thread producer([&queue] {
+    for (uint64_t i = 0; i < kValueCount; ++i) {
+      uint64_t value = i;
+      while (!queue.TryPush(std::move(value))) {
+        std::this_thread::yield();
+      }
+    }
+  });
+
+  uint64_t expected = 0;
+  while (expected < kValueCount) {
+    uint64_t value;
+    if (!queue.TryPop(&value)) {
+      std::this_thread::yield();
+      continue;
+    }
+    ASSERT_EQ(value, expected);
+    ++expected;
+  }
+  producer.join();
+  EXPECT_TRUE(queue.IsEmpty());
+}
+
+TEST(FutexNotifier, NotifyWakesUpWaitingThread) {
+  // A timeout long enough to make the test time out rather than pass by
+  // chance if the notification is missed.
+  constexpr uint32_t kTimeoutMs = 60'000;
+  FutexNotifier notifier;
+  std::atomic<bool> ready = false;
+
+  std::thread consumer([&notifier, &ready] {
+    while (true) {
+      uint32_t token = notifier.PrepareWait();
+      if (ready) {
+        notifier.CancelWait();
+        return;
+      }
+      notifier.Wait(token, kTimeoutMs);
+    }
+  });
+
+  ready = true;
+  notifier.Notify();
+  consumer.join();
+}
+
+TEST(FutexNotifier, WaitTimesOut) {
+  FutexNotifier notifier;
+  uint32_t token = notifier.PrepareWait();
+  notifier.Wait(token, 1);
+}
+
+}  // namespace LinuxTracing
@@ -0,0 +1,57 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "StackCopySizeEstimator.h"
+
+#include <algorithm>
+#include <limits>
+
+namespace LinuxTracing {
+
+uint64_t StackCopySizeEstimator::MakeEntry(pid_t tid, uint64_t estimate) {
+  estimate = std::min<uint64_t>(estimate, std::numeric_limits<uint32_t>::max());
+  return (static_cast<uint64_t>(static_cast<uint32_t>(tid)) << 32u) | estimate;
+}
+
+uint64_t StackCopySizeEstimator::GetEstimate(uint64_t entry, pid_t tid) {
+  if ((entry >> 32u) != static_cast<uint32_t>(tid)) {
+    return 0;
+  }
+  return entry & std::numeric_limits<uint32_t>::max();
+}
+
+uint64_t StackCopySizeEstimator::GetCopySize(pid_t tid, uint64_t dyn_size) const {
+  uint64_t estimate = GetEstimate(entries_[GetIndex(tid)].load(std::memory_order_relaxed), tid);
+  if (estimate == 0) {
+    return dyn_size;
+  }
+  uint64_t copy_size = estimate + estimate / MARGIN_FRACTION + MARGIN_BYTES;
+  // Keep the copy 8-byte aligned like the stack dump.
+  copy_size = (copy_size + 7) & ~7ul;
+  return std::min(dyn_size, copy_size);
+}
+
+void StackCopySizeEstimator::OnUnwindSucceeded(pid_t tid, uint64_t used_size,
+                                               bool whole_stack_copied) {
+  std::atomic<uint64_t>& entry = entries_[GetIndex(tid)];
+  uint64_t previous_entry = entry.load(std::memory_order_relaxed);
+  uint64_t new_entry;
+  do {
+    // The stack dump of this sample was copied with an estimate that has since
+    // turned out to be too small: keep copying whole stack dumps.
+    if (previous_entry == MakeEntry(tid, 0) && !whole_stack_copied) {
+      return;
+    }
+    uint64_t previous_estimate = GetEstimate(previous_entry, tid);
+    uint64_t estimate =
+        std::max(used_size, previous_estimate - previous_estimate / ESTIMATE_DECAY_FRACTION);
+    new_entry = MakeEntry(tid, estimate);
+  } while (!entry.compare_exchange_weak(previous_entry, new_entry, std::memory_order_relaxed));
+}
+
+void StackCopySizeEstimator::OnUnwindNeededMoreStack(pid_t tid) {
+  entries_[GetIndex(tid)].store(MakeEntry(tid, 0), std::memory_order_relaxed);
+}
+
+}  // namespace LinuxTracing
@@ -0,0 +1,60 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef ORBIT_LINUX_TRACING_STACK_COPY_SIZE_ESTIMATOR_H_
+#define ORBIT_LINUX_TRACING_STACK_COPY_SIZE_ESTIMATOR_H_
+
+#include <sys/types.h>
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+namespace LinuxTracing {
+
+// Learns, for each thread, how many bytes of the stack dump of a sample
+// unwinding has recently needed, so that the ring buffer readers only copy that
+// many bytes (plus a margin) of the stack dumps of the thread's next samples.
+// GetCopySize is called by the ring buffer readers, the other methods by the
+// threads that unwind, concurrently and not necessarily in the order of the
+// samples. The estimates are kept in a fixed-size table of atomics indexed by
+// tid: threads whose tids collide evict each other's estimate, and the samples
+// of a thread without an estimate are copied whole.
+class StackCopySizeEstimator {
+ public:
+  [[nodiscard]] uint64_t GetCopySize(pid_t tid, uint64_t dyn_size) const;
+
+  // Unwinding a sample of the thread succeeded and only read the first
+  // used_size bytes of the stack dump. If only part of the stack dump had been
+  // copied, this doesn't undo a concurrent or later OnUnwindNeededMoreStack.
+  void OnUnwindSucceeded(pid_t tid, uint64_t used_size, bool whole_stack_copied);
+
+  // Unwinding a sample of the thread failed because it needed more of the stack
+  // dump than had been copied. The next samples are copied whole until
+  // unwinding one of them succeeds.
+  void OnUnwindNeededMoreStack(pid_t tid);
+
+ private:
+  static constexpr size_t TABLE_SIZE = 4096;
+  // The estimate follows the needed size immediately when it grows, and decays
+  // by 1/ESTIMATE_DECAY_FRACTION with every sample when it shrinks.
+  static constexpr uint64_t ESTIMATE_DECAY_FRACTION = 16;
+  // The margin added to the estimate is 1/MARGIN_FRACTION of it plus
+  // MARGIN_BYTES.
+  static constexpr uint64_t MARGIN_FRACTION = 4;
+  static constexpr uint64_t MARGIN_BYTES = 1024;
+
+  static size_t GetIndex(pid_t tid) { return static_cast<uint32_t>(tid) % TABLE_SIZE; }
+  // Each entry holds the tid in the upper 32 bits and the estimate in the lower
+  // 32 bits, so that the two are always read and written together.
+  static uint64_t MakeEntry(pid_t tid, uint64_t estimate);
+  // Returns 0 if the entry is not for this tid.
+  static uint64_t GetEstimate(uint64_t entry, pid_t tid);
+
+  std::array<std::atomic<uint64_t>, TABLE_SIZE> entries_{};
+};
+
+}  // namespace LinuxTracing
+
+#endif  // ORBIT_LINUX_TRACING_STACK_COPY_SIZE_ESTIMATOR_H_
@@ -0,0 +1,94 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <gtest/gtest.h>
+
+#include "StackCopySizeEstimator.h"
+
+namespace LinuxTracing {
+
+TEST(StackCopySizeEstimator, CopiesWholeDumpOfUnknownThread) {
+  StackCopySizeEstimator estimator;
+  EXPECT_EQ(estimator.GetCopySize(42, 65000), 65000);
+}
+
+TEST(StackCopySizeEstimator, CopiesUsedSizePlusMargin) {
+  StackCopySizeEstimator estimator;
+  estimator.OnUnwindSucceeded(42, 4001, true);
+  uint64_t copy_size = estimator.GetCopySize(42, 65000);
+  EXPECT_GT(copy_size, 4001);
+  EXPECT_LT(copy_size, 8000);
+  EXPECT_EQ(copy_size % 8, 0);
+
+  // Never more than what has been dumped.
+  EXPECT_EQ(estimator.GetCopySize(42, 3000), 3000);
+
+  // Other threads are not affected.
+  EXPECT_EQ(estimator.GetCopySize(43, 65000), 65000);
+}
+
+TEST(StackCopySizeEstimator, GrowsImmediatelyAndShrinksSlowly) {
+  StackCopySizeEstimator estimator;
+  estimator.OnUnwindSucceeded(42, 4000, true);
+  uint64_t small_copy_size = estimator.GetCopySize(42, 65000);
+
+  estimator.OnUnwindSucceeded(42, 20000, true);
+  uint64_t large_copy_size = estimator.GetCopySize(42, 65000);
+  EXPECT_GT(large_copy_size, 20000);
+
+  estimator.OnUnwindSucceeded(42, 4000, true);
+  uint64_t copy_size = estimator.GetCopySize(42, 65000);
+  EXPECT_LT(copy_size, large_copy_size);
+  EXPECT_GT(copy_size, 20000);
+
+  for (int i = 0; i < 1000; ++i) {
+    estimator.OnUnwindSucceeded(42, 4000, true);
+  }
+  EXPECT_EQ(estimator.GetCopySize(42, 65000), small_copy_size);
+}
+
+TEST(StackCopySizeEstimator, CopiesWholeDumpAfterUnwindNeededMoreStack) {
+  StackCopySizeEstimator estimator;
+  estimator.OnUnwindSucceeded(42, 4000, true);
+  estimator.OnUnwindNeededMoreStack(42);
+  EXPECT_EQ(estimator.GetCopySize(42, 65000), 65000);
+
+  estimator.OnUnwindSucceeded(42, 10000, true);
+  uint64_t copy_size = estimator.GetCopySize(42, 65000);
+  EXPECT_GT(copy_size, 10000);
+  EXPECT_LT(copy_size, 65000);
+}
+
+TEST(StackCopySizeEstimator, PartialCopySuccessDoesNotUndoUnwindNeededMoreStack) {
+  StackCopySizeEstimator estimator;
+  estimator.OnUnwindSucceeded(42, 4000, true);
+  // A sample copied with the old estimate finishes unwinding after the failure.
+  estimator.OnUnwindNeededMoreStack(42);
+  estimator.OnUnwindSucceeded(42, 4000, false);
+  EXPECT_EQ(estimator.GetCopySize(42, 65000), 65000);
+
+  estimator.OnUnwindSucceeded(42, 10000, true);
+  uint64_t copy_size = estimator.GetCopySize(42, 65000);
+  EXPECT_GT(copy_size, 10000);
+  EXPECT_LT(copy_size, 65000);
+
+  // Without a pending failure, partial copies keep updating the estimate.
+  for (int i = 0; i < 1000; ++i) {
+    estimator.OnUnwindSucceeded(42, 4000, false);
+  }
+  EXPECT_LT(estimator.GetCopySize(42, 65000), 10000);
+}
+
+TEST(StackCopySizeEstimator, CollidingThreadsEvictEachOther) {
+  StackCopySizeEstimator estimator;
+  constexpr pid_t kTid = 42;
+  // The table has 4096 entries.
+  constexpr pid_t kCollidingTid = kTid + 4096;
+  estimator.OnUnwindSucceeded(kTid, 4000, true);
+  estimator.OnUnwindSucceeded(kCollidingTid, 8000, true);
+  EXPECT_EQ(estimator.GetCopySize(kTid, 65000), 65000);
+  EXPECT_LT(estimator.GetCopySize(kCollidingTid, 65000), 65000);
+}
+
+}  // namespace LinuxTracing
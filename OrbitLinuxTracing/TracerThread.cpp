@@ -5,10 +5,17 @@
 #include "TracerThread.h"
 
 #include <OrbitBase/Logging.h>
+#include <OrbitBase/SafeStrerror.h>
 #include <OrbitBase/Tracing.h>
+#include <sys/epoll.h>
 
+#include <algorithm>
+#include <array>
+#include <iterator>
+#include <limits>
 #include <thread>
 
+#include "PerfEventAllocator.h"
 #include "UprobesUnwindingVisitor.h"
 #include "absl/strings/str_format.h"
 
@@ -23,7 +30,11 @@ TracerThread::TracerThread(const CaptureOptions& capture_options)
     : trace_context_switches_{capture_options.trace_context_switches()},
       pid_{capture_options.pid()},
       unwinding_method_{capture_options.unwinding_method()},
-      trace_gpu_driver_{capture_options.trace_gpu_driver()} {
+      trace_gpu_driver_{capture_options.trace_gpu_driver()},
+      ring_buffer_reading_mode_{capture_options.ring_buffer_reading_mode()},
+      ring_buffer_reader_count_{std::max<uint32_t>(
+          1, capture_options.ring_buffer_reader_thread_count())},
+      unwinding_thread_count_{capture_options.unwinding_thread_count()} {
   if (unwinding_method_ != CaptureOptions::kUndefined) {
     std::optional<uint64_t> sampling_period_ns =
         ComputeSamplingPeriodNs(capture_options.sampling_rate());
@@ -34,6 +45,11 @@ TracerThread::TracerThread(const CaptureOptions& capture_options)
     sampling_period_ns_ = 0;
   }
 
+  stack_dump_size_ = ComputeStackDumpSize(capture_options.stack_dump_size());
+  if (capture_options.adaptive_stack_copy() && unwinding_method_ == CaptureOptions::kDwarf) {
+    stack_copy_size_estimator_ = std::make_unique<StackCopySizeEstimator>();
+  }
+
   instrumented_functions_.clear();
   instrumented_functions_.reserve(capture_options.instrumented_functions_size());
 
@@ -79,11 +95,13 @@ bool TracerThread::OpenContextSwitches(const std::vector<int32_t>& cpus) {
   std::vector<int> context_switch_tracing_fds;
   std::vector<PerfEventRingBuffer> context_switch_ring_buffers;
   for (int32_t cpu : cpus) {
-    int context_switch_fd = context_switch_event_open(-1, cpu);
+    int context_switch_fd = context_switch_event_open(
+        -1, cpu, ComputeWakeupWatermarkBytes(CONTEXT_SWITCHES_RING_BUFFER_SIZE_KB));
     std::string buffer_name = absl::StrFormat("context_switch_%d", cpu);
     PerfEventRingBuffer context_switch_ring_buffer{
         context_switch_fd, CONTEXT_SWITCHES_RING_BUFFER_SIZE_KB, buffer_name};
     if (context_switch_ring_buffer.IsOpen()) {
+      ring_buffer_fds_to_cpu_[context_switch_fd] = cpu;
       context_switch_tracing_fds.push_back(context_switch_fd);
       context_switch_ring_buffers.push_back(std::move(context_switch_ring_buffer));
     } else {
@@ -103,10 +121,20 @@ bool TracerThread::OpenContextSwitches(const std::vector<int32_t>& cpus) {
 }
 
 void TracerThread::InitUprobesEventProcessor() {
+  // Keep the ELF files parsed for unwinding across the refreshes of the maps
+  // that follow every executable mmap. Disabled again at the end of Run.
+  LibunwindstackUnwinder::SetElfCachingEnabled(true);
   auto uprobes_unwinding_visitor = std::make_unique<UprobesUnwindingVisitor>(ReadMaps(pid_));
   uprobes_unwinding_visitor->SetListener(listener_);
   uprobes_unwinding_visitor->SetUnwindErrorsAndDiscardedSamplesCounters(
       stats_.unwind_error_count, stats_.discarded_samples_in_uretprobes_count);
+  if (stack_copy_size_estimator_ != nullptr) {
+    uprobes_unwinding_visitor->SetStackCopySizeEstimator(
+        stack_copy_size_estimator_.get(), stats_.unwind_errors_on_partial_stack_copy_count);
+  }
+  if (unwinding_method_ == CaptureOptions::kDwarf) {
+    uprobes_unwinding_visitor->SetUnwindingThreadCount(unwinding_thread_count_);
+  }
   uprobes_event_processor_ =
       std::make_unique<PerfEventProcessor>(std::move(uprobes_unwinding_visitor));
 }
@@ -117,7 +145,8 @@ bool TracerThread::OpenUprobes(const LinuxTracing::Function& function,
   const char* module = function.BinaryPath().c_str();
   const uint64_t offset = function.FileOffset();
   for (int32_t cpu : cpus) {
-    int fd = uprobes_retaddr_event_open(module, offset, -1, cpu);
+    int fd = uprobes_retaddr_event_open(module, offset, -1, cpu,
+                                        ComputeWakeupWatermarkBytes(UPROBES_RING_BUFFER_SIZE_KB));
     if (fd < 0) {
       ERROR("Opening uprobe 0x%lx on cpu %d", function.VirtualAddress(), cpu);
       return false;
@@ -133,7 +162,8 @@ bool TracerThread::OpenUretprobes(const LinuxTracing::Function& function,
   const char* module = function.BinaryPath().c_str();
   const uint64_t offset = function.FileOffset();
   for (int32_t cpu : cpus) {
-    int fd = uretprobes_event_open(module, offset, -1, cpu);
+    int fd = uretprobes_event_open(module, offset, -1, cpu,
+                                   ComputeWakeupWatermarkBytes(UPROBES_RING_BUFFER_SIZE_KB));
     if (fd < 0) {
       ERROR("Opening uretprobe 0x%lx on cpu %d", function.VirtualAddress(), cpu);
       return false;
@@ -222,6 +252,7 @@ void TracerThread::OpenUserSpaceProbesRingBuffers() {
     constexpr uint64_t buffer_size = UPROBES_RING_BUFFER_SIZE_KB;
     std::string buffer_name = absl::StrFormat("uprobes_uretprobes_%u", cpu);
     ring_buffers_.emplace_back(ring_buffer_fd, buffer_size, buffer_name);
+    ring_buffer_fds_to_cpu_[ring_buffer_fd] = cpu;
 
     // Redirect subsequent fds to the cpu specific ring buffer created above.
     for (size_t i = 1; i < fds.size(); ++i) {
@@ -234,11 +265,13 @@ bool TracerThread::OpenMmapTask(const std::vector<int32_t>& cpus) {
   std::vector<int> mmap_task_tracing_fds;
   std::vector<PerfEventRingBuffer> mmap_task_ring_buffers;
   for (int32_t cpu : cpus) {
-    int mmap_task_fd = mmap_task_event_open(-1, cpu);
+    int mmap_task_fd =
+        mmap_task_event_open(-1, cpu, ComputeWakeupWatermarkBytes(MMAP_TASK_RING_BUFFER_SIZE_KB));
     std::string buffer_name = absl::StrFormat("mmap_task_%d", cpu);
     PerfEventRingBuffer mmap_task_ring_buffer{mmap_task_fd, MMAP_TASK_RING_BUFFER_SIZE_KB,
                                               buffer_name};
     if (mmap_task_ring_buffer.IsOpen()) {
+      ring_buffer_fds_to_cpu_[mmap_task_fd] = cpu;
       mmap_task_tracing_fds.push_back(mmap_task_fd);
       mmap_task_ring_buffers.push_back(std::move(mmap_task_ring_buffer));
     } else {
@@ -260,14 +293,17 @@ bool TracerThread::OpenMmapTask(const std::vector<int32_t>& cpus) {
 bool TracerThread::OpenSampling(const std::vector<int32_t>& cpus) {
   std::vector<int> sampling_tracing_fds;
   std::vector<PerfEventRingBuffer> sampling_ring_buffers;
+  const uint32_t wakeup_watermark_bytes = ComputeWakeupWatermarkBytes(SAMPLING_RING_BUFFER_SIZE_KB);
   for (int32_t cpu : cpus) {
     int sampling_fd;
     switch (unwinding_method_) {
       case CaptureOptions::kFramePointers:
-        sampling_fd = callchain_sample_event_open(sampling_period_ns_, -1, cpu);
+        sampling_fd =
+            callchain_sample_event_open(sampling_period_ns_, -1, cpu, wakeup_watermark_bytes);
         break;
       case CaptureOptions::kDwarf:
-        sampling_fd = stack_sample_event_open(sampling_period_ns_, -1, cpu);
+        sampling_fd = stack_sample_event_open(sampling_period_ns_, -1, cpu, stack_dump_size_,
+                                              wakeup_watermark_bytes);
         break;
       case CaptureOptions::kUndefined:
       default:
@@ -280,6 +316,7 @@ bool TracerThread::OpenSampling(const std::vector<int32_t>& cpus) {
     PerfEventRingBuffer sampling_ring_buffer{sampling_fd, SAMPLING_RING_BUFFER_SIZE_KB,
                                              buffer_name};
     if (sampling_ring_buffer.IsOpen()) {
+      ring_buffer_fds_to_cpu_[sampling_fd] = cpu;
       sampling_tracing_fds.push_back(sampling_fd);
       sampling_ring_buffers.push_back(std::move(sampling_ring_buffer));
     } else {
@@ -331,10 +368,11 @@ bool TracerThread::OpenRingBuffersForTracepoint(
     const char* tracepoint_category, const char* tracepoint_name, const std::vector<int32_t>& cpus,
     std::vector<int>* tracing_fds, absl::flat_hash_set<uint64_t>* tracepoint_ids,
     absl::flat_hash_map<int32_t, int>* tracepoint_ring_buffer_fds_per_cpu,
-    std::vector<PerfEventRingBuffer>* ring_buffers) {
+    std::vector<PerfEventRingBuffer>* ring_buffers, uint32_t wakeup_watermark_bytes) {
   absl::flat_hash_map<int32_t, int> tracepoint_fds_per_cpu;
   for (int32_t cpu : cpus) {
-    int fd = tracepoint_event_open(tracepoint_category, tracepoint_name, -1, cpu);
+    int fd = tracepoint_event_open(tracepoint_category, tracepoint_name, -1, cpu,
+                                   wakeup_watermark_bytes);
     if (fd < 0) {
       ERROR("Opening %s:%s tracepoint for cpu %d", tracepoint_category, tracepoint_name, cpu);
       for (const auto& open_fd : tracepoint_fds_per_cpu) {
@@ -359,26 +397,33 @@ bool TracerThread::OpenRingBuffersForTracepoint(
 bool TracerThread::OpenTracepoints(const std::vector<int32_t>& cpus) {
   bool tracepoint_event_open_errors = false;
   absl::flat_hash_map<int32_t, int> tracepoint_ring_buffer_fds_per_cpu;
+  const uint32_t wakeup_watermark_bytes =
+      ComputeWakeupWatermarkBytes(TRACEPOINTS_RING_BUFFER_SIZE_KB);
 
-  tracepoint_event_open_errors |=
-      !OpenRingBuffersForTracepoint("task", "task_newtask", cpus, &tracing_fds_, &task_newtask_ids_,
-                                    &tracepoint_ring_buffer_fds_per_cpu, &ring_buffers_);
+  tracepoint_event_open_errors |= !OpenRingBuffersForTracepoint(
+      "task", "task_newtask", cpus, &tracing_fds_, &task_newtask_ids_,
+      &tracepoint_ring_buffer_fds_per_cpu, &ring_buffers_, wakeup_watermark_bytes);
 
-  tracepoint_event_open_errors |=
-      !OpenRingBuffersForTracepoint("task", "task_rename", cpus, &tracing_fds_, &task_rename_ids_,
-                                    &tracepoint_ring_buffer_fds_per_cpu, &ring_buffers_);
+  tracepoint_event_open_errors |= !OpenRingBuffersForTracepoint(
+      "task", "task_rename", cpus, &tracing_fds_, &task_rename_ids_,
+      &tracepoint_ring_buffer_fds_per_cpu, &ring_buffers_, wakeup_watermark_bytes);
 
   for (const auto& selected_tracepoint : instrumented_tracepoints_) {
     absl::flat_hash_set<uint64_t> stream_ids;
     tracepoint_event_open_errors |= !OpenRingBuffersForTracepoint(
         selected_tracepoint.category().c_str(), selected_tracepoint.name().c_str(), cpus,
-        &tracing_fds_, &stream_ids, &tracepoint_ring_buffer_fds_per_cpu, &ring_buffers_);
+        &tracing_fds_, &stream_ids, &tracepoint_ring_buffer_fds_per_cpu, &ring_buffers_,
+        wakeup_watermark_bytes);
 
     for (const auto& stream_id : stream_ids) {
       ids_to_tracepoint_info_.emplace(stream_id, selected_tracepoint);
     }
   }
 
+  for (const auto& [/*int32_t*/ cpu, /*int*/ ring_buffer_fd] : tracepoint_ring_buffer_fds_per_cpu) {
+    ring_buffer_fds_to_cpu_[ring_buffer_fd] = cpu;
+  }
+
   return !tracepoint_event_open_errors;
 }
 
@@ -406,8 +451,11 @@ bool TracerThread::OpenGpuTracepoints(const std::vector<int32_t>& cpus) {
   absl::flat_hash_map<int32_t, int> amdgpu_sched_run_job_fds_per_cpu;
   absl::flat_hash_map<int32_t, int> dma_fence_signaled_fds_per_cpu;
   bool tracepoint_event_open_errors = false;
+  const uint32_t wakeup_watermark_bytes =
+      ComputeWakeupWatermarkBytes(GPU_TRACING_RING_BUFFER_SIZE_KB);
   for (int32_t cpu : cpus) {
-    int amdgpu_cs_ioctl_fd = tracepoint_event_open("amdgpu", "amdgpu_cs_ioctl", -1, cpu);
+    int amdgpu_cs_ioctl_fd =
+        tracepoint_event_open("amdgpu", "amdgpu_cs_ioctl", -1, cpu, wakeup_watermark_bytes);
     if (amdgpu_cs_ioctl_fd == -1) {
       ERROR("Opening amdgpu:amdgpu_cs_ioctl tracepoint for cpu %d", cpu);
       tracepoint_event_open_errors = true;
@@ -415,7 +463,8 @@ bool TracerThread::OpenGpuTracepoints(const std::vector<int32_t>& cpus) {
     }
     amdgpu_cs_ioctl_fds_per_cpu.emplace(cpu, amdgpu_cs_ioctl_fd);
 
-    int amdgpu_sched_run_job_fd = tracepoint_event_open("amdgpu", "amdgpu_sched_run_job", -1, cpu);
+    int amdgpu_sched_run_job_fd =
+        tracepoint_event_open("amdgpu", "amdgpu_sched_run_job", -1, cpu, wakeup_watermark_bytes);
     if (amdgpu_sched_run_job_fd == -1) {
       ERROR("Opening amdgpu:amdgpu_sched_run_job tracepoint for cpu %d", cpu);
       tracepoint_event_open_errors = true;
@@ -423,7 +472,8 @@ bool TracerThread::OpenGpuTracepoints(const std::vector<int32_t>& cpus) {
     }
     amdgpu_sched_run_job_fds_per_cpu.emplace(cpu, amdgpu_sched_run_job_fd);
 
-    int dma_fence_signaled_fd = tracepoint_event_open("dma_fence", "dma_fence_signaled", -1, cpu);
+    int dma_fence_signaled_fd =
+        tracepoint_event_open("dma_fence", "dma_fence_signaled", -1, cpu, wakeup_watermark_bytes);
     if (dma_fence_signaled_fd == -1) {
       ERROR("Opening dma_fence:dma_fence_signaled tracepoint for cpu %d", cpu);
       tracepoint_event_open_errors = true;
@@ -472,6 +522,10 @@ bool TracerThread::OpenGpuTracepoints(const std::vector<int32_t>& cpus) {
   OpenRingBuffersOrRedirectOnExisting(
       dma_fence_signaled_fds_per_cpu, &gpu_tracepoint_ring_buffer_fds_per_cpu, &ring_buffers_,
       GPU_TRACING_RING_BUFFER_SIZE_KB, absl::StrFormat("%s:%s", "dma_fence", "dma_fence_signaled"));
+  for (const auto& [/*int32_t*/ cpu, /*int*/ ring_buffer_fd] :
+       gpu_tracepoint_ring_buffer_fds_per_cpu) {
+    ring_buffer_fds_to_cpu_[ring_buffer_fd] = cpu;
+  }
 
   return true;
 }
@@ -508,8 +562,6 @@ void TracerThread::Run(const std::shared_ptr<std::atomic<bool>>& exit_requested)
     perf_event_open_errors |= !OpenContextSwitches(all_cpus);
   }
 
-  context_switch_manager_.Clear();
-
   perf_event_open_errors |= !OpenMmapTask(cpuset_cpus);
 
   bool uprobes_event_open_errors = false;
@@ -563,22 +615,119 @@ void TracerThread::Run(const std::shared_ptr<std::atomic<bool>>& exit_requested)
   // Get the initial thread names and notify the listener_.
   RetrieveThreadNames();
 
+  CreateRingBufferReaders();
+
   stats_.Reset();
 
-  bool last_iteration_saw_events = false;
   std::thread deferred_events_thread(&TracerThread::ProcessDeferredEvents, this);
 
+  // The first reader runs on this thread, the others on their own threads.
+  std::vector<std::thread> ring_buffer_reader_threads;
+  for (size_t reader_index = 1; reader_index < ring_buffer_readers_.size(); ++reader_index) {
+    ring_buffer_reader_threads.emplace_back([this, reader_index, &exit_requested] {
+      std::string thread_name = absl::StrFormat("Tracer::Read%u", reader_index);
+      pthread_setname_np(pthread_self(), thread_name.c_str());
+      ReadRingBuffers(ring_buffer_readers_[reader_index].get(), exit_requested);
+    });
+  }
+  ReadRingBuffers(ring_buffer_readers_[0].get(), exit_requested);
+  for (std::thread& ring_buffer_reader_thread : ring_buffer_reader_threads) {
+    ring_buffer_reader_thread.join();
+  }
+
+  // Finish processing all deferred events.
+  stop_deferred_thread_ = true;
+  deferred_events_notifier_.Notify();
+  deferred_events_thread.join();
+  uprobes_event_processor_->ProcessAllEvents();
+  // Also waits for the stack samples that are still being unwound.
+  uprobes_event_processor_.reset();
+  LibunwindstackUnwinder::SetElfCachingEnabled(false);
+
+  // Stop recording.
+  for (int fd : tracing_fds_) {
+    perf_event_disable(fd);
+  }
+
+  // Close the ring buffers.
+  ring_buffers_.clear();
+
+  // Close the file descriptors.
+  for (int fd : tracing_fds_) {
+    close(fd);
+  }
+
+  // The events of this capture are gone, and the threads that read and
+  // processed them have returned their cached blocks.
+  ReleaseSharedPerfEventMemory();
+}
+
+void TracerThread::CreateRingBufferReaders() {
+  std::vector<int32_t> cpus;
+  for (const auto& [/*int*/ unused_fd, /*int32_t*/ cpu] : ring_buffer_fds_to_cpu_) {
+    cpus.push_back(cpu);
+  }
+  std::sort(cpus.begin(), cpus.end());
+  cpus.erase(std::unique(cpus.begin(), cpus.end()), cpus.end());
+
+  size_t reader_count = std::min<size_t>(ring_buffer_reader_count_, cpus.size());
+  reader_count = std::max<size_t>(reader_count, 1);
+  ring_buffer_readers_.clear();
+  for (size_t i = 0; i < reader_count; ++i) {
+    ring_buffer_readers_.emplace_back(std::make_unique<RingBufferReader>());
+  }
+
+  // Assign groups of consecutive cpus to the same reader. All the ring buffers
+  // of a cpu go to the same reader, in particular because ContextSwitchManager
+  // needs to see all context switches of a cpu.
+  absl::flat_hash_map<int32_t, size_t> cpu_to_reader_index;
+  for (size_t cpu_index = 0; cpu_index < cpus.size(); ++cpu_index) {
+    cpu_to_reader_index.emplace(cpus[cpu_index], cpu_index * reader_count / cpus.size());
+  }
+  for (PerfEventRingBuffer& ring_buffer : ring_buffers_) {
+    size_t reader_index = 0;
+    auto cpu_it = ring_buffer_fds_to_cpu_.find(ring_buffer.GetFileDescriptor());
+    if (cpu_it != ring_buffer_fds_to_cpu_.end()) {
+      reader_index = cpu_to_reader_index.at(cpu_it->second);
+    }
+    ring_buffer_readers_[reader_index]->ring_buffers.push_back(&ring_buffer);
+  }
+
+  if (ring_buffer_reading_mode_ == CaptureOptions::kEventDriven) {
+    for (const std::unique_ptr<RingBufferReader>& reader : ring_buffer_readers_) {
+      reader->epoll_fd = CreateRingBuffersEpoll(reader->ring_buffers);
+      if (reader->epoll_fd < 0) {
+        ERROR("Could not set up epoll on the ring buffers: falling back to polling");
+      }
+    }
+  }
+}
+
+void TracerThread::ReadRingBuffers(RingBufferReader* reader,
+                                   const std::shared_ptr<std::atomic<bool>>& exit_requested) {
+  bool last_iteration_saw_events = false;
+
   while (!(*exit_requested)) {
     ORBIT_SCOPE("Tracer Iteration");
 
     if (!last_iteration_saw_events) {
       // Periodically print event statistics.
-      PrintStatsIfTimerElapsed();
+      if (reader == ring_buffer_readers_[0].get()) {
+        PrintStatsIfTimerElapsed();
+      }
 
-      // Sleep if there was no new event in the last iteration so that we are
-      // not constantly polling. Don't sleep so long that ring buffers overflow.
-      // TODO: Refine this sleeping pattern, possibly using exponential backoff.
-      {
+      if (reader->epoll_fd >= 0) {
+        // Block until one of the ring buffers crosses its wakeup watermark. The
+        // timeout bounds the latency of the events in buffers that fill slowly
+        // and of reacting to exit_requested.
+        ORBIT_SCOPE("Wait");
+        WaitForRingBuffers(reader->epoll_fd);
+      } else {
+        // Sleep if there was no new event in the last iteration so that we are
+        // not constantly polling. Don't sleep so long that ring buffers
+        // overflow.
+        // TODO: Refine this sleeping pattern, possibly using exponential
+        //  backoff.
         ORBIT_SCOPE("Sleep");
         usleep(IDLE_TIME_ON_EMPTY_RING_BUFFERS_US);
       }
@@ -589,7 +738,7 @@ void TracerThread::Run(const std::shared_ptr<std::atomic<bool>>& exit_requested)
     // Read and process events from all ring buffers. In order to ensure that no
     // buffer is read constantly while others overflow, we schedule the reading
     // using round-robin like scheduling.
-    for (PerfEventRingBuffer& ring_buffer : ring_buffers_) {
+    for (PerfEventRingBuffer* ring_buffer : reader->ring_buffers) {
       if (*exit_requested) {
         break;
       }
@@ -603,13 +752,13 @@ void TracerThread::Run(const std::shared_ptr<std::atomic<bool>>& exit_requested)
         if (*exit_requested) {
           break;
         }
-        if (!ring_buffer.HasNewData()) {
+        if (!ring_buffer->HasNewData()) {
           break;
         }
 
         last_iteration_saw_events = true;
         perf_event_header header;
-        ring_buffer.ReadHeader(&header);
+        ring_buffer->ReadHeader(&header);
 
         // perf_event_header::type contains the type of record, e.g.,
         // PERF_RECORD_SAMPLE, PERF_RECORD_MMAP, etc., defined in enum
@@ -621,67 +770,100 @@ void TracerThread::Run(const std::shared_ptr<std::atomic<bool>>& exit_requested)
             ERROR(
                 "Unexpected PERF_RECORD_SWITCH in ring buffer '%s' (only "
                 "PERF_RECORD_SWITCH_CPU_WIDE are expected)",
-                ring_buffer.GetName().c_str());
+                ring_buffer->GetName().c_str());
             break;
           case PERF_RECORD_SWITCH_CPU_WIDE:
-            ProcessContextSwitchCpuWideEvent(header, &ring_buffer);
+            ProcessContextSwitchCpuWideEvent(header, ring_buffer, reader);
             break;
           case PERF_RECORD_FORK:
-            ProcessForkEvent(header, &ring_buffer);
+            ProcessForkEvent(header, ring_buffer);
             break;
           case PERF_RECORD_EXIT:
-            ProcessExitEvent(header, &ring_buffer);
+            ProcessExitEvent(header, ring_buffer);
             break;
           case PERF_RECORD_MMAP:
-            ProcessMmapEvent(header, &ring_buffer);
+            ProcessMmapEvent(header, ring_buffer, reader);
             break;
           case PERF_RECORD_SAMPLE:
-            ProcessSampleEvent(header, &ring_buffer);
+            ProcessSampleEvent(header, ring_buffer, reader);
             break;
           case PERF_RECORD_LOST:
-            ProcessLostEvent(header, &ring_buffer);
+            ProcessLostEvent(header, ring_buffer);
             break;
           case PERF_RECORD_THROTTLE:
             // We don't use throttle/unthrottle events, but log them separately
             // from the default 'Unexpected perf_event_header::type' case.
-            LOG("PERF_RECORD_THROTTLE in ring buffer '%s'", ring_buffer.GetName().c_str());
-            ring_buffer.SkipRecord(header);
+            LOG("PERF_RECORD_THROTTLE in ring buffer '%s'", ring_buffer->GetName().c_str());
+            ring_buffer->SkipRecord(header);
             break;
           case PERF_RECORD_UNTHROTTLE:
-            LOG("PERF_RECORD_UNTHROTTLE in ring buffer '%s'", ring_buffer.GetName().c_str());
-            ring_buffer.SkipRecord(header);
+            LOG("PERF_RECORD_UNTHROTTLE in ring buffer '%s'", ring_buffer->GetName().c_str());
+            ring_buffer->SkipRecord(header);
             break;
           default:
             ERROR("Unexpected perf_event_header::type in ring buffer '%s': %u",
-                  ring_buffer.GetName().c_str(), header.type);
-            ring_buffer.SkipRecord(header);
+                  ring_buffer->GetName().c_str(), header.type);
+            ring_buffer->SkipRecord(header);
             break;
         }
       }
     }
   }
 
-  // Finish processing all deferred events.
-  stop_deferred_thread_ = true;
-  deferred_events_thread.join();
-  uprobes_event_processor_->ProcessAllEvents();
+  if (reader->epoll_fd >= 0) {
+    close(reader->epoll_fd);
+    reader->epoll_fd = -1;
+  }
+}
 
-  // Stop recording.
-  for (int fd : tracing_fds_) {
-    perf_event_disable(fd);
+uint32_t TracerThread::ComputeWakeupWatermarkBytes(uint64_t ring_buffer_size_kb) const {
+  if (ring_buffer_reading_mode_ != CaptureOptions::kEventDriven) {
+    return 0;
   }
+  return static_cast<uint32_t>(ring_buffer_size_kb * 1024 / RING_BUFFER_WAKEUP_WATERMARK_FRACTION);
+}
 
-  // Close the ring buffers.
-  ring_buffers_.clear();
+int TracerThread::CreateRingBuffersEpoll(const std::vector<PerfEventRingBuffer*>& ring_buffers) {
+  int epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+  if (epoll_fd < 0) {
+    ERROR("epoll_create1: %s", SafeStrerror(errno));
+    return -1;
+  }
 
-  // Close the file descriptors.
-  for (int fd : tracing_fds_) {
-    close(fd);
+  // Only the file descriptors on which a ring buffer was mmapped are added:
+  // the ones that were redirected to them never become readable themselves.
+  for (const PerfEventRingBuffer* ring_buffer : ring_buffers) {
+    epoll_event event{};
+    event.events = EPOLLIN;
+    event.data.fd = ring_buffer->GetFileDescriptor();
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, ring_buffer->GetFileDescriptor(), &event) != 0) {
+      ERROR("epoll_ctl on ring buffer '%s': %s", ring_buffer->GetName().c_str(),
+            SafeStrerror(errno));
+      close(epoll_fd);
+      return -1;
+    }
+  }
+  return epoll_fd;
+}
+
+void TracerThread::WaitForRingBuffers(int epoll_fd) {
+  // We don't need to know which ring buffers woke us up, as after waking up
+  // all of them are read anyway: a small array is enough to consume the
+  // notifications.
+  static constexpr int MAX_EPOLL_EVENTS = 64;
+  std::array<epoll_event, MAX_EPOLL_EVENTS> events;
+  int ret =
+      epoll_wait(epoll_fd, events.data(), MAX_EPOLL_EVENTS, EPOLL_TIMEOUT_ON_EMPTY_RING_BUFFERS_MS);
+  if (ret < 0 && errno != EINTR) {
+    ERROR("epoll_wait: %s", SafeStrerror(errno));
+    // Avoid spinning in case the error is persistent.
+    usleep(IDLE_TIME_ON_EMPTY_RING_BUFFERS_US);
   }
 }
 
 void TracerThread::ProcessContextSwitchCpuWideEvent(const perf_event_header& header,
-                                                    PerfEventRingBuffer* ring_buffer) {
+                                                    PerfEventRingBuffer* ring_buffer,
+                                                    RingBufferReader* reader) {
   SystemWideContextSwitchPerfEvent event;
   ring_buffer->ConsumeRecord(header, &event.ring_buffer_record);
   pid_t pid = event.GetPid();
@@ -696,12 +878,16 @@ void TracerThread::ProcessContextSwitchCpuWideEvent(const perf_event_header& hea
       // Careful: when a switch out is caused by the thread exiting, pid and tid
       // have value -1.
       std::optional<SchedulingSlice> scheduling_slice =
-          context_switch_manager_.ProcessContextSwitchOut(pid, tid, cpu, time);
+          reader->context_switch_manager.ProcessContextSwitchOut(pid, tid, cpu, time);
       if (scheduling_slice.has_value()) {
-        listener_->OnSchedulingSlice(std::move(scheduling_slice.value()));
+        // SchedulingSlice only has scalar fields, so copying it doesn't allocate.
+        listener_->OnSchedulingSlice(
+            [&scheduling_slice](SchedulingSlice* listener_scheduling_slice) {
+              *listener_scheduling_slice = scheduling_slice.value();
+            });
       }
     } else {
-      context_switch_manager_.ProcessContextSwitchIn(pid, tid, cpu, time);
+      reader->context_switch_manager.ProcessContextSwitchIn(pid, tid, cpu, time);
     }
   }
 
@@ -734,7 +920,7 @@ void TracerThread::ProcessExitEvent(const perf_event_header& header,
 }
 
 void TracerThread::ProcessMmapEvent(const perf_event_header& header,
-                                    PerfEventRingBuffer* ring_buffer) {
+                                    PerfEventRingBuffer* ring_buffer, RingBufferReader* reader) {
   pid_t pid = ReadMmapRecordPid(ring_buffer);
   ring_buffer->SkipRecord(header);
 
@@ -746,11 +932,11 @@ void TracerThread::ProcessMmapEvent(const perf_event_header& header,
   // This should happen rarely.
   auto event = std::make_unique<MapsPerfEvent>(MonotonicTimestampNs(), ReadMaps(pid_));
   event->SetOriginFileDescriptor(ring_buffer->GetFileDescriptor());
-  DeferEvent(std::move(event));
+  DeferEvent(reader, std::move(event));
 }
 
 void TracerThread::ProcessSampleEvent(const perf_event_header& header,
-                                      PerfEventRingBuffer* ring_buffer) {
+                                      PerfEventRingBuffer* ring_buffer, RingBufferReader* reader) {
   uint64_t stream_id = ReadSampleRecordStreamId(ring_buffer);
   bool is_uprobe = uprobes_ids_.contains(stream_id);
   bool is_uretprobe = uretprobes_ids_.contains(stream_id);
@@ -782,7 +968,7 @@ void TracerThread::ProcessSampleEvent(const perf_event_header& header,
 
     event->SetFunction(uprobes_uretprobes_ids_to_function_.at(event->GetStreamId()));
     event->SetOriginFileDescriptor(fd);
-    DeferEvent(std::move(event));
+    DeferEvent(reader, std::move(event));
     ++stats_.uprobes_count;
 
   } else if (is_uretprobe) {
@@ -796,12 +982,13 @@ void TracerThread::ProcessSampleEvent(const perf_event_header& header,
 
     event->SetFunction(uprobes_uretprobes_ids_to_function_.at(event->GetStreamId()));
     event->SetOriginFileDescriptor(fd);
-    DeferEvent(std::move(event));
+    DeferEvent(reader, std::move(event));
     ++stats_.uprobes_count;
 
   } else if (is_stack_sample) {
     pid_t pid = ReadSampleRecordPid(ring_buffer);
-    constexpr size_t size_of_stack_sample = sizeof(perf_event_stack_sample);
+    const size_t size_of_stack_sample =
+        sizeof(perf_event_stack_sample_fixed) + stack_dump_size_ + sizeof(uint64_t);
     if (header.size != size_of_stack_sample) {
       // Skip stack samples that have an unexpected size. These normally have
       // abi == PERF_SAMPLE_REGS_ABI_NONE and no registers, and size == 0 and
@@ -820,26 +1007,33 @@ void TracerThread::ProcessSampleEvent(const perf_event_header& header,
     // e.g., with header.misc == PERF_RECORD_MISC_KERNEL,
     // in general they seem to produce valid callstacks.
 
-    auto event = ConsumeStackSamplePerfEvent(ring_buffer, header);
+    uint64_t max_copy_size = std::numeric_limits<uint64_t>::max();
+    if (stack_copy_size_estimator_ != nullptr) {
+      max_copy_size =
+          stack_copy_size_estimator_->GetCopySize(ReadSampleRecordTid(ring_buffer), max_copy_size);
+    }
+    auto event = ConsumeStackSamplePerfEvent(ring_buffer, header, max_copy_size);
+    stats_.stack_dumped_bytes += event->GetDumpedStackSize();
+    stats_.stack_copied_bytes += event->GetStackSize();
     event->SetOriginFileDescriptor(fd);
-    DeferEvent(std::move(event));
+    DeferEvent(reader, std::move(event));
     ++stats_.sample_count;
 
   } else if (is_task_newtask) {
     auto event = ConsumeTracepointPerfEvent<TaskNewtaskPerfEvent>(ring_buffer, header);
-    ThreadName thread_name;
-    thread_name.set_tid(event->GetTid());
-    thread_name.set_name(event->GetComm());
-    thread_name.set_timestamp_ns(event->GetTimestamp());
-    listener_->OnThreadName(std::move(thread_name));
+    listener_->OnThreadName([&event](ThreadName* thread_name) {
+      thread_name->set_tid(event->GetTid());
+      thread_name->set_name(event->GetComm());
+      thread_name->set_timestamp_ns(event->GetTimestamp());
+    });
 
   } else if (is_task_rename) {
     auto event = ConsumeTracepointPerfEvent<TaskRenamePerfEvent>(ring_buffer, header);
-    ThreadName thread_name;
-    thread_name.set_tid(event->GetTid());
-    thread_name.set_name(event->GetNewComm());
-    thread_name.set_timestamp_ns(event->GetTimestamp());
-    listener_->OnThreadName(std::move(thread_name));
+    listener_->OnThreadName([&event](ThreadName* thread_name) {
+      thread_name->set_tid(event->GetTid());
+      thread_name->set_name(event->GetNewComm());
+      thread_name->set_timestamp_ns(event->GetTimestamp());
+    });
 
   } else if (is_user_instrumented_tracepoint) {
     auto it = ids_to_tracepoint_info_.find(stream_id);
@@ -850,31 +1044,35 @@ void TracerThread::ProcessSampleEvent(const perf_event_header& header,
 
     auto event = ConsumeGenericTracepointPerfEvent(ring_buffer, header);
 
-    orbit_grpc_protos::TracepointEvent tracepoint_event;
-    tracepoint_event.set_pid(event->GetPid());
-    tracepoint_event.set_tid(event->GetTid());
-    tracepoint_event.set_time(event->GetTimestamp());
-    tracepoint_event.set_cpu(event->GetCpu());
-
-    orbit_grpc_protos::TracepointInfo* tracepoint = tracepoint_event.mutable_tracepoint_info();
-    tracepoint->set_name(it->second.name());
-    tracepoint->set_category(it->second.category());
+    listener_->OnTracepointEvent(
+        [&event, &it](orbit_grpc_protos::TracepointEvent* tracepoint_event) {
+          tracepoint_event->set_pid(event->GetPid());
+          tracepoint_event->set_tid(event->GetTid());
+          tracepoint_event->set_time(event->GetTimestamp());
+          tracepoint_event->set_cpu(event->GetCpu());
 
-    listener_->OnTracepointEvent(std::move(tracepoint_event));
+          orbit_grpc_protos::TracepointInfo* tracepoint =
+              tracepoint_event->mutable_tracepoint_info();
+          tracepoint->set_name(it->second.name());
+          tracepoint->set_category(it->second.category());
+        });
 
   } else if (is_amdgpu_cs_ioctl_event) {
     // TODO: Consider deferring GPU events.
     auto event = ConsumeTracepointPerfEvent<AmdgpuCsIoctlPerfEvent>(ring_buffer, header);
     // Do not filter GPU tracepoint events based on pid as we want to have
     // visibility into all GPU activity across the system.
+    std::lock_guard<std::mutex> lock(gpu_event_processor_mutex_);
     gpu_event_processor_->PushEvent(*event);
     ++stats_.gpu_events_count;
   } else if (is_amdgpu_sched_run_job_event) {
     auto event = ConsumeTracepointPerfEvent<AmdgpuSchedRunJobPerfEvent>(ring_buffer, header);
+    std::lock_guard<std::mutex> lock(gpu_event_processor_mutex_);
     gpu_event_processor_->PushEvent(*event);
     ++stats_.gpu_events_count;
   } else if (is_dma_fence_signaled_event) {
     auto event = ConsumeTracepointPerfEvent<DmaFenceSignaledPerfEvent>(ring_buffer, header);
+    std::lock_guard<std::mutex> lock(gpu_event_processor_mutex_);
     gpu_event_processor_->PushEvent(*event);
     ++stats_.gpu_events_count;
   } else if (is_callchain_sample) {
@@ -886,7 +1084,7 @@ void TracerThread::ProcessSampleEvent(const perf_event_header& header,
 
     auto event = ConsumeCallchainSamplePerfEvent(ring_buffer, header);
     event->SetOriginFileDescriptor(fd);
-    DeferEvent(std::move(event));
+    DeferEvent(reader, std::move(event));
     ++stats_.sample_count;
   } else {
     ERROR("PERF_EVENT_SAMPLE with unexpected stream_id: %lu", stream_id);
@@ -899,19 +1097,48 @@ void TracerThread::ProcessLostEvent(const perf_event_header& header,
   LostPerfEvent event;
   ring_buffer->ConsumeRecord(header, &event.ring_buffer_record);
   stats_.lost_count += event.GetNumLost();
+  total_lost_count_ += event.GetNumLost();
+  std::lock_guard<std::mutex> lock(stats_.lost_count_per_buffer_mutex);
   stats_.lost_count_per_buffer[ring_buffer] += event.GetNumLost();
 }
 
-void TracerThread::DeferEvent(std::unique_ptr<PerfEvent> event) {
-  std::lock_guard<std::mutex> lock(deferred_events_mutex_);
-  deferred_events_.emplace_back(std::move(event));
+void TracerThread::DeferEvent(RingBufferReader* reader, std::unique_ptr<PerfEvent> event) {
+  while (!reader->deferred_events.TryPush(std::move(event))) {
+    // Don't drop events, as that would break uprobe/uretprobe pairs: let the
+    // deferred events thread catch up.
+    deferred_events_notifier_.Notify();
+    std::this_thread::yield();
+  }
+  if (++reader->deferred_event_count % DEFERRED_EVENTS_NOTIFY_BATCH_SIZE == 0) {
+    deferred_events_notifier_.Notify();
+  }
 }
 
-std::vector<std::unique_ptr<PerfEvent>> TracerThread::ConsumeDeferredEvents() {
-  std::lock_guard<std::mutex> lock(deferred_events_mutex_);
-  std::vector<std::unique_ptr<PerfEvent>> events(std::move(deferred_events_));
-  deferred_events_.clear();
-  return events;
+size_t TracerThread::ConsumeDeferredEvents() {
+  size_t event_count = 0;
+  for (const std::unique_ptr<RingBufferReader>& reader : ring_buffer_readers_) {
+    std::unique_ptr<PerfEvent> event;
+    while (reader->deferred_events.TryPop(&event)) {
+      int fd = event->GetOriginFileDescriptor();
+      uprobes_event_processor_->AddEvent(fd, std::move(event));
+      ++event_count;
+    }
+  }
+  return event_count;
+}
+
+void TracerThread::WaitForDeferredEvents() {
+  uint32_t token = deferred_events_notifier_.PrepareWait();
+  bool has_deferred_events =
+      std::any_of(ring_buffer_readers_.begin(), ring_buffer_readers_.end(),
+                  [](const std::unique_ptr<RingBufferReader>& reader) {
+                    return !reader->deferred_events.IsEmpty();
+                  });
+  if (has_deferred_events || stop_deferred_thread_) {
+    deferred_events_notifier_.CancelWait();
+    return;
+  }
+  deferred_events_notifier_.Wait(token, DEFERRED_EVENTS_WAIT_TIMEOUT_MS);
 }
 
 void TracerThread::ProcessDeferredEvents() {
@@ -921,16 +1148,11 @@ void TracerThread::ProcessDeferredEvents() {
     // When "should_exit" becomes true, we know that we have stopped generating
     // deferred events. The last iteration will consume all remaining events.
     should_exit = stop_deferred_thread_;
-    std::vector<std::unique_ptr<PerfEvent>> events = ConsumeDeferredEvents();
-    if (events.empty()) {
-      // TODO: use a wait/notify mechanism instead of check/sleep.
-      usleep(IDLE_TIME_ON_EMPTY_DEFERRED_EVENTS_US);
-    } else {
-      for (auto& event : events) {
-        int fd = event->GetOriginFileDescriptor();
-        uprobes_event_processor_->AddEvent(fd, std::move(event));
-      }
-
+    if (ConsumeDeferredEvents() > 0) {
+      uprobes_event_processor_->ProcessOldEvents();
+    } else if (!should_exit) {
+      // Also process old events that were held back when no new events arrive.
+      WaitForDeferredEvents();
       uprobes_event_processor_->ProcessOldEvents();
     }
   }
@@ -944,15 +1166,16 @@ void TracerThread::RetrieveThreadNames() {
       continue;
     }
 
-    ThreadName thread_name;
-    thread_name.set_tid(tid);
-    thread_name.set_name(std::move(name));
-    thread_name.set_timestamp_ns(timestamp_ns);
-    listener_->OnThreadName(std::move(thread_name));
+    listener_->OnThreadName([tid, &name, timestamp_ns](ThreadName* thread_name) {
+      thread_name->set_tid(tid);
+      thread_name->set_name(std::move(name));
+      thread_name->set_timestamp_ns(timestamp_ns);
+    });
   }
 }
 
 void TracerThread::Reset() {
+  total_lost_count_ = 0;
   tracing_fds_.clear();
   fds_per_cpu_.clear();
   ring_buffers_.clear();
@@ -968,7 +1191,8 @@ void TracerThread::Reset() {
   dma_fence_signaled_ids_.clear();
   callchain_sampling_ids_.clear();
 
-  deferred_events_.clear();
+  ring_buffer_fds_to_cpu_.clear();
+  ring_buffer_readers_.clear();
   stop_deferred_thread_ = false;
 }
 
@@ -983,19 +1207,34 @@ void TracerThread::PrintStatsIfTimerElapsed() {
     LOG("  u(ret)probes: %.0f", stats_.uprobes_count / actual_window_s);
     LOG("  gpu events: %.0f", stats_.gpu_events_count / actual_window_s);
 
-    if (stats_.lost_count_per_buffer.empty()) {
-      LOG("  lost: %.0f", stats_.lost_count / actual_window_s);
-    } else {
-      LOG("  lost: %.0f, of which:", stats_.lost_count / actual_window_s);
-      for (const auto& lost_from_buffer : stats_.lost_count_per_buffer) {
-        LOG("    from %s: %.0f", lost_from_buffer.first->GetName().c_str(),
-            lost_from_buffer.second / actual_window_s);
+    {
+      std::lock_guard<std::mutex> lock(stats_.lost_count_per_buffer_mutex);
+      if (stats_.lost_count_per_buffer.empty()) {
+        LOG("  lost: %.0f", stats_.lost_count / actual_window_s);
+      } else {
+        LOG("  lost: %.0f, of which:", stats_.lost_count / actual_window_s);
+        for (const auto& lost_from_buffer : stats_.lost_count_per_buffer) {
+          LOG("    from %s: %.0f", lost_from_buffer.first->GetName().c_str(),
+              lost_from_buffer.second / actual_window_s);
+        }
       }
     }
 
     uint64_t unwind_error_count = *stats_.unwind_error_count;
     LOG("  unwind errors: %.0f (%.1f%%)", unwind_error_count / actual_window_s,
         100.0 * unwind_error_count / stats_.sample_count);
+    if (stack_copy_size_estimator_ != nullptr) {
+      uint64_t unwind_errors_on_partial_stack_copy_count =
+          *stats_.unwind_errors_on_partial_stack_copy_count;
+      LOG("    of which on partial stack copies: %.0f (%.1f%%)",
+          unwind_errors_on_partial_stack_copy_count / actual_window_s,
+          100.0 * unwind_errors_on_partial_stack_copy_count / stats_.sample_count);
+    }
+    if (stats_.sample_count > 0) {
+      LOG("  stack bytes per sample: %.0f dumped, %.0f copied",
+          static_cast<double>(stats_.stack_dumped_bytes) / stats_.sample_count,
+          static_cast<double>(stats_.stack_copied_bytes) / stats_.sample_count);
+    }
     uint64_t discarded_samples_in_uretprobes_count = *stats_.discarded_samples_in_uretprobes_count;
     LOG("  discarded samples in u(ret)probes: %.0f (%.1f%%)",
         discarded_samples_in_uretprobes_count / actual_window_s,
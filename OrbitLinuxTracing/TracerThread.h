@@ -24,6 +24,8 @@
 #include "PerfEventProcessor.h"
 #include "PerfEventReaders.h"
 #include "PerfEventRingBuffer.h"
+#include "SpscQueue.h"
+#include "StackCopySizeEstimator.h"
 #include "TracepointCustom.h"
 #include "Utils.h"
 #include "absl/container/flat_hash_map.h"
@@ -45,6 +47,10 @@ class TracerThread {
 
   void Run(const std::shared_ptr<std::atomic<bool>>& exit_requested);
 
+  // The number of events that the kernel reported as lost with PERF_RECORD_LOST
+  // records during the last call to Run.
+  [[nodiscard]] uint64_t GetLostEventCount() const { return total_lost_count_; }
+
  private:
   static std::optional<uint64_t> ComputeSamplingPeriodNs(double sampling_frequency) {
     double period_ns_dbl = 1'000'000'000 / sampling_frequency;
@@ -85,22 +91,56 @@ class TracerThread {
       const std::vector<int32_t>& cpus, std::vector<int>* tracing_fds,
       absl::flat_hash_set<uint64_t>* tracepoint_ids,
       absl::flat_hash_map<int32_t, int>* tracepoint_ring_buffer_fds_per_cpu,
-      std::vector<PerfEventRingBuffer>* ring_buffers);
+      std::vector<PerfEventRingBuffer>* ring_buffers, uint32_t wakeup_watermark_bytes);
   bool OpenTracepoints(const std::vector<int32_t>& cpus);
 
   bool InitGpuTracepointEventProcessor();
   bool OpenGpuTracepoints(const std::vector<int32_t>& cpus);
 
+  // Returns the wakeup_watermark to pass to perf_event_open for events whose
+  // ring buffer has the specified size, depending on ring_buffer_reading_mode_.
+  [[nodiscard]] uint32_t ComputeWakeupWatermarkBytes(uint64_t ring_buffer_size_kb) const;
+  // Returns an epoll file descriptor on which all the ring buffers are
+  // registered, or -1 on error.
+  [[nodiscard]] static int CreateRingBuffersEpoll(
+      const std::vector<PerfEventRingBuffer*>& ring_buffers);
+  static void WaitForRingBuffers(int epoll_fd);
+
+  // Each RingBufferReader reads, on its own thread, the ring buffers of a group
+  // of cpus, and owns all the state that is needed to process them and that is
+  // not shared with other readers.
+  struct RingBufferReader {
+    std::vector<PerfEventRingBuffer*> ring_buffers;
+    int epoll_fd = -1;
+    // ContextSwitchManager keeps its state per core, and all the context
+    // switches of a core are read by the same reader.
+    ContextSwitchManager context_switch_manager;
+    // As a ring buffer is only read by one reader, the deferred events from the
+    // same ring buffer are still in order, which PerfEventProcessor requires.
+    // The reader is the only producer and ProcessDeferredEvents the only
+    // consumer.
+    SpscQueue<std::unique_ptr<PerfEvent>> deferred_events{DEFERRED_EVENTS_QUEUE_CAPACITY};
+    uint64_t deferred_event_count = 0;
+  };
+
+  void CreateRingBufferReaders();
+  void ReadRingBuffers(RingBufferReader* reader,
+                       const std::shared_ptr<std::atomic<bool>>& exit_requested);
+
   void ProcessContextSwitchCpuWideEvent(const perf_event_header& header,
-                                        PerfEventRingBuffer* ring_buffer);
+                                        PerfEventRingBuffer* ring_buffer, RingBufferReader* reader);
   void ProcessForkEvent(const perf_event_header& header, PerfEventRingBuffer* ring_buffer);
   void ProcessExitEvent(const perf_event_header& header, PerfEventRingBuffer* ring_buffer);
-  void ProcessMmapEvent(const perf_event_header& header, PerfEventRingBuffer* ring_buffer);
-  void ProcessSampleEvent(const perf_event_header& header, PerfEventRingBuffer* ring_buffer);
+  void ProcessMmapEvent(const perf_event_header& header, PerfEventRingBuffer* ring_buffer,
+                        RingBufferReader* reader);
+  void ProcessSampleEvent(const perf_event_header& header, PerfEventRingBuffer* ring_buffer,
+                          RingBufferReader* reader);
   void ProcessLostEvent(const perf_event_header& header, PerfEventRingBuffer* ring_buffer);
 
-  void DeferEvent(std::unique_ptr<PerfEvent> event);
-  std::vector<std::unique_ptr<PerfEvent>> ConsumeDeferredEvents();
+  void DeferEvent(RingBufferReader* reader, std::unique_ptr<PerfEvent> event);
+  // Returns the number of events moved to uprobes_event_processor_.
+  size_t ConsumeDeferredEvents();
+  void WaitForDeferredEvents();
   void ProcessDeferredEvents();
 
   void RetrieveThreadNames();
@@ -124,7 +164,25 @@ class TracerThread {
   static constexpr uint64_t GPU_TRACING_RING_BUFFER_SIZE_KB = 256;
 
   static constexpr uint32_t IDLE_TIME_ON_EMPTY_RING_BUFFERS_US = 100;
-  static constexpr uint32_t IDLE_TIME_ON_EMPTY_DEFERRED_EVENTS_US = 1000;
+
+  // In CaptureOptions::kEventDriven mode, the reading thread is woken up when a
+  // ring buffer is a quarter full, which leaves plenty of room for the events
+  // that arrive while the ring buffers are being read. Events in buffers that
+  // fill more slowly are picked up at the latest after the timeout, which needs
+  // to be well below PerfEventProcessor::PROCESSING_DELAY_MS.
+  static constexpr uint64_t RING_BUFFER_WAKEUP_WATERMARK_FRACTION = 4;
+  static constexpr int EPOLL_TIMEOUT_ON_EMPTY_RING_BUFFERS_MS = 10;
+
+  // Enough for about 100 ms of uprobes at several hundred thousand per second
+  // per reader, in case the deferred events thread falls behind. When a queue
+  // is full, its reader waits for the deferred events thread to catch up.
+  static constexpr size_t DEFERRED_EVENTS_QUEUE_CAPACITY = 64 * 1024;
+  // Waking up the deferred events thread for every event would cost a syscall
+  // per event, so the readers only notify it every so many events, and the
+  // remaining events are picked up after the timeout. This delay is fine, as
+  // PerfEventProcessor holds back events for PROCESSING_DELAY_MS anyway.
+  static constexpr uint64_t DEFERRED_EVENTS_NOTIFY_BATCH_SIZE = 1024;
+  static constexpr uint32_t DEFERRED_EVENTS_WAIT_TIMEOUT_MS = 10;
 
   bool trace_context_switches_;
   pid_t pid_;
@@ -133,12 +191,20 @@ class TracerThread {
   std::vector<Function> instrumented_functions_;
   std::deque<orbit_grpc_protos::TracepointInfo> instrumented_tracepoints_;
   bool trace_gpu_driver_;
+  orbit_grpc_protos::CaptureOptions::RingBufferReadingMode ring_buffer_reading_mode_;
+  uint32_t ring_buffer_reader_count_;
+  uint16_t stack_dump_size_;
+  // Only set when adaptive stack copying is enabled.
+  std::unique_ptr<StackCopySizeEstimator> stack_copy_size_estimator_;
+  uint32_t unwinding_thread_count_;
 
   TracerListener* listener_ = nullptr;
 
   std::vector<int> tracing_fds_;
   absl::flat_hash_map<int32_t, std::vector<int>> fds_per_cpu_;
   std::vector<PerfEventRingBuffer> ring_buffers_;
+  absl::flat_hash_map<int, int32_t> ring_buffer_fds_to_cpu_;
+  std::vector<std::unique_ptr<RingBufferReader>> ring_buffer_readers_;
 
   absl::flat_hash_map<uint64_t, const Function*> uprobes_uretprobes_ids_to_function_;
   absl::flat_hash_set<uint64_t> uprobes_ids_;
@@ -153,12 +219,13 @@ class TracerThread {
   absl::flat_hash_map<uint64_t, orbit_grpc_protos::TracepointInfo> ids_to_tracepoint_info_;
 
   std::atomic<bool> stop_deferred_thread_ = false;
-  std::vector<std::unique_ptr<PerfEvent>> deferred_events_;
-  std::mutex deferred_events_mutex_;
-  ContextSwitchManager context_switch_manager_;
+  FutexNotifier deferred_events_notifier_;
   std::unique_ptr<PerfEventProcessor> uprobes_event_processor_;
   std::unique_ptr<GpuTracepointEventProcessor> gpu_event_processor_;
+  // GPU events are matched across cpus, hence across readers.
+  std::mutex gpu_event_processor_mutex_;
 
+  // The counters are updated by all the ring buffer readers.
   struct EventStats {
     void Reset() {
       event_count_begin_ns = MonotonicTimestampNs();
@@ -166,26 +233,39 @@ class TracerThread {
       sample_count = 0;
       uprobes_count = 0;
       lost_count = 0;
-      lost_count_per_buffer.clear();
+      {
+        std::lock_guard<std::mutex> lock(lost_count_per_buffer_mutex);
+        lost_count_per_buffer.clear();
+      }
+      stack_dumped_bytes = 0;
+      stack_copied_bytes = 0;
       *unwind_error_count = 0;
+      *unwind_errors_on_partial_stack_copy_count = 0;
       *discarded_samples_in_uretprobes_count = 0;
     }
 
     uint64_t event_count_begin_ns = 0;
-    uint64_t sched_switch_count = 0;
-    uint64_t sample_count = 0;
-    uint64_t uprobes_count = 0;
-    uint64_t gpu_events_count = 0;
-    uint64_t lost_count = 0;
+    std::atomic<uint64_t> sched_switch_count = 0;
+    std::atomic<uint64_t> sample_count = 0;
+    std::atomic<uint64_t> uprobes_count = 0;
+    std::atomic<uint64_t> gpu_events_count = 0;
+    std::atomic<uint64_t> lost_count = 0;
     absl::flat_hash_map<PerfEventRingBuffer*, uint64_t> lost_count_per_buffer{};
+    std::mutex lost_count_per_buffer_mutex;
+    std::atomic<uint64_t> stack_dumped_bytes = 0;
+    std::atomic<uint64_t> stack_copied_bytes = 0;
     std::shared_ptr<std::atomic<uint64_t>> unwind_error_count =
         std::make_unique<std::atomic<uint64_t>>(0);
+    std::shared_ptr<std::atomic<uint64_t>> unwind_errors_on_partial_stack_copy_count =
+        std::make_unique<std::atomic<uint64_t>>(0);
     std::shared_ptr<std::atomic<uint64_t>> discarded_samples_in_uretprobes_count =
         std::make_unique<std::atomic<uint64_t>>(0);
   };
 
   static constexpr uint64_t EVENT_STATS_WINDOW_S = 5;
   EventStats stats_{};
+  // Unlike stats_, not reset at every stats window.
+  std::atomic<uint64_t> total_lost_count_ = 0;
   ManualInstrumentationConfig manual_instrumentation_config_;
 
   static constexpr uint64_t NS_PER_MILLISECOND = 1'000'000;
@@ -0,0 +1,162 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// Compares CaptureOptions::kPolling and CaptureOptions::kEventDriven ring
+// buffer reading. For each sampling rate, a child process with a fixed number
+// of busy threads is sampled with frame pointers (plus system-wide context
+// switches) for a fixed time, once per reading mode. The benchmark reports the
+// CPU time used by this process (i.e., by the tracer's threads) and the number
+// of events that the kernel reported as lost (PERF_RECORD_LOST) because the
+// ring buffers were not read in time. Use --reader_threads to compare different
+// numbers of ring buffer readers. Needs to run as root.
+
+#include <OrbitBase/Logging.h>
+#include <OrbitLinuxTracing/TracerListener.h>
+#include <signal.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <thread>
+#include <memory>
+#include <vector>
+
+#include "TracerThread.h"
+#include "absl/flags/flag.h"
+#include "absl/flags/parse.h"
+#include "capture.pb.h"
+
+ABSL_FLAG(std::vector<std::string>, sampling_rates,
+          std::vector<std::string>({"1000", "4000", "10000"}),
+          "Sampling rates per thread to benchmark, in samples per second");
+ABSL_FLAG(uint32_t, threads, 0, "Number of busy threads to sample (0: number of cores)");
+ABSL_FLAG(uint32_t, duration_s, 5, "Duration of each run in seconds");
+ABSL_FLAG(uint32_t, reader_threads, 1, "Number of threads reading the ring buffers");
+
+namespace {
+
+using orbit_grpc_protos::CaptureOptions;
+
+class CountingTracerListener : public LinuxTracing::TracerListener {
+ public:
+  void OnSchedulingSlice(
+      absl::FunctionRef<void(orbit_grpc_protos::SchedulingSlice*)> /*fill_scheduling_slice*/)
+      override {
+    ++scheduling_slice_count;
+  }
+  void OnCallstackSample(
+      absl::FunctionRef<void(orbit_grpc_protos::CallstackSample*)> /*fill_callstack_sample*/)
+      override {
+    ++callstack_sample_count;
+  }
+  void OnFunctionCall(
+      absl::FunctionRef<void(orbit_grpc_protos::FunctionCall*)> /*fill_function_call*/) override {}
+  void OnGpuJob(absl::FunctionRef<void(orbit_grpc_protos::GpuJob*)> /*fill_gpu_job*/) override {}
+  void OnThreadName(
+      absl::FunctionRef<void(orbit_grpc_protos::ThreadName*)> /*fill_thread_name*/) override {}
+  void OnAddressInfo(
+      absl::FunctionRef<void(orbit_grpc_protos::AddressInfo*)> /*fill_address_info*/) override {}
+  void OnTracepointEvent(absl::FunctionRef<void(orbit_grpc_protos::TracepointEvent*)>
+                         /*fill_tracepoint_event*/) override {}
+
+  std::atomic<uint64_t> scheduling_slice_count = 0;
+  std::atomic<uint64_t> callstack_sample_count = 0;
+};
+
+[[noreturn]] void RunBusyThreads(uint32_t thread_count) {
+  std::vector<std::thread> threads;
+  for (uint32_t i = 0; i < thread_count; ++i) {
+    threads.emplace_back([] {
+      volatile uint64_t counter = 0;
+      while (true) {
+        counter = counter + 1;
+      }
+    });
+  }
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+  _exit(0);
+}
+
+double GetProcessCpuTimeS() {
+  rusage usage{};
+  getrusage(RUSAGE_SELF, &usage);
+  return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec +
+         (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+}
+
+void RunBenchmark(CaptureOptions::RingBufferReadingMode mode, double sampling_rate,
+                  uint32_t thread_count, uint32_t duration_s, uint32_t reader_thread_count) {
+  pid_t child_pid = fork();
+  FAIL_IF(child_pid < 0, "fork failed");
+  if (child_pid == 0) {
+    RunBusyThreads(thread_count);
+  }
+  // Let the child spawn its threads.
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+  CaptureOptions capture_options;
+  capture_options.set_trace_context_switches(true);
+  capture_options.set_pid(child_pid);
+  capture_options.set_sampling_rate(sampling_rate);
+  capture_options.set_unwinding_method(CaptureOptions::kFramePointers);
+  capture_options.set_ring_buffer_reading_mode(mode);
+  capture_options.set_ring_buffer_reader_thread_count(reader_thread_count);
+
+  CountingTracerListener listener;
+  LinuxTracing::TracerThread tracer{capture_options};
+  tracer.SetListener(&listener);
+  auto exit_requested = std::make_shared<std::atomic<bool>>(false);
+
+  double cpu_time_begin_s = GetProcessCpuTimeS();
+  auto wall_time_begin = std::chrono::steady_clock::now();
+  std::thread tracer_thread{[&tracer, &exit_requested] { tracer.Run(exit_requested); }};
+  std::this_thread::sleep_for(std::chrono::seconds(duration_s));
+  *exit_requested = true;
+  tracer_thread.join();
+  double wall_time_s =
+      std::chrono::duration<double>(std::chrono::steady_clock::now() - wall_time_begin).count();
+  double cpu_time_s = GetProcessCpuTimeS() - cpu_time_begin_s;
+
+  kill(child_pid, SIGKILL);
+  waitpid(child_pid, nullptr, 0);
+
+  uint64_t received_samples = listener.callstack_sample_count;
+  uint64_t lost_events = tracer.GetLostEventCount();
+  printf("%-12s %10.0f %9.1f%% %12lu %12lu %14lu\n",
+         mode == CaptureOptions::kEventDriven ? "event-driven" : "polling", sampling_rate,
+         100.0 * cpu_time_s / wall_time_s, lost_events, received_samples,
+         listener.scheduling_slice_count.load());
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  absl::ParseCommandLine(argc, argv);
+
+  uint32_t thread_count = absl::GetFlag(FLAGS_threads);
+  if (thread_count == 0) {
+    thread_count = std::thread::hardware_concurrency();
+  }
+  uint32_t duration_s = absl::GetFlag(FLAGS_duration_s);
+  uint32_t reader_thread_count = absl::GetFlag(FLAGS_reader_threads);
+
+  printf("%u busy threads, %u s per run, %u reader threads\n", thread_count, duration_s,
+         reader_thread_count);
+  printf("%-12s %10s %10s %12s %12s %14s\n", "mode", "rate [Hz]", "tracer CPU", "lost events",
+         "samples", "sched slices");
+  for (const std::string& sampling_rate_string : absl::GetFlag(FLAGS_sampling_rates)) {
+    double sampling_rate = std::stod(sampling_rate_string);
+    for (CaptureOptions::RingBufferReadingMode mode :
+         {CaptureOptions::kPolling, CaptureOptions::kEventDriven}) {
+      RunBenchmark(mode, sampling_rate, thread_count, duration_s, reader_thread_count);
+    }
+  }
+  return 0;
+}
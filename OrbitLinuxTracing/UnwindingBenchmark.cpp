@@ -0,0 +1,252 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// Records StackSamplePerfEvents of threads of this process that spin at the
+// bottom of a deep recursion, then replays them through
+// UprobesUnwindingVisitor with different numbers of unwinding threads. Reports
+// the samples unwound per second and checks that the callstacks are reported in
+// the same order as with unwinding on the visiting thread. With
+// --maps_refresh_period, the maps are replaced every so many samples, like
+// after an mmap, to show the effect of ELF caching across maps refreshes. The
+// CPU time and the number of AddressInfos show the cost of reporting them.
+// Needs to run as root.
+
+#include <OrbitBase/Logging.h>
+#include <OrbitLinuxTracing/TracerListener.h>
+#include <sys/resource.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "LibunwindstackUnwinder.h"
+#include "PerfEvent.h"
+#include "PerfEventOpen.h"
+#include "PerfEventReaders.h"
+#include "PerfEventRecords.h"
+#include "PerfEventRingBuffer.h"
+#include "UprobesUnwindingVisitor.h"
+#include "Utils.h"
+#include "absl/flags/flag.h"
+#include "absl/flags/parse.h"
+#include "capture.pb.h"
+
+ABSL_FLAG(std::vector<std::string>, unwinding_threads,
+          std::vector<std::string>({"0", "1", "2", "4", "8"}),
+          "Numbers of unwinding threads to benchmark (0: unwind on the visiting thread)");
+ABSL_FLAG(uint32_t, busy_threads, 4, "Number of threads to record stack samples of");
+ABSL_FLAG(uint32_t, depth, 64, "Depth of the recursion the busy threads spin in");
+ABSL_FLAG(uint32_t, duration_s, 2, "Duration of the recording in seconds");
+ABSL_FLAG(double, sampling_rate, 1000, "Sampling rate per cpu, in samples per second");
+ABSL_FLAG(uint32_t, maps_refresh_period, 0, "Replace the maps every this many samples (0: never)");
+ABSL_FLAG(bool, elf_caching, true, "Cache ELF files across maps refreshes");
+
+namespace {
+
+using LinuxTracing::MapsPerfEvent;
+using LinuxTracing::StackSamplePerfEvent;
+
+class RecordingTracerListener : public LinuxTracing::TracerListener {
+ public:
+  void OnSchedulingSlice(
+      absl::FunctionRef<void(orbit_grpc_protos::SchedulingSlice*)> /*fill_scheduling_slice*/)
+      override {}
+  void OnCallstackSample(absl::FunctionRef<void(orbit_grpc_protos::CallstackSample*)>
+                             fill_callstack_sample) override {
+    orbit_grpc_protos::CallstackSample callstack_sample;
+    fill_callstack_sample(&callstack_sample);
+    timestamps_ns.push_back(callstack_sample.timestamp_ns());
+  }
+  void OnFunctionCall(
+      absl::FunctionRef<void(orbit_grpc_protos::FunctionCall*)> /*fill_function_call*/) override {}
+  void OnGpuJob(absl::FunctionRef<void(orbit_grpc_protos::GpuJob*)> /*fill_gpu_job*/) override {}
+  void OnThreadName(
+      absl::FunctionRef<void(orbit_grpc_protos::ThreadName*)> /*fill_thread_name*/) override {}
+  void OnAddressInfo(
+      absl::FunctionRef<void(orbit_grpc_protos::AddressInfo*)> /*fill_address_info*/) override {
+    ++address_info_count;
+  }
+  void OnTracepointEvent(absl::FunctionRef<void(orbit_grpc_protos::TracepointEvent*)>
+                         /*fill_tracepoint_event*/) override {}
+
+  // Callstack samples are reported one at a time, so these need no lock.
+  std::vector<uint64_t> timestamps_ns;
+  uint64_t address_info_count = 0;
+};
+
+std::atomic<bool> stop_busy_threads = false;
+
+double GetProcessCpuTimeS() {
+  rusage usage{};
+  getrusage(RUSAGE_SELF, &usage);
+  return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec +
+         (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+}
+
+__attribute__((noinline)) uint64_t Recurse(uint32_t depth) {
+  if (depth == 0) {
+    volatile uint64_t counter = 0;
+    while (!stop_busy_threads) {
+      counter = counter + 1;
+    }
+    return counter;
+  }
+  uint64_t result = Recurse(depth - 1);
+  // Prevent the recursion from being turned into a loop.
+  asm volatile("" ::: "memory");
+  return result + depth;
+}
+
+std::vector<std::unique_ptr<StackSamplePerfEvent>> RecordStackSamples(double sampling_rate,
+                                                                      uint32_t duration_s) {
+  uint64_t sampling_period_ns = static_cast<uint64_t>(1'000'000'000 / sampling_rate);
+  std::vector<int> fds;
+  std::vector<LinuxTracing::PerfEventRingBuffer> ring_buffers;
+  for (int32_t cpu = 0; cpu < LinuxTracing::GetNumCores(); ++cpu) {
+    int fd = LinuxTracing::stack_sample_event_open(
+        sampling_period_ns, -1, cpu, LinuxTracing::SAMPLE_STACK_USER_SIZE, 0);
+    FAIL_IF(fd < 0, "Could not open stack sampling event (are you root?)");
+    fds.push_back(fd);
+    ring_buffers.emplace_back(fd, 64 * 1024, "stack_samples_" + std::to_string(cpu));
+    FAIL_IF(!ring_buffers.back().IsOpen(), "Could not open ring buffer");
+  }
+
+  constexpr size_t kStackSampleSize = sizeof(LinuxTracing::perf_event_stack_sample_fixed) +
+                                      LinuxTracing::SAMPLE_STACK_USER_SIZE + sizeof(uint64_t);
+  std::vector<std::unique_ptr<StackSamplePerfEvent>> events;
+  for (int fd : fds) {
+    LinuxTracing::perf_event_enable(fd);
+  }
+  auto end = std::chrono::steady_clock::now() + std::chrono::seconds(duration_s);
+  while (std::chrono::steady_clock::now() < end) {
+    for (LinuxTracing::PerfEventRingBuffer& ring_buffer : ring_buffers) {
+      while (ring_buffer.HasNewData()) {
+        perf_event_header header;
+        ring_buffer.ReadHeader(&header);
+        if (header.type != PERF_RECORD_SAMPLE || header.size != kStackSampleSize ||
+            LinuxTracing::ReadSampleRecordPid(&ring_buffer) != getpid()) {
+          ring_buffer.SkipRecord(header);
+          continue;
+        }
+        events.push_back(LinuxTracing::ConsumeStackSamplePerfEvent(&ring_buffer, header));
+      }
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  for (int fd : fds) {
+    LinuxTracing::perf_event_disable(fd);
+  }
+  ring_buffers.clear();
+  for (int fd : fds) {
+    close(fd);
+  }
+  return events;
+}
+
+// The visitor takes the stack dumps of the events, so each run needs copies.
+std::vector<std::unique_ptr<StackSamplePerfEvent>> CopyEvents(
+    const std::vector<std::unique_ptr<StackSamplePerfEvent>>& events) {
+  std::vector<std::unique_ptr<StackSamplePerfEvent>> copies;
+  copies.reserve(events.size());
+  for (const std::unique_ptr<StackSamplePerfEvent>& event : events) {
+    auto copy =
+        std::make_unique<StackSamplePerfEvent>(event->GetDumpedStackSize(), event->GetStackSize());
+    copy->ring_buffer_record.header = event->ring_buffer_record.header;
+    copy->ring_buffer_record.sample_id = event->ring_buffer_record.sample_id;
+    copy->ring_buffer_record.regs = event->ring_buffer_record.regs;
+    memcpy(copy->GetStackData(), event->GetStackData(), event->GetStackSize());
+    copies.push_back(std::move(copy));
+  }
+  return copies;
+}
+
+std::vector<uint64_t> RunBenchmark(const std::string& maps,
+                                   const std::vector<std::unique_ptr<StackSamplePerfEvent>>& events,
+                                   uint32_t unwinding_thread_count, uint32_t maps_refresh_period,
+                                   bool elf_caching) {
+  // Alternate between the maps and the maps without their last line, so that
+  // each refresh actually changes the maps.
+  std::string other_maps = maps.substr(0, maps.rfind('\n', maps.size() - 2) + 1);
+  std::vector<std::unique_ptr<StackSamplePerfEvent>> copies = CopyEvents(events);
+  RecordingTracerListener listener;
+  auto unwind_error_count = std::make_shared<std::atomic<uint64_t>>(0);
+  auto discarded_sample_count = std::make_shared<std::atomic<uint64_t>>(0);
+
+  double cpu_time_begin_s = GetProcessCpuTimeS();
+  auto begin = std::chrono::steady_clock::now();
+  LinuxTracing::LibunwindstackUnwinder::SetElfCachingEnabled(elf_caching);
+  {
+    LinuxTracing::UprobesUnwindingVisitor visitor{maps};
+    visitor.SetListener(&listener);
+    visitor.SetUnwindErrorsAndDiscardedSamplesCounters(unwind_error_count, discarded_sample_count);
+    visitor.SetUnwindingThreadCount(unwinding_thread_count);
+    for (size_t i = 0; i < copies.size(); ++i) {
+      if (maps_refresh_period > 0 && i > 0 && i % maps_refresh_period == 0) {
+        MapsPerfEvent maps_event{0, (i / maps_refresh_period) % 2 == 0 ? maps : other_maps};
+        maps_event.Accept(&visitor);
+      }
+      std::unique_ptr<StackSamplePerfEvent>& event = copies[i];
+      event->Accept(&visitor);
+      // Like PerfEventProcessor, destroy the events once visited.
+      event.reset();
+    }
+  }
+  LinuxTracing::LibunwindstackUnwinder::SetElfCachingEnabled(false);
+  double duration_s =
+      std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+  double cpu_time_s = GetProcessCpuTimeS() - cpu_time_begin_s;
+
+  printf("%-10u %14.0f %14.1f %12lu %14lu %14lu\n", unwinding_thread_count,
+         events.size() / duration_s, 1e6 * cpu_time_s / events.size(),
+         listener.timestamps_ns.size(), listener.address_info_count, unwind_error_count->load());
+  return listener.timestamps_ns;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  absl::ParseCommandLine(argc, argv);
+  uint32_t busy_thread_count = absl::GetFlag(FLAGS_busy_threads);
+  uint32_t depth = absl::GetFlag(FLAGS_depth);
+
+  std::vector<std::thread> busy_threads;
+  for (uint32_t i = 0; i < busy_thread_count; ++i) {
+    busy_threads.emplace_back([depth] { Recurse(depth); });
+  }
+  std::vector<std::unique_ptr<StackSamplePerfEvent>> events =
+      RecordStackSamples(absl::GetFlag(FLAGS_sampling_rate), absl::GetFlag(FLAGS_duration_s));
+  std::string maps = LinuxTracing::ReadMaps(getpid());
+  stop_busy_threads = true;
+  for (std::thread& busy_thread : busy_threads) {
+    busy_thread.join();
+  }
+  printf("%lu stack samples recorded from %u threads at depth %u\n", events.size(),
+         busy_thread_count, depth);
+
+  printf("%-10s %14s %14s %12s %14s %14s\n", "threads", "samples/s", "CPU us/sample",
+         "callstacks", "address infos", "unwind errors");
+  std::vector<uint64_t> expected_timestamps_ns;
+  bool first_run = true;
+  for (const std::string& unwinding_thread_count_string :
+       absl::GetFlag(FLAGS_unwinding_threads)) {
+    uint32_t unwinding_thread_count = std::stoul(unwinding_thread_count_string);
+    std::vector<uint64_t> timestamps_ns =
+        RunBenchmark(maps, events, unwinding_thread_count, absl::GetFlag(FLAGS_maps_refresh_period),
+                     absl::GetFlag(FLAGS_elf_caching));
+    if (first_run) {
+      expected_timestamps_ns = std::move(timestamps_ns);
+      first_run = false;
+    } else if (timestamps_ns != expected_timestamps_ns) {
+      ERROR("Callstacks reported in a different order with %u unwinding threads",
+            unwinding_thread_count);
+    }
+  }
+  return 0;
+}
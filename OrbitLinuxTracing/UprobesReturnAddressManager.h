@@ -52,7 +52,7 @@ class UprobesReturnAddressManager {
         continue;
       }
       const uint64_t& offset = uprobes.stack_pointer - stack_pointer;
-      if (offset >= stack_size) {
+      if (offset + sizeof(uprobes.return_address) > stack_size) {
         continue;
       }
 
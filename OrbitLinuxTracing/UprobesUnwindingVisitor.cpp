@@ -4,6 +4,8 @@
 
 #include "UprobesUnwindingVisitor.h"
 
+#include <algorithm>
+
 #include "OrbitBase/Logging.h"
 
 namespace LinuxTracing {
@@ -13,6 +15,42 @@ using orbit_grpc_protos::Callstack;
 using orbit_grpc_protos::CallstackSample;
 using orbit_grpc_protos::FunctionCall;
 
+// Unwinds a stack sample on an unwinding thread and reports it once the samples
+// before it have been reported.
+class UprobesUnwindingVisitor::UnwindingJob : public SequencedJob {
+ public:
+  // The event is destroyed once it has been visited, so the job can take its
+  // (already patched) stack dump instead of copying it.
+  UnwindingJob(UprobesUnwindingVisitor* visitor, std::shared_ptr<unwindstack::BufferMaps> maps,
+               StackSamplePerfEvent&& event)
+      : visitor_{visitor}, maps_{std::move(maps)}, event_{std::move(event)} {}
+
+  void Run() override {
+    LibunwindstackUnwinder unwinder;
+    unwound_stack_sample_ = visitor_->UnwindStackSample(&unwinder, maps_.get(), event_);
+  }
+
+  void Complete() override {
+    if (unwound_stack_sample_.has_value()) {
+      visitor_->ReportUnwoundStackSample(std::move(unwound_stack_sample_.value()));
+    }
+  }
+
+ private:
+  UprobesUnwindingVisitor* visitor_;
+  std::shared_ptr<unwindstack::BufferMaps> maps_;
+  StackSamplePerfEvent event_;
+  std::optional<UnwoundStackSample> unwound_stack_sample_;
+};
+
+void UprobesUnwindingVisitor::SetUnwindingThreadCount(size_t thread_count) {
+  CHECK(unwinding_thread_pool_ == nullptr);
+  if (thread_count > 0) {
+    unwinding_thread_pool_ =
+        std::make_unique<SequencedThreadPool>(thread_count, MAX_PENDING_UNWINDING_JOBS);
+  }
+}
+
 void UprobesUnwindingVisitor::visit(StackSamplePerfEvent* event) {
   CHECK(listener_ != nullptr);
 
@@ -20,17 +58,67 @@ void UprobesUnwindingVisitor::visit(StackSamplePerfEvent* event) {
     return;
   }
 
+  // Patching depends on the uprobes and uretprobes before the sample, so it
+  // happens here, in order.
   return_address_manager_.PatchSample(event->GetTid(), event->GetRegisters()[PERF_REG_X86_SP],
                                       event->GetStackData(), event->GetStackSize());
 
-  const std::vector<unwindstack::FrameData>& libunwindstack_callstack = unwinder_.Unwind(
-      current_maps_.get(), event->GetRegisters(), event->GetStackData(), event->GetStackSize());
+  if (unwinding_thread_pool_ != nullptr) {
+    unwinding_thread_pool_->Submit(
+        std::make_unique<UnwindingJob>(this, current_maps_, std::move(*event)));
+    return;
+  }
+
+  std::optional<UnwoundStackSample> unwound_stack_sample =
+      UnwindStackSample(&unwinder_, current_maps_.get(), *event);
+  if (unwound_stack_sample.has_value()) {
+    ReportUnwoundStackSample(std::move(unwound_stack_sample.value()));
+  }
+}
+
+std::optional<UprobesUnwindingVisitor::UnwoundStackSample>
+UprobesUnwindingVisitor::UnwindStackSample(LibunwindstackUnwinder* unwinder,
+                                           unwindstack::Maps* maps,
+                                           const StackSamplePerfEvent& event) {
+  LibunwindstackUnwinder::StackDumpAccess stack_dump_access;
+  // Frames whose address hasn't been reported yet. The set is looked up once
+  // per sample, after unwinding, so that the unwinding threads don't contend
+  // for the lock on every frame.
+  std::vector<bool> frames_to_report;
+  auto select_frames_to_report = [this, &frames_to_report](
+                                     const std::vector<unwindstack::FrameData>& frames) {
+    frames_to_report.resize(frames.size());
+    std::lock_guard<std::mutex> lock{reported_addresses_mutex_};
+    for (size_t i = 0; i < frames.size(); ++i) {
+      frames_to_report[i] = !reported_addresses_.contains(frames[i].pc);
+    }
+    return frames_to_report;
+  };
+  const std::vector<unwindstack::FrameData>& libunwindstack_callstack =
+      unwinder->Unwind(maps, event.GetRegisters(), event.GetStackData(), event.GetStackSize(),
+                       &stack_dump_access, select_frames_to_report);
 
   if (libunwindstack_callstack.empty()) {
     if (unwind_error_counter_ != nullptr) {
       ++(*unwind_error_counter_);
     }
-    return;
+    // Tell apart the errors caused by not having copied the part of the stack
+    // dump that unwinding tried to read.
+    if (stack_copy_size_estimator_ != nullptr &&
+        event.GetStackSize() < event.GetDumpedStackSize() &&
+        stack_dump_access.failed_read_offset < event.GetDumpedStackSize()) {
+      stack_copy_size_estimator_->OnUnwindNeededMoreStack(event.GetTid());
+      if (unwind_errors_on_partial_stack_copy_counter_ != nullptr) {
+        ++(*unwind_errors_on_partial_stack_copy_counter_);
+      }
+    }
+    return std::nullopt;
+  }
+
+  if (stack_copy_size_estimator_ != nullptr) {
+    stack_copy_size_estimator_->OnUnwindSucceeded(
+        event.GetTid(), stack_dump_access.read_size,
+        event.GetStackSize() == event.GetDumpedStackSize());
   }
 
   // Some samples can actually fall inside u(ret)probes code. Discard them,
@@ -39,26 +127,58 @@ void UprobesUnwindingVisitor::visit(StackSamplePerfEvent* event) {
     if (discarded_samples_in_uretprobes_counter_ != nullptr) {
       ++(*discarded_samples_in_uretprobes_counter_);
     }
-    return;
+    return std::nullopt;
   }
 
-  CallstackSample sample;
-  sample.set_tid(event->GetTid());
-  sample.set_timestamp_ns(event->GetTimestamp());
-
-  Callstack* callstack = sample.mutable_callstack();
-  for (const unwindstack::FrameData& libunwindstack_frame : libunwindstack_callstack) {
-    AddressInfo address_info;
-    address_info.set_absolute_address(libunwindstack_frame.pc);
-    address_info.set_function_name(libunwindstack_frame.function_name);
-    address_info.set_offset_in_function(libunwindstack_frame.function_offset);
-    address_info.set_map_name(libunwindstack_frame.map_name);
-    listener_->OnAddressInfo(std::move(address_info));
+  UnwoundStackSample unwound_stack_sample;
+  unwound_stack_sample.tid = event.GetTid();
+  unwound_stack_sample.timestamp_ns = event.GetTimestamp();
+  unwound_stack_sample.pcs.reserve(libunwindstack_callstack.size());
+  for (size_t i = 0; i < libunwindstack_callstack.size(); ++i) {
+    const unwindstack::FrameData& libunwindstack_frame = libunwindstack_callstack[i];
+    if (frames_to_report[i]) {
+      AddressInfo& address_info = unwound_stack_sample.address_infos.emplace_back();
+      address_info.set_absolute_address(libunwindstack_frame.pc);
+      address_info.set_function_name(libunwindstack_frame.function_name);
+      address_info.set_offset_in_function(libunwindstack_frame.function_offset);
+      address_info.set_map_name(libunwindstack_frame.map_name);
+    }
 
-    callstack->add_pcs(libunwindstack_frame.pc);
+    unwound_stack_sample.pcs.push_back(libunwindstack_frame.pc);
   }
 
-  listener_->OnCallstackSample(std::move(sample));
+  return unwound_stack_sample;
+}
+
+void UprobesUnwindingVisitor::ReportUnwoundStackSample(UnwoundStackSample unwound_stack_sample) {
+  std::vector<AddressInfo>& address_infos = unwound_stack_sample.address_infos;
+  {
+    // Samples are reported in order, so an address is always reported before
+    // or together with the first callstack that contains it, even if a later
+    // sample was unwound first. Also drops duplicates within this sample.
+    std::lock_guard<std::mutex> lock{reported_addresses_mutex_};
+    address_infos.erase(std::remove_if(address_infos.begin(), address_infos.end(),
+                                       [this](const AddressInfo& address_info) {
+                                         return !reported_addresses_
+                                                     .insert(address_info.absolute_address())
+                                                     .second;
+                                       }),
+                        address_infos.end());
+  }
+  for (AddressInfo& address_info : address_infos) {
+    listener_->OnAddressInfo([&address_info](AddressInfo* listener_address_info) {
+      listener_address_info->set_absolute_address(address_info.absolute_address());
+      listener_address_info->set_function_name(std::move(*address_info.mutable_function_name()));
+      listener_address_info->set_offset_in_function(address_info.offset_in_function());
+      listener_address_info->set_map_name(std::move(*address_info.mutable_map_name()));
+    });
+  }
+  listener_->OnCallstackSample([&unwound_stack_sample](CallstackSample* callstack_sample) {
+    callstack_sample->set_tid(unwound_stack_sample.tid);
+    callstack_sample->set_timestamp_ns(unwound_stack_sample.timestamp_ns);
+    callstack_sample->mutable_callstack()->mutable_pcs()->Add(unwound_stack_sample.pcs.begin(),
+                                                             unwound_stack_sample.pcs.end());
+  });
 }
 
 void UprobesUnwindingVisitor::visit(CallchainSamplePerfEvent* event) {
@@ -90,26 +210,27 @@ void UprobesUnwindingVisitor::visit(CallchainSamplePerfEvent* event) {
     return;
   }
 
-  CallstackSample sample;
-  sample.set_tid(event->GetTid());
-  sample.set_timestamp_ns(event->GetTimestamp());
-
-  Callstack* callstack = sample.mutable_callstack();
-  uint64_t* raw_callchain = event->GetCallchain();
-  // Skip the first frame as the top of a perf_event_open callchain is always
-  // inside kernel code.
-  callstack->add_pcs(raw_callchain[1]);
-  // Only the address of the top of the stack is correct. Frame-based unwinding
-  // uses the return address of a function call as the caller's address.
-  // However, the actual address of the call instruction is before that.
-  // As we don't know the size of the call instruction, we subtract 1 from the
-  // return address. This way we fall into the range of the call instruction.
-  // Note: This is also done the same way in Libunwindstack.
-  for (uint64_t frame_index = 2; frame_index < event->GetCallchainSize(); ++frame_index) {
-    callstack->add_pcs(raw_callchain[frame_index] - 1);
-  }
-
-  listener_->OnCallstackSample(std::move(sample));
+  listener_->OnCallstackSample([event](CallstackSample* sample) {
+    sample->set_tid(event->GetTid());
+    sample->set_timestamp_ns(event->GetTimestamp());
+
+    Callstack* callstack = sample->mutable_callstack();
+    callstack->mutable_pcs()->Reserve(event->GetCallchainSize() - 1);
+    uint64_t* raw_callchain = event->GetCallchain();
+    // Skip the first frame as the top of a perf_event_open callchain is always
+    // inside kernel code.
+    callstack->add_pcs(raw_callchain[1]);
+    // Only the address of the top of the stack is correct. Frame-based
+    // unwinding uses the return address of a function call as the caller's
+    // address. However, the actual address of the call instruction is before
+    // that. As we don't know the size of the call instruction, we subtract 1
+    // from the return address. This way we fall into the range of the call
+    // instruction.
+    // Note: This is also done the same way in Libunwindstack.
+    for (uint64_t frame_index = 2; frame_index < event->GetCallchainSize(); ++frame_index) {
+      callstack->add_pcs(raw_callchain[frame_index] - 1);
+    }
+  });
 }
 
 void UprobesUnwindingVisitor::visit(UprobesPerfEvent* event) {
@@ -166,14 +287,23 @@ void UprobesUnwindingVisitor::visit(UretprobesPerfEvent* event) {
   std::optional<FunctionCall> function_call = function_call_manager_.ProcessUretprobes(
       event->GetTid(), event->GetTimestamp(), event->GetAx());
   if (function_call.has_value()) {
-    listener_->OnFunctionCall(std::move(function_call.value()));
+    // FunctionCall only has scalar fields, so copying it doesn't allocate.
+    listener_->OnFunctionCall([&function_call](FunctionCall* listener_function_call) {
+      *listener_function_call = function_call.value();
+    });
   }
 
   return_address_manager_.ProcessUretprobes(event->GetTid());
 }
 
 void UprobesUnwindingVisitor::visit(MapsPerfEvent* event) {
+  if (event->GetMaps() == current_maps_buffer_) {
+    return;
+  }
+  // Unless ELF caching is enabled, this discards the unwind information parsed
+  // from the ELF files of the previous maps.
   current_maps_ = LibunwindstackUnwinder::ParseMaps(event->GetMaps());
+  current_maps_buffer_ = event->GetMaps();
 }
 
 }  // namespace LinuxTracing
@@ -7,15 +7,22 @@
 
 #include <OrbitLinuxTracing/TracerListener.h>
 
+#include <memory>
+#include <mutex>
+#include <optional>
 #include <stack>
 #include <utility>
+#include <vector>
 
 #include "LibunwindstackUnwinder.h"
 #include "PerfEvent.h"
 #include "PerfEventVisitor.h"
+#include "SequencedThreadPool.h"
+#include "StackCopySizeEstimator.h"
 #include "UprobesFunctionCallManager.h"
 #include "UprobesReturnAddressManager.h"
 #include "absl/container/flat_hash_map.h"
+#include "absl/container/flat_hash_set.h"
 
 namespace LinuxTracing {
 
@@ -31,6 +38,10 @@ namespace LinuxTracing {
 // of the return addresses before they are hijacked, and patches them into the
 // time-based stack samples. Such return addresses can be retrieved by getting
 // the eight bytes at the top of the stack on hitting uprobes.
+// The expensive part, unwinding the stack samples with libunwindstack, can be
+// distributed to a pool of threads (see SetUnwindingThreadCount). The samples
+// are still patched in order on the calling thread, and the resulting
+// callstacks are reported in the order of the samples.
 // TODO: Make this more robust to losing uprobes or uretprobes events, if this
 //  is still observed. For example, pass the address of uretprobes and compare
 //  it against the address of uprobes on the stack.
@@ -38,13 +49,15 @@ namespace LinuxTracing {
 class UprobesUnwindingVisitor : public PerfEventVisitor {
  public:
   explicit UprobesUnwindingVisitor(const std::string& initial_maps)
-      : current_maps_{LibunwindstackUnwinder::ParseMaps(initial_maps)} {}
+      : current_maps_{LibunwindstackUnwinder::ParseMaps(initial_maps)},
+        current_maps_buffer_{initial_maps} {}
 
   UprobesUnwindingVisitor(const UprobesUnwindingVisitor&) = delete;
   UprobesUnwindingVisitor& operator=(const UprobesUnwindingVisitor&) = delete;
 
-  UprobesUnwindingVisitor(UprobesUnwindingVisitor&&) = default;
-  UprobesUnwindingVisitor& operator=(UprobesUnwindingVisitor&&) = default;
+  // The jobs of the unwinding threads refer to the visitor.
+  UprobesUnwindingVisitor(UprobesUnwindingVisitor&&) = delete;
+  UprobesUnwindingVisitor& operator=(UprobesUnwindingVisitor&&) = delete;
 
   void SetListener(TracerListener* listener) { listener_ = listener; }
 
@@ -55,6 +68,22 @@ class UprobesUnwindingVisitor : public PerfEventVisitor {
     discarded_samples_in_uretprobes_counter_ = std::move(discarded_samples_in_uretprobes_counter);
   }
 
+  // Reports to stack_copy_size_estimator how much of the stack dumps unwinding
+  // needs. Unwinding errors caused by stack samples whose stack dump wasn't
+  // copied entirely are also counted in unwind_errors_on_partial_stack_copy_counter.
+  void SetStackCopySizeEstimator(
+      StackCopySizeEstimator* stack_copy_size_estimator,
+      std::shared_ptr<std::atomic<uint64_t>> unwind_errors_on_partial_stack_copy_counter) {
+    stack_copy_size_estimator_ = stack_copy_size_estimator;
+    unwind_errors_on_partial_stack_copy_counter_ =
+        std::move(unwind_errors_on_partial_stack_copy_counter);
+  }
+
+  // With thread_count > 0, stack samples are unwound on that many threads
+  // instead of in visit. Call before visiting any event. Destroying the visitor
+  // waits for the samples that are still being unwound to be reported.
+  void SetUnwindingThreadCount(size_t thread_count);
+
   void visit(StackSamplePerfEvent* event) override;
   void visit(CallchainSamplePerfEvent* event) override;
   void visit(UprobesPerfEvent* event) override;
@@ -62,17 +91,50 @@ class UprobesUnwindingVisitor : public PerfEventVisitor {
   void visit(MapsPerfEvent* event) override;
 
  private:
+  // Each pending job holds a stack dump, so this bounds the memory they use.
+  static constexpr size_t MAX_PENDING_UNWINDING_JOBS = 1024;
+
   UprobesFunctionCallManager function_call_manager_{};
   UprobesReturnAddressManager return_address_manager_{};
-  std::unique_ptr<unwindstack::BufferMaps> current_maps_;
+  // Shared with the jobs of the unwinding threads, as the maps can be replaced
+  // while samples are still being unwound.
+  std::shared_ptr<unwindstack::BufferMaps> current_maps_;
+  // Several mmaps in a row, e.g., from dlopen, often result in identical maps.
+  std::string current_maps_buffer_;
   LibunwindstackUnwinder unwinder_{};
 
   TracerListener* listener_ = nullptr;
   std::shared_ptr<std::atomic<uint64_t>> unwind_error_counter_ = nullptr;
   std::shared_ptr<std::atomic<uint64_t>> discarded_samples_in_uretprobes_counter_ = nullptr;
+  StackCopySizeEstimator* stack_copy_size_estimator_ = nullptr;
+  std::shared_ptr<std::atomic<uint64_t>> unwind_errors_on_partial_stack_copy_counter_ = nullptr;
 
   absl::flat_hash_map<pid_t, std::vector<std::tuple<uint64_t, uint64_t, uint32_t>>>
       uprobe_sps_ips_cpus_per_thread_{};
+
+  // An AddressInfo is only reported the first time its address appears in a
+  // callstack, and the function name is only resolved for such addresses.
+  absl::flat_hash_set<uint64_t> reported_addresses_;
+  std::mutex reported_addresses_mutex_;
+
+  struct UnwoundStackSample {
+    // Only for the addresses that hadn't been reported when unwinding.
+    std::vector<orbit_grpc_protos::AddressInfo> address_infos;
+    pid_t tid;
+    uint64_t timestamp_ns;
+    std::vector<uint64_t> pcs;
+  };
+  class UnwindingJob;
+
+  // Thread-safe, as long as each thread uses its own unwinder. Returns
+  // std::nullopt if the sample shouldn't be reported.
+  std::optional<UnwoundStackSample> UnwindStackSample(LibunwindstackUnwinder* unwinder,
+                                                      unwindstack::Maps* maps,
+                                                      const StackSamplePerfEvent& event);
+  void ReportUnwoundStackSample(UnwoundStackSample unwound_stack_sample);
+
+  // Declared last, so that it is destroyed, and its jobs completed, first.
+  std::unique_ptr<SequencedThreadPool> unwinding_thread_pool_;
 };
 
 }  // namespace LinuxTracing
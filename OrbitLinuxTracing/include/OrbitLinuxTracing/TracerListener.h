@@ -5,20 +5,31 @@
 #ifndef ORBIT_LINUX_TRACING_TRACER_LISTENER_H_
 #define ORBIT_LINUX_TRACING_TRACER_LISTENER_H_
 
+#include "absl/functional/function_ref.h"
 #include "capture.pb.h"
 
 namespace LinuxTracing {
 
+// Each method is called with a function that fills in the event, so that the
+// listener can build the event directly where it stores it, e.g., on an arena,
+// instead of receiving a message that was built elsewhere and has to be copied.
+// The fill function can only be called during the call to the method.
 class TracerListener {
  public:
   virtual ~TracerListener() = default;
-  virtual void OnSchedulingSlice(orbit_grpc_protos::SchedulingSlice scheduling_slice) = 0;
-  virtual void OnCallstackSample(orbit_grpc_protos::CallstackSample callstack_sample) = 0;
-  virtual void OnFunctionCall(orbit_grpc_protos::FunctionCall function_call) = 0;
-  virtual void OnGpuJob(orbit_grpc_protos::GpuJob gpu_job) = 0;
-  virtual void OnThreadName(orbit_grpc_protos::ThreadName thread_name) = 0;
-  virtual void OnAddressInfo(orbit_grpc_protos::AddressInfo address_info) = 0;
-  virtual void OnTracepointEvent(orbit_grpc_protos::TracepointEvent tracepoint_event) = 0;
+  virtual void OnSchedulingSlice(
+      absl::FunctionRef<void(orbit_grpc_protos::SchedulingSlice*)> fill_scheduling_slice) = 0;
+  virtual void OnCallstackSample(
+      absl::FunctionRef<void(orbit_grpc_protos::CallstackSample*)> fill_callstack_sample) = 0;
+  virtual void OnFunctionCall(
+      absl::FunctionRef<void(orbit_grpc_protos::FunctionCall*)> fill_function_call) = 0;
+  virtual void OnGpuJob(absl::FunctionRef<void(orbit_grpc_protos::GpuJob*)> fill_gpu_job) = 0;
+  virtual void OnThreadName(
+      absl::FunctionRef<void(orbit_grpc_protos::ThreadName*)> fill_thread_name) = 0;
+  virtual void OnAddressInfo(
+      absl::FunctionRef<void(orbit_grpc_protos::AddressInfo*)> fill_address_info) = 0;
+  virtual void OnTracepointEvent(
+      absl::FunctionRef<void(orbit_grpc_protos::TracepointEvent*)> fill_tracepoint_event) = 0;
 };
 
 }  // namespace LinuxTracing
@@ -24,6 +24,15 @@ OrbitGLWidget::OrbitGLWidget(QWidget* parent) : QOpenGLWidget(parent) {
   installEventFilter(this);
 }
 
+OrbitGLWidget::~OrbitGLWidget() {
+  if (m_OrbitPanel) {
+    // The buffers of the panel belong to the context of the widget.
+    makeCurrent();
+    m_OrbitPanel->ReleaseGpuResources();
+    doneCurrent();
+  }
+}
+
 bool OrbitGLWidget::eventFilter(QObject* /*object*/, QEvent* event) {
   if (event->type() == QEvent::Paint) {
     if (m_OrbitPanel) {
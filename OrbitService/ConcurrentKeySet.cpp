@@ -0,0 +1,104 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "ConcurrentKeySet.h"
+
+#include "OrbitBase/Logging.h"
+
+namespace orbit_service {
+
+ConcurrentKeySet::Table::Table(size_t capacity)
+    : capacity{capacity}, slots{std::make_unique<std::atomic<uint64_t>[]>(capacity)} {
+  for (size_t i = 0; i < capacity; ++i) {
+    slots[i].store(EMPTY_SLOT, std::memory_order_relaxed);
+  }
+}
+
+ConcurrentKeySet::ConcurrentKeySet(size_t initial_capacity) {
+  size_t capacity = 1;
+  while (capacity < initial_capacity) {
+    capacity *= 2;
+  }
+  absl::MutexLock lock{&mutex_};
+  tables_.push_back(std::make_unique<Table>(capacity));
+  table_.store(tables_.back().get(), std::memory_order_release);
+}
+
+size_t ConcurrentKeySet::GetFirstIndex(uint64_t key, size_t capacity) {
+  // The keys are hashes, but not always good ones (e.g., callstack keys), so
+  // mix them with Fibonacci hashing.
+  return (key * uint64_t{0x9e3779b97f4a7c15}) >> 32u & (capacity - 1);
+}
+
+bool ConcurrentKeySet::Contains(uint64_t key) const {
+  if (key == EMPTY_SLOT) {
+    return contains_empty_slot_key_.load(std::memory_order_acquire);
+  }
+  const Table* table = table_.load(std::memory_order_acquire);
+  for (size_t index = GetFirstIndex(key, table->capacity);;
+       index = (index + 1) & (table->capacity - 1)) {
+    uint64_t slot = table->slots[index].load(std::memory_order_acquire);
+    if (slot == key) {
+      return true;
+    }
+    if (slot == EMPTY_SLOT) {
+      return false;
+    }
+  }
+}
+
+bool ConcurrentKeySet::InsertIntoTable(Table* table, uint64_t key) {
+  for (size_t index = GetFirstIndex(key, table->capacity);;
+       index = (index + 1) & (table->capacity - 1)) {
+    uint64_t slot = table->slots[index].load(std::memory_order_relaxed);
+    if (slot == key) {
+      return false;
+    }
+    if (slot == EMPTY_SLOT) {
+      table->slots[index].store(key, std::memory_order_release);
+      return true;
+    }
+  }
+}
+
+bool ConcurrentKeySet::Insert(uint64_t key) {
+  absl::MutexLock lock{&mutex_};
+  if (key == EMPTY_SLOT) {
+    if (contains_empty_slot_key_.load(std::memory_order_relaxed)) {
+      return false;
+    }
+    contains_empty_slot_key_.store(true, std::memory_order_release);
+    ++size_;
+    return true;
+  }
+
+  if (Contains(key)) {
+    return false;
+  }
+  Table* table = tables_.back().get();
+  // Keep the load factor at most 1/2, so that probe sequences stay short.
+  if (2 * (size_ + 1) > table->capacity) {
+    auto new_table = std::make_unique<Table>(2 * table->capacity);
+    for (size_t i = 0; i < table->capacity; ++i) {
+      uint64_t slot = table->slots[i].load(std::memory_order_relaxed);
+      if (slot != EMPTY_SLOT) {
+        CHECK(InsertIntoTable(new_table.get(), slot));
+      }
+    }
+    tables_.push_back(std::move(new_table));
+    table = tables_.back().get();
+    table_.store(table, std::memory_order_release);
+  }
+
+  CHECK(InsertIntoTable(table, key));
+  ++size_;
+  return true;
+}
+
+size_t ConcurrentKeySet::Size() const {
+  absl::MutexLock lock{&mutex_};
+  return size_;
+}
+
+}  // namespace orbit_service
@@ -0,0 +1,61 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef ORBIT_SERVICE_CONCURRENT_KEY_SET_H_
+#define ORBIT_SERVICE_CONCURRENT_KEY_SET_H_
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "absl/synchronization/mutex.h"
+
+namespace orbit_service {
+
+// An insert-only set of uint64_t keys. Contains never blocks: it probes an
+// open-addressing table of atomics. Insert takes a mutex. When the table grows,
+// the previous tables are kept until the set is destroyed, as Contains could
+// still be probing them. A Contains that races with an Insert of the same key
+// can return false, but never returns false for a key whose Insert has
+// returned before Contains was called.
+class ConcurrentKeySet {
+ public:
+  explicit ConcurrentKeySet(size_t initial_capacity = 1024);
+
+  ConcurrentKeySet(const ConcurrentKeySet&) = delete;
+  ConcurrentKeySet& operator=(const ConcurrentKeySet&) = delete;
+  ConcurrentKeySet(ConcurrentKeySet&&) = delete;
+  ConcurrentKeySet& operator=(ConcurrentKeySet&&) = delete;
+
+  [[nodiscard]] bool Contains(uint64_t key) const;
+  // Returns false if the key was already in the set.
+  bool Insert(uint64_t key);
+  [[nodiscard]] size_t Size() const;
+
+ private:
+  // Slots hold the keys, or EMPTY_SLOT. The key EMPTY_SLOT itself is tracked by
+  // contains_empty_slot_key_.
+  static constexpr uint64_t EMPTY_SLOT = 0;
+
+  struct Table {
+    explicit Table(size_t capacity);
+    size_t capacity;
+    std::unique_ptr<std::atomic<uint64_t>[]> slots;
+  };
+
+  static size_t GetFirstIndex(uint64_t key, size_t capacity);
+  static bool InsertIntoTable(Table* table, uint64_t key);
+
+  std::atomic<Table*> table_;
+  std::atomic<bool> contains_empty_slot_key_ = false;
+
+  mutable absl::Mutex mutex_;
+  std::vector<std::unique_ptr<Table>> tables_ ABSL_GUARDED_BY(mutex_);
+  size_t size_ ABSL_GUARDED_BY(mutex_) = 0;
+};
+
+}  // namespace orbit_service
+
+#endif  // ORBIT_SERVICE_CONCURRENT_KEY_SET_H_
@@ -0,0 +1,71 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "ConcurrentKeySet.h"
+
+namespace orbit_service {
+
+TEST(ConcurrentKeySet, InsertAndContains) {
+  ConcurrentKeySet set;
+  EXPECT_FALSE(set.Contains(42));
+  EXPECT_TRUE(set.Insert(42));
+  EXPECT_TRUE(set.Contains(42));
+  EXPECT_FALSE(set.Insert(42));
+  EXPECT_FALSE(set.Contains(43));
+  EXPECT_EQ(set.Size(), 1);
+}
+
+TEST(ConcurrentKeySet, ZeroKey) {
+  ConcurrentKeySet set;
+  EXPECT_FALSE(set.Contains(0));
+  EXPECT_TRUE(set.Insert(0));
+  EXPECT_TRUE(set.Contains(0));
+  EXPECT_FALSE(set.Insert(0));
+  EXPECT_EQ(set.Size(), 1);
+}
+
+TEST(ConcurrentKeySet, Grows) {
+  ConcurrentKeySet set{4};
+  constexpr uint64_t kKeyCount = 10'000;
+  for (uint64_t key = 0; key < kKeyCount; ++key) {
+    EXPECT_TRUE(set.Insert(key * 31));
+  }
+  EXPECT_EQ(set.Size(), kKeyCount);
+  for (uint64_t key = 0; key < kKeyCount; ++key) {
+    EXPECT_TRUE(set.Contains(key * 31));
+    EXPECT_FALSE(set.Contains(key * 31 + 1));
+  }
+}
+
+TEST(ConcurrentKeySet, ConcurrentInsertsAndContains) {
+  ConcurrentKeySet set{16};
+  constexpr uint64_t kThreadCount = 4;
+  constexpr uint64_t kKeyCount = 20'000;
+  std::atomic<uint64_t> inserted_count = 0;
+  std::vector<std::thread> threads;
+  for (uint64_t thread_index = 0; thread_index < kThreadCount; ++thread_index) {
+    threads.emplace_back([&set, &inserted_count] {
+      for (uint64_t key = 1; key <= kKeyCount; ++key) {
+        if (!set.Contains(key) && set.Insert(key)) {
+          ++inserted_count;
+        }
+        // A key this thread has made sure is inserted must always be found.
+        EXPECT_TRUE(set.Contains(key));
+      }
+    });
+  }
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+  EXPECT_EQ(inserted_count, kKeyCount);
+  EXPECT_EQ(set.Size(), kKeyCount);
+}
+
+}  // namespace orbit_service
@@ -4,6 +4,9 @@
 
 #include "LinuxTracingGrpcHandler.h"
 
+#include <algorithm>
+#include <iterator>
+
 #include "llvm/Demangle/Demangle.h"
 
 namespace orbit_service {
@@ -19,125 +22,122 @@ using orbit_grpc_protos::GpuJob;
 using orbit_grpc_protos::SchedulingSlice;
 using orbit_grpc_protos::ThreadName;
 
+std::atomic<uint64_t> LinuxTracingGrpcHandler::next_id_ = 1;
+
 void LinuxTracingGrpcHandler::Start(CaptureOptions capture_options) {
   CHECK(tracer_ == nullptr);
-  CHECK(!sender_thread_.joinable());
 
-  {
-    // Protect tracer_ with event_buffer_mutex_ so that we can use tracer_ in
-    // Conditions for Await/LockWhen (specifically, in SenderThread).
-    absl::MutexLock lock{&event_buffer_mutex_};
-    tracer_ = std::make_unique<LinuxTracing::Tracer>(std::move(capture_options));
-  }
+  tracer_ = std::make_unique<LinuxTracing::Tracer>(std::move(capture_options));
   tracer_->SetListener(this);
   tracer_->Start();
 
-  sender_thread_ = std::thread{[this] { SenderThread(); }};
+  StartSenderThread();
 }
 
 void LinuxTracingGrpcHandler::Stop() {
   CHECK(tracer_ != nullptr);
-  CHECK(sender_thread_.joinable());
 
   tracer_->Stop();
-  {
-    absl::MutexLock lock{&event_buffer_mutex_};
-    tracer_.reset();
-  }
+  tracer_.reset();
 
-  sender_thread_.join();
+  StopSenderThread();
 }
 
-void LinuxTracingGrpcHandler::OnSchedulingSlice(SchedulingSlice scheduling_slice) {
-  CaptureEvent event;
-  *event.mutable_scheduling_slice() = std::move(scheduling_slice);
+void LinuxTracingGrpcHandler::StartSenderThread() {
+  CHECK(!sender_thread_.joinable());
   {
-    absl::MutexLock lock{&event_buffer_mutex_};
-    event_buffer_.emplace_back(std::move(event));
+    absl::MutexLock lock{&sender_thread_mutex_};
+    stop_sender_thread_ = false;
   }
+  sender_thread_ = std::thread{[this] { SenderThread(); }};
 }
 
-void LinuxTracingGrpcHandler::OnCallstackSample(CallstackSample callstack_sample) {
-  CHECK(callstack_sample.callstack_or_key_case() == CallstackSample::kCallstack);
-  callstack_sample.set_callstack_key(
-      InternCallstackIfNecessaryAndGetKey(callstack_sample.callstack()));
-
-  CaptureEvent event;
-  *event.mutable_callstack_sample() = std::move(callstack_sample);
+void LinuxTracingGrpcHandler::StopSenderThread() {
+  CHECK(sender_thread_.joinable());
   {
-    absl::MutexLock lock{&event_buffer_mutex_};
-    event_buffer_.emplace_back(std::move(event));
+    absl::MutexLock lock{&sender_thread_mutex_};
+    stop_sender_thread_ = true;
   }
+  sender_thread_.join();
 }
 
-void LinuxTracingGrpcHandler::OnFunctionCall(FunctionCall function_call) {
-  CaptureEvent event;
-  *event.mutable_function_call() = std::move(function_call);
-  {
-    absl::MutexLock lock{&event_buffer_mutex_};
-    event_buffer_.emplace_back(std::move(event));
-  }
+void LinuxTracingGrpcHandler::OnSchedulingSlice(
+    absl::FunctionRef<void(SchedulingSlice*)> fill_scheduling_slice) {
+  BufferEvent([fill_scheduling_slice](CaptureEvent* event) {
+    fill_scheduling_slice(event->mutable_scheduling_slice());
+    return true;
+  });
 }
 
-void LinuxTracingGrpcHandler::OnGpuJob(GpuJob gpu_job) {
-  CHECK(gpu_job.timeline_or_key_case() == GpuJob::kTimeline);
-  gpu_job.set_timeline_key(
-      InternStringIfNecessaryAndGetKey(std::move(*gpu_job.mutable_timeline())));
+void LinuxTracingGrpcHandler::OnCallstackSample(
+    absl::FunctionRef<void(CallstackSample*)> fill_callstack_sample) {
+  BufferEvent([this, fill_callstack_sample](CaptureEvent* event) {
+    CallstackSample* callstack_sample = event->mutable_callstack_sample();
+    fill_callstack_sample(callstack_sample);
+    CHECK(callstack_sample->callstack_or_key_case() == CallstackSample::kCallstack);
+    callstack_sample->set_callstack_key(
+        InternCallstackIfNecessaryAndGetKey(callstack_sample->callstack()));
+    return true;
+  });
+}
 
-  CaptureEvent event;
-  *event.mutable_gpu_job() = std::move(gpu_job);
-  {
-    absl::MutexLock lock{&event_buffer_mutex_};
-    event_buffer_.emplace_back(std::move(event));
-  }
+void LinuxTracingGrpcHandler::OnFunctionCall(
+    absl::FunctionRef<void(FunctionCall*)> fill_function_call) {
+  BufferEvent([fill_function_call](CaptureEvent* event) {
+    fill_function_call(event->mutable_function_call());
+    return true;
+  });
 }
 
-void LinuxTracingGrpcHandler::OnThreadName(ThreadName thread_name) {
-  CaptureEvent event;
-  *event.mutable_thread_name() = std::move(thread_name);
-  {
-    absl::MutexLock lock{&event_buffer_mutex_};
-    event_buffer_.emplace_back(std::move(event));
-  }
+void LinuxTracingGrpcHandler::OnGpuJob(absl::FunctionRef<void(GpuJob*)> fill_gpu_job) {
+  BufferEvent([this, fill_gpu_job](CaptureEvent* event) {
+    GpuJob* gpu_job = event->mutable_gpu_job();
+    fill_gpu_job(gpu_job);
+    CHECK(gpu_job->timeline_or_key_case() == GpuJob::kTimeline);
+    gpu_job->set_timeline_key(
+        InternStringIfNecessaryAndGetKey(std::move(*gpu_job->mutable_timeline())));
+    return true;
+  });
 }
 
-void LinuxTracingGrpcHandler::OnAddressInfo(AddressInfo address_info) {
-  {
-    absl::MutexLock lock{&addresses_seen_mutex_};
-    if (addresses_seen_.contains(address_info.absolute_address())) {
-      return;
-    }
-    addresses_seen_.emplace(address_info.absolute_address());
-  }
+void LinuxTracingGrpcHandler::OnThreadName(absl::FunctionRef<void(ThreadName*)> fill_thread_name) {
+  BufferEvent([fill_thread_name](CaptureEvent* event) {
+    fill_thread_name(event->mutable_thread_name());
+    return true;
+  });
+}
 
-  CHECK(address_info.function_name_or_key_case() == AddressInfo::kFunctionName);
-  address_info.set_function_name_key(
-      InternStringIfNecessaryAndGetKey(llvm::demangle(address_info.function_name())));
-  CHECK(address_info.map_name_or_key_case() == AddressInfo::kMapName);
-  address_info.set_map_name_key(
-      InternStringIfNecessaryAndGetKey(std::move(*address_info.mutable_map_name())));
+void LinuxTracingGrpcHandler::OnAddressInfo(
+    absl::FunctionRef<void(AddressInfo*)> fill_address_info) {
+  BufferEvent([this, fill_address_info](CaptureEvent* event) {
+    AddressInfo* address_info = event->mutable_address_info();
+    fill_address_info(address_info);
+    if (addresses_seen_.Contains(address_info->absolute_address()) ||
+        !addresses_seen_.Insert(address_info->absolute_address())) {
+      return false;
+    }
 
-  CaptureEvent event;
-  *event.mutable_address_info() = std::move(address_info);
-  {
-    absl::MutexLock lock{&event_buffer_mutex_};
-    event_buffer_.emplace_back(std::move(event));
-  }
+    CHECK(address_info->function_name_or_key_case() == AddressInfo::kFunctionName);
+    address_info->set_function_name_key(
+        InternStringIfNecessaryAndGetKey(llvm::demangle(address_info->function_name())));
+    CHECK(address_info->map_name_or_key_case() == AddressInfo::kMapName);
+    address_info->set_map_name_key(
+        InternStringIfNecessaryAndGetKey(std::move(*address_info->mutable_map_name())));
+    return true;
+  });
 }
 
 void LinuxTracingGrpcHandler::OnTracepointEvent(
-    orbit_grpc_protos::TracepointEvent tracepoint_event) {
-  CHECK(tracepoint_event.tracepoint_info_or_key_case() ==
-        orbit_grpc_protos::TracepointEvent::kTracepointInfo);
-  tracepoint_event.set_tracepoint_info_key(
-      InternTracepointInfoIfNecessaryAndGetKey(tracepoint_event.tracepoint_info()));
-
-  CaptureEvent event;
-  *event.mutable_tracepoint_event() = std::move(tracepoint_event);
-  {
-    absl::MutexLock lock{&event_buffer_mutex_};
-    event_buffer_.emplace_back(std::move(event));
-  }
+    absl::FunctionRef<void(orbit_grpc_protos::TracepointEvent*)> fill_tracepoint_event) {
+  BufferEvent([this, fill_tracepoint_event](CaptureEvent* event) {
+    orbit_grpc_protos::TracepointEvent* tracepoint_event = event->mutable_tracepoint_event();
+    fill_tracepoint_event(tracepoint_event);
+    CHECK(tracepoint_event->tracepoint_info_or_key_case() ==
+          orbit_grpc_protos::TracepointEvent::kTracepointInfo);
+    tracepoint_event->set_tracepoint_info_key(
+        InternTracepointInfoIfNecessaryAndGetKey(tracepoint_event->tracepoint_info()));
+    return true;
+  });
 }
 
 uint64_t LinuxTracingGrpcHandler::ComputeCallstackKey(const Callstack& callstack) {
@@ -148,23 +148,14 @@ uint64_t LinuxTracingGrpcHandler::ComputeCallstackKey(const Callstack& callstack
   return key;
 }
 
-uint64_t LinuxTracingGrpcHandler::InternCallstackIfNecessaryAndGetKey(Callstack callstack) {
+uint64_t LinuxTracingGrpcHandler::InternCallstackIfNecessaryAndGetKey(const Callstack& callstack) {
   uint64_t key = ComputeCallstackKey(callstack);
-  {
-    absl::MutexLock lock{&callstack_keys_sent_mutex_};
-    if (callstack_keys_sent_.contains(key)) {
-      return key;
-    }
-    callstack_keys_sent_.emplace(key);
-  }
-
-  CaptureEvent event;
-  event.mutable_interned_callstack()->set_key(key);
-  *event.mutable_interned_callstack()->mutable_intern() = std::move(callstack);
-  {
-    absl::MutexLock lock{&event_buffer_mutex_};
-    event_buffer_.emplace_back(std::move(event));
-  }
+  BufferInternedEventIfKeyNotSent(key, &callstack_keys_sent_,
+                                  [key, &callstack](CaptureEvent* event) {
+                                    event->mutable_interned_callstack()->set_key(key);
+                                    *event->mutable_interned_callstack()->mutable_intern() =
+                                        callstack;
+                                  });
   return key;
 }
 
@@ -174,92 +165,175 @@ uint64_t LinuxTracingGrpcHandler::ComputeStringKey(const std::string& str) {
 
 uint64_t LinuxTracingGrpcHandler::InternStringIfNecessaryAndGetKey(std::string str) {
   uint64_t key = ComputeStringKey(str);
-  {
-    absl::MutexLock lock{&string_keys_sent_mutex_};
-    if (string_keys_sent_.contains(key)) {
-      return key;
-    }
-    string_keys_sent_.emplace(key);
-  }
-
-  CaptureEvent event;
-  event.mutable_interned_string()->set_key(key);
-  event.mutable_interned_string()->set_intern(std::move(str));
-  {
-    absl::MutexLock lock{&event_buffer_mutex_};
-    event_buffer_.emplace_back(std::move(event));
-  }
+  BufferInternedEventIfKeyNotSent(key, &string_keys_sent_, [key, &str](CaptureEvent* event) {
+    event->mutable_interned_string()->set_key(key);
+    event->mutable_interned_string()->set_intern(std::move(str));
+  });
   return key;
 }
 
 uint64_t LinuxTracingGrpcHandler::InternTracepointInfoIfNecessaryAndGetKey(
-    orbit_grpc_protos::TracepointInfo tracepoint_info) {
+    const orbit_grpc_protos::TracepointInfo& tracepoint_info) {
   uint64_t key =
       ComputeStringKey(absl::StrCat(tracepoint_info.category(), ":", tracepoint_info.name()));
-  {
-    absl::MutexLock lock{&tracepoint_keys_sent_mutex_};
-    if (tracepoint_keys_sent_.contains(key)) {
-      return key;
-    }
-    tracepoint_keys_sent_.emplace(key);
+  BufferInternedEventIfKeyNotSent(
+      key, &tracepoint_keys_sent_, [key, &tracepoint_info](CaptureEvent* event) {
+        event->mutable_interned_tracepoint_info()->set_key(key);
+        event->mutable_interned_tracepoint_info()->mutable_intern()->set_name(
+            tracepoint_info.name());
+        event->mutable_interned_tracepoint_info()->mutable_intern()->set_category(
+            tracepoint_info.category());
+      });
+  return key;
+}
+
+void LinuxTracingGrpcHandler::BufferInternedEventIfKeyNotSent(
+    uint64_t key, ConcurrentKeySet* keys_sent,
+    absl::FunctionRef<void(CaptureEvent*)> fill_interned_event) {
+  if (keys_sent->Contains(key)) {
+    return;
   }
+  absl::MutexLock lock{&interned_event_buffer_.mutex};
+  if (keys_sent->Contains(key)) {
+    return;
+  }
+  fill_interned_event(AddEvent(&interned_event_buffer_));
+  keys_sent->Insert(key);
+}
+
+LinuxTracingGrpcHandler::ArenaCaptureResponse::ArenaCaptureResponse()
+    : initial_block_{std::make_unique<char[]>(kBlockSize)}, arena_{[this] {
+        google::protobuf::ArenaOptions options;
+        options.initial_block = initial_block_.get();
+        options.initial_block_size = kBlockSize;
+        options.start_block_size = kBlockSize;
+        options.max_block_size = kBlockSize;
+        return options;
+      }()} {
+  response_ = google::protobuf::Arena::CreateMessage<CaptureResponse>(&arena_);
+}
+
+void LinuxTracingGrpcHandler::ArenaCaptureResponse::Reset() {
+  // This frees all blocks but the initial one.
+  arena_.Reset();
+  response_ = google::protobuf::Arena::CreateMessage<CaptureResponse>(&arena_);
+}
+
+CaptureEvent* LinuxTracingGrpcHandler::AddEvent(EventBuffer* buffer) {
+  if (buffer->response == nullptr) {
+    buffer->response = std::make_unique<ArenaCaptureResponse>();
+  } else if (buffer->response->response()->capture_events_size() == kMaxEventsPerResponse) {
+    buffer->full_responses.emplace_back(std::move(buffer->response));
+    buffer->response = std::make_unique<ArenaCaptureResponse>();
+  }
+  return buffer->response->response()->add_capture_events();
+}
 
-  CaptureEvent event;
-  event.mutable_interned_tracepoint_info()->set_key(key);
-  event.mutable_interned_tracepoint_info()->mutable_intern()->set_name(tracepoint_info.name());
-  event.mutable_interned_tracepoint_info()->mutable_intern()->set_category(
-      tracepoint_info.category());
+LinuxTracingGrpcHandler::EventBuffer* LinuxTracingGrpcHandler::GetThreadEventBuffer() {
+  thread_local uint64_t cached_handler_id = 0;
+  thread_local EventBuffer* cached_buffer = nullptr;
+  if (cached_handler_id == id_) {
+    return cached_buffer;
+  }
+
+  auto buffer = std::make_unique<EventBuffer>();
+  cached_handler_id = id_;
+  cached_buffer = buffer.get();
+  absl::MutexLock lock{&thread_event_buffers_mutex_};
+  thread_event_buffers_.emplace_back(std::move(buffer));
+  return cached_buffer;
+}
+
+void LinuxTracingGrpcHandler::BufferEvent(absl::FunctionRef<bool(CaptureEvent*)> fill_event) {
+  EventBuffer* buffer = GetThreadEventBuffer();
   {
-    absl::MutexLock lock{&event_buffer_mutex_};
-    event_buffer_.emplace_back(std::move(event));
+    // Only contended when SenderThread is collecting this buffer.
+    absl::MutexLock lock{&buffer->mutex};
+    if (!fill_event(AddEvent(buffer))) {
+      // The event is the last one of the current response, even if AddEvent
+      // has just started a new one.
+      buffer->response->response()->mutable_capture_events()->RemoveLast();
+      return;
+    }
+  }
+  if (++buffered_event_count_ == kSendEventCountInterval) {
+    // Let SenderThread re-evaluate its condition.
+    absl::MutexLock lock{&sender_thread_mutex_};
   }
-  return key;
 }
 
 void LinuxTracingGrpcHandler::SenderThread() {
   pthread_setname_np(pthread_self(), "SenderThread");
   constexpr absl::Duration kSendTimeInterval = absl::Milliseconds(20);
-  // This should be lower than kMaxEventsPerResponse in SendBufferedEvents as
-  // a few more events are likely to arrive after the condition becomes true.
-  constexpr uint64_t kSendEventCountInterval = 5000;
 
   bool stopped = false;
   while (!stopped) {
-    event_buffer_mutex_.LockWhenWithTimeout(absl::Condition(
-                                                +[](LinuxTracingGrpcHandler* self) {
-                                                  return self->event_buffer_.size() >=
-                                                             kSendEventCountInterval ||
-                                                         self->tracer_ == nullptr;
-                                                },
-                                                this),
-                                            kSendTimeInterval);
-    if (tracer_ == nullptr) {
-      stopped = true;
-    }
-    std::vector<CaptureEvent> buffered_events = std::move(event_buffer_);
-    event_buffer_.clear();
-    event_buffer_mutex_.Unlock();
-    SendBufferedEvents(std::move(buffered_events));
+    sender_thread_mutex_.LockWhenWithTimeout(absl::Condition(
+                                                 +[](LinuxTracingGrpcHandler* self) {
+                                                   return self->buffered_event_count_ >=
+                                                              kSendEventCountInterval ||
+                                                          self->stop_sender_thread_;
+                                                 },
+                                                 this),
+                                             kSendTimeInterval);
+    stopped = stop_sender_thread_;
+    sender_thread_mutex_.Unlock();
+    SendBufferedResponses(CollectBufferedResponses());
   }
 }
 
-void LinuxTracingGrpcHandler::SendBufferedEvents(std::vector<CaptureEvent>&& buffered_events) {
-  if (buffered_events.empty()) {
-    return;
+void LinuxTracingGrpcHandler::CollectResponses(
+    EventBuffer* buffer, std::vector<std::unique_ptr<ArenaCaptureResponse>>* responses) {
+  std::unique_ptr<ArenaCaptureResponse> free_response;
+  if (!free_responses_.empty()) {
+    free_response = std::move(free_responses_.back());
+    free_responses_.pop_back();
+  } else {
+    free_response = std::make_unique<ArenaCaptureResponse>();
   }
-  constexpr uint64_t kMaxEventsPerResponse = 10'000;
-  CaptureResponse response;
-  for (CaptureEvent& event : buffered_events) {
-    // We buffer to avoid sending countless tiny messages, but we also want to
-    // avoid huge messages, which would cause the capture on the client to jump
-    // forward in time in few big steps and not look live anymore.
-    if (response.capture_events_size() == kMaxEventsPerResponse) {
-      reader_writer_->Write(response);
-      response.clear_capture_events();
+
+  absl::MutexLock lock{&buffer->mutex};
+  std::move(buffer->full_responses.begin(), buffer->full_responses.end(),
+            std::back_inserter(*responses));
+  buffer->full_responses.clear();
+  if (buffer->response != nullptr && buffer->response->response()->capture_events_size() > 0) {
+    responses->emplace_back(std::move(buffer->response));
+    buffer->response = std::move(free_response);
+  } else {
+    free_responses_.emplace_back(std::move(free_response));
+  }
+}
+
+std::vector<std::unique_ptr<LinuxTracingGrpcHandler::ArenaCaptureResponse>>
+LinuxTracingGrpcHandler::CollectBufferedResponses() {
+  std::vector<std::unique_ptr<ArenaCaptureResponse>> responses;
+  {
+    absl::MutexLock lock{&thread_event_buffers_mutex_};
+    for (const std::unique_ptr<EventBuffer>& buffer : thread_event_buffers_) {
+      CollectResponses(buffer.get(), &responses);
     }
-    response.mutable_capture_events()->Add(std::move(event));
   }
-  reader_writer_->Write(response);
+  uint64_t event_count = 0;
+  for (const std::unique_ptr<ArenaCaptureResponse>& response : responses) {
+    event_count += response->response()->capture_events_size();
+  }
+  buffered_event_count_ -= event_count;
+
+  // Collect the interned events *after* the other events, so that the interned
+  // events the other events refer to are included.
+  std::vector<std::unique_ptr<ArenaCaptureResponse>> buffered_responses;
+  CollectResponses(&interned_event_buffer_, &buffered_responses);
+  std::move(responses.begin(), responses.end(), std::back_inserter(buffered_responses));
+  return buffered_responses;
+}
+
+void LinuxTracingGrpcHandler::SendBufferedResponses(
+    std::vector<std::unique_ptr<ArenaCaptureResponse>>&& responses) {
+  for (std::unique_ptr<ArenaCaptureResponse>& response : responses) {
+    reader_writer_->Write(*response->response());
+    response->Reset();
+    free_responses_.emplace_back(std::move(response));
+  }
 }
 
 }  // namespace orbit_service
@@ -9,18 +9,30 @@
 #include <OrbitLinuxTracing/Tracer.h>
 #include <OrbitLinuxTracing/TracerListener.h>
 
-#include "absl/container/flat_hash_set.h"
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "ConcurrentKeySet.h"
+#include "absl/functional/function_ref.h"
 #include "absl/synchronization/mutex.h"
+#include "google/protobuf/arena.h"
 #include "services.grpc.pb.h"
 
 namespace orbit_service {
 
+// The TracerListener methods are called concurrently by several threads of the
+// Tracer. Each of those threads builds its events in place in its own
+// CaptureResponse, allocated on an arena, and SenderThread collects and writes
+// the responses of all threads. The keys of interned callstacks, strings and
+// tracepoints that have already been sent are looked up without blocking.
 class LinuxTracingGrpcHandler : public LinuxTracing::TracerListener {
  public:
   explicit LinuxTracingGrpcHandler(
-      grpc::ServerReaderWriter<orbit_grpc_protos::CaptureResponse,
-                               orbit_grpc_protos::CaptureRequest>* reader_writer)
-      : reader_writer_{reader_writer} {}
+      grpc::ServerReaderWriterInterface<orbit_grpc_protos::CaptureResponse,
+                                        orbit_grpc_protos::CaptureRequest>* reader_writer)
+      : reader_writer_{reader_writer}, id_{next_id_++} {}
 
   ~LinuxTracingGrpcHandler() override = default;
   LinuxTracingGrpcHandler(const LinuxTracingGrpcHandler&) = delete;
@@ -31,41 +43,117 @@ class LinuxTracingGrpcHandler : public LinuxTracing::TracerListener {
   void Start(orbit_grpc_protos::CaptureOptions capture_options);
   void Stop();
 
-  void OnSchedulingSlice(orbit_grpc_protos::SchedulingSlice scheduling_slice) override;
-  void OnCallstackSample(orbit_grpc_protos::CallstackSample callstack_sample) override;
-  void OnFunctionCall(orbit_grpc_protos::FunctionCall function_call) override;
-  void OnGpuJob(orbit_grpc_protos::GpuJob gpu_job) override;
-  void OnThreadName(orbit_grpc_protos::ThreadName thread_name) override;
-  void OnAddressInfo(orbit_grpc_protos::AddressInfo address_info) override;
-  void OnTracepointEvent(orbit_grpc_protos::TracepointEvent tracepoint_event) override;
+  // Start and Stop call these. They are public so that the handler can also be
+  // fed without a Tracer, e.g., by benchmarks.
+  void StartSenderThread();
+  void StopSenderThread();
+
+  void OnSchedulingSlice(absl::FunctionRef<void(orbit_grpc_protos::SchedulingSlice*)>
+                             fill_scheduling_slice) override;
+  void OnCallstackSample(absl::FunctionRef<void(orbit_grpc_protos::CallstackSample*)>
+                             fill_callstack_sample) override;
+  void OnFunctionCall(
+      absl::FunctionRef<void(orbit_grpc_protos::FunctionCall*)> fill_function_call) override;
+  void OnGpuJob(absl::FunctionRef<void(orbit_grpc_protos::GpuJob*)> fill_gpu_job) override;
+  void OnThreadName(
+      absl::FunctionRef<void(orbit_grpc_protos::ThreadName*)> fill_thread_name) override;
+  void OnAddressInfo(
+      absl::FunctionRef<void(orbit_grpc_protos::AddressInfo*)> fill_address_info) override;
+  void OnTracepointEvent(absl::FunctionRef<void(orbit_grpc_protos::TracepointEvent*)>
+                             fill_tracepoint_event) override;
 
  private:
-  grpc::ServerReaderWriter<orbit_grpc_protos::CaptureResponse, orbit_grpc_protos::CaptureRequest>*
-      reader_writer_;
+  static std::atomic<uint64_t> next_id_;
+
+  grpc::ServerReaderWriterInterface<orbit_grpc_protos::CaptureResponse,
+                                    orbit_grpc_protos::CaptureRequest>* reader_writer_;
   std::unique_ptr<LinuxTracing::Tracer> tracer_;
 
   [[nodiscard]] static uint64_t ComputeCallstackKey(const orbit_grpc_protos::Callstack& callstack);
   [[nodiscard]] uint64_t InternCallstackIfNecessaryAndGetKey(
-      orbit_grpc_protos::Callstack callstack);
+      const orbit_grpc_protos::Callstack& callstack);
   [[nodiscard]] static uint64_t ComputeStringKey(const std::string& str);
   [[nodiscard]] uint64_t InternStringIfNecessaryAndGetKey(std::string str);
   [[nodiscard]] uint64_t InternTracepointInfoIfNecessaryAndGetKey(
-      orbit_grpc_protos::TracepointInfo tracepoint_info);
+      const orbit_grpc_protos::TracepointInfo& tracepoint_info);
+
+  // A CaptureResponse on its own arena. Its memory is reused once the response
+  // has been written, so building an event rarely allocates.
+  class ArenaCaptureResponse {
+   public:
+    ArenaCaptureResponse();
+    [[nodiscard]] orbit_grpc_protos::CaptureResponse* response() { return response_; }
+    void Reset();
+
+   private:
+    static constexpr size_t kBlockSize = 64 * 1024;
+    std::unique_ptr<char[]> initial_block_;
+    google::protobuf::Arena arena_;
+    orbit_grpc_protos::CaptureResponse* response_;
+  };
 
-  absl::flat_hash_set<uint64_t> addresses_seen_;
-  absl::Mutex addresses_seen_mutex_;
-  absl::flat_hash_set<uint64_t> callstack_keys_sent_;
-  absl::Mutex callstack_keys_sent_mutex_;
-  absl::flat_hash_set<uint64_t> string_keys_sent_;
-  absl::Mutex string_keys_sent_mutex_;
-  absl::flat_hash_set<uint64_t> tracepoint_keys_sent_;
-  absl::Mutex tracepoint_keys_sent_mutex_;
+  // Events are added to response until it holds kMaxEventsPerResponse events,
+  // then it is moved to full_responses. We buffer to avoid sending countless
+  // tiny messages, but we also want to avoid huge messages, which would cause
+  // the capture on the client to jump forward in time in few big steps and not
+  // look live anymore.
+  struct EventBuffer {
+    absl::Mutex mutex;
+    std::vector<std::unique_ptr<ArenaCaptureResponse>> full_responses ABSL_GUARDED_BY(mutex);
+    std::unique_ptr<ArenaCaptureResponse> response ABSL_GUARDED_BY(mutex);
+  };
+  static constexpr int kMaxEventsPerResponse = 10'000;
+  static orbit_grpc_protos::CaptureEvent* AddEvent(EventBuffer* buffer)
+      ABSL_EXCLUSIVE_LOCKS_REQUIRED(buffer->mutex);
+
+  // The events are built in place, in the arena of the response of the thread.
+  // fill_event returns false if the event should be dropped after all. It can
+  // buffer interned events: SenderThread never holds interned_event_buffer_.mutex
+  // while waiting for the mutex of a thread's buffer.
+  void BufferEvent(absl::FunctionRef<bool(orbit_grpc_protos::CaptureEvent*)> fill_event);
+  // An interned event must reach the client before any event that refers to
+  // its key. Interned events are buffered separately, and the key is only added
+  // to the set of sent keys afterwards, under interned_event_buffer_.mutex.
+  // Once a thread finds a key in the set, the interned event is buffered, and
+  // SenderThread collects the interned events after the other events and sends
+  // them first.
+  void BufferInternedEventIfKeyNotSent(uint64_t key, ConcurrentKeySet* keys_sent,
+                                       absl::FunctionRef<void(orbit_grpc_protos::CaptureEvent*)>
+                                           fill_interned_event);
+
+  ConcurrentKeySet addresses_seen_;
+  ConcurrentKeySet callstack_keys_sent_;
+  ConcurrentKeySet string_keys_sent_;
+  ConcurrentKeySet tracepoint_keys_sent_;
 
   void SenderThread();
-  void SendBufferedEvents(std::vector<orbit_grpc_protos::CaptureEvent>&& buffered_events);
+  // Replaces the response of the buffer with one from free_responses_.
+  void CollectResponses(EventBuffer* buffer,
+                        std::vector<std::unique_ptr<ArenaCaptureResponse>>* responses);
+  std::vector<std::unique_ptr<ArenaCaptureResponse>> CollectBufferedResponses();
+  void SendBufferedResponses(std::vector<std::unique_ptr<ArenaCaptureResponse>>&& responses);
+  // Responses that have been written, ready to be reused. Only accessed by
+  // SenderThread.
+  std::vector<std::unique_ptr<ArenaCaptureResponse>> free_responses_;
+
+  EventBuffer* GetThreadEventBuffer();
+
+  // Distinguishes this handler from previous ones in the thread-local caches of
+  // GetThreadEventBuffer, even if it has the same address.
+  const uint64_t id_;
+  absl::Mutex thread_event_buffers_mutex_;
+  std::vector<std::unique_ptr<EventBuffer>> thread_event_buffers_
+      ABSL_GUARDED_BY(thread_event_buffers_mutex_);
+  EventBuffer interned_event_buffer_;
+  // The number of events in the thread buffers. SenderThread is woken up early
+  // when it reaches kSendEventCountInterval.
+  std::atomic<uint64_t> buffered_event_count_ = 0;
+  // This should be lower than kMaxEventsPerResponse as a few more events are
+  // likely to arrive after the condition becomes true.
+  static constexpr uint64_t kSendEventCountInterval = 5000;
 
-  std::vector<orbit_grpc_protos::CaptureEvent> event_buffer_;
-  absl::Mutex event_buffer_mutex_;
+  bool stop_sender_thread_ ABSL_GUARDED_BY(sender_thread_mutex_) = false;
+  absl::Mutex sender_thread_mutex_;
   std::thread sender_thread_;
 };
 
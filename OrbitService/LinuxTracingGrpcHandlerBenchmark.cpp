@@ -0,0 +1,297 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// Feeds LinuxTracingGrpcHandler from several threads at once, like the
+// Tracer's ring buffer readers, deferred events thread and GPU event
+// processing do. The producers emit a mix of scheduling slices, function calls,
+// callstack samples (from a limited set of callstacks), address infos and GPU
+// jobs. The events are written to a fake stream or, with --grpc, sent to a
+// client through an in-process gRPC server. Either way, the receiving side
+// counts the events and checks that each interned key has been sent before it
+// is referenced. Reports the events per second, and the heap allocations and
+// the CPU time per event on the service side.
+
+#include <OrbitBase/Logging.h>
+#include <time.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <limits>
+#include <new>
+#include <thread>
+#include <vector>
+
+#include "LinuxTracingGrpcHandler.h"
+#include "absl/container/flat_hash_set.h"
+#include "absl/flags/flag.h"
+#include "absl/flags/parse.h"
+
+ABSL_FLAG(uint32_t, threads, 4, "Number of threads calling the handler");
+ABSL_FLAG(uint64_t, events, 1'000'000, "Number of events per thread");
+ABSL_FLAG(uint32_t, callstacks, 1000, "Number of distinct callstacks");
+ABSL_FLAG(uint32_t, callstack_depth, 32, "Number of frames per callstack");
+ABSL_FLAG(bool, grpc, false, "Send the events through an in-process gRPC server");
+
+namespace {
+
+std::atomic<uint64_t> heap_allocation_count = 0;
+// The gRPC client runs on the main thread. Its allocations are not counted.
+thread_local bool count_heap_allocations = true;
+
+}  // namespace
+
+void* operator new(size_t size) {
+  if (count_heap_allocations) {
+    heap_allocation_count.fetch_add(1, std::memory_order_relaxed);
+  }
+  void* ptr = malloc(size == 0 ? 1 : size);
+  if (ptr == nullptr) {
+    throw std::bad_alloc{};
+  }
+  return ptr;
+}
+
+void operator delete(void* ptr) noexcept { free(ptr); }
+
+void operator delete(void* ptr, size_t /*size*/) noexcept { free(ptr); }
+
+namespace {
+
+using orbit_grpc_protos::CaptureEvent;
+using orbit_grpc_protos::CaptureRequest;
+using orbit_grpc_protos::CaptureResponse;
+
+class EventChecker {
+ public:
+  void Check(const CaptureResponse& response) {
+    for (const CaptureEvent& event : response.capture_events()) {
+      ++event_count_;
+      switch (event.event_case()) {
+        case CaptureEvent::kInternedCallstack:
+          callstack_keys_.insert(event.interned_callstack().key());
+          break;
+        case CaptureEvent::kInternedString:
+          string_keys_.insert(event.interned_string().key());
+          break;
+        case CaptureEvent::kCallstackSample:
+          if (!callstack_keys_.contains(event.callstack_sample().callstack_key())) {
+            ++unknown_key_count_;
+          }
+          break;
+        case CaptureEvent::kGpuJob:
+          if (!string_keys_.contains(event.gpu_job().timeline_key())) {
+            ++unknown_key_count_;
+          }
+          break;
+        case CaptureEvent::kAddressInfo:
+          if (!string_keys_.contains(event.address_info().function_name_key()) ||
+              !string_keys_.contains(event.address_info().map_name_key())) {
+            ++unknown_key_count_;
+          }
+          break;
+        default:
+          break;
+      }
+    }
+  }
+
+  [[nodiscard]] uint64_t event_count() const { return event_count_; }
+  [[nodiscard]] uint64_t unknown_key_count() const { return unknown_key_count_; }
+
+ private:
+  uint64_t event_count_ = 0;
+  uint64_t unknown_key_count_ = 0;
+  absl::flat_hash_set<uint64_t> callstack_keys_;
+  absl::flat_hash_set<uint64_t> string_keys_;
+};
+
+class CheckingWriter
+    : public grpc::ServerReaderWriterInterface<CaptureResponse, CaptureRequest> {
+ public:
+  void SendInitialMetadata() override {}
+  bool NextMessageSize(uint32_t* /*sz*/) override { return false; }
+  bool Read(CaptureRequest* /*msg*/) override { return false; }
+
+  // Only called from SenderThread.
+  bool Write(const CaptureResponse& response, grpc::WriteOptions /*options*/) override {
+    checker.Check(response);
+    return true;
+  }
+
+  EventChecker checker;
+};
+
+void ProduceEvents(orbit_service::LinuxTracingGrpcHandler* handler, uint32_t thread_index,
+                   uint64_t event_count, uint32_t callstack_count, uint32_t callstack_depth) {
+  for (uint64_t i = 0; i < event_count; ++i) {
+    uint64_t timestamp_ns = i * 1000;
+    switch (i % 8) {
+      case 0:
+      case 1:
+      case 2:
+        handler->OnSchedulingSlice(
+            [thread_index, timestamp_ns](orbit_grpc_protos::SchedulingSlice* scheduling_slice) {
+              scheduling_slice->set_pid(1);
+              scheduling_slice->set_tid(thread_index);
+              scheduling_slice->set_core(thread_index);
+              scheduling_slice->set_in_timestamp_ns(timestamp_ns);
+              scheduling_slice->set_out_timestamp_ns(timestamp_ns + 500);
+            });
+        break;
+      case 3:
+      case 4:
+        handler->OnFunctionCall(
+            [thread_index, timestamp_ns, i](orbit_grpc_protos::FunctionCall* function_call) {
+              function_call->set_tid(thread_index);
+              function_call->set_absolute_address(0x1000 + i % 100);
+              function_call->set_begin_timestamp_ns(timestamp_ns);
+              function_call->set_end_timestamp_ns(timestamp_ns + 500);
+            });
+        break;
+      case 5:
+      case 6: {
+        uint64_t callstack_index = (i * 7919) % callstack_count;
+        if (i < 8 * uint64_t{callstack_count}) {
+          // Most address infos arrive at the beginning of a capture.
+          for (uint32_t depth = 0; depth < callstack_depth; ++depth) {
+            uint64_t pc = 0x10000 + callstack_index * callstack_depth + depth;
+            handler->OnAddressInfo([pc, depth](orbit_grpc_protos::AddressInfo* address_info) {
+              address_info->set_absolute_address(pc);
+              address_info->set_function_name("_ZN7example8functionEv");
+              address_info->set_offset_in_function(depth);
+              address_info->set_map_name("/usr/lib/libexample.so");
+            });
+          }
+        }
+        handler->OnCallstackSample(
+            [thread_index, timestamp_ns, callstack_index,
+             callstack_depth](orbit_grpc_protos::CallstackSample* callstack_sample) {
+              callstack_sample->set_tid(thread_index);
+              callstack_sample->set_timestamp_ns(timestamp_ns);
+              orbit_grpc_protos::Callstack* callstack = callstack_sample->mutable_callstack();
+              callstack->mutable_pcs()->Reserve(callstack_depth);
+              for (uint32_t depth = 0; depth < callstack_depth; ++depth) {
+                callstack->add_pcs(0x10000 + callstack_index * callstack_depth + depth);
+              }
+            });
+      } break;
+      case 7:
+        handler->OnGpuJob([thread_index, timestamp_ns, i](orbit_grpc_protos::GpuJob* gpu_job) {
+          gpu_job->set_tid(thread_index);
+          gpu_job->set_timeline(i % 16 == 7 ? "gfx" : "sdma0");
+          gpu_job->set_amdgpu_cs_ioctl_time_ns(timestamp_ns);
+        });
+        break;
+    }
+  }
+}
+
+// Feeds the handler from the producer threads and returns the duration until
+// all events have been written.
+double RunHandler(
+    grpc::ServerReaderWriterInterface<CaptureResponse, CaptureRequest>* reader_writer) {
+  uint32_t thread_count = absl::GetFlag(FLAGS_threads);
+  uint64_t event_count = absl::GetFlag(FLAGS_events);
+  uint32_t callstack_count = absl::GetFlag(FLAGS_callstacks);
+  uint32_t callstack_depth = absl::GetFlag(FLAGS_callstack_depth);
+
+  auto begin = std::chrono::steady_clock::now();
+  orbit_service::LinuxTracingGrpcHandler handler{reader_writer};
+  handler.StartSenderThread();
+  std::vector<std::thread> threads;
+  for (uint32_t i = 0; i < thread_count; ++i) {
+    threads.emplace_back(ProduceEvents, &handler, i, event_count, callstack_count,
+                         callstack_depth);
+  }
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+  handler.StopSenderThread();
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+}
+
+class BenchmarkCaptureService final : public orbit_grpc_protos::CaptureService::Service {
+ public:
+  grpc::Status Capture(grpc::ServerContext* /*context*/,
+                       grpc::ServerReaderWriter<CaptureResponse, CaptureRequest>* reader_writer)
+      override {
+    CaptureRequest request;
+    reader_writer->Read(&request);
+    duration_s = RunHandler(reader_writer);
+    return grpc::Status::OK;
+  }
+
+  // Read by the client after the call has finished.
+  double duration_s = 0;
+};
+
+// Returns the duration measured by the server.
+double ReceiveThroughGrpc(EventChecker* checker) {
+  count_heap_allocations = false;
+  BenchmarkCaptureService service;
+  grpc::ServerBuilder builder;
+  builder.RegisterService(&service);
+  std::unique_ptr<grpc::Server> server = builder.BuildAndStart();
+  FAIL_IF(server == nullptr, "Could not start the gRPC server");
+
+  grpc::ChannelArguments channel_arguments;
+  channel_arguments.SetMaxReceiveMessageSize(std::numeric_limits<int32_t>::max());
+  std::unique_ptr<orbit_grpc_protos::CaptureService::Stub> stub =
+      orbit_grpc_protos::CaptureService::NewStub(server->InProcessChannel(channel_arguments));
+  grpc::ClientContext context;
+  auto reader_writer = stub->Capture(&context);
+  reader_writer->Write(CaptureRequest{});
+  reader_writer->WritesDone();
+  CaptureResponse response;
+  while (reader_writer->Read(&response)) {
+    checker->Check(response);
+  }
+  grpc::Status status = reader_writer->Finish();
+  FAIL_IF(!status.ok(), "Capture failed: %s", status.error_message().c_str());
+  server->Shutdown();
+  return service.duration_s;
+}
+
+double GetCpuTimeS(clockid_t clock_id) {
+  timespec time{};
+  clock_gettime(clock_id, &time);
+  return time.tv_sec + time.tv_nsec / 1e9;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  absl::ParseCommandLine(argc, argv);
+  uint32_t thread_count = absl::GetFlag(FLAGS_threads);
+  uint64_t event_count = absl::GetFlag(FLAGS_events);
+
+  EventChecker checker;
+  CheckingWriter writer;
+  uint64_t heap_allocation_count_begin = heap_allocation_count;
+  double process_cpu_time_begin_s = GetCpuTimeS(CLOCK_PROCESS_CPUTIME_ID);
+  double main_thread_cpu_time_begin_s = GetCpuTimeS(CLOCK_THREAD_CPUTIME_ID);
+  double duration_s;
+  if (absl::GetFlag(FLAGS_grpc)) {
+    duration_s = ReceiveThroughGrpc(&checker);
+  } else {
+    duration_s = RunHandler(&writer);
+  }
+  // The main thread either waits for the producers or is the gRPC client.
+  double service_cpu_time_s =
+      (GetCpuTimeS(CLOCK_PROCESS_CPUTIME_ID) - process_cpu_time_begin_s) -
+      (GetCpuTimeS(CLOCK_THREAD_CPUTIME_ID) - main_thread_cpu_time_begin_s);
+  uint64_t heap_allocations = heap_allocation_count - heap_allocation_count_begin;
+  const EventChecker& result = absl::GetFlag(FLAGS_grpc) ? checker : writer.checker;
+
+  uint64_t produced_event_count = thread_count * event_count;
+  printf("%u threads: %.0f events/s, %.2f allocs/event, %.3f CPU us/event\n", thread_count,
+         produced_event_count / duration_s,
+         static_cast<double>(heap_allocations) / produced_event_count,
+         1e6 * service_cpu_time_s / produced_event_count);
+  printf("%lu events sent, %lu referring to unsent keys\n", result.event_count(),
+         result.unknown_key_count());
+  return result.unknown_key_count() == 0 ? 0 : 1;
+}